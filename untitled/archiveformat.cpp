@@ -0,0 +1,62 @@
+#include "archiveformat.h"
+#include "depthprediction.h"
+
+namespace
+{
+    inline int predictAt(const quint16* row, const quint16* up, int x, int y)
+    {
+        if (y == 0)
+        {
+            return x > 0 ? row[x - 1] : 0;
+        }
+        if (x == 0)
+        {
+            return up[0];
+        }
+        return predictMed(row[x - 1], up[x], up[x - 1]);
+    }
+}
+
+namespace archive
+{
+    void packDepthFrame(const quint16* src, int width, int height, int strideBytes, uchar* dst)
+    {
+        // Residuals of smooth surfaces and of invalid (zero) areas are
+        // small, so the high plane is nearly all zeros and compresses away.
+        uchar* lowPlane = dst;
+        uchar* highPlane = dst + width * height;
+        const quint16* up = NULL;
+        for (int y = 0; y < height; ++y)
+        {
+            const quint16* row = reinterpret_cast<const quint16*>(reinterpret_cast<const uchar*>(src) + y * strideBytes);
+            for (int x = 0; x < width; ++x)
+            {
+                quint16 value = zigzag(row[x] - predictAt(row, up, x, y));
+                lowPlane[x] = uchar(value);
+                highPlane[x] = uchar(value >> 8);
+            }
+            lowPlane += width;
+            highPlane += width;
+            up = row;
+        }
+    }
+
+    void unpackDepthFrame(const uchar* src, int width, int height, quint16* dst)
+    {
+        const uchar* lowPlane = src;
+        const uchar* highPlane = src + width * height;
+        const quint16* up = NULL;
+        for (int y = 0; y < height; ++y)
+        {
+            quint16* row = dst + y * width;
+            for (int x = 0; x < width; ++x)
+            {
+                quint16 value = quint16(lowPlane[x] | (highPlane[x] << 8));
+                row[x] = quint16(predictAt(row, up, x, y) + unzigzag(value));
+            }
+            lowPlane += width;
+            highPlane += width;
+            up = row;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef ARCHIVEFORMAT_H
+#define ARCHIVEFORMAT_H
+
+#include <QtGlobal>
+
+// On-disk layout of .oca frame archives, a random-access alternative to .oni.
+//
+//   FileHeader | chunk | chunk | ... | footer
+//
+// A chunk holds up to framesPerChunk consecutive frames of one stream,
+// compressed together. Every chunk and the footer start on a
+// kChunkAlignment boundary and all structures are naturally aligned, so a
+// mapped file is read in place. The footer describes the streams, gives the
+// timestamp of every frame and the position of every chunk; the header
+// points at it. Frames are numbered from 1 per stream, are stored without
+// row padding and all frames of a stream have the same size.
+// Values are little endian.
+
+namespace archive
+{
+    const quint32 kFileMagic = 0x3141434F;   // "OCA1"
+    const quint32 kChunkMagic = 0x4B4E4843;  // "CHNK"
+    const quint32 kFooterMagic = 0x5846434F; // "OCFX"
+    const quint32 kVersion = 1;
+
+    const int kChunkAlignment = 4096;
+
+    enum Codec
+    {
+        // The frames as they are, zlib compressed.
+        CODEC_ZLIB = 0,
+        // 16-bit depth: median edge predictor residuals, zigzag coded and
+        // split into a low and a high byte plane per frame, zlib compressed.
+        CODEC_DEPTH_MED_ZLIB = 1,
+        // 16-bit depth: DepthEncoder frames (depthcodec.h), each preceded by
+        // its quint32 size. The first frame of a chunk is a key frame.
+        CODEC_DEPTH_PREDICTIVE = 2
+    };
+
+    struct FileHeader
+    {
+        quint32 magic;
+        quint32 version;
+        quint64 footerOffset;
+        quint32 footerSize;
+        quint32 framesPerChunk;
+        quint32 reserved[10];
+    };
+
+    struct ChunkHeader
+    {
+        quint32 magic;
+        quint32 stream;
+        quint32 firstFrame;
+        quint32 frameCount;
+        quint32 codec;
+        quint32 rawSize;
+        quint32 packedSize;
+        quint32 reserved;
+    };
+
+    struct FooterHeader
+    {
+        quint32 magic;
+        quint32 streamCount;
+        quint32 chunkCount;
+        quint32 reserved;
+    };
+
+    // Followed in the footer by chunkCount ChunkEntry, then for every
+    // stream frameCount quint64 timestamps.
+    struct StreamDesc
+    {
+        quint32 sensorType;
+        quint32 pixelFormat;
+        quint32 width;
+        quint32 height;
+        quint32 bytesPerPixel;
+        quint32 fps;
+        quint32 frameCount;
+        quint32 maxDepth;
+        float horizontalFov;
+        float verticalFov;
+        quint32 reserved[2];
+    };
+
+    struct ChunkEntry
+    {
+        quint64 offset;
+        quint32 stream;
+        quint32 firstFrame;
+        quint32 frameCount;
+        quint32 size;
+    };
+
+    static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+    static_assert(sizeof(ChunkHeader) == 32, "ChunkHeader layout");
+    static_assert(sizeof(FooterHeader) == 16, "FooterHeader layout");
+    static_assert(sizeof(StreamDesc) == 48, "StreamDesc layout");
+    static_assert(sizeof(ChunkEntry) == 24, "ChunkEntry layout");
+
+    inline qint64 alignUp(qint64 value)
+    {
+        return (value + kChunkAlignment - 1) / kChunkAlignment * kChunkAlignment;
+    }
+
+    // CODEC_DEPTH_MED_ZLIB frame transform, before and after zlib.
+    // dst receives 2 * width * height bytes; src rows are strideBytes apart.
+    void packDepthFrame(const quint16* src, int width, int height, int strideBytes, uchar* dst);
+
+    // Inverse of packDepthFrame, dst is written without row padding.
+    void unpackDepthFrame(const uchar* src, int width, int height, quint16* dst);
+}
+
+#endif // ARCHIVEFORMAT_H
@@ -0,0 +1,236 @@
+#include "archivereader.h"
+#include "depthcodec.h"
+#include <QObject>
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    // The frames of the chunk one after another, empty on damaged data.
+    // Temporal prediction chains them, so the whole chunk is decoded at once.
+    QByteArray decodeDepthChunk(const char* data, int size, int frameCount, int width, int height)
+    {
+        int frameBytes = width * height * int(sizeof(openni::DepthPixel));
+        QByteArray frames(frameCount * frameBytes, Qt::Uninitialized);
+        DepthDecoder decoder;
+        int offset = 0;
+        for (int i = 0; i < frameCount; ++i)
+        {
+            quint32 frameSize = 0;
+            if (offset + 4 > size)
+            {
+                return QByteArray();
+            }
+            memcpy(&frameSize, data + offset, 4);
+            offset += 4;
+            if (frameSize > quint32(size - offset) ||
+                !decoder.decode(data + offset, int(frameSize), reinterpret_cast<openni::DepthPixel*>(frames.data() + i * frameBytes),
+                                width, height))
+            {
+                return QByteArray();
+            }
+            offset += int(frameSize);
+        }
+
+        return frames;
+    }
+}
+
+ArchiveReader::ArchiveReader()
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    close();
+}
+
+bool ArchiveReader::fail(const QString& error)
+{
+    close();
+    m_errorString = error;
+    return false;
+}
+
+bool ArchiveReader::open(const QString& fileName)
+{
+    close();
+    m_errorString.clear();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        return fail(m_file.errorString());
+    }
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(archive::FileHeader)))
+    {
+        return fail(QObject::tr("Not an archive"));
+    }
+
+    // Mapped once; the OS pages chunks in as they are read.
+    m_pMap = m_file.map(0, m_size);
+    if (m_pMap == NULL)
+    {
+        return fail(m_file.errorString());
+    }
+
+    const archive::FileHeader* pHeader = reinterpret_cast<const archive::FileHeader*>(m_pMap);
+    if (pHeader->magic != archive::kFileMagic || pHeader->version != archive::kVersion)
+    {
+        return fail(QObject::tr("Not an archive"));
+    }
+    if (pHeader->footerOffset == 0 || pHeader->footerOffset + pHeader->footerSize > quint64(m_size) ||
+        pHeader->footerSize < sizeof(archive::FooterHeader) || pHeader->framesPerChunk == 0)
+    {
+        return fail(QObject::tr("The archive is incomplete"));
+    }
+    m_framesPerChunk = int(pHeader->framesPerChunk);
+
+    const uchar* footer = m_pMap + pHeader->footerOffset;
+    const uchar* footerEnd = footer + pHeader->footerSize;
+    const archive::FooterHeader* pFooter = reinterpret_cast<const archive::FooterHeader*>(footer);
+    const archive::StreamDesc* descs = reinterpret_cast<const archive::StreamDesc*>(pFooter + 1);
+    const archive::ChunkEntry* entries = reinterpret_cast<const archive::ChunkEntry*>(descs + pFooter->streamCount);
+    const quint64* timestamps = reinterpret_cast<const quint64*>(entries + pFooter->chunkCount);
+    if (pFooter->magic != archive::kFooterMagic || reinterpret_cast<const uchar*>(timestamps) > footerEnd)
+    {
+        return fail(QObject::tr("Damaged archive footer"));
+    }
+
+    m_streams.resize(int(pFooter->streamCount));
+    for (int s = 0; s < m_streams.size(); ++s)
+    {
+        m_streams[s].pDesc = &descs[s];
+        m_streams[s].timestamps = timestamps;
+        timestamps += descs[s].frameCount;
+    }
+    if (reinterpret_cast<const uchar*>(timestamps) > footerEnd)
+    {
+        return fail(QObject::tr("Damaged archive footer"));
+    }
+
+    for (quint32 i = 0; i < pFooter->chunkCount; ++i)
+    {
+        const archive::ChunkEntry& entry = entries[i];
+        if (entry.stream >= pFooter->streamCount || entry.offset + entry.size > quint64(m_size) ||
+            entry.size < sizeof(archive::ChunkHeader))
+        {
+            return fail(QObject::tr("Damaged archive index"));
+        }
+        m_streams[int(entry.stream)].chunks.append(&entry);
+    }
+
+    return true;
+}
+
+void ArchiveReader::close()
+{
+    if (m_pMap != NULL)
+    {
+        m_file.unmap(const_cast<uchar*>(m_pMap));
+        m_pMap = NULL;
+    }
+    m_file.close();
+    m_size = 0;
+    m_streams.clear();
+}
+
+int ArchiveReader::findStream(openni::SensorType sensorType) const
+{
+    for (int s = 0; s < m_streams.size(); ++s)
+    {
+        if (m_streams[s].pDesc->sensorType == quint32(sensorType))
+        {
+            return s;
+        }
+    }
+
+    return -1;
+}
+
+int ArchiveReader::frameAtTimestamp(int stream, quint64 timestamp) const
+{
+    const StreamState& state = m_streams[stream];
+    const quint64* end = state.timestamps + state.pDesc->frameCount;
+    const quint64* it = std::upper_bound(state.timestamps, end, timestamp);
+
+    return qMax(1, int(it - state.timestamps));
+}
+
+bool ArchiveReader::readFrame(int stream, int frameId, ArchiveFrame* pFrame)
+{
+    if (stream < 0 || stream >= m_streams.size())
+    {
+        return false;
+    }
+    StreamState& state = m_streams[stream];
+    const archive::StreamDesc& desc = *state.pDesc;
+    if (frameId < 1 || frameId > int(desc.frameCount))
+    {
+        return false;
+    }
+
+    // Every chunk but the last of a stream is full.
+    int chunkIndex = (frameId - 1) / m_framesPerChunk;
+    if (chunkIndex >= state.chunks.size())
+    {
+        return false;
+    }
+    const archive::ChunkEntry& entry = *state.chunks[chunkIndex];
+    int frameInChunk = frameId - int(entry.firstFrame);
+    if (frameInChunk < 0 || frameInChunk >= int(entry.frameCount))
+    {
+        return false;
+    }
+
+    int rowBytes = int(desc.width * desc.bytesPerPixel);
+    int frameBytes = rowBytes * int(desc.height);
+
+    if (chunkIndex != state.cachedChunk)
+    {
+        const archive::ChunkHeader* pHeader = reinterpret_cast<const archive::ChunkHeader*>(m_pMap + entry.offset);
+        if (pHeader->magic != archive::kChunkMagic || sizeof(*pHeader) + pHeader->packedSize > entry.size ||
+            pHeader->codec > archive::CODEC_DEPTH_PREDICTIVE)
+        {
+            m_errorString = QObject::tr("Damaged chunk at %1").arg(entry.offset);
+            return false;
+        }
+
+        state.cachedChunk = -1;
+        if (pHeader->codec == archive::CODEC_DEPTH_PREDICTIVE)
+        {
+            state.chunkData = decodeDepthChunk(reinterpret_cast<const char*>(pHeader + 1), int(pHeader->packedSize),
+                                               int(entry.frameCount), int(desc.width), int(desc.height));
+        }
+        else
+        {
+            state.chunkData = qUncompress(reinterpret_cast<const uchar*>(pHeader + 1), int(pHeader->packedSize));
+        }
+        if (state.chunkData.size() != int(pHeader->rawSize) || state.chunkData.size() < int(entry.frameCount) * frameBytes)
+        {
+            m_errorString = QObject::tr("Damaged chunk at %1").arg(entry.offset);
+            return false;
+        }
+        state.cachedChunk = chunkIndex;
+        state.cachedCodec = pHeader->codec;
+    }
+
+    const char* data = state.chunkData.constData() + frameInChunk * frameBytes;
+    if (state.cachedCodec == archive::CODEC_DEPTH_MED_ZLIB)
+    {
+        state.frameData.resize(frameBytes);
+        archive::unpackDepthFrame(reinterpret_cast<const uchar*>(data), int(desc.width), int(desc.height),
+                                  reinterpret_cast<quint16*>(state.frameData.data()));
+        data = state.frameData.constData();
+    }
+
+    pFrame->data = data;
+    pFrame->width = int(desc.width);
+    pFrame->height = int(desc.height);
+    pFrame->strideBytes = rowBytes;
+    pFrame->frameIndex = frameId;
+    pFrame->timestamp = state.timestamps[frameId - 1];
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "OpenNI.h"
+#include "archiveformat.h"
+
+// A decoded archive frame. data belongs to the reader and stays valid until
+// the next readFrame() of the same stream or close().
+struct ArchiveFrame
+{
+    const void* data = NULL;
+    int width = 0;
+    int height = 0;
+    int strideBytes = 0;
+    int frameIndex = 0;
+    quint64 timestamp = 0;
+};
+
+// Random-access reader for .oca archives written by transcodeToArchive().
+// The file is memory mapped; a frame costs one chunk decompression when its
+// chunk is not the one decoded last for that stream. Not thread safe, use
+// one reader per thread.
+class ArchiveReader
+{
+public:
+    ArchiveReader();
+    ~ArchiveReader();
+
+    bool open(const QString& fileName);
+
+    void close();
+
+    bool isOpen() const { return m_pMap != NULL; }
+
+    QString errorString() const { return m_errorString; }
+
+    // Index of the first stream of sensorType, or -1.
+    int findStream(openni::SensorType sensorType) const;
+
+    const archive::StreamDesc& streamDesc(int stream) const { return *m_streams[stream].pDesc; }
+
+    int getNumberOfFrames(int stream) const { return int(m_streams[stream].pDesc->frameCount); }
+
+    // The last frame of the stream taken at or before timestamp, at least 1.
+    int frameAtTimestamp(int stream, quint64 timestamp) const;
+
+    // frameId counts from 1.
+    bool readFrame(int stream, int frameId, ArchiveFrame* pFrame);
+
+private:
+    ArchiveReader(const ArchiveReader&);
+    ArchiveReader& operator=(const ArchiveReader&);
+
+    struct StreamState
+    {
+        const archive::StreamDesc* pDesc;
+        const quint64* timestamps;
+        QVector<const archive::ChunkEntry*> chunks;
+
+        // The chunk decoded last, as stored before the codec's frame transform.
+        int cachedChunk = -1;
+        quint32 cachedCodec = 0;
+        QByteArray chunkData;
+        QByteArray frameData;
+    };
+
+    bool fail(const QString& error);
+
+    QFile m_file;
+    const uchar* m_pMap = NULL;
+    qint64 m_size = 0;
+    int m_framesPerChunk = 0;
+    QVector<StreamState> m_streams;
+    QString m_errorString;
+};
+
+#endif // ARCHIVEREADER_H
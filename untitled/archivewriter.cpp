@@ -0,0 +1,333 @@
+#include "archivewriter.h"
+#include "archiveformat.h"
+#include "recordingreader.h"
+#include "depthcodec.h"
+#include "taskscheduler.h"
+#include "frameconvert.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QObject>
+#include <QQueue>
+#include <QVector>
+#include <string.h>
+
+namespace
+{
+    // About half a second at 30 fps: the most a random seek has to decode.
+    const int kFramesPerChunk = 16;
+
+    const int kCompressionLevel = 6;
+
+    // Chunks being compressed or waiting to be written, per worker thread.
+    const int kChunksInFlightPerThread = 2;
+
+    struct PendingChunk
+    {
+        archive::ChunkEntry entry;
+        quint32 codec;
+        quint32 rawSize;
+        QFuture<QByteArray> packed;
+    };
+
+    QByteArray packChunk(QByteArray raw, quint32 codec, int width, int height)
+    {
+        if (codec == archive::CODEC_DEPTH_PREDICTIVE)
+        {
+            // Chunks already run in parallel, the bands of a frame need not.
+            DepthEncoder encoder;
+            encoder.setParallel(false);
+            int frameBytes = width * height * 2;
+            QByteArray packed;
+            for (int offset = 0; offset + frameBytes <= raw.size(); offset += frameBytes)
+            {
+                QByteArray frame = encoder.encode(reinterpret_cast<const openni::DepthPixel*>(raw.constData() + offset),
+                                                  width, height, width * 2, offset == 0);
+                quint32 frameSize = quint32(frame.size());
+                packed.append(reinterpret_cast<const char*>(&frameSize), 4);
+                packed.append(frame);
+            }
+            return packed;
+        }
+
+        if (codec == archive::CODEC_DEPTH_MED_ZLIB)
+        {
+            int frameBytes = width * height * 2;
+            QByteArray planes(raw.size(), Qt::Uninitialized);
+            for (int offset = 0; offset + frameBytes <= raw.size(); offset += frameBytes)
+            {
+                archive::packDepthFrame(reinterpret_cast<const quint16*>(raw.constData() + offset), width, height,
+                                        width * 2, reinterpret_cast<uchar*>(planes.data() + offset));
+            }
+            raw = planes;
+        }
+
+        return qCompress(raw, kCompressionLevel);
+    }
+
+    bool writePadding(QFile& file)
+    {
+        qint64 padding = archive::alignUp(file.pos()) - file.pos();
+        if (padding == 0)
+        {
+            return true;
+        }
+        QByteArray zeros(int(padding), '\0');
+        return file.write(zeros) == padding;
+    }
+
+    bool writeChunk(QFile& file, PendingChunk& chunk, QVector<archive::ChunkEntry>* pEntries)
+    {
+        TaskScheduler::instance()->waitFor(chunk.packed);
+        QByteArray packed = chunk.packed.result();
+        if (!writePadding(file))
+        {
+            return false;
+        }
+
+        archive::ChunkHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = archive::kChunkMagic;
+        header.stream = chunk.entry.stream;
+        header.firstFrame = chunk.entry.firstFrame;
+        header.frameCount = chunk.entry.frameCount;
+        header.codec = chunk.codec;
+        header.rawSize = chunk.rawSize;
+        header.packedSize = quint32(packed.size());
+
+        chunk.entry.offset = quint64(file.pos());
+        chunk.entry.size = quint32(sizeof(header) + packed.size());
+        pEntries->append(chunk.entry);
+
+        return file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header)) &&
+               file.write(packed) == packed.size();
+    }
+}
+
+bool transcodeToArchive(const QString& oniFileName, const QString& archiveFileName, QString* pError,
+                        ArchiveStats* pStats, const QAtomicInt* pCanceled, QAtomicInt* pProgress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RecordingReader reader;
+    if (reader.open(oniFileName) != openni::STATUS_OK)
+    {
+        *pError = QObject::tr("%1: %2").arg(oniFileName).arg(QString::fromLatin1(openni::OpenNI::getExtendedError()));
+        return false;
+    }
+
+    const openni::SensorType sensorTypes[] = {openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR};
+    QVector<openni::SensorType> sensors;
+    qint64 totalFrames = 0;
+    for (size_t i = 0; i < sizeof(sensorTypes) / sizeof(sensorTypes[0]); ++i)
+    {
+        if (reader.hasStream(sensorTypes[i]))
+        {
+            sensors.append(sensorTypes[i]);
+            totalFrames += reader.getNumberOfFrames(sensorTypes[i]);
+        }
+    }
+    if (sensors.isEmpty() || totalFrames <= 0)
+    {
+        *pError = QObject::tr("%1: no frames found").arg(oniFileName);
+        return false;
+    }
+
+    QFile file(archiveFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        *pError = QObject::tr("%1: %2").arg(archiveFileName).arg(file.errorString());
+        return false;
+    }
+
+    archive::FileHeader fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    fileHeader.magic = archive::kFileMagic;
+    fileHeader.version = archive::kVersion;
+    fileHeader.framesPerChunk = kFramesPerChunk;
+    // Written again with the footer position once everything is in.
+    if (file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader)) != qint64(sizeof(fileHeader)))
+    {
+        *pError = file.errorString();
+        return false;
+    }
+
+    QVector<archive::StreamDesc> streams;
+    QVector<QVector<quint64> > timestamps;
+    QVector<archive::ChunkEntry> entries;
+    QQueue<PendingChunk> pending;
+    int maxInFlight = qMax(2, TaskScheduler::instance()->workerCount() * kChunksInFlightPerThread);
+    qint64 framesDone = 0;
+    qint64 rawBytes = 0;
+    bool bOk = true;
+
+    for (int s = 0; s < sensors.size() && bOk; ++s)
+    {
+        openni::VideoFrameRef frame;
+        int numberOfFrames = reader.getNumberOfFrames(sensors[s]);
+        openni::Status nRetVal = reader.readFrameAt(sensors[s], 1, &frame);
+        if (nRetVal != openni::STATUS_OK || !frame.isValid())
+        {
+            continue;
+        }
+
+        openni::VideoStream* pStream = reader.stream(sensors[s]);
+        archive::StreamDesc desc;
+        memset(&desc, 0, sizeof(desc));
+        desc.sensorType = quint32(sensors[s]);
+        desc.pixelFormat = quint32(frame.getVideoMode().getPixelFormat());
+        desc.width = quint32(frame.getWidth());
+        desc.height = quint32(frame.getHeight());
+        desc.bytesPerPixel = quint32(bytesPerPixel(frame.getVideoMode().getPixelFormat()));
+        desc.fps = quint32(reader.getFps(sensors[s]));
+        desc.maxDepth = sensors[s] == openni::SENSOR_DEPTH ? quint32(pStream->getMaxPixelValue()) : 0;
+        desc.horizontalFov = pStream->getHorizontalFieldOfView();
+        desc.verticalFov = pStream->getVerticalFieldOfView();
+
+        quint32 streamIndex = quint32(streams.size());
+        quint32 codec = (sensors[s] == openni::SENSOR_DEPTH && desc.bytesPerPixel == 2)
+                        ? archive::CODEC_DEPTH_PREDICTIVE : archive::CODEC_ZLIB;
+        int rowBytes = int(desc.width * desc.bytesPerPixel);
+        int frameBytes = rowBytes * int(desc.height);
+        QVector<quint64> streamTimestamps;
+        QByteArray raw;
+
+        for (int i = 0; i < numberOfFrames; ++i)
+        {
+            if (pCanceled != NULL && pCanceled->load())
+            {
+                *pError = QObject::tr("Canceled");
+                bOk = false;
+                break;
+            }
+
+            if (raw.isEmpty())
+            {
+                raw.reserve(frameBytes * kFramesPerChunk);
+            }
+            const char* data = static_cast<const char*>(frame.getData());
+            for (int y = 0; y < int(desc.height); ++y)
+            {
+                raw.append(data + y * frame.getStrideInBytes(), rowBytes);
+            }
+            streamTimestamps.append(frame.getTimestamp());
+
+            bool bLast = (i + 1 == numberOfFrames);
+            if (!bLast)
+            {
+                // A mode change mid-file cannot be stored, the stream ends there.
+                nRetVal = reader.readNextFrame(sensors[s], &frame);
+                bLast = (nRetVal != openni::STATUS_OK || frame.getWidth() != int(desc.width) ||
+                         frame.getHeight() != int(desc.height));
+            }
+
+            int framesInChunk = raw.size() / frameBytes;
+            if (framesInChunk == kFramesPerChunk || bLast)
+            {
+                PendingChunk chunk;
+                chunk.entry.offset = 0;
+                chunk.entry.stream = streamIndex;
+                chunk.entry.firstFrame = quint32(streamTimestamps.size() - framesInChunk + 1);
+                chunk.entry.frameCount = quint32(framesInChunk);
+                chunk.entry.size = 0;
+                chunk.codec = codec;
+                chunk.rawSize = quint32(raw.size());
+                int width = int(desc.width);
+                int height = int(desc.height);
+                chunk.packed = TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [raw, codec, width, height]()
+                {
+                    return packChunk(raw, codec, width, height);
+                });
+                pending.enqueue(chunk);
+                rawBytes += raw.size();
+                raw = QByteArray();
+
+                // Compression runs ahead, chunks land in the file in order.
+                while (pending.size() >= maxInFlight && bOk)
+                {
+                    bOk = writeChunk(file, pending.head(), &entries);
+                    pending.dequeue();
+                }
+            }
+
+            ++framesDone;
+            if (pProgress != NULL)
+            {
+                pProgress->store(int(framesDone * 1000 / totalFrames));
+            }
+
+            if (bLast)
+            {
+                break;
+            }
+        }
+
+        desc.frameCount = quint32(streamTimestamps.size());
+        streams.append(desc);
+        timestamps.append(streamTimestamps);
+    }
+
+    while (!pending.isEmpty())
+    {
+        if (bOk)
+        {
+            bOk = writeChunk(file, pending.head(), &entries);
+        }
+        else
+        {
+            TaskScheduler::instance()->waitFor(pending.head().packed);
+        }
+        pending.dequeue();
+    }
+
+    if (!bOk)
+    {
+        if (pError->isEmpty())
+        {
+            *pError = file.errorString();
+        }
+        file.remove();
+        return false;
+    }
+
+    QByteArray footer;
+    archive::FooterHeader footerHeader;
+    memset(&footerHeader, 0, sizeof(footerHeader));
+    footerHeader.magic = archive::kFooterMagic;
+    footerHeader.streamCount = quint32(streams.size());
+    footerHeader.chunkCount = quint32(entries.size());
+    footer.append(reinterpret_cast<const char*>(&footerHeader), sizeof(footerHeader));
+    footer.append(reinterpret_cast<const char*>(streams.constData()), int(streams.size() * sizeof(archive::StreamDesc)));
+    footer.append(reinterpret_cast<const char*>(entries.constData()), int(entries.size() * sizeof(archive::ChunkEntry)));
+    for (int s = 0; s < timestamps.size(); ++s)
+    {
+        footer.append(reinterpret_cast<const char*>(timestamps[s].constData()), int(timestamps[s].size() * sizeof(quint64)));
+    }
+
+    bOk = writePadding(file);
+    fileHeader.footerOffset = quint64(file.pos());
+    fileHeader.footerSize = quint32(footer.size());
+    bOk = bOk && file.write(footer) == footer.size();
+    bOk = bOk && file.seek(0) &&
+          file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader)) == qint64(sizeof(fileHeader));
+    if (!bOk)
+    {
+        *pError = file.errorString();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    if (pStats != NULL)
+    {
+        pStats->frames = int(framesDone);
+        pStats->sourceBytes = QFileInfo(oniFileName).size();
+        pStats->rawBytes = rawBytes;
+        pStats->archiveBytes = QFileInfo(archiveFileName).size();
+        pStats->seconds = timer.elapsed() / 1000.0;
+    }
+
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef ARCHIVEWRITER_H
+#define ARCHIVEWRITER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+struct ArchiveStats
+{
+    int frames = 0;
+    qint64 sourceBytes = 0;
+    // Decoded frame data, what a raw copy would take.
+    qint64 rawBytes = 0;
+    qint64 archiveBytes = 0;
+    double seconds = 0;
+};
+
+// Transcodes every stream of an .oni recording into an .oca archive (see
+// archiveformat.h). Frames are decoded through a RecordingReader, chunks are
+// compressed in parallel as background tasks of the scheduler and written
+// in order.
+// pProgress, when given, receives the progress in per mille.
+bool transcodeToArchive(const QString& oniFileName, const QString& archiveFileName, QString* pError,
+                        ArchiveStats* pStats = NULL, const QAtomicInt* pCanceled = NULL, QAtomicInt* pProgress = NULL);
+
+#endif // ARCHIVEWRITER_H
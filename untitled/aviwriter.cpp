@@ -0,0 +1,218 @@
+#include "aviwriter.h"
+#include <QObject>
+
+namespace
+{
+    const quint32 kAviFlagHasIndex = 0x10;
+    const quint32 kIndexFlagKeyFrame = 0x10;
+
+    // Leaves room for the index, every offset must fit in 31 bits.
+    const qint64 kMaxFileBytes = 0x7F000000;
+
+    // Header field positions, fixed by the layout written in open().
+    const int kRiffSizePosition = 4;
+    const int kMaxBytesPerSecPosition = 36;
+    const int kTotalFramesPosition = 48;
+    const int kAviSuggestedBufferPosition = 60;
+    const int kStreamLengthPosition = 140;
+    const int kStreamSuggestedBufferPosition = 144;
+    const int kMoviSizePosition = 216;
+
+    void appendFourCC(QByteArray* pData, const char* fourCC)
+    {
+        pData->append(fourCC, 4);
+    }
+
+    void appendUInt32(QByteArray* pData, quint32 value)
+    {
+        char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+        pData->append(bytes, 4);
+    }
+
+    void appendUInt16(QByteArray* pData, quint16 value)
+    {
+        char bytes[2] = {char(value), char(value >> 8)};
+        pData->append(bytes, 2);
+    }
+}
+
+AviWriter::AviWriter()
+{
+}
+
+AviWriter::~AviWriter()
+{
+    if (m_file.isOpen())
+    {
+        close();
+    }
+}
+
+bool AviWriter::open(const QString& fileName, int width, int height, int fps)
+{
+    m_fps = qMax(1, fps);
+    m_maxFrameSize = 0;
+    m_index.clear();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    QByteArray header;
+    appendFourCC(&header, "RIFF");
+    appendUInt32(&header, 0);
+    appendFourCC(&header, "AVI ");
+
+    appendFourCC(&header, "LIST");
+    appendUInt32(&header, 192);
+    appendFourCC(&header, "hdrl");
+
+    appendFourCC(&header, "avih");
+    appendUInt32(&header, 56);
+    appendUInt32(&header, quint32(1000000 / m_fps));
+    appendUInt32(&header, 0);                  // max bytes per second
+    appendUInt32(&header, 0);                  // padding granularity
+    appendUInt32(&header, kAviFlagHasIndex);
+    appendUInt32(&header, 0);                  // total frames
+    appendUInt32(&header, 0);                  // initial frames
+    appendUInt32(&header, 1);                  // streams
+    appendUInt32(&header, 0);                  // suggested buffer size
+    appendUInt32(&header, quint32(width));
+    appendUInt32(&header, quint32(height));
+    for (int i = 0; i < 4; ++i)
+    {
+        appendUInt32(&header, 0);
+    }
+
+    appendFourCC(&header, "LIST");
+    appendUInt32(&header, 116);
+    appendFourCC(&header, "strl");
+
+    appendFourCC(&header, "strh");
+    appendUInt32(&header, 56);
+    appendFourCC(&header, "vids");
+    appendFourCC(&header, "MJPG");
+    appendUInt32(&header, 0);                  // flags
+    appendUInt16(&header, 0);                  // priority
+    appendUInt16(&header, 0);                  // language
+    appendUInt32(&header, 0);                  // initial frames
+    appendUInt32(&header, 1);                  // scale
+    appendUInt32(&header, quint32(m_fps));     // rate
+    appendUInt32(&header, 0);                  // start
+    appendUInt32(&header, 0);                  // length
+    appendUInt32(&header, 0);                  // suggested buffer size
+    appendUInt32(&header, 0xFFFFFFFF);         // quality
+    appendUInt32(&header, 0);                  // sample size
+    appendUInt16(&header, 0);
+    appendUInt16(&header, 0);
+    appendUInt16(&header, quint16(width));
+    appendUInt16(&header, quint16(height));
+
+    appendFourCC(&header, "strf");
+    appendUInt32(&header, 40);
+    appendUInt32(&header, 40);                 // BITMAPINFOHEADER size
+    appendUInt32(&header, quint32(width));
+    appendUInt32(&header, quint32(height));
+    appendUInt16(&header, 1);                  // planes
+    appendUInt16(&header, 24);                 // bit count
+    appendFourCC(&header, "MJPG");
+    appendUInt32(&header, quint32(width * height * 3));
+    for (int i = 0; i < 4; ++i)
+    {
+        appendUInt32(&header, 0);
+    }
+
+    appendFourCC(&header, "LIST");
+    appendUInt32(&header, 0);
+    m_moviPosition = header.size();
+    appendFourCC(&header, "movi");
+
+    if (m_file.write(header) != header.size())
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool AviWriter::writeFrame(const QByteArray& jpeg)
+{
+    qint64 position = m_file.pos();
+    if (position + jpeg.size() + 8 > kMaxFileBytes)
+    {
+        m_errorString = QObject::tr("AVI files are limited to 2 GB, export a shorter range");
+        return false;
+    }
+
+    QByteArray chunkHeader;
+    appendFourCC(&chunkHeader, "00dc");
+    appendUInt32(&chunkHeader, quint32(jpeg.size()));
+
+    bool bOk = m_file.write(chunkHeader) == chunkHeader.size() && m_file.write(jpeg) == jpeg.size();
+    // Chunks start on even offsets.
+    if (bOk && (jpeg.size() & 1))
+    {
+        bOk = m_file.write("\0", 1) == 1;
+    }
+    if (!bOk)
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    IndexEntry entry = {quint32(position - m_moviPosition), quint32(jpeg.size())};
+    m_index.append(entry);
+    m_maxFrameSize = qMax(m_maxFrameSize, quint32(jpeg.size()));
+
+    return true;
+}
+
+bool AviWriter::patch(qint64 position, quint32 value)
+{
+    QByteArray data;
+    appendUInt32(&data, value);
+    return m_file.seek(position) && m_file.write(data) == data.size();
+}
+
+bool AviWriter::close()
+{
+    if (!m_file.isOpen())
+    {
+        return false;
+    }
+
+    qint64 indexPosition = m_file.pos();
+
+    QByteArray index;
+    appendFourCC(&index, "idx1");
+    appendUInt32(&index, quint32(m_index.size() * 16));
+    for (int i = 0; i < m_index.size(); ++i)
+    {
+        appendFourCC(&index, "00dc");
+        appendUInt32(&index, kIndexFlagKeyFrame);
+        appendUInt32(&index, m_index[i].offset);
+        appendUInt32(&index, m_index[i].size);
+    }
+
+    quint32 bufferSize = m_maxFrameSize + 8;
+    bool bOk = m_file.write(index) == index.size();
+    qint64 fileSize = m_file.pos();
+    bOk = bOk && patch(kRiffSizePosition, quint32(fileSize - 8));
+    bOk = bOk && patch(kMoviSizePosition, quint32(indexPosition - kMoviSizePosition - 4));
+    bOk = bOk && patch(kMaxBytesPerSecPosition, m_maxFrameSize * quint32(m_fps));
+    bOk = bOk && patch(kTotalFramesPosition, quint32(m_index.size()));
+    bOk = bOk && patch(kAviSuggestedBufferPosition, bufferSize);
+    bOk = bOk && patch(kStreamLengthPosition, quint32(m_index.size()));
+    bOk = bOk && patch(kStreamSuggestedBufferPosition, bufferSize);
+    if (!bOk)
+    {
+        m_errorString = m_file.errorString();
+    }
+
+    m_file.close();
+    return bOk;
+}
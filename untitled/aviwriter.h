@@ -0,0 +1,49 @@
+#ifndef AVIWRITER_H
+#define AVIWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Writes a single Motion JPEG video stream into an AVI 1.0 file: RIFF
+// headers, one '00dc' chunk per JPEG frame and an idx1 index. Frame counts
+// and sizes are patched into the headers by close(). AVI 1.0 offsets are
+// 32 bit, so writeFrame() fails once the file would pass 2 GB.
+class AviWriter
+{
+public:
+    AviWriter();
+    ~AviWriter();
+
+    bool open(const QString& fileName, int width, int height, int fps);
+
+    bool writeFrame(const QByteArray& jpeg);
+
+    bool close();
+
+    int frames() const { return m_index.size(); }
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    AviWriter(const AviWriter&);
+    AviWriter& operator=(const AviWriter&);
+
+    struct IndexEntry
+    {
+        quint32 offset;
+        quint32 size;
+    };
+
+    bool patch(qint64 position, quint32 value);
+
+    QFile m_file;
+    QString m_errorString;
+    int m_fps = 30;
+    quint32 m_maxFrameSize = 0;
+    qint64 m_moviPosition = 0;
+    QVector<IndexEntry> m_index;
+};
+
+#endif // AVIWRITER_H
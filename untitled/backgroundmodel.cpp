@@ -0,0 +1,359 @@
+#include "backgroundmodel.h"
+#include "simd.h"
+#include <QHash>
+#include "taskscheduler.h"
+#include <algorithm>
+
+using openni::DepthPixel;
+
+namespace
+{
+    // Row bands per worker thread.
+    const int kBandsPerThread = 2;
+
+    // Upper bound of the foreground threshold, keeps 16-bit blends exact.
+    const int kMaxThreshold = 0x3fff;
+
+    // Updates one row of the model and writes its foreground mask.
+    void updateRow(const DepthPixel* depth, DepthPixel* mean, DepthPixel* deviation, quint8* mask, int width,
+                   int alphaQ15, int minDifference, int deviationFactor)
+    {
+        int x = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(-1);
+        const __m128i alpha = _mm_set1_epi16(short(alphaQ15));
+        const __m128i factor = _mm_set1_epi16(short(deviationFactor));
+        const __m128i minDiff = _mm_set1_epi16(short(minDifference));
+        const __m128i cap = _mm_set1_epi16(short(kMaxThreshold));
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + x));
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mean + x));
+            __m128i dev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deviation + x));
+
+            // Unsigned max and min through saturating subtraction.
+            __m128i threshold = _mm_mullo_epi16(dev, factor);
+            threshold = _mm_add_epi16(threshold, _mm_subs_epu16(minDiff, threshold));
+            threshold = _mm_sub_epi16(threshold, _mm_subs_epu16(threshold, cap));
+
+            __m128i closer = _mm_subs_epu16(m, cur);
+            __m128i farther = _mm_subs_epu16(cur, m);
+            __m128i isCloser = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_subs_epu16(closer, threshold), zero), ones);
+            __m128i isFarther = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_subs_epu16(farther, threshold), zero), ones);
+
+            __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi16(cur, zero), ones);
+            __m128i meanZero = _mm_cmpeq_epi16(m, zero);
+
+            __m128i foreground = _mm_andnot_si128(meanZero, _mm_and_si128(valid, isCloser));
+            __m128i takeCur = _mm_and_si128(valid, _mm_or_si128(meanZero, isFarther));
+            __m128i blend = _mm_andnot_si128(_mm_or_si128(meanZero, _mm_or_si128(isCloser, isFarther)), valid);
+
+            // Blended lanes are within the threshold, so the differences are exact.
+            __m128i absDiff = _mm_or_si128(closer, farther);
+            __m128i newMean = _mm_add_epi16(m, _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(cur, m), 1), alpha));
+            __m128i newDev = _mm_add_epi16(dev, _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(absDiff, dev), 1), alpha));
+
+            m = _mm_or_si128(_mm_and_si128(blend, newMean), _mm_andnot_si128(blend, m));
+            m = _mm_or_si128(_mm_and_si128(takeCur, cur), _mm_andnot_si128(takeCur, m));
+            dev = _mm_or_si128(_mm_and_si128(blend, newDev), _mm_andnot_si128(blend, dev));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mean + x), m);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(deviation + x), dev);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(mask + x), _mm_packs_epi16(foreground, zero));
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            int cur = depth[x];
+            int m = mean[x];
+            int dev = deviation[x];
+            int threshold = qMin(kMaxThreshold, qMax(minDifference, dev * deviationFactor));
+
+            mask[x] = 0;
+            if (cur == 0)
+            {
+                continue;
+            }
+
+            if (m == 0 || cur - m > threshold)
+            {
+                mean[x] = DepthPixel(cur);
+            }
+            else if (m - cur > threshold)
+            {
+                mask[x] = 255;
+            }
+            else
+            {
+                // Same rounding as _mm_mulhi_epi16.
+                mean[x] = DepthPixel(m + (((cur - m) * 2 * alphaQ15) >> 16));
+                deviation[x] = DepthPixel(dev + (((qAbs(cur - m) - dev) * 2 * alphaQ15) >> 16));
+            }
+        }
+    }
+
+    int findRoot(const int* parent, int i)
+    {
+        while (parent[i] != i)
+        {
+            i = parent[i];
+        }
+        return i;
+    }
+
+    // Joins the sets of a and b under the smaller root index, halving
+    // paths on the way.
+    void unite(int* parent, int a, int b)
+    {
+        while (parent[a] != a)
+        {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+        while (parent[b] != b)
+        {
+            parent[b] = parent[parent[b]];
+            b = parent[b];
+        }
+        if (a < b)
+        {
+            parent[b] = a;
+        }
+        else if (b < a)
+        {
+            parent[a] = b;
+        }
+    }
+
+    struct BlobAccumulator
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+        int pixels;
+        int nearest;
+    };
+
+    void addPixel(BlobAccumulator* pBlob, int x, int y, int depth)
+    {
+        pBlob->left = qMin(pBlob->left, x);
+        pBlob->right = qMax(pBlob->right, x);
+        pBlob->top = qMin(pBlob->top, y);
+        pBlob->bottom = qMax(pBlob->bottom, y);
+        pBlob->nearest = qMin(pBlob->nearest, depth);
+        ++pBlob->pixels;
+    }
+
+    BlobAccumulator newBlob(int x, int y)
+    {
+        BlobAccumulator blob = { x, y, x, y, 0, 0xffff };
+        return blob;
+    }
+
+    bool largerBlob(const ForegroundBlob& a, const ForegroundBlob& b)
+    {
+        return a.pixelCount > b.pixelCount;
+    }
+}
+
+BackgroundModel::BackgroundModel()
+{
+}
+
+void BackgroundModel::setSettings(const BackgroundModelSettings& settings)
+{
+    m_settings = settings;
+}
+
+void BackgroundModel::reset()
+{
+    m_mean.fill(0);
+    m_deviation.fill(0);
+    m_mask.fill(0);
+}
+
+QVector<ForegroundBlob> BackgroundModel::process(const DepthPixel* pDepth, int width, int height, int strideBytes)
+{
+    if (width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_mean.resize(width * height);
+        m_deviation.resize(width * height);
+        m_mask.resize(width * height);
+        m_parent.resize(width * height);
+        reset();
+    }
+
+    const int alphaQ15 = qBound(1, int(m_settings.learningRate * 32768), 32767);
+    const int minDifference = qBound(1, m_settings.minDifference, kMaxThreshold);
+    // At most 4 keeps deviation * factor inside 16 bits.
+    const int deviationFactor = qBound(1, m_settings.deviationFactor, 4);
+
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    DepthPixel* pMean = m_mean.data();
+    DepthPixel* pDeviation = m_deviation.data();
+    quint8* pMask = m_mask.data();
+
+    int bandCount = qMin(height, qMax(1, TaskScheduler::instance()->workerCount() * kBandsPerThread));
+
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, [&](int band)
+    {
+        int firstRow = int(qint64(height) * band / bandCount);
+        int lastRow = int(qint64(height) * (band + 1) / bandCount);
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const DepthPixel* row = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+            updateRow(row, pMean + y * width, pDeviation + y * width, pMask + y * width, width,
+                      alphaQ15, minDifference, deviationFactor);
+        }
+    });
+
+    return findBlobs(pDepth, strideBytes, bandCount);
+}
+
+QVector<ForegroundBlob> BackgroundModel::findBlobs(const DepthPixel* pDepth, int strideBytes, int bandCount)
+{
+    const int width = m_width;
+    const int height = m_height;
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    const quint8* pMask = m_mask.constData();
+    int* pParent = m_parent.data();
+
+    // Label each band on its own, unions never leave the band.
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, [&](int band)
+    {
+        int firstRow = int(qint64(height) * band / bandCount);
+        int lastRow = int(qint64(height) * (band + 1) / bandCount);
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                int i = y * width + x;
+                if (pMask[i] == 0)
+                {
+                    continue;
+                }
+                pParent[i] = i;
+                if (x > 0 && pMask[i - 1] != 0)
+                {
+                    unite(pParent, i, i - 1);
+                }
+                if (y > firstRow && pMask[i - width] != 0)
+                {
+                    unite(pParent, i, i - width);
+                }
+            }
+        }
+    });
+
+    // Stitch the bands along their first rows.
+    for (int band = 1; band < bandCount; ++band)
+    {
+        int y = int(qint64(height) * band / bandCount);
+        for (int x = 0; x < width; ++x)
+        {
+            int i = y * width + x;
+            if (pMask[i] != 0 && pMask[i - width] != 0)
+            {
+                unite(pParent, i, i - width);
+            }
+        }
+    }
+
+    // Gather blob statistics per band, the tree is only read from here on.
+    QVector<QHash<int, BlobAccumulator> > bandBlobs(bandCount);
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, [&](int band)
+    {
+        QHash<int, BlobAccumulator>& blobs = bandBlobs[band];
+        int firstRow = int(qint64(height) * band / bandCount);
+        int lastRow = int(qint64(height) * (band + 1) / bandCount);
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const DepthPixel* row = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+            int lastRoot = -1;
+            BlobAccumulator* pBlob = NULL;
+            for (int x = 0; x < width; ++x)
+            {
+                int i = y * width + x;
+                if (pMask[i] == 0)
+                {
+                    continue;
+                }
+                int root = findRoot(pParent, i);
+                if (root != lastRoot)
+                {
+                    QHash<int, BlobAccumulator>::iterator it = blobs.find(root);
+                    if (it == blobs.end())
+                    {
+                        it = blobs.insert(root, newBlob(x, y));
+                    }
+                    pBlob = &it.value();
+                    lastRoot = root;
+                }
+                addPixel(pBlob, x, y, row[x]);
+            }
+        }
+    });
+
+    QHash<int, BlobAccumulator> merged;
+    for (int band = 0; band < bandCount; ++band)
+    {
+        for (QHash<int, BlobAccumulator>::const_iterator it = bandBlobs[band].constBegin(); it != bandBlobs[band].constEnd(); ++it)
+        {
+            QHash<int, BlobAccumulator>::iterator target = merged.find(it.key());
+            if (target == merged.end())
+            {
+                merged.insert(it.key(), it.value());
+                continue;
+            }
+            BlobAccumulator& blob = target.value();
+            const BlobAccumulator& part = it.value();
+            blob.left = qMin(blob.left, part.left);
+            blob.top = qMin(blob.top, part.top);
+            blob.right = qMax(blob.right, part.right);
+            blob.bottom = qMax(blob.bottom, part.bottom);
+            blob.nearest = qMin(blob.nearest, part.nearest);
+            blob.pixels += part.pixels;
+        }
+    }
+
+    QVector<ForegroundBlob> result;
+    for (QHash<int, BlobAccumulator>::const_iterator it = merged.constBegin(); it != merged.constEnd(); ++it)
+    {
+        const BlobAccumulator& blob = it.value();
+        if (blob.pixels < m_settings.minBlobPixels)
+        {
+            continue;
+        }
+        ForegroundBlob foreground;
+        foreground.bounds = QRect(QPoint(blob.left, blob.top), QPoint(blob.right, blob.bottom));
+        foreground.pixelCount = blob.pixels;
+        foreground.nearestDepth = blob.nearest;
+        result.append(foreground);
+    }
+    std::sort(result.begin(), result.end(), largerBlob);
+
+    return result;
+}
+
+void writeForegroundCsvHeader(QTextStream& out)
+{
+    out << "frame,blob,x,y,width,height,pixels,nearest_mm\n";
+}
+
+void writeForegroundCsv(QTextStream& out, int frameIndex, const QVector<ForegroundBlob>& blobs)
+{
+    for (int i = 0; i < blobs.size(); ++i)
+    {
+        const ForegroundBlob& blob = blobs[i];
+        out << frameIndex << ',' << i << ','
+            << blob.bounds.x() << ',' << blob.bounds.y() << ','
+            << blob.bounds.width() << ',' << blob.bounds.height() << ','
+            << blob.pixelCount << ',' << blob.nearestDepth << '\n';
+    }
+}
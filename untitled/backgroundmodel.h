@@ -0,0 +1,78 @@
+#ifndef BACKGROUNDMODEL_H
+#define BACKGROUNDMODEL_H
+
+#include <QRect>
+#include <QTextStream>
+#include <QVector>
+#include "OpenNI.h"
+
+struct BackgroundModelSettings
+{
+    // Weight of a new frame in the running background depth and deviation.
+    double learningRate = 0.02;
+
+    // A pixel is foreground when it is closer than the background by more
+    // than max(minDifference, deviationFactor * deviation) mm.
+    int minDifference = 80;
+    int deviationFactor = 3;
+
+    // Smaller connected regions are left out of the blob list.
+    int minBlobPixels = 150;
+};
+
+// Connected foreground region of one frame.
+struct ForegroundBlob
+{
+    QRect bounds;
+    int pixelCount;
+    int nearestDepth;
+};
+
+// Per-pixel depth background of a static scene, updated with every frame
+// passed to process(). Background is the farthest stable depth seen, so
+// whatever stands in front of it becomes foreground, and a surface that
+// shows up behind the model replaces it right away.
+// Rows are updated in parallel bands with SSE2, blobs come from a banded
+// union-find whose bands are stitched together afterwards.
+class BackgroundModel
+{
+public:
+    BackgroundModel();
+
+    void setSettings(const BackgroundModelSettings& settings);
+
+    const BackgroundModelSettings& settings() const { return m_settings; }
+
+    // Forgets the learned background.
+    void reset();
+
+    // Updates the model with a frame and returns its blobs, largest first.
+    QVector<ForegroundBlob> process(const openni::DepthPixel* pDepth, int width, int height, int strideBytes);
+
+    // Foreground mask of the last processed frame, 255 for foreground,
+    // width() bytes per row.
+    const quint8* mask() const { return m_mask.constData(); }
+
+    int width() const { return m_width; }
+
+    int height() const { return m_height; }
+
+private:
+    QVector<ForegroundBlob> findBlobs(const openni::DepthPixel* pDepth, int strideBytes, int bandCount);
+
+    BackgroundModelSettings m_settings;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    QVector<openni::DepthPixel> m_mean;
+    QVector<openni::DepthPixel> m_deviation;
+    QVector<quint8> m_mask;
+    QVector<int> m_parent;
+};
+
+void writeForegroundCsvHeader(QTextStream& out);
+
+void writeForegroundCsv(QTextStream& out, int frameIndex, const QVector<ForegroundBlob>& blobs);
+
+#endif // BACKGROUNDMODEL_H
@@ -0,0 +1,511 @@
+#include "depthcodec.h"
+#include "depthprediction.h"
+#include "taskscheduler.h"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    const quint32 kMagic = 0x31435044; // "DPC1"
+    const quint16 kFlagKeyFrame = 1;
+
+    // Rows per independently coded band, the unit of parallel work.
+    const int kBandRows = 32;
+
+    // Residuals with a longer unary part are stored as 16 raw bits.
+    const int kEscapeBits = 24;
+
+    const int kActivityBuckets = 8;
+
+    // Context statistics are halved at this count so they follow the scene.
+    const quint32 kContextWindow = 64;
+
+    struct FrameHeader
+    {
+        quint32 magic;
+        quint16 width;
+        quint16 height;
+        quint16 flags;
+        quint16 bandCount;
+        quint16 bandRows;
+        quint16 reserved;
+    };
+
+    // Running mean of the coded values, which picks the Rice parameter.
+    struct Context
+    {
+        quint32 sum;
+        quint32 count;
+    };
+
+    enum PredictionMode
+    {
+        MODE_SPATIAL = 0,
+        MODE_TEMPORAL = 1
+    };
+
+    struct ContextSet
+    {
+        Context contexts[2][kActivityBuckets];
+
+        ContextSet()
+        {
+            for (int m = 0; m < 2; ++m)
+            {
+                for (int b = 0; b < kActivityBuckets; ++b)
+                {
+                    contexts[m][b].sum = 2;
+                    contexts[m][b].count = 1;
+                }
+            }
+        }
+    };
+
+    inline int riceParameter(const Context& context)
+    {
+        int k = 0;
+        while ((context.count << k) < context.sum && k < 15)
+        {
+            ++k;
+        }
+        return k;
+    }
+
+    inline void updateContext(Context& context, quint32 value)
+    {
+        context.sum += value;
+        if (++context.count >= kContextWindow)
+        {
+            context.sum >>= 1;
+            context.count >>= 1;
+        }
+    }
+
+    // 0, 1, 2-3, 4-7, ... 64 and above.
+    inline int activityBucket(int activity)
+    {
+        int bucket = 0;
+        while (activity > 0 && bucket < kActivityBuckets - 1)
+        {
+            activity >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // Median edge predictor; the first row of a band only looks left.
+    inline int predictSpatial(const quint16* row, const quint16* up, int x)
+    {
+        if (up == NULL)
+        {
+            return x > 0 ? row[x - 1] : 0;
+        }
+        if (x == 0)
+        {
+            return up[0];
+        }
+        return predictMed(row[x - 1], up[x], up[x - 1]);
+    }
+
+    // Gradients around the pixel, known to the decoder before it.
+    inline int spatialActivity(const quint16* row, const quint16* up, int x)
+    {
+        if (x == 0)
+        {
+            return 0;
+        }
+        if (up == NULL)
+        {
+            return x > 1 ? qAbs(row[x - 1] - row[x - 2]) : 0;
+        }
+        return qAbs(row[x - 1] - up[x - 1]) + qAbs(up[x] - up[x - 1]);
+    }
+
+    // How much the left neighbour moved since the previous frame.
+    inline int temporalActivity(const quint16* row, const quint16* before, int x)
+    {
+        return x > 0 ? qAbs(row[x - 1] - before[x - 1]) : 0;
+    }
+
+    // Least significant bit first.
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(QByteArray* pOut) : m_pOut(pOut) {}
+
+        // count is at most 32 and value fits in it.
+        void put(quint32 value, int count)
+        {
+            m_bits |= quint64(value) << m_count;
+            m_count += count;
+            if (m_count >= 32)
+            {
+                char bytes[4] = {char(m_bits), char(m_bits >> 8), char(m_bits >> 16), char(m_bits >> 24)};
+                m_pOut->append(bytes, 4);
+                m_bits >>= 32;
+                m_count -= 32;
+            }
+        }
+
+        void flush()
+        {
+            while (m_count > 0)
+            {
+                m_pOut->append(char(m_bits));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+            m_count = 0;
+            m_bits = 0;
+        }
+
+    private:
+        QByteArray* m_pOut;
+        quint64 m_bits = 0;
+        int m_count = 0;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader(const uchar* data, int size) : m_p(data), m_end(data + size) {}
+
+        // Buffers at least 57 bits, zeros past the end of the data.
+        void refill()
+        {
+            while (m_count <= 56)
+            {
+                quint64 byte = m_p < m_end ? *m_p++ : 0;
+                m_bits |= byte << m_count;
+                m_count += 8;
+            }
+        }
+
+        quint64 bits() const { return m_bits; }
+
+        quint32 take(int count)
+        {
+            quint32 value = quint32(m_bits & ((quint64(1) << count) - 1));
+            m_bits >>= count;
+            m_count -= count;
+            return value;
+        }
+
+    private:
+        const uchar* m_p;
+        const uchar* m_end;
+        quint64 m_bits = 0;
+        int m_count = 0;
+    };
+
+    inline void writeResidual(BitWriter& writer, Context& context, quint32 value)
+    {
+        int k = riceParameter(context);
+        quint32 quotient = value >> k;
+        if (quotient < quint32(kEscapeBits))
+        {
+            writer.put(1u << quotient, int(quotient) + 1);
+            if (k > 0)
+            {
+                writer.put(value & ((1u << k) - 1), k);
+            }
+        }
+        else
+        {
+            writer.put(0, kEscapeBits);
+            writer.put(value, 16);
+        }
+        updateContext(context, value);
+    }
+
+    inline quint32 readResidual(BitReader& reader, Context& context)
+    {
+        reader.refill();
+        int k = riceParameter(context);
+        quint32 value;
+        quint64 bits = reader.bits();
+        if ((bits & ((quint64(1) << kEscapeBits) - 1)) == 0)
+        {
+            reader.take(kEscapeBits);
+            value = reader.take(16);
+        }
+        else
+        {
+            int quotient = 0;
+            while ((bits & 1) == 0)
+            {
+                bits >>= 1;
+                ++quotient;
+            }
+            reader.take(quotient + 1);
+            value = (quint32(quotient) << k) | reader.take(k);
+        }
+        updateContext(context, value);
+        return value;
+    }
+
+    void encodeBand(const quint16* current, const quint16* previous, int width, int firstRow, int endRow, QByteArray* pOut)
+    {
+        ContextSet contextSet;
+        BitWriter writer(pOut);
+        std::vector<quint32> spatial(width);
+        std::vector<quint32> temporal(width);
+
+        for (int y = firstRow; y < endRow; ++y)
+        {
+            const quint16* row = current + y * width;
+            const quint16* up = y > firstRow ? row - width : NULL;
+            const quint16* before = previous != NULL ? previous + y * width : NULL;
+
+            quint64 spatialCost = 0;
+            for (int x = 0; x < width; ++x)
+            {
+                spatial[x] = zigzag(row[x] - predictSpatial(row, up, x));
+                spatialCost += spatial[x];
+            }
+
+            // One bit per row picks the cheaper predictor.
+            PredictionMode mode = MODE_SPATIAL;
+            if (before != NULL)
+            {
+                quint64 temporalCost = 0;
+                for (int x = 0; x < width; ++x)
+                {
+                    temporal[x] = zigzag(row[x] - before[x]);
+                    temporalCost += temporal[x];
+                }
+                mode = temporalCost < spatialCost ? MODE_TEMPORAL : MODE_SPATIAL;
+                writer.put(quint32(mode), 1);
+            }
+
+            Context* contexts = contextSet.contexts[mode];
+            for (int x = 0; x < width; ++x)
+            {
+                if (mode == MODE_TEMPORAL)
+                {
+                    writeResidual(writer, contexts[activityBucket(temporalActivity(row, before, x))], temporal[x]);
+                }
+                else
+                {
+                    writeResidual(writer, contexts[activityBucket(spatialActivity(row, up, x))], spatial[x]);
+                }
+            }
+        }
+
+        writer.flush();
+    }
+
+    void decodeBand(const uchar* data, int size, const quint16* previous, quint16* current, int width, int firstRow, int endRow)
+    {
+        ContextSet contextSet;
+        BitReader reader(data, size);
+
+        for (int y = firstRow; y < endRow; ++y)
+        {
+            quint16* row = current + y * width;
+            const quint16* up = y > firstRow ? row - width : NULL;
+            const quint16* before = previous != NULL ? previous + y * width : NULL;
+
+            PredictionMode mode = MODE_SPATIAL;
+            if (before != NULL)
+            {
+                reader.refill();
+                mode = PredictionMode(reader.take(1));
+            }
+
+            Context* contexts = contextSet.contexts[mode];
+            if (mode == MODE_TEMPORAL)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    quint32 value = readResidual(reader, contexts[activityBucket(temporalActivity(row, before, x))]);
+                    row[x] = quint16(before[x] + unzigzag(value));
+                }
+            }
+            else
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    quint32 value = readResidual(reader, contexts[activityBucket(spatialActivity(row, up, x))]);
+                    row[x] = quint16(predictSpatial(row, up, x) + unzigzag(value));
+                }
+            }
+        }
+    }
+
+    template <typename F>
+    void forEachBand(int bandCount, bool bParallel, F function)
+    {
+        if (!bParallel || bandCount == 1)
+        {
+            for (int band = 0; band < bandCount; ++band)
+            {
+                function(band);
+            }
+            return;
+        }
+
+        // Within an export or scan the bands take the class of that job.
+        TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, function);
+    }
+}
+
+DepthEncoder::DepthEncoder()
+{
+}
+
+void DepthEncoder::reset()
+{
+    m_previous.clear();
+}
+
+QByteArray DepthEncoder::encode(const openni::VideoFrameRef& frame, bool bKeyFrame)
+{
+    return encode(static_cast<const openni::DepthPixel*>(frame.getData()), frame.getWidth(), frame.getHeight(),
+                  frame.getStrideInBytes(), bKeyFrame);
+}
+
+QByteArray DepthEncoder::encode(const openni::DepthPixel* depth, int width, int height, int strideBytes, bool bKeyFrame)
+{
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+    {
+        return QByteArray();
+    }
+
+    bool bKey = bKeyFrame || m_previous.isEmpty() || width != m_width || height != m_height;
+
+    m_current.resize(width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(m_current.data() + y * width, reinterpret_cast<const char*>(depth) + y * strideBytes, width * sizeof(quint16));
+    }
+
+    int bandCount = (height + kBandRows - 1) / kBandRows;
+    QVector<QByteArray> bands(bandCount);
+    const quint16* current = m_current.constData();
+    const quint16* previous = bKey ? NULL : m_previous.constData();
+    forEachBand(bandCount, m_bParallel, [&](int band)
+    {
+        bands[band].reserve(width * kBandRows);
+        encodeBand(current, previous, width, band * kBandRows, qMin(height, (band + 1) * kBandRows), &bands[band]);
+    });
+
+    FrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMagic;
+    header.width = quint16(width);
+    header.height = quint16(height);
+    header.flags = bKey ? kFlagKeyFrame : 0;
+    header.bandCount = quint16(bandCount);
+    header.bandRows = quint16(kBandRows);
+
+    int totalSize = int(sizeof(header)) + bandCount * 4;
+    for (int band = 0; band < bandCount; ++band)
+    {
+        totalSize += bands[band].size();
+    }
+
+    QByteArray out;
+    out.reserve(totalSize);
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int band = 0; band < bandCount; ++band)
+    {
+        quint32 bandSize = quint32(bands[band].size());
+        out.append(reinterpret_cast<const char*>(&bandSize), 4);
+    }
+    for (int band = 0; band < bandCount; ++band)
+    {
+        out.append(bands[band]);
+    }
+
+    m_previous.swap(m_current);
+    m_width = width;
+    m_height = height;
+
+    return out;
+}
+
+DepthDecoder::DepthDecoder()
+{
+}
+
+void DepthDecoder::reset()
+{
+    m_previous.clear();
+}
+
+bool DepthDecoder::frameSize(const char* data, int size, int* pWidth, int* pHeight)
+{
+    FrameHeader header;
+    if (size < int(sizeof(header)))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic)
+    {
+        return false;
+    }
+
+    *pWidth = header.width;
+    *pHeight = header.height;
+    return true;
+}
+
+bool DepthDecoder::decode(const char* data, int size, openni::DepthPixel* depth, int width, int height)
+{
+    FrameHeader header;
+    if (size < int(sizeof(header)))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic || header.width != width || header.height != height || header.bandRows == 0 ||
+        header.bandCount != (height + header.bandRows - 1) / header.bandRows)
+    {
+        return false;
+    }
+
+    bool bKey = (header.flags & kFlagKeyFrame) != 0;
+    if (!bKey && (m_previous.isEmpty() || m_width != width || m_height != height))
+    {
+        return false;
+    }
+
+    int bandCount = header.bandCount;
+    int bandRows = header.bandRows;
+    const char* sizes = data + sizeof(header);
+    qint64 offset = qint64(sizeof(header)) + bandCount * 4;
+    if (offset > size)
+    {
+        return false;
+    }
+
+    QVector<int> offsets(bandCount + 1);
+    for (int band = 0; band < bandCount; ++band)
+    {
+        quint32 bandSize;
+        memcpy(&bandSize, sizes + band * 4, 4);
+        offsets[band] = int(offset);
+        offset += bandSize;
+        if (offset > size)
+        {
+            return false;
+        }
+    }
+    offsets[bandCount] = int(offset);
+
+    const quint16* previous = bKey ? NULL : m_previous.constData();
+    forEachBand(bandCount, m_bParallel, [&](int band)
+    {
+        decodeBand(reinterpret_cast<const uchar*>(data) + offsets[band], offsets[band + 1] - offsets[band],
+                   previous, depth, width, band * bandRows, qMin(height, (band + 1) * bandRows));
+    });
+
+    m_previous.resize(width * height);
+    memcpy(m_previous.data(), depth, width * height * sizeof(quint16));
+    m_width = width;
+    m_height = height;
+
+    return true;
+}
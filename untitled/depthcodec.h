@@ -0,0 +1,68 @@
+#ifndef DEPTHCODEC_H
+#define DEPTHCODEC_H
+
+#include <QByteArray>
+#include <QVector>
+#include "OpenNI.h"
+
+// Lossless codec for 16-bit depth frames.
+//
+// Every row is predicted either spatially (median edge predictor on the
+// current frame) or temporally (the same pixel of the previous frame),
+// whichever the encoder finds cheaper, and the residuals are Golomb-Rice
+// coded with adaptive parameters chosen by local activity. A frame is cut
+// into bands of rows that are coded independently, so both sides run
+// the bands in parallel as tasks of the scheduler.
+//
+// Key frames use spatial prediction only and can be decoded on their own;
+// other frames need the decoder to have seen the previous frame.
+
+class DepthEncoder
+{
+public:
+    DepthEncoder();
+
+    // Bands run on the scheduler unless disabled, e.g. when the
+    // caller already encodes several frames in parallel.
+    void setParallel(bool bParallel) { m_bParallel = bParallel; }
+
+    // Forces the next frame to be a key frame.
+    void reset();
+
+    // A frame with a new size is always a key frame.
+    QByteArray encode(const openni::DepthPixel* depth, int width, int height, int strideBytes, bool bKeyFrame = false);
+
+    QByteArray encode(const openni::VideoFrameRef& frame, bool bKeyFrame = false);
+
+private:
+    bool m_bParallel = true;
+    int m_width = 0;
+    int m_height = 0;
+    QVector<quint16> m_current;
+    QVector<quint16> m_previous;
+};
+
+class DepthDecoder
+{
+public:
+    DepthDecoder();
+
+    void setParallel(bool bParallel) { m_bParallel = bParallel; }
+
+    void reset();
+
+    // Frame size from an encoded frame header.
+    static bool frameSize(const char* data, int size, int* pWidth, int* pHeight);
+
+    // Writes width * height pixels without row padding. Fails on damaged
+    // data, on a size mismatch and on a non-key frame without its predecessor.
+    bool decode(const char* data, int size, openni::DepthPixel* depth, int width, int height);
+
+private:
+    bool m_bParallel = true;
+    int m_width = 0;
+    int m_height = 0;
+    QVector<quint16> m_previous;
+};
+
+#endif // DEPTHCODEC_H
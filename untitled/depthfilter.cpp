@@ -0,0 +1,360 @@
+#include "depthfilter.h"
+#include "simd.h"
+#include "taskscheduler.h"
+#include <string.h>
+
+using openni::DepthPixel;
+
+namespace
+{
+    // Border width of the padded buffer, the radius of the largest median.
+    const int kPad = 2;
+
+    // Row bands per worker thread.
+    const int kBandsPerThread = 2;
+
+    struct Comparator
+    {
+        int a;
+        int b;
+    };
+
+    // Compare-exchange network that leaves the median of count values at
+    // index count / 2. Built from Batcher's odd-even merge sort, then cut
+    // down to the comparators the median actually depends on.
+    QVector<Comparator> buildMedianNetwork(int count)
+    {
+        int n = 1;
+        while (n < count)
+        {
+            n <<= 1;
+        }
+
+        QVector<Comparator> sorter;
+        for (int p = 1; p < n; p <<= 1)
+        {
+            for (int k = p; k >= 1; k >>= 1)
+            {
+                for (int j = k % p; j + k < n; j += 2 * k)
+                {
+                    for (int i = 0; i < k && i + j + k < n; ++i)
+                    {
+                        int a = i + j;
+                        int b = i + j + k;
+                        // Lanes past count hold +infinity and never move.
+                        if ((a / (2 * p)) == (b / (2 * p)) && b < count)
+                        {
+                            Comparator c = { a, b };
+                            sorter.append(c);
+                        }
+                    }
+                }
+            }
+        }
+
+        QVector<bool> needed(count, false);
+        needed[count / 2] = true;
+        QVector<Comparator> network;
+        for (int i = sorter.size() - 1; i >= 0; --i)
+        {
+            const Comparator& c = sorter[i];
+            if (needed[c.a] || needed[c.b])
+            {
+                needed[c.a] = true;
+                needed[c.b] = true;
+                network.prepend(c);
+            }
+        }
+        return network;
+    }
+
+    const QVector<Comparator>& medianNetwork(int size)
+    {
+        static const QVector<Comparator> network3 = buildMedianNetwork(9);
+        static const QVector<Comparator> network5 = buildMedianNetwork(25);
+        return size == 5 ? network5 : network3;
+    }
+
+    // Copies a row and fills its short zero runs, see DepthFilterSettings.
+    void fillRowHoles(const DepthPixel* in, DepthPixel* out, int width, int maxGap, int edgeJump)
+    {
+        memcpy(out, in, width * sizeof(DepthPixel));
+
+        int x = 0;
+        while (x < width)
+        {
+#ifdef ONI_HAVE_SSE2
+            // Most of a row is valid, skip it eight pixels at a time.
+            const __m128i zero = _mm_setzero_si128();
+            while (x + 8 <= width &&
+                   _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(out + x)), zero)) == 0)
+            {
+                x += 8;
+            }
+#endif
+            if (x >= width)
+            {
+                break;
+            }
+            if (out[x] != 0)
+            {
+                ++x;
+                continue;
+            }
+
+            int start = x;
+            while (x < width && out[x] == 0)
+            {
+                ++x;
+            }
+            if (x - start > maxGap)
+            {
+                continue;
+            }
+
+            int left = (start > 0) ? out[start - 1] : 0;
+            int right = (x < width) ? out[x] : 0;
+            if (left == 0 && right == 0)
+            {
+                continue;
+            }
+
+            if (left != 0 && right != 0 && qAbs(left - right) <= edgeJump)
+            {
+                int span = x - start + 1;
+                for (int i = start; i < x; ++i)
+                {
+                    out[i] = DepthPixel(left + (right - left) * (i - start + 1) / span);
+                }
+            }
+            else
+            {
+                // Holes next to edges are mostly shadow of the background.
+                DepthPixel fill = DepthPixel(qMax(left, right));
+                for (int i = start; i < x; ++i)
+                {
+                    out[i] = fill;
+                }
+            }
+        }
+    }
+
+    void medianRow(const DepthPixel* padded, int paddedWidth, DepthPixel* out, int width,
+                   int size, const QVector<Comparator>& network)
+    {
+        const int radius = size / 2;
+        const int count = size * size;
+        const Comparator* comparators = network.constData();
+        const int comparatorCount = network.size();
+
+        // Top-left pixel of each tap relative to the output pixel.
+        int offsets[25];
+        for (int dy = 0; dy < size; ++dy)
+        {
+            for (int dx = 0; dx < size; ++dx)
+            {
+                offsets[dy * size + dx] = (dy - radius) * paddedWidth + (dx - radius);
+            }
+        }
+
+        int x = 0;
+
+#ifdef ONI_HAVE_SSE2
+        // SSE2 only has signed 16-bit min/max, so values are biased into
+        // signed range and back.
+        const __m128i bias = _mm_set1_epi16(short(0x8000));
+        __m128i taps[25];
+        for (; x + 8 <= width; x += 8)
+        {
+            for (int k = 0; k < count; ++k)
+            {
+                taps[k] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + offsets[k])), bias);
+            }
+            for (int i = 0; i < comparatorCount; ++i)
+            {
+                __m128i a = taps[comparators[i].a];
+                __m128i b = taps[comparators[i].b];
+                taps[comparators[i].a] = _mm_min_epi16(a, b);
+                taps[comparators[i].b] = _mm_max_epi16(a, b);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_xor_si128(taps[count / 2], bias));
+        }
+#endif
+
+        int values[25];
+        for (; x < width; ++x)
+        {
+            for (int k = 0; k < count; ++k)
+            {
+                values[k] = padded[x + offsets[k]];
+            }
+            for (int i = 0; i < comparatorCount; ++i)
+            {
+                int a = values[comparators[i].a];
+                int b = values[comparators[i].b];
+                values[comparators[i].a] = qMin(a, b);
+                values[comparators[i].b] = qMax(a, b);
+            }
+            out[x] = DepthPixel(values[count / 2]);
+        }
+    }
+
+    // Blends row into history in place, see DepthFilterSettings. A pixel
+    // without depth keeps its history, a pixel without history or one that
+    // moved takes the new value. alphaQ15 is the new frame weight * 32768.
+    void temporalRow(DepthPixel* row, DepthPixel* history, int width, int alphaQ15, int motionThreshold)
+    {
+        int x = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha = _mm_set1_epi16(short(alphaQ15));
+        const __m128i limit = _mm_set1_epi16(short(motionThreshold));
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(history + x));
+
+            __m128i absDiff = _mm_or_si128(_mm_subs_epu16(cur, prev), _mm_subs_epu16(prev, cur));
+            __m128i still = _mm_cmpeq_epi16(_mm_subs_epu16(absDiff, limit), zero);
+            __m128i takeCur = _mm_or_si128(_mm_cmpeq_epi16(prev, zero), _mm_andnot_si128(still, _mm_set1_epi16(-1)));
+            __m128i takePrev = _mm_cmpeq_epi16(cur, zero);
+
+            // Only lanes within motionThreshold use the blend, so the
+            // wrapping difference is exact there and doubling it fits.
+            __m128i diff = _mm_sub_epi16(cur, prev);
+            __m128i blend = _mm_add_epi16(prev, _mm_mulhi_epi16(_mm_slli_epi16(diff, 1), alpha));
+
+            __m128i result = _mm_or_si128(_mm_and_si128(takeCur, cur), _mm_andnot_si128(takeCur, blend));
+            result = _mm_or_si128(_mm_and_si128(takePrev, prev), _mm_andnot_si128(takePrev, result));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), result);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(history + x), result);
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            int cur = row[x];
+            int prev = history[x];
+            int result;
+            if (cur == 0)
+            {
+                result = prev;
+            }
+            else if (prev == 0 || qAbs(cur - prev) > motionThreshold)
+            {
+                result = cur;
+            }
+            else
+            {
+                // Same rounding as _mm_mulhi_epi16.
+                result = prev + (((cur - prev) * 2 * alphaQ15) >> 16);
+            }
+            row[x] = DepthPixel(result);
+            history[x] = DepthPixel(result);
+        }
+    }
+}
+
+DepthFilter::DepthFilter()
+{
+}
+
+void DepthFilter::setSettings(const DepthFilterSettings& settings)
+{
+    m_settings = settings;
+    reset();
+}
+
+void DepthFilter::reset()
+{
+    m_history.fill(0);
+}
+
+const DepthPixel* DepthFilter::process(const DepthPixel* pDepth, int width, int height, int strideBytes)
+{
+    if (width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_padded.resize((width + 2 * kPad) * (height + 2 * kPad));
+        m_output.resize(width * height);
+        m_history.resize(width * height);
+        reset();
+    }
+
+    const int paddedWidth = width + 2 * kPad;
+    const DepthFilterSettings settings = m_settings;
+    const int medianSize = (settings.medianSize >= 5) ? 5 : (settings.medianSize >= 3 ? 3 : 0);
+    const QVector<Comparator>& network = medianNetwork(medianSize);
+    const int alphaQ15 = qBound(1, int(settings.temporalAlpha * 32768), 32767);
+    const int motionThreshold = qBound(0, settings.motionThreshold, 0x3fff);
+
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    DepthPixel* pPadded = m_padded.data();
+    DepthPixel* pOutput = m_output.data();
+    DepthPixel* pHistory = m_history.data();
+
+    int bandCount = qMin(height, qMax(1, TaskScheduler::instance()->workerCount() * kBandsPerThread));
+
+    // Pass 1: hole fill into the padded buffer. The median of a row needs
+    // its neighbours, so this pass completes before the next one starts.
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, [&](int band)
+    {
+        int firstRow = int(qint64(height) * band / bandCount);
+        int lastRow = int(qint64(height) * (band + 1) / bandCount);
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const DepthPixel* in = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+            DepthPixel* row = pPadded + (y + kPad) * paddedWidth + kPad;
+            if (settings.bHoleFill)
+            {
+                fillRowHoles(in, row, width, settings.holeMaxGap, settings.holeEdgeJump);
+            }
+            else
+            {
+                memcpy(row, in, width * sizeof(DepthPixel));
+            }
+            for (int i = 1; i <= kPad; ++i)
+            {
+                row[-i] = row[0];
+                row[width - 1 + i] = row[width - 1];
+            }
+        }
+    });
+
+    for (int i = 0; i < kPad; ++i)
+    {
+        memcpy(pPadded + i * paddedWidth, pPadded + kPad * paddedWidth, paddedWidth * sizeof(DepthPixel));
+        memcpy(pPadded + (height + kPad + i) * paddedWidth, pPadded + (height + kPad - 1) * paddedWidth,
+               paddedWidth * sizeof(DepthPixel));
+    }
+
+    // Pass 2: median and temporal smoothing, both row local.
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, bandCount, [&](int band)
+    {
+        int firstRow = int(qint64(height) * band / bandCount);
+        int lastRow = int(qint64(height) * (band + 1) / bandCount);
+        for (int y = firstRow; y < lastRow; ++y)
+        {
+            const DepthPixel* padded = pPadded + (y + kPad) * paddedWidth + kPad;
+            DepthPixel* out = pOutput + y * width;
+            if (medianSize != 0)
+            {
+                medianRow(padded, paddedWidth, out, width, medianSize, network);
+            }
+            else
+            {
+                memcpy(out, padded, width * sizeof(DepthPixel));
+            }
+
+            if (settings.bTemporal)
+            {
+                temporalRow(out, pHistory + y * width, width, alphaQ15, motionThreshold);
+            }
+        }
+    });
+
+    return pOutput;
+}
@@ -0,0 +1,60 @@
+#ifndef DEPTHFILTER_H
+#define DEPTHFILTER_H
+
+#include <QVector>
+#include "OpenNI.h"
+
+// Stages of the depth clean-up filter, applied in this order.
+struct DepthFilterSettings
+{
+    // Fill zero-depth runs of up to holeMaxGap pixels along a row.
+    // Neighbours further apart than holeEdgeJump (mm) are treated as an
+    // object edge and the hole takes the far side instead of a blend.
+    bool bHoleFill = true;
+    int holeMaxGap = 8;
+    int holeEdgeJump = 50;
+
+    // 0 disables the median, otherwise 3 or 5.
+    int medianSize = 3;
+
+    // Exponential smoothing over frames, temporalAlpha being the weight of
+    // the new frame. Pixels that moved by more than motionThreshold (mm)
+    // start over from the new value so moving objects do not smear.
+    bool bTemporal = true;
+    double temporalAlpha = 0.3;
+    int motionThreshold = 60;
+};
+
+// Hole fill, median and temporal smoothing for depth frames. Rows are
+// split into bands that run in parallel on the global thread pool.
+// The temporal stage keeps state, call reset() whenever the next frame
+// does not follow the previous one.
+class DepthFilter
+{
+public:
+    DepthFilter();
+
+    void setSettings(const DepthFilterSettings& settings);
+
+    const DepthFilterSettings& settings() const { return m_settings; }
+
+    void reset();
+
+    // Returns the filtered frame, width * height pixels without padding.
+    // The buffer belongs to the filter and stays valid until the next call.
+    const openni::DepthPixel* process(const openni::DepthPixel* pDepth, int width, int height, int strideBytes);
+
+private:
+    DepthFilterSettings m_settings;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    // Hole-filled input with kPad replicated pixels on every side, so the
+    // median never has to special-case borders.
+    QVector<openni::DepthPixel> m_padded;
+    QVector<openni::DepthPixel> m_output;
+    QVector<openni::DepthPixel> m_history;
+};
+
+#endif // DEPTHFILTER_H
@@ -0,0 +1,77 @@
+#include "depthfilterdialog.h"
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+
+DepthFilterDialog::DepthFilterDialog(const DepthFilterSettings& settings, QWidget* parent) :
+    QDialog(parent)
+{
+    setWindowTitle(tr("Depth filter"));
+
+    pHoleFillCheck = new QCheckBox(tr("Fill holes"), this);
+    pHoleFillCheck->setChecked(settings.bHoleFill);
+    pHoleMaxGap = new QSpinBox(this);
+    pHoleMaxGap->setRange(1, 64);
+    pHoleMaxGap->setPrefix(tr("up to "));
+    pHoleMaxGap->setSuffix(" px");
+    pHoleMaxGap->setValue(settings.holeMaxGap);
+    pHoleEdgeJump = new QSpinBox(this);
+    pHoleEdgeJump->setRange(1, 10000);
+    pHoleEdgeJump->setPrefix(tr("edge at "));
+    pHoleEdgeJump->setSuffix(" mm");
+    pHoleEdgeJump->setValue(settings.holeEdgeJump);
+
+    pMedianSize = new QComboBox(this);
+    pMedianSize->addItem(tr("Off"), 0);
+    pMedianSize->addItem("3x3", 3);
+    pMedianSize->addItem("5x5", 5);
+    pMedianSize->setCurrentIndex(qMax(0, pMedianSize->findData(settings.medianSize)));
+
+    pTemporalCheck = new QCheckBox(tr("Temporal smoothing"), this);
+    pTemporalCheck->setChecked(settings.bTemporal);
+    pTemporalAlpha = new QDoubleSpinBox(this);
+    pTemporalAlpha->setRange(0.05, 1);
+    pTemporalAlpha->setSingleStep(0.05);
+    pTemporalAlpha->setPrefix(tr("new frame weight "));
+    pTemporalAlpha->setValue(settings.temporalAlpha);
+    pMotionThreshold = new QSpinBox(this);
+    pMotionThreshold->setRange(1, 10000);
+    pMotionThreshold->setPrefix(tr("reset over "));
+    pMotionThreshold->setSuffix(" mm");
+    pMotionThreshold->setValue(settings.motionThreshold);
+
+    QHBoxLayout* holeLayout = new QHBoxLayout;
+    holeLayout->addWidget(pHoleMaxGap);
+    holeLayout->addWidget(pHoleEdgeJump);
+
+    QHBoxLayout* temporalLayout = new QHBoxLayout;
+    temporalLayout->addWidget(pTemporalAlpha);
+    temporalLayout->addWidget(pMotionThreshold);
+
+    QDialogButtonBox* pButtons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(pButtons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(pButtons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QFormLayout* pLayout = new QFormLayout(this);
+    pLayout->addRow(pHoleFillCheck, holeLayout);
+    pLayout->addRow(tr("Median"), pMedianSize);
+    pLayout->addRow(pTemporalCheck, temporalLayout);
+    pLayout->addRow(pButtons);
+}
+
+DepthFilterSettings DepthFilterDialog::settings() const
+{
+    DepthFilterSettings settings;
+
+    settings.bHoleFill = pHoleFillCheck->isChecked();
+    settings.holeMaxGap = pHoleMaxGap->value();
+    settings.holeEdgeJump = pHoleEdgeJump->value();
+
+    settings.medianSize = pMedianSize->currentData().toInt();
+
+    settings.bTemporal = pTemporalCheck->isChecked();
+    settings.temporalAlpha = pTemporalAlpha->value();
+    settings.motionThreshold = pMotionThreshold->value();
+
+    return settings;
+}
@@ -0,0 +1,33 @@
+#ifndef DEPTHFILTERDIALOG_H
+#define DEPTHFILTERDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QSpinBox>
+#include "depthfilter.h"
+
+// Lets the user configure the stages of a DepthFilter.
+class DepthFilterDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DepthFilterDialog(const DepthFilterSettings& settings, QWidget* parent = nullptr);
+
+    DepthFilterSettings settings() const;
+
+private:
+    QCheckBox* pHoleFillCheck;
+    QSpinBox* pHoleMaxGap;
+    QSpinBox* pHoleEdgeJump;
+
+    QComboBox* pMedianSize;
+
+    QCheckBox* pTemporalCheck;
+    QDoubleSpinBox* pTemporalAlpha;
+    QSpinBox* pMotionThreshold;
+};
+
+#endif // DEPTHFILTERDIALOG_H
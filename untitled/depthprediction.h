@@ -0,0 +1,38 @@
+#ifndef DEPTHPREDICTION_H
+#define DEPTHPREDICTION_H
+
+#include <QtGlobal>
+
+// Pixel prediction shared by the archive format and the depth codec.
+
+// LOCO-I median edge detector: a is left, b is up, c is up-left.
+// Follows edges in either direction and is exact on planar ramps,
+// which covers most of a depth image.
+inline int predictMed(int a, int b, int c)
+{
+    int lo = a < b ? a : b;
+    int hi = a < b ? b : a;
+    if (c >= hi)
+    {
+        return lo;
+    }
+    if (c <= lo)
+    {
+        return hi;
+    }
+    return a + b - c;
+}
+
+// Signed 16-bit residual to 0, 1, 2, ... for -0, -1, 1, -2, ...
+inline quint16 zigzag(int residual)
+{
+    qint16 r = qint16(residual);
+    return quint16((r << 1) ^ (r >> 15));
+}
+
+inline int unzigzag(quint32 value)
+{
+    return int(value >> 1) ^ -int(value & 1);
+}
+
+#endif // DEPTHPREDICTION_H
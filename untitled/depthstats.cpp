@@ -0,0 +1,157 @@
+#include "depthstats.h"
+#include "simd.h"
+#include <math.h>
+
+using openni::DepthPixel;
+
+namespace
+{
+    // Histogram copies filled in turn, so consecutive pixels of the same
+    // depth do not wait on each other's increments.
+    const int kHistogramCopies = 4;
+}
+
+DepthStats computeDepthStats(const DepthPixel* pDepth, int width, int height, int strideBytes)
+{
+    DepthStats stats;
+
+    quint32 histograms[kHistogramCopies][DepthStats::kHistogramBins] = {};
+    const int lastBin = DepthStats::kHistogramBins - 1;
+    int minDepth = 0xffff;
+    int maxDepth = 0;
+    int invalid = 0;
+    quint64 sum = 0;
+    quint64 sumOfSquares = 0;
+
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    for (int y = 0; y < height; ++y)
+    {
+        const DepthPixel* row = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+        int x = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        // Unsigned compares through the signed ones, with the sign bit flipped.
+        const __m128i bias = _mm_set1_epi16(short(0x8000));
+        const __m128i binLimit = _mm_set1_epi16(short(lastBin));
+
+        __m128i minAcc = _mm_set1_epi16(short(0x7fff));
+        __m128i maxAcc = bias;
+        __m128i invalidAcc = zero;
+        __m128i sumAcc = zero;
+        __m128i squareAcc = zero;
+        quint16 bins[8];
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i depth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i isInvalid = _mm_cmpeq_epi16(depth, zero);
+            invalidAcc = _mm_sub_epi16(invalidAcc, isInvalid);
+
+            // Invalid pixels become 0xffff for the minimum, stay 0 for the maximum.
+            minAcc = _mm_min_epi16(minAcc, _mm_xor_si128(_mm_or_si128(depth, isInvalid), bias));
+            maxAcc = _mm_max_epi16(maxAcc, _mm_xor_si128(depth, bias));
+
+            // Zero adds nothing to the sums, no masking needed.
+            __m128i low = _mm_unpacklo_epi16(depth, zero);
+            __m128i high = _mm_unpackhi_epi16(depth, zero);
+            sumAcc = _mm_add_epi32(sumAcc, _mm_add_epi32(low, high));
+            squareAcc = _mm_add_epi64(squareAcc, _mm_mul_epu32(low, low));
+            squareAcc = _mm_add_epi64(squareAcc, _mm_mul_epu32(_mm_srli_epi64(low, 32), _mm_srli_epi64(low, 32)));
+            squareAcc = _mm_add_epi64(squareAcc, _mm_mul_epu32(high, high));
+            squareAcc = _mm_add_epi64(squareAcc, _mm_mul_epu32(_mm_srli_epi64(high, 32), _mm_srli_epi64(high, 32)));
+
+            __m128i bin = _mm_min_epi16(_mm_srli_epi16(depth, DepthStats::kHistogramShift), binLimit);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bins), bin);
+            for (int i = 0; i < 8; ++i)
+            {
+                ++histograms[i % kHistogramCopies][bins[i]];
+            }
+        }
+
+        quint16 lanes[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_xor_si128(minAcc, bias));
+        for (int i = 0; i < 8; ++i)
+        {
+            minDepth = qMin(minDepth, int(lanes[i]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_xor_si128(maxAcc, bias));
+        for (int i = 0; i < 8; ++i)
+        {
+            maxDepth = qMax(maxDepth, int(lanes[i]));
+        }
+        invalid += sumCounts16(invalidAcc);
+
+        quint32 sums[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), sumAcc);
+        sum += quint64(sums[0]) + sums[1] + sums[2] + sums[3];
+        quint64 squares[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(squares), squareAcc);
+        sumOfSquares += squares[0] + squares[1];
+#endif
+
+        for (; x < width; ++x)
+        {
+            int depth = row[x];
+            ++histograms[0][qMin(depth >> DepthStats::kHistogramShift, lastBin)];
+            if (depth == 0)
+            {
+                ++invalid;
+                continue;
+            }
+            minDepth = qMin(minDepth, depth);
+            maxDepth = qMax(maxDepth, depth);
+            sum += depth;
+            sumOfSquares += quint64(depth) * depth;
+        }
+    }
+
+    for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+    {
+        for (int copy = 0; copy < kHistogramCopies; ++copy)
+        {
+            stats.histogram[bin] += histograms[copy][bin];
+        }
+    }
+    // Bin 0 counted the invalid pixels along with the nearest valid ones.
+    stats.histogram[0] -= invalid;
+
+    stats.invalidPixels = invalid;
+    stats.validPixels = width * height - invalid;
+    if (stats.validPixels > 0)
+    {
+        stats.minDepth = minDepth;
+        stats.maxDepth = maxDepth;
+        stats.mean = double(sum) / stats.validPixels;
+        double variance = double(sumOfSquares) / stats.validPixels - stats.mean * stats.mean;
+        stats.standardDeviation = sqrt(qMax(0.0, variance));
+    }
+
+    return stats;
+}
+
+void writeDepthStatsCsvHeader(QTextStream& out, bool bHistogram)
+{
+    out << "frame,timestamp_us,valid,invalid_ratio,min_mm,max_mm,mean_mm,stddev_mm";
+    if (bHistogram)
+    {
+        for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+        {
+            out << ",bin_" << (bin << DepthStats::kHistogramShift);
+        }
+    }
+    out << '\n';
+}
+
+void writeDepthStatsCsv(QTextStream& out, int frameIndex, quint64 timestamp, const DepthStats& stats, bool bHistogram)
+{
+    out << frameIndex << ',' << timestamp << ',' << stats.validPixels << ',' << stats.invalidRatio() << ','
+        << stats.minDepth << ',' << stats.maxDepth << ',' << stats.mean << ',' << stats.standardDeviation;
+    if (bHistogram)
+    {
+        for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+        {
+            out << ',' << stats.histogram[bin];
+        }
+    }
+    out << '\n';
+}
@@ -0,0 +1,37 @@
+#ifndef DEPTHSTATS_H
+#define DEPTHSTATS_H
+
+#include <QTextStream>
+#include "OpenNI.h"
+
+// Statistics of the valid (non-zero) pixels of one depth frame.
+struct DepthStats
+{
+    // 32 mm per bin, the last bin also holds everything farther.
+    static const int kHistogramBins = 256;
+    static const int kHistogramShift = 5;
+
+    int validPixels = 0;
+    int invalidPixels = 0;
+    int minDepth = 0;
+    int maxDepth = 0;
+    double mean = 0;
+    double standardDeviation = 0;
+    quint32 histogram[kHistogramBins] = {};
+
+    double invalidRatio() const
+    {
+        int total = validPixels + invalidPixels;
+        return total > 0 ? double(invalidPixels) / total : 0;
+    }
+};
+
+// Everything in one pass over the frame: min, max, sum and sum of squares
+// with SSE2, the histogram from the bins the same loads produce.
+DepthStats computeDepthStats(const openni::DepthPixel* pDepth, int width, int height, int strideBytes);
+
+void writeDepthStatsCsvHeader(QTextStream& out, bool bHistogram);
+
+void writeDepthStatsCsv(QTextStream& out, int frameIndex, quint64 timestamp, const DepthStats& stats, bool bHistogram);
+
+#endif // DEPTHSTATS_H
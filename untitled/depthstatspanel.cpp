@@ -0,0 +1,109 @@
+#include "depthstatspanel.h"
+#include <QPainter>
+#include <QPolygonF>
+
+namespace
+{
+    // Frames in the sparkline, ten seconds at 30 fps.
+    const int kHistoryFrames = 300;
+
+    const int kMargin = 4;
+    const int kHistogramHeight = 60;
+    const int kSparklineHeight = 40;
+
+    void drawSparkline(QPainter* pPainter, const QRect& rect, const QVector<float>& values, float maxValue, const QColor& color)
+    {
+        if (values.size() < 2 || maxValue <= 0)
+        {
+            return;
+        }
+
+        QPolygonF line;
+        for (int i = 0; i < values.size(); ++i)
+        {
+            line << QPointF(rect.left() + double(i) * rect.width() / (kHistoryFrames - 1),
+                            rect.bottom() - values[i] / maxValue * rect.height());
+        }
+        pPainter->setPen(color);
+        pPainter->drawPolyline(line);
+    }
+}
+
+DepthStatsPanel::DepthStatsPanel(QWidget* parent) :
+    QWidget(parent)
+{
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+}
+
+QSize DepthStatsPanel::sizeHint() const
+{
+    return QSize(260, 4 * fontMetrics().height() + kHistogramHeight + kSparklineHeight + 5 * kMargin);
+}
+
+void DepthStatsPanel::clear()
+{
+    m_frameIndex = 0;
+    m_stats = DepthStats();
+    m_means.clear();
+    m_invalidRatios.clear();
+    update();
+}
+
+void DepthStatsPanel::addFrame(int frameIndex, const DepthStats& stats)
+{
+    m_frameIndex = frameIndex;
+    m_stats = stats;
+    if (m_means.size() == kHistoryFrames)
+    {
+        m_means.removeFirst();
+        m_invalidRatios.removeFirst();
+    }
+    m_means.append(float(stats.mean));
+    m_invalidRatios.append(float(stats.invalidRatio()));
+    update();
+}
+
+void DepthStatsPanel::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().dark());
+
+    int lineHeight = fontMetrics().height();
+    QRect textRect(kMargin, kMargin, width() - 2 * kMargin, 4 * lineHeight);
+    painter.setPen(palette().brightText().color());
+    painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop,
+                     tr("Frame %1\nMin %2 mm, max %3 mm\nMean %4 mm, std dev %5 mm\nInvalid %6%")
+                     .arg(m_frameIndex)
+                     .arg(m_stats.minDepth)
+                     .arg(m_stats.maxDepth)
+                     .arg(m_stats.mean, 0, 'f', 0)
+                     .arg(m_stats.standardDeviation, 0, 'f', 0)
+                     .arg(100 * m_stats.invalidRatio(), 0, 'f', 1));
+
+    // Histogram of valid depth, bars scaled to the fullest bin.
+    QRect histogramRect(kMargin, textRect.bottom() + kMargin, width() - 2 * kMargin, kHistogramHeight);
+    quint32 fullest = 1;
+    for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+    {
+        fullest = qMax(fullest, m_stats.histogram[bin]);
+    }
+    for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+    {
+        int left = histogramRect.left() + bin * histogramRect.width() / DepthStats::kHistogramBins;
+        int right = histogramRect.left() + (bin + 1) * histogramRect.width() / DepthStats::kHistogramBins;
+        int barHeight = int(qint64(m_stats.histogram[bin]) * histogramRect.height() / fullest);
+        painter.fillRect(left, histogramRect.bottom() - barHeight, qMax(1, right - left), barHeight, palette().highlight());
+    }
+
+    QRect sparklineRect(kMargin, histogramRect.bottom() + kMargin, width() - 2 * kMargin, kSparklineHeight);
+    painter.fillRect(sparklineRect, palette().shadow());
+    float maxMean = 0;
+    for (int i = 0; i < m_means.size(); ++i)
+    {
+        maxMean = qMax(maxMean, m_means[i]);
+    }
+    drawSparkline(&painter, sparklineRect, m_means, maxMean, Qt::white);
+    drawSparkline(&painter, sparklineRect, m_invalidRatios, 1.0f, Qt::red);
+}
@@ -0,0 +1,34 @@
+#ifndef DEPTHSTATSPANEL_H
+#define DEPTHSTATSPANEL_H
+
+#include <QVector>
+#include <QWidget>
+#include "depthstats.h"
+
+// Numbers of the current depth frame, its histogram, and a sparkline of
+// the mean depth (white) and the invalid pixel ratio (red) of the last
+// frames shown.
+class DepthStatsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DepthStatsPanel(QWidget* parent = nullptr);
+
+    void clear();
+
+    void addFrame(int frameIndex, const DepthStats& stats);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    int m_frameIndex = 0;
+    DepthStats m_stats;
+    QVector<float> m_means;
+    QVector<float> m_invalidRatios;
+};
+
+#endif // DEPTHSTATSPANEL_H
@@ -0,0 +1,44 @@
+#include "fasthash.h"
+#include <string.h>
+
+quint64 fastHash64(const void* data, size_t size, quint64 seed)
+{
+    const quint64 m = Q_UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
+
+    quint64 h = seed ^ (quint64(size) * m);
+
+    const uchar* p = static_cast<const uchar*>(data);
+    const uchar* end = p + (size & ~size_t(7));
+
+    for (; p != end; p += 8)
+    {
+        quint64 k;
+        memcpy(&k, p, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    switch (size & 7)
+    {
+    case 7: h ^= quint64(p[6]) << 48; // fall through
+    case 6: h ^= quint64(p[5]) << 40; // fall through
+    case 5: h ^= quint64(p[4]) << 32; // fall through
+    case 4: h ^= quint64(p[3]) << 24; // fall through
+    case 3: h ^= quint64(p[2]) << 16; // fall through
+    case 2: h ^= quint64(p[1]) << 8;  // fall through
+    case 1: h ^= quint64(p[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
@@ -0,0 +1,11 @@
+#ifndef FASTHASH_H
+#define FASTHASH_H
+
+#include <QtGlobal>
+#include <stddef.h>
+
+// Non-cryptographic 64-bit hash (MurmurHash64A) for spotting identical
+// frame payloads. Runs at memory bandwidth, not suitable for security.
+quint64 fastHash64(const void* data, size_t size, quint64 seed = 0);
+
+#endif // FASTHASH_H
@@ -0,0 +1,161 @@
+#include "frameconvert.h"
+#include <QColor>
+#include <QVector>
+
+namespace
+{
+    // Depth range mapped onto the gray scale, in millimeters.
+    const int kMaxDisplayDepth = 10000;
+
+    // Hue ramp over the display range, one entry per millimeter.
+    QVector<QRgb> makeDepthPalette()
+    {
+        QVector<QRgb> palette(kMaxDisplayDepth);
+        palette[0] = qRgb(0, 0, 0);
+        for (int depth = 1; depth < kMaxDisplayDepth; ++depth)
+        {
+            palette[depth] = QColor::fromHsv(240 * depth / kMaxDisplayDepth, 255, 255).rgb();
+        }
+        return palette;
+    }
+}
+
+QImage depthFrameToImage(const openni::VideoFrameRef& frame, int step)
+{
+    if (!frame.isValid() || step < 1)
+    {
+        return QImage();
+    }
+
+    int width = frame.getWidth() / step;
+    int height = frame.getHeight() / step;
+    QImage image(width, height, QImage::Format_Grayscale8);
+
+    const uchar* data = static_cast<const uchar*>(frame.getData());
+    int stride = frame.getStrideInBytes();
+
+    for (int y = 0; y < height; ++y)
+    {
+        const openni::DepthPixel* src = reinterpret_cast<const openni::DepthPixel*>(data + y * step * stride);
+        uchar* dst = image.scanLine(y);
+        for (int x = 0; x < width; ++x)
+        {
+            int depth = src[x * step];
+            if (depth == 0 || depth >= kMaxDisplayDepth)
+            {
+                dst[x] = 0;
+            }
+            else
+            {
+                dst[x] = static_cast<uchar>(255 - depth * 255 / kMaxDisplayDepth);
+            }
+        }
+    }
+
+    return image;
+}
+
+QImage colorizeDepth(const openni::DepthPixel* depth, int width, int height, int strideBytes, const DepthStats& stats)
+{
+    QRgb palette[DepthStats::kHistogramBins];
+    quint64 nearer = 0;
+    for (int bin = 0; bin < DepthStats::kHistogramBins; ++bin)
+    {
+        nearer += stats.histogram[bin];
+        int hue = int(240 * nearer / qMax(1, stats.validPixels));
+        palette[bin] = QColor::fromHsv(qMin(hue, 240), 255, 255).rgb();
+    }
+
+    const int lastBin = DepthStats::kHistogramBins - 1;
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y)
+    {
+        const openni::DepthPixel* src = reinterpret_cast<const openni::DepthPixel*>(reinterpret_cast<const uchar*>(depth) + y * strideBytes);
+        QRgb* dst = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x)
+        {
+            dst[x] = src[x] != 0 ? palette[qMin(src[x] >> DepthStats::kHistogramShift, lastBin)] : qRgb(0, 0, 0);
+        }
+    }
+
+    return image;
+}
+
+QImage colorFrameToImage(const openni::VideoFrameRef& frame, int step)
+{
+    if (!frame.isValid() || step < 1)
+    {
+        return QImage();
+    }
+
+    const uchar* data = static_cast<const uchar*>(frame.getData());
+    int stride = frame.getStrideInBytes();
+
+    if (step == 1)
+    {
+        return QImage(data, frame.getWidth(), frame.getHeight(), stride, QImage::Format_RGB888).copy();
+    }
+
+    int width = frame.getWidth() / step;
+    int height = frame.getHeight() / step;
+    QImage image(width, height, QImage::Format_RGB888);
+
+    for (int y = 0; y < height; ++y)
+    {
+        const openni::RGB888Pixel* src = reinterpret_cast<const openni::RGB888Pixel*>(data + y * step * stride);
+        openni::RGB888Pixel* dst = reinterpret_cast<openni::RGB888Pixel*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x)
+        {
+            dst[x] = src[x * step];
+        }
+    }
+
+    return image;
+}
+
+QImage colorizeDepth(const openni::DepthPixel* depth, int width, int height, int strideBytes)
+{
+    static const QVector<QRgb> palette = makeDepthPalette();
+
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y)
+    {
+        const openni::DepthPixel* src = reinterpret_cast<const openni::DepthPixel*>(reinterpret_cast<const uchar*>(depth) + y * strideBytes);
+        QRgb* dst = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x)
+        {
+            dst[x] = src[x] < kMaxDisplayDepth ? palette[src[x]] : qRgb(0, 0, 0);
+        }
+    }
+
+    return image;
+}
+
+QRect regionRect(const QRectF& region, int width, int height)
+{
+    if (region.isNull())
+    {
+        return QRect(0, 0, width, height);
+    }
+
+    return QRect(int(region.x() * width), int(region.y() * height),
+                 qMax(1, int(region.width() * width)), qMax(1, int(region.height() * height))) & QRect(0, 0, width, height);
+}
+
+int bytesPerPixel(openni::PixelFormat pixelFormat)
+{
+    switch (pixelFormat)
+    {
+    case openni::PIXEL_FORMAT_RGB888:
+        return 3;
+    case openni::PIXEL_FORMAT_GRAY8:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+const uchar* regionData(const void* data, int strideBytes, int bytesPerPixel, const QRect& region)
+{
+    return static_cast<const uchar*>(data) + qint64(region.y()) * strideBytes + region.x() * bytesPerPixel;
+}
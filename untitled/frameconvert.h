@@ -0,0 +1,37 @@
+#ifndef FRAMECONVERT_H
+#define FRAMECONVERT_H
+
+#include <QImage>
+#include <QRect>
+#include "OpenNI.h"
+#include "depthstats.h"
+
+// Converts a depth frame to an 8-bit grayscale image, near is bright and
+// invalid (zero) depth is black. Every step-th pixel is sampled, so step > 1
+// gives a cheap downscaled image.
+QImage depthFrameToImage(const openni::VideoFrameRef& frame, int step = 1);
+
+// Colors a depth buffer for export: near is red through yellow, green and
+// cyan to far blue, invalid (zero) depth is black.
+QImage colorizeDepth(const openni::DepthPixel* depth, int width, int height, int strideBytes);
+
+// Same colors, spread by the frame's histogram: the hue follows the share
+// of valid pixels nearer than each bin, so the depths the frame actually
+// has use the whole ramp.
+QImage colorizeDepth(const openni::DepthPixel* depth, int width, int height, int strideBytes, const DepthStats& stats);
+
+// Converts an RGB888 color frame to an image, sampling every step-th pixel.
+QImage colorFrameToImage(const openni::VideoFrameRef& frame, int step = 1);
+
+// Pixels of region, given in fractions of the frame, in a frame of this
+// size; the whole frame for a null region.
+QRect regionRect(const QRectF& region, int width, int height);
+
+// Size of one pixel of the formats the player handles: RGB888, GRAY8 and
+// the 16-bit depth and IR formats.
+int bytesPerPixel(openni::PixelFormat pixelFormat);
+
+// First pixel of region in a buffer with rows strideBytes apart.
+const uchar* regionData(const void* data, int strideBytes, int bytesPerPixel, const QRect& region);
+
+#endif // FRAMECONVERT_H
@@ -0,0 +1,68 @@
+#ifndef FRAMEMAILBOX_H
+#define FRAMEMAILBOX_H
+
+#include <QAtomicInt>
+
+// Single producer, single consumer triple buffer where the newest value
+// always wins. The producer fills back() and publishes it, the consumer
+// takes whatever was published last; values the consumer never got to are
+// simply overwritten, so a slow consumer sees fewer frames instead of
+// older ones. Neither side ever blocks.
+template <typename T>
+class FrameMailbox
+{
+public:
+    FrameMailbox()
+        : m_middle(1)
+        , m_back(2)
+        , m_front(0)
+    {
+    }
+
+    // Producer side. The slot belongs to the producer until publish().
+    T& back() { return m_slots[m_back]; }
+
+    // Hands back() over to the consumer. Returns true if a previously
+    // published value had not been taken yet and was dropped.
+    bool publish()
+    {
+        int old = m_middle.fetchAndStoreOrdered(m_back | kFreshBit);
+        m_back = old & kIndexMask;
+        return (old & kFreshBit) != 0;
+    }
+
+    // Consumer side. Moves the newest published value to front(); returns
+    // false if nothing new was published since the last call.
+    bool take()
+    {
+        // Only the consumer clears the fresh bit, so it cannot be lost
+        // between this check and the exchange.
+        if ((m_middle.loadAcquire() & kFreshBit) == 0)
+        {
+            return false;
+        }
+
+        int old = m_middle.fetchAndStoreOrdered(m_front);
+        m_front = old & kIndexMask;
+        return true;
+    }
+
+    T& front() { return m_slots[m_front]; }
+
+private:
+    FrameMailbox(const FrameMailbox&);
+    FrameMailbox& operator=(const FrameMailbox&);
+
+    static const int kIndexMask = 3;
+    static const int kFreshBit = 4;
+
+    T m_slots[3];
+
+    // Index of the slot in the middle, plus kFreshBit when unread.
+    QAtomicInt m_middle;
+
+    int m_back;
+    int m_front;
+};
+
+#endif // FRAMEMAILBOX_H
@@ -0,0 +1,92 @@
+#include "framepublisher.h"
+#include <string.h>
+
+FramePublisher::FramePublisher()
+{
+}
+
+FramePublisher::~FramePublisher()
+{
+    close();
+}
+
+bool FramePublisher::create(const QString& name, int slotCount, int slotSize)
+{
+    close();
+
+    int size = int(framering::ringSize(quint32(slotCount), quint32(slotSize)));
+
+    // Native keys keep the name usable from processes without Qt.
+    m_memory.setNativeKey(name);
+    if (!m_memory.create(size))
+    {
+        // Left behind by a publisher that crashed, or still mapped by
+        // subscribers: reuse it if it is large enough.
+        if (m_memory.error() != QSharedMemory::AlreadyExists || !m_memory.attach() || m_memory.size() < size)
+        {
+            m_errorString = m_memory.errorString();
+            m_memory.detach();
+            return false;
+        }
+    }
+
+    framering::RingHeader* header = static_cast<framering::RingHeader*>(m_memory.data());
+    // Invalidate first so subscribers of an older ring stop reading.
+    header->magic = 0;
+    memset(m_memory.data(), 0, size_t(size));
+    header->version = framering::kVersion;
+    header->slotCount = quint32(slotCount);
+    header->slotSize = quint32(slotSize);
+    header->lastSequence.store(0, std::memory_order_release);
+    header->magic = framering::kMagic;
+
+    m_sequence = 0;
+    m_oversized = 0;
+    return true;
+}
+
+void FramePublisher::close()
+{
+    if (m_memory.isAttached())
+    {
+        static_cast<framering::RingHeader*>(m_memory.data())->magic = 0;
+        m_memory.detach();
+    }
+}
+
+bool FramePublisher::publish(framering::StreamKind stream, const openni::VideoFrameRef& frame)
+{
+    if (!m_memory.isAttached() || !frame.isValid())
+    {
+        return false;
+    }
+
+    framering::RingHeader* header = static_cast<framering::RingHeader*>(m_memory.data());
+    if (quint32(frame.getDataSize()) > header->slotSize)
+    {
+        ++m_oversized;
+        return false;
+    }
+
+    quint64 sequence = m_sequence + 1;
+    framering::SlotHeader* slot = framering::slotHeader(header, sequence);
+
+    slot->sequence.store(2 * sequence - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->stream = quint32(stream);
+    slot->pixelFormat = quint32(frame.getVideoMode().getPixelFormat());
+    slot->width = quint32(frame.getWidth());
+    slot->height = quint32(frame.getHeight());
+    slot->strideBytes = quint32(frame.getStrideInBytes());
+    slot->dataSize = quint32(frame.getDataSize());
+    slot->frameIndex = frame.getFrameIndex();
+    slot->timestamp = frame.getTimestamp();
+    memcpy(framering::slotData(slot), frame.getData(), size_t(frame.getDataSize()));
+
+    slot->sequence.store(2 * sequence, std::memory_order_release);
+    header->lastSequence.store(sequence, std::memory_order_release);
+
+    m_sequence = sequence;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef FRAMEPUBLISHER_H
+#define FRAMEPUBLISHER_H
+
+#include <QSharedMemory>
+#include <QString>
+#include "OpenNI.h"
+#include "framering.h"
+
+// Writes decoded frames into a shared-memory ring (see framering.h) so
+// other local processes can use them in place through FrameSubscriber
+// instead of opening and decoding the recording themselves.
+// Single writer; all calls from one thread.
+class FramePublisher
+{
+public:
+    FramePublisher();
+    ~FramePublisher();
+
+    // slotSize is the largest frame in bytes. Fails if the name is taken
+    // by a ring of another size.
+    bool create(const QString& name, int slotCount, int slotSize);
+
+    void close();
+
+    bool isOpen() const { return m_memory.isAttached(); }
+
+    // Returns false if the frame does not fit a slot.
+    bool publish(framering::StreamKind stream, const openni::VideoFrameRef& frame);
+
+    quint64 published() const { return m_sequence; }
+
+    int oversized() const { return m_oversized; }
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    FramePublisher(const FramePublisher&);
+    FramePublisher& operator=(const FramePublisher&);
+
+    QSharedMemory m_memory;
+    quint64 m_sequence = 0;
+    int m_oversized = 0;
+    QString m_errorString;
+};
+
+#endif // FRAMEPUBLISHER_H
@@ -0,0 +1,269 @@
+#include "framequery.h"
+#include "recordingreader.h"
+#include "simd.h"
+#include "taskscheduler.h"
+
+namespace
+{
+    // Chunks per worker thread, small enough to balance uneven decode cost.
+    const int kChunksPerThread = 4;
+
+    // Counts pixels with 0 < depth < nearDepth and pixels without depth.
+    void countRow(const openni::DepthPixel* row, int width, int nearDepth, int* pNear, int* pInvalid)
+    {
+        int x = 0;
+        int nearCount = 0;
+        int invalidCount = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i bias = _mm_set1_epi16(short(0x8000));
+        // Unsigned (depth - 1) < (nearDepth - 1) rejects zero and far pixels in one compare.
+        const __m128i nearLimit = _mm_set1_epi16(short((nearDepth - 1) ^ 0x8000));
+
+        __m128i nearAcc = zero;
+        __m128i invalidAcc = zero;
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i depth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i isInvalid = _mm_cmpeq_epi16(depth, zero);
+            __m128i isNear = _mm_cmplt_epi16(_mm_xor_si128(_mm_sub_epi16(depth, one), bias), nearLimit);
+            invalidAcc = _mm_sub_epi16(invalidAcc, isInvalid);
+            nearAcc = _mm_sub_epi16(nearAcc, isNear);
+        }
+        nearCount = sumCounts16(nearAcc);
+        invalidCount = sumCounts16(invalidAcc);
+#endif
+
+        for (; x < width; ++x)
+        {
+            int depth = row[x];
+            if (depth == 0)
+            {
+                ++invalidCount;
+            }
+            else if (depth < nearDepth)
+            {
+                ++nearCount;
+            }
+        }
+
+        *pNear += nearCount;
+        *pInvalid += invalidCount;
+    }
+
+    // Counts pixels valid in both rows whose depth differs by more than threshold.
+    int countChangedRow(const openni::DepthPixel* row, const openni::DepthPixel* previous, int width, int threshold)
+    {
+        int x = 0;
+        int changedCount = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i limit = _mm_set1_epi16(short(threshold));
+
+        __m128i changedAcc = zero;
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + x));
+            __m128i diff = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+            __m128i unchanged = _mm_cmpeq_epi16(_mm_subs_epu16(diff, limit), zero);
+            __m128i rejected = _mm_or_si128(unchanged, _mm_or_si128(_mm_cmpeq_epi16(a, zero), _mm_cmpeq_epi16(b, zero)));
+            // rejected lanes are -1, accepted 0: count the accepted ones.
+            changedAcc = _mm_add_epi16(changedAcc, _mm_add_epi16(rejected, _mm_set1_epi16(1)));
+        }
+        changedCount = sumCounts16(changedAcc);
+#endif
+
+        for (; x < width; ++x)
+        {
+            int a = row[x];
+            int b = previous[x];
+            if (a != 0 && b != 0 && qAbs(a - b) > threshold)
+            {
+                ++changedCount;
+            }
+        }
+
+        return changedCount;
+    }
+}
+
+FrameQueryEngine::FrameQueryEngine(const QString& fileName, const FrameQuery& query) :
+    m_fileName(fileName),
+    m_query(query),
+    m_bCanceled(0),
+    m_framesScanned(0),
+    m_numberOfFrames(0)
+{
+}
+
+void FrameQueryEngine::cancel()
+{
+    m_bCanceled.store(1);
+}
+
+bool FrameQueryEngine::matches(const openni::VideoFrameRef& frame, const openni::VideoFrameRef& previous) const
+{
+    QRect roi = m_query.roi.isEmpty() ? QRect(0, 0, frame.getWidth(), frame.getHeight())
+                                      : m_query.roi.intersected(QRect(0, 0, frame.getWidth(), frame.getHeight()));
+    if (roi.isEmpty())
+    {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(frame.getData());
+    int stride = frame.getStrideInBytes();
+    bool bCompare = m_query.bChange && previous.isValid() &&
+                    previous.getWidth() == frame.getWidth() && previous.getHeight() == frame.getHeight();
+    const char* previousData = bCompare ? static_cast<const char*>(previous.getData()) : NULL;
+
+    int nearCount = 0;
+    int invalidCount = 0;
+    int changedCount = 0;
+    int nearDepth = qMax(1, m_query.nearDepth);
+
+    for (int y = roi.top(); y <= roi.bottom(); ++y)
+    {
+        const openni::DepthPixel* row = reinterpret_cast<const openni::DepthPixel*>(data + y * stride) + roi.left();
+        countRow(row, roi.width(), nearDepth, &nearCount, &invalidCount);
+
+        if (previousData != NULL)
+        {
+            const openni::DepthPixel* previousRow = reinterpret_cast<const openni::DepthPixel*>(previousData + y * stride) + roi.left();
+            changedCount += countChangedRow(row, previousRow, roi.width(), m_query.changeDepth);
+        }
+    }
+
+    double area = double(roi.width()) * roi.height();
+
+    if (m_query.bNear && nearCount < m_query.nearMinPixels)
+    {
+        return false;
+    }
+    if (m_query.bInvalid && invalidCount <= m_query.invalidRatio * area)
+    {
+        return false;
+    }
+    if (m_query.bChange && (previousData == NULL || changedCount <= m_query.changeRatio * area))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+QVector<FrameRange> FrameQueryEngine::scanChunk(int first, int last)
+{
+    QVector<FrameRange> ranges;
+
+    RecordingReader reader;
+    if (reader.open(m_fileName) != openni::STATUS_OK || !reader.hasStream(openni::SENSOR_DEPTH))
+    {
+        return ranges;
+    }
+
+    openni::VideoFrameRef previous;
+    openni::VideoFrameRef frame;
+
+    // The change predicate needs the frame just before the chunk.
+    int startId = (m_query.bChange && first > 1) ? first - 1 : first;
+    openni::Status nRetVal = reader.readFrameAt(openni::SENSOR_DEPTH, startId, &frame);
+    if (startId < first && nRetVal == openni::STATUS_OK)
+    {
+        previous = frame;
+        nRetVal = reader.readNextFrame(openni::SENSOR_DEPTH, &frame);
+    }
+
+    while (nRetVal == openni::STATUS_OK && !m_bCanceled.load())
+    {
+        int frameId = frame.getFrameIndex();
+        if (frameId > last)
+        {
+            break;
+        }
+
+        if (matches(frame, previous))
+        {
+            if (!ranges.isEmpty() && ranges.last().last + 1 >= frameId)
+            {
+                ranges.last().last = frameId;
+            }
+            else
+            {
+                FrameRange range = { frameId, frameId };
+                ranges.append(range);
+            }
+        }
+
+        m_framesScanned.fetchAndAddRelaxed(1);
+
+        if (frameId >= last)
+        {
+            break;
+        }
+
+        previous = frame;
+        nRetVal = reader.readNextFrame(openni::SENSOR_DEPTH, &frame);
+    }
+
+    return ranges;
+}
+
+QVector<FrameRange> FrameQueryEngine::run()
+{
+    QVector<FrameRange> result;
+
+    int numberOfFrames = 0;
+    {
+        RecordingReader reader;
+        if (reader.open(m_fileName) != openni::STATUS_OK)
+        {
+            return result;
+        }
+        numberOfFrames = reader.getNumberOfFrames(openni::SENSOR_DEPTH);
+    }
+    m_numberOfFrames.store(numberOfFrames);
+    if (numberOfFrames <= 0)
+    {
+        return result;
+    }
+
+    int chunkCount = qMin(numberOfFrames, qMax(1, TaskScheduler::instance()->workerCount() * kChunksPerThread));
+    QVector<FrameRange> chunks;
+    for (int i = 0; i < chunkCount; ++i)
+    {
+        // ONI frame indices start at 1.
+        FrameRange chunk = { int(qint64(numberOfFrames) * i / chunkCount) + 1,
+                             int(qint64(numberOfFrames) * (i + 1) / chunkCount) };
+        chunks.append(chunk);
+    }
+
+    // Queries run as background jobs, the chunks stay in that class.
+    QVector<QVector<FrameRange> > chunkResults(chunkCount);
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Background, chunkCount, [&](int index)
+    {
+        chunkResults[index] = scanChunk(chunks[index].first, chunks[index].last);
+    });
+
+    // Chunks are in file order, only ranges touching a chunk border need merging.
+    for (int i = 0; i < chunkCount; ++i)
+    {
+        for (int j = 0; j < chunkResults[i].size(); ++j)
+        {
+            const FrameRange& range = chunkResults[i][j];
+            if (!result.isEmpty() && result.last().last + 1 >= range.first)
+            {
+                result.last().last = qMax(result.last().last, range.last);
+            }
+            else
+            {
+                result.append(range);
+            }
+        }
+    }
+
+    return result;
+}
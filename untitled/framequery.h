@@ -0,0 +1,69 @@
+#ifndef FRAMEQUERY_H
+#define FRAMEQUERY_H
+
+#include <QAtomicInt>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "OpenNI.h"
+
+// Depth conditions a frame has to meet. Every enabled predicate must hold.
+struct FrameQuery
+{
+    // Something closer than nearDepth (mm) inside roi, at least nearMinPixels of it.
+    bool bNear = true;
+    int nearDepth = 800;
+    int nearMinPixels = 50;
+
+    // More than invalidRatio of the roi has no depth.
+    bool bInvalid = false;
+    double invalidRatio = 0.3;
+
+    // More than changeRatio of the roi moved by over changeDepth (mm) since the previous frame.
+    bool bChange = false;
+    int changeDepth = 100;
+    double changeRatio = 0.1;
+
+    // Empty means the whole frame.
+    QRect roi;
+};
+
+// Inclusive range of matching frame indices.
+struct FrameRange
+{
+    int first;
+    int last;
+};
+
+// Scans the depth stream of a recording for frames that satisfy a FrameQuery.
+// The file is split into chunks that are scanned in parallel as tasks of
+// the scheduler, each through its own RecordingReader, so the open player
+// streams are never touched.
+class FrameQueryEngine
+{
+public:
+    FrameQueryEngine(const QString& fileName, const FrameQuery& query);
+
+    // Blocks until the whole file is scanned or cancel() is called.
+    QVector<FrameRange> run();
+
+    void cancel();
+
+    int framesScanned() const { return m_framesScanned.load(); }
+
+    int numberOfFrames() const { return m_numberOfFrames.load(); }
+
+private:
+    QVector<FrameRange> scanChunk(int first, int last);
+
+    bool matches(const openni::VideoFrameRef& frame, const openni::VideoFrameRef& previous) const;
+
+    QString m_fileName;
+    FrameQuery m_query;
+
+    QAtomicInt m_bCanceled;
+    QAtomicInt m_framesScanned;
+    QAtomicInt m_numberOfFrames;
+};
+
+#endif // FRAMEQUERY_H
@@ -0,0 +1,104 @@
+#include "framequerydialog.h"
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+
+FrameQueryDialog::FrameQueryDialog(const FrameQuery& query, QWidget* parent) :
+    QDialog(parent)
+{
+    setWindowTitle(tr("Find frames"));
+
+    pNearCheck = new QCheckBox(tr("Closer than"), this);
+    pNearCheck->setChecked(query.bNear);
+    pNearDepth = new QSpinBox(this);
+    pNearDepth->setRange(1, 10000);
+    pNearDepth->setSuffix(" mm");
+    pNearDepth->setValue(query.nearDepth);
+    pNearMinPixels = new QSpinBox(this);
+    pNearMinPixels->setRange(1, 1 << 22);
+    pNearMinPixels->setSuffix(tr(" px at least"));
+    pNearMinPixels->setValue(query.nearMinPixels);
+
+    pInvalidCheck = new QCheckBox(tr("Invalid pixels over"), this);
+    pInvalidCheck->setChecked(query.bInvalid);
+    pInvalidPercent = new QDoubleSpinBox(this);
+    pInvalidPercent->setRange(0, 100);
+    pInvalidPercent->setSuffix(" %");
+    pInvalidPercent->setValue(query.invalidRatio * 100);
+
+    pChangeCheck = new QCheckBox(tr("Changed pixels over"), this);
+    pChangeCheck->setChecked(query.bChange);
+    pChangePercent = new QDoubleSpinBox(this);
+    pChangePercent->setRange(0, 100);
+    pChangePercent->setSuffix(" %");
+    pChangePercent->setValue(query.changeRatio * 100);
+    pChangeDepth = new QSpinBox(this);
+    pChangeDepth->setRange(1, 10000);
+    pChangeDepth->setPrefix(tr("by more than "));
+    pChangeDepth->setSuffix(" mm");
+    pChangeDepth->setValue(query.changeDepth);
+
+    pRoiX = new QSpinBox(this);
+    pRoiY = new QSpinBox(this);
+    pRoiWidth = new QSpinBox(this);
+    pRoiHeight = new QSpinBox(this);
+    QSpinBox* roiBoxes[] = {pRoiX, pRoiY, pRoiWidth, pRoiHeight};
+    for (QSpinBox* pBox : roiBoxes)
+    {
+        pBox->setRange(0, 4096);
+    }
+    pRoiWidth->setSpecialValueText(tr("full"));
+    pRoiHeight->setSpecialValueText(tr("full"));
+    pRoiX->setValue(query.roi.x());
+    pRoiY->setValue(query.roi.y());
+    pRoiWidth->setValue(query.roi.isEmpty() ? 0 : query.roi.width());
+    pRoiHeight->setValue(query.roi.isEmpty() ? 0 : query.roi.height());
+
+    QHBoxLayout* nearLayout = new QHBoxLayout;
+    nearLayout->addWidget(pNearDepth);
+    nearLayout->addWidget(pNearMinPixels);
+
+    QHBoxLayout* changeLayout = new QHBoxLayout;
+    changeLayout->addWidget(pChangePercent);
+    changeLayout->addWidget(pChangeDepth);
+
+    QHBoxLayout* roiLayout = new QHBoxLayout;
+    roiLayout->addWidget(pRoiX);
+    roiLayout->addWidget(pRoiY);
+    roiLayout->addWidget(pRoiWidth);
+    roiLayout->addWidget(pRoiHeight);
+
+    QDialogButtonBox* pButtons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(pButtons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(pButtons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QFormLayout* pLayout = new QFormLayout(this);
+    pLayout->addRow(pNearCheck, nearLayout);
+    pLayout->addRow(pInvalidCheck, pInvalidPercent);
+    pLayout->addRow(pChangeCheck, changeLayout);
+    pLayout->addRow(tr("ROI (x, y, w, h)"), roiLayout);
+    pLayout->addRow(pButtons);
+}
+
+FrameQuery FrameQueryDialog::query() const
+{
+    FrameQuery query;
+
+    query.bNear = pNearCheck->isChecked();
+    query.nearDepth = pNearDepth->value();
+    query.nearMinPixels = pNearMinPixels->value();
+
+    query.bInvalid = pInvalidCheck->isChecked();
+    query.invalidRatio = pInvalidPercent->value() / 100;
+
+    query.bChange = pChangeCheck->isChecked();
+    query.changeDepth = pChangeDepth->value();
+    query.changeRatio = pChangePercent->value() / 100;
+
+    if (pRoiWidth->value() > 0 && pRoiHeight->value() > 0)
+    {
+        query.roi = QRect(pRoiX->value(), pRoiY->value(), pRoiWidth->value(), pRoiHeight->value());
+    }
+
+    return query;
+}
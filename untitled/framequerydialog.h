@@ -0,0 +1,38 @@
+#ifndef FRAMEQUERYDIALOG_H
+#define FRAMEQUERYDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QSpinBox>
+#include "framequery.h"
+
+// Lets the user pick the predicates of a FrameQuery.
+class FrameQueryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FrameQueryDialog(const FrameQuery& query, QWidget* parent = nullptr);
+
+    FrameQuery query() const;
+
+private:
+    QCheckBox* pNearCheck;
+    QSpinBox* pNearDepth;
+    QSpinBox* pNearMinPixels;
+
+    QCheckBox* pInvalidCheck;
+    QDoubleSpinBox* pInvalidPercent;
+
+    QCheckBox* pChangeCheck;
+    QSpinBox* pChangeDepth;
+    QDoubleSpinBox* pChangePercent;
+
+    QSpinBox* pRoiX;
+    QSpinBox* pRoiY;
+    QSpinBox* pRoiWidth;
+    QSpinBox* pRoiHeight;
+};
+
+#endif // FRAMEQUERYDIALOG_H
@@ -0,0 +1,87 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+// Layout of the shared-memory frame ring written by FramePublisher and read
+// by FrameSubscriber. Kept free of Qt and OpenNI so consumers built with
+// anything else can map the same memory (on Windows it is the file mapping
+// named after the ring).
+//
+// The ring is a RingHeader followed by slotCount slots, each a SlotHeader
+// and slotSize bytes of frame data, every part 64-byte aligned. Frame n
+// (counting from 1) goes into slot n % slotCount. Each slot is a seqlock:
+// its sequence is odd while the publisher writes it and 2 * n once frame n
+// is complete, so a reader checks the sequence before and after using the
+// data and drops the frame if it changed.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace framering
+{
+    const uint32_t kMagic = 0x474e5246; // "FRNG"
+    const uint32_t kVersion = 1;
+    const size_t kAlignment = 64;
+
+    enum StreamKind
+    {
+        STREAM_DEPTH = 1,
+        STREAM_COLOR = 2,
+        STREAM_IR = 3
+    };
+
+    struct RingHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+        // Number of the last completely written frame.
+        std::atomic<uint64_t> lastSequence;
+    };
+
+    struct SlotHeader
+    {
+        std::atomic<uint64_t> sequence;
+        uint32_t stream;
+        // openni::PixelFormat value.
+        uint32_t pixelFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t strideBytes;
+        uint32_t dataSize;
+        int32_t frameIndex;
+        uint32_t reserved;
+        // Device timestamp in microseconds.
+        uint64_t timestamp;
+    };
+
+    inline size_t alignUp(size_t size)
+    {
+        return (size + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    inline size_t slotStride(uint32_t slotSize)
+    {
+        return alignUp(sizeof(SlotHeader)) + alignUp(slotSize);
+    }
+
+    inline size_t ringSize(uint32_t slotCount, uint32_t slotSize)
+    {
+        return alignUp(sizeof(RingHeader)) + slotCount * slotStride(slotSize);
+    }
+
+    inline SlotHeader* slotHeader(void* ring, uint64_t sequence)
+    {
+        const RingHeader* header = static_cast<const RingHeader*>(ring);
+        char* base = static_cast<char*>(ring) + alignUp(sizeof(RingHeader));
+        return reinterpret_cast<SlotHeader*>(base + (sequence % header->slotCount) * slotStride(header->slotSize));
+    }
+
+    inline char* slotData(SlotHeader* slot)
+    {
+        return reinterpret_cast<char*>(slot) + alignUp(sizeof(SlotHeader));
+    }
+}
+
+#endif // FRAMERING_H
@@ -0,0 +1,11 @@
+# Frame ring subscriber for processes that read frames published by the
+# player. Add "include(path/to/framering.pri)" to the consumer's .pro.
+
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/framering.h \
+    $$PWD/framesubscriber.h
+
+SOURCES += \
+    $$PWD/framesubscriber.cpp
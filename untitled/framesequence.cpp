@@ -0,0 +1,195 @@
+#include "framesequence.h"
+#include "recordingreader.h"
+
+const openni::VideoFrameRef& FrameSequence::const_iterator::operator*() const
+{
+    return m_pRange->m_frame;
+}
+
+const openni::VideoFrameRef* FrameSequence::const_iterator::operator->() const
+{
+    return &m_pRange->m_frame;
+}
+
+FrameSequence::const_iterator& FrameSequence::const_iterator::operator++()
+{
+    m_pRange->advance();
+    if (m_pRange->m_bAtEnd)
+    {
+        m_pRange = NULL;
+    }
+    return *this;
+}
+
+FrameSequence::FrameSequence(RecordingReader* pReader, openni::SensorType sensorType, int firstFrame, int lastFrame, int stride) :
+    m_pReader(pReader),
+    m_sensorType(sensorType),
+    m_firstFrame(firstFrame),
+    m_lastFrame(lastFrame),
+    m_stride(qMax(1, stride))
+{
+}
+
+FrameSequence FrameSequence::byTimestamp(RecordingReader* pReader, openni::SensorType sensorType,
+                                   quint64 firstTimestamp, quint64 lastTimestamp, int stride)
+{
+    FrameSequence range(pReader, sensorType, 1, 0, stride);
+    range.m_bByTimestamp = true;
+    range.m_firstTimestamp = firstTimestamp;
+    range.m_lastTimestamp = lastTimestamp;
+    return range;
+}
+
+FrameSequence::~FrameSequence()
+{
+    // The reader must be idle once the range is gone.
+    waitForPending();
+}
+
+FrameSequence::ReadResult FrameSequence::readFrame(RecordingReader* pReader, openni::SensorType sensorType, int frameId, bool bSeek)
+{
+    ReadResult result;
+    result.status = bSeek ? pReader->readFrameAt(sensorType, frameId, &result.frame)
+                          : pReader->readNextFrame(sensorType, &result.frame);
+    return result;
+}
+
+void FrameSequence::waitForPending()
+{
+    if (m_bPending)
+    {
+        m_token.cancel();
+        TaskScheduler::instance()->waitFor(m_pending);
+        m_pending = QFuture<ReadResult>();
+        m_bPending = false;
+        m_token = CancelToken();
+    }
+}
+
+int FrameSequence::findFrame(quint64 timestamp)
+{
+    // First frame at or after timestamp, 0 when there is none.
+    int low = 1;
+    int high = m_endFrame;
+    int found = 0;
+    while (low <= high)
+    {
+        int middle = low + (high - low) / 2;
+        ReadResult result = readFrame(m_pReader, m_sensorType, middle, true);
+        if (result.status != openni::STATUS_OK)
+        {
+            m_status = result.status;
+            return 0;
+        }
+
+        if (result.frame.getTimestamp() >= timestamp)
+        {
+            found = middle;
+            high = middle - 1;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return found;
+}
+
+FrameSequence::const_iterator FrameSequence::begin()
+{
+    waitForPending();
+    m_frame.release();
+    m_status = openni::STATUS_OK;
+    m_bAtEnd = true;
+
+    int numberOfFrames = m_pReader->getNumberOfFrames(m_sensorType);
+    m_endFrame = (m_lastFrame > 0) ? qMin(m_lastFrame, numberOfFrames) : numberOfFrames;
+
+    int firstFrame = m_bByTimestamp ? findFrame(m_firstTimestamp) : qMax(1, m_firstFrame);
+    if (firstFrame < 1 || firstFrame > m_endFrame)
+    {
+        return end();
+    }
+
+    m_bAtEnd = false;
+    if (!accept(readFrame(m_pReader, m_sensorType, firstFrame, true)))
+    {
+        m_bAtEnd = true;
+        return end();
+    }
+    scheduleNext();
+
+    return const_iterator(this);
+}
+
+bool FrameSequence::accept(const ReadResult& result)
+{
+    if (result.status != openni::STATUS_OK)
+    {
+        m_status = result.status;
+        return false;
+    }
+
+    // Read in sequence, a dropped frame can carry a later number.
+    if (result.frame.getFrameIndex() > m_endFrame ||
+        (m_bByTimestamp && result.frame.getTimestamp() > m_lastTimestamp))
+    {
+        return false;
+    }
+
+    m_frame = result.frame;
+    return true;
+}
+
+void FrameSequence::scheduleNext()
+{
+    m_nextFrame = m_frame.getFrameIndex() + m_stride;
+    if (m_nextFrame > m_endFrame || !m_bPrefetch)
+    {
+        return;
+    }
+
+    RecordingReader* pReader = m_pReader;
+    openni::SensorType sensorType = m_sensorType;
+    int frameId = m_nextFrame;
+    bool bSeek = m_stride != 1;
+    m_pending = TaskScheduler::instance()->run(TaskScheduler::Priority_Prefetch, m_token, [pReader, sensorType, frameId, bSeek]()
+    {
+        return readFrame(pReader, sensorType, frameId, bSeek);
+    });
+    m_bPending = true;
+}
+
+void FrameSequence::advance()
+{
+    if (m_bAtEnd)
+    {
+        return;
+    }
+
+    if (m_nextFrame > m_endFrame)
+    {
+        m_bAtEnd = true;
+        return;
+    }
+
+    ReadResult result;
+    if (m_bPending)
+    {
+        TaskScheduler::instance()->waitFor(m_pending);
+        result = m_pending.result();
+        m_pending = QFuture<ReadResult>();
+        m_bPending = false;
+    }
+    else
+    {
+        result = readFrame(m_pReader, m_sensorType, m_nextFrame, m_stride != 1);
+    }
+
+    if (!accept(result))
+    {
+        m_bAtEnd = true;
+        return;
+    }
+    scheduleNext();
+}
@@ -0,0 +1,117 @@
+#ifndef FRAMESEQUENCE_H
+#define FRAMESEQUENCE_H
+
+#include <QFuture>
+#include <iterator>
+#include "OpenNI.h"
+#include "taskscheduler.h"
+
+class RecordingReader;
+
+// Frames of one stream of a recording, read lazily while iterating:
+//
+//     for (const openni::VideoFrameRef& frame : reader.frames(openni::SENSOR_DEPTH, 1000, 5000, 5))
+//
+// The frames are the reader's reference-counted frames, nothing is copied,
+// and a frame stays valid for as long as a copy of its VideoFrameRef is
+// kept. The next frame is read as a prefetch task of the scheduler while
+// the loop body works on the current one. Consecutive frames are read in sequence,
+// the reader only seeks for the first frame and to skip frames.
+// A range is a single pass over the reader, which must not be used by
+// anything else until the loop is done; begin() starts over.
+class FrameSequence
+{
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef openni::VideoFrameRef value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const openni::VideoFrameRef* pointer;
+        typedef const openni::VideoFrameRef& reference;
+
+        const openni::VideoFrameRef& operator*() const;
+
+        const openni::VideoFrameRef* operator->() const;
+
+        const_iterator& operator++();
+
+        bool operator==(const const_iterator& other) const { return m_pRange == other.m_pRange; }
+
+        bool operator!=(const const_iterator& other) const { return m_pRange != other.m_pRange; }
+
+    private:
+        friend class FrameSequence;
+
+        explicit const_iterator(FrameSequence* pRange) : m_pRange(pRange) {}
+
+        // NULL at the end.
+        FrameSequence* m_pRange;
+    };
+
+    // Frame numbers as in the recording, from 1; lastFrame 0 means up to
+    // the last frame.
+    FrameSequence(RecordingReader* pReader, openni::SensorType sensorType, int firstFrame = 1, int lastFrame = 0, int stride = 1);
+
+    // Frames with timestamps in [firstTimestamp, lastTimestamp], in
+    // microseconds as the recording has them. The first frame is found
+    // with a binary search over the frame numbers.
+    static FrameSequence byTimestamp(RecordingReader* pReader, openni::SensorType sensorType,
+                                  quint64 firstTimestamp, quint64 lastTimestamp, int stride = 1);
+
+    ~FrameSequence();
+
+    // Read the next frame while the current one is in use, on by default.
+    void setPrefetch(bool bPrefetch) { m_bPrefetch = bPrefetch; }
+
+    const_iterator begin();
+
+    const_iterator end() { return const_iterator(NULL); }
+
+    // STATUS_OK when the pass ended at the end of the range; otherwise the
+    // read that ended it early failed with this status.
+    openni::Status status() const { return m_status; }
+
+private:
+    struct ReadResult
+    {
+        openni::Status status;
+        openni::VideoFrameRef frame;
+    };
+
+    static ReadResult readFrame(RecordingReader* pReader, openni::SensorType sensorType, int frameId, bool bSeek);
+
+    int findFrame(quint64 timestamp);
+
+    bool accept(const ReadResult& result);
+
+    void advance();
+
+    void scheduleNext();
+
+    void waitForPending();
+
+    RecordingReader* m_pReader;
+    openni::SensorType m_sensorType;
+    int m_firstFrame;
+    int m_lastFrame;
+    int m_stride;
+    bool m_bByTimestamp = false;
+    quint64 m_firstTimestamp = 0;
+    quint64 m_lastTimestamp = 0;
+    bool m_bPrefetch = true;
+
+    // Current pass.
+    openni::VideoFrameRef m_frame;
+    openni::Status m_status = openni::STATUS_OK;
+    int m_endFrame = 0;
+    int m_nextFrame = 0;
+    bool m_bAtEnd = true;
+    QFuture<ReadResult> m_pending;
+    bool m_bPending = false;
+    // Drops the pending read when the pass is abandoned.
+    CancelToken m_token;
+};
+
+#endif // FRAMESEQUENCE_H
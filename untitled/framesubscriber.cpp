@@ -0,0 +1,140 @@
+#include "framesubscriber.h"
+
+FrameSubscriber::FrameSubscriber()
+{
+}
+
+FrameSubscriber::~FrameSubscriber()
+{
+    detach();
+}
+
+const framering::RingHeader* FrameSubscriber::header() const
+{
+    return static_cast<const framering::RingHeader*>(m_memory.constData());
+}
+
+bool FrameSubscriber::attach(const QString& name)
+{
+    detach();
+
+    m_memory.setNativeKey(name);
+    if (!m_memory.attach(QSharedMemory::ReadOnly))
+    {
+        m_errorString = m_memory.errorString();
+        return false;
+    }
+
+    const framering::RingHeader* pHeader = header();
+    if (m_memory.size() < int(sizeof(framering::RingHeader)) ||
+        pHeader->magic != framering::kMagic || pHeader->version != framering::kVersion ||
+        pHeader->slotCount == 0 ||
+        size_t(m_memory.size()) < framering::ringSize(pHeader->slotCount, pHeader->slotSize))
+    {
+        m_errorString = QString("%1 is not a frame ring").arg(name);
+        m_memory.detach();
+        return false;
+    }
+
+    // Start with the newest frame rather than replaying the whole ring.
+    quint64 latest = latestSequence();
+    m_lastSequence = latest > 0 ? latest - 1 : 0;
+    m_missed = 0;
+    return true;
+}
+
+void FrameSubscriber::detach()
+{
+    if (m_memory.isAttached())
+    {
+        m_memory.detach();
+    }
+}
+
+bool FrameSubscriber::isAttached() const
+{
+    return m_memory.isAttached() && header()->magic == framering::kMagic;
+}
+
+quint64 FrameSubscriber::latestSequence() const
+{
+    if (!m_memory.isAttached())
+    {
+        return 0;
+    }
+
+    return header()->lastSequence.load(std::memory_order_acquire);
+}
+
+bool FrameSubscriber::frame(quint64 sequence, FrameView* view) const
+{
+    if (!isAttached() || sequence == 0)
+    {
+        return false;
+    }
+
+    const framering::RingHeader* pHeader = header();
+    framering::SlotHeader* slot = framering::slotHeader(const_cast<void*>(m_memory.constData()), sequence);
+
+    if (slot->sequence.load(std::memory_order_acquire) != 2 * sequence)
+    {
+        return false;
+    }
+
+    view->sequence = sequence;
+    view->stream = framering::StreamKind(slot->stream);
+    view->pixelFormat = int(slot->pixelFormat);
+    view->width = int(slot->width);
+    view->height = int(slot->height);
+    view->strideBytes = int(slot->strideBytes);
+    view->dataSize = int(qMin(slot->dataSize, pHeader->slotSize));
+    view->frameIndex = slot->frameIndex;
+    view->timestamp = slot->timestamp;
+    view->data = framering::slotData(slot);
+
+    // The header fields are only consistent if the slot was not rewritten meanwhile.
+    return isValid(*view);
+}
+
+bool FrameSubscriber::isValid(const FrameView& view) const
+{
+    if (!isAttached() || view.sequence == 0)
+    {
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const framering::SlotHeader* slot = framering::slotHeader(const_cast<void*>(m_memory.constData()), view.sequence);
+    return slot->sequence.load(std::memory_order_relaxed) == 2 * view.sequence;
+}
+
+bool FrameSubscriber::next(FrameView* view)
+{
+    quint64 latest = latestSequence();
+    if (latest <= m_lastSequence)
+    {
+        return false;
+    }
+
+    // Keep one slot of margin, the oldest one may be rewritten next.
+    quint64 keep = qMax<quint64>(1, header()->slotCount - 1);
+    quint64 oldest = latest >= keep ? latest - keep + 1 : 1;
+    quint64 sequence = m_lastSequence + 1;
+    if (sequence < oldest)
+    {
+        m_missed += oldest - sequence;
+        sequence = oldest;
+    }
+
+    for (; sequence <= latest; ++sequence)
+    {
+        m_lastSequence = sequence;
+        if (frame(sequence, view))
+        {
+            return true;
+        }
+        ++m_missed;
+    }
+
+    return false;
+}
@@ -0,0 +1,71 @@
+#ifndef FRAMESUBSCRIBER_H
+#define FRAMESUBSCRIBER_H
+
+#include <QSharedMemory>
+#include <QString>
+#include "framering.h"
+
+// A frame in the shared ring. data points straight into shared memory and
+// may be overwritten by the publisher at any time; check
+// FrameSubscriber::isValid() after using it.
+struct FrameView
+{
+    quint64 sequence = 0;
+    framering::StreamKind stream = framering::STREAM_DEPTH;
+    int pixelFormat = 0;
+    int width = 0;
+    int height = 0;
+    int strideBytes = 0;
+    int dataSize = 0;
+    int frameIndex = 0;
+    quint64 timestamp = 0;
+    const void* data = NULL;
+};
+
+// Reads frames published by FramePublisher in another process without
+// copying them. Consumers add framering.pri to their project.
+class FrameSubscriber
+{
+public:
+    FrameSubscriber();
+    ~FrameSubscriber();
+
+    bool attach(const QString& name);
+
+    void detach();
+
+    // False once the publisher closed or recreated the ring.
+    bool isAttached() const;
+
+    // Sequence of the newest complete frame, 0 if none yet.
+    quint64 latestSequence() const;
+
+    // Fills view with frame sequence if it is still in the ring.
+    bool frame(quint64 sequence, FrameView* view) const;
+
+    // True while the data behind view has not been overwritten.
+    bool isValid(const FrameView& view) const;
+
+    // Next frame after the last one returned, skipping ahead to the oldest
+    // frame still in the ring if the consumer fell behind. False if there is
+    // nothing new.
+    bool next(FrameView* view);
+
+    // Frames that were overwritten before next() got to them.
+    quint64 missed() const { return m_missed; }
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    FrameSubscriber(const FrameSubscriber&);
+    FrameSubscriber& operator=(const FrameSubscriber&);
+
+    const framering::RingHeader* header() const;
+
+    QSharedMemory m_memory;
+    quint64 m_lastSequence = 0;
+    quint64 m_missed = 0;
+    QString m_errorString;
+};
+
+#endif // FRAMESUBSCRIBER_H
@@ -0,0 +1,287 @@
+#include "gridview.h"
+#include "frameconvert.h"
+#include "recordingreader.h"
+#include "taskscheduler.h"
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QtAlgorithms>
+#include <math.h>
+
+// One recording of the grid. The reader and the result fields belong to the
+// decode task while it runs, everything else to the GUI thread.
+struct GridTile
+{
+    QString fileName;
+    QFutureWatcher<void>* pWatcher = nullptr;
+
+    RecordingReader reader;
+    bool bOpened = false;
+    openni::SensorType sensorType = openni::SENSOR_DEPTH;
+    quint64 firstTimestamp = 0;
+    qint64 frameIntervalUs = 33333;
+    QString error;
+
+    // Last decoded frame, relative to the first one.
+    qint64 positionUs = -1;
+    bool bEnded = false;
+    QImage image;
+
+    QImage resultImage;
+    qint64 resultPositionUs = -1;
+    bool bResultEnded = false;
+    QString resultError;
+};
+
+namespace
+{
+    const int kTickMs = 10;
+
+    // Tiles further behind than this seek instead of reading forward.
+    const qint64 kSeekThresholdUs = 1000000;
+
+    qint64 relativeUs(const GridTile* pTile, const openni::VideoFrameRef& frame)
+    {
+        return qint64(frame.getTimestamp()) - qint64(pTile->firstTimestamp);
+    }
+
+    // Runs on the scheduler. Brings the tile to the frame shown at targetUs,
+    // unless token is canceled on the way.
+    void decodeTile(GridTile* pTile, qint64 targetUs, QSize size, const CancelToken& token)
+    {
+        openni::VideoFrameRef frame;
+        bool bHaveFrame = false;
+
+        if (!pTile->bOpened)
+        {
+            if (pTile->reader.open(pTile->fileName) != openni::STATUS_OK)
+            {
+                pTile->resultError = QObject::tr("Cannot open");
+                return;
+            }
+            pTile->sensorType = pTile->reader.hasStream(openni::SENSOR_DEPTH) ? openni::SENSOR_DEPTH : openni::SENSOR_COLOR;
+            if (pTile->reader.readFrameAt(pTile->sensorType, 1, &frame) != openni::STATUS_OK)
+            {
+                pTile->resultError = QObject::tr("No frames");
+                return;
+            }
+            pTile->firstTimestamp = frame.getTimestamp();
+            pTile->frameIntervalUs = 1000000 / qMax(1, pTile->reader.getFps(pTile->sensorType));
+            pTile->bOpened = true;
+            bHaveFrame = true;
+        }
+
+        qint64 positionUs = pTile->positionUs;
+        if (!bHaveFrame && (targetUs < positionUs || targetUs - positionUs > kSeekThresholdUs))
+        {
+            int frameId = int(targetUs / pTile->frameIntervalUs) + 1;
+            bHaveFrame = pTile->reader.readFrameAt(pTile->sensorType, qMax(1, frameId), &frame) == openni::STATUS_OK;
+        }
+
+        // Frames in between are read but never converted.
+        pTile->bResultEnded = false;
+        while (!bHaveFrame || relativeUs(pTile, frame) + pTile->frameIntervalUs / 2 < targetUs)
+        {
+            if (token.isCanceled())
+            {
+                return;
+            }
+            if (pTile->reader.readNextFrame(pTile->sensorType, &frame) != openni::STATUS_OK)
+            {
+                pTile->bResultEnded = true;
+                break;
+            }
+            bHaveFrame = true;
+        }
+
+        if (!bHaveFrame)
+        {
+            return;
+        }
+
+        // Sample down to about the tile size, the cost follows what is on screen.
+        int step = qMax(1, qMin(frame.getWidth() / qMax(1, size.width()), frame.getHeight() / qMax(1, size.height())));
+        pTile->resultImage = (pTile->sensorType == openni::SENSOR_DEPTH) ? depthFrameToImage(frame, step) : colorFrameToImage(frame, step);
+        pTile->resultPositionUs = relativeUs(pTile, frame);
+    }
+}
+
+GridView::GridView(const QStringList& fileNames, QWidget* parent) :
+    QWidget(parent)
+{
+    setWindowTitle(tr("Grid (%1 recordings)").arg(fileNames.size()));
+    setFocusPolicy(Qt::StrongFocus);
+    resize(1280, 720);
+
+    for (int i = 0; i < fileNames.size(); ++i)
+    {
+        GridTile* pTile = new GridTile;
+        pTile->fileName = fileNames[i];
+        pTile->pWatcher = new QFutureWatcher<void>(this);
+        connect(pTile->pWatcher, &QFutureWatcher<void>::finished, this, [this, i]()
+        {
+            onDecoded(i);
+        });
+        m_tiles.append(pTile);
+    }
+
+    connect(&m_tickTimer, &QTimer::timeout, this, &GridView::onTick);
+    m_tickTimer.start(kTickMs);
+
+    setPlaying(true);
+}
+
+GridView::~GridView()
+{
+    m_tickTimer.stop();
+    m_seekToken.cancel();
+    for (int i = 0; i < m_tiles.size(); ++i)
+    {
+        m_tiles[i]->pWatcher->waitForFinished();
+    }
+    qDeleteAll(m_tiles);
+}
+
+qint64 GridView::positionUs() const
+{
+    return m_bPlaying ? m_clockBaseUs + m_clock.nsecsElapsed() / 1000 : m_clockBaseUs;
+}
+
+void GridView::setPlaying(bool bPlaying)
+{
+    m_clockBaseUs = positionUs();
+    m_bPlaying = bPlaying;
+    m_clock.start();
+}
+
+void GridView::restart()
+{
+    m_clockBaseUs = 0;
+    m_clock.start();
+
+    m_seekToken.cancel();
+    m_seekToken = CancelToken();
+}
+
+QRect GridView::tileRect(int index) const
+{
+    int count = qMax(1, m_tiles.size());
+    int columns = int(ceil(sqrt(double(count))));
+    int rows = (count + columns - 1) / columns;
+
+    int width = this->width() / columns;
+    int height = this->height() / rows;
+    return QRect((index % columns) * width, (index / columns) * height, width, height);
+}
+
+void GridView::onTick()
+{
+    // Nothing is decoded while the window cannot be seen.
+    if (!isVisible() || window()->isMinimized())
+    {
+        return;
+    }
+
+    qint64 targetUs = positionUs();
+    QRegion visible = visibleRegion();
+
+    bool bAllEnded = !m_tiles.isEmpty();
+    for (int i = 0; i < m_tiles.size(); ++i)
+    {
+        GridTile* pTile = m_tiles[i];
+        bAllEnded = bAllEnded && (pTile->bEnded || !pTile->error.isEmpty());
+
+        if (pTile->pWatcher->isRunning() || !pTile->error.isEmpty() || !visible.intersects(tileRect(i)))
+        {
+            continue;
+        }
+
+        bool bBehind = pTile->positionUs < 0 || (!pTile->bEnded && targetUs >= pTile->positionUs + pTile->frameIntervalUs);
+        if (bBehind || targetUs < pTile->positionUs)
+        {
+            startDecode(i, targetUs);
+        }
+    }
+
+    // Loop once the longest recording is done.
+    if (bAllEnded && m_bPlaying)
+    {
+        restart();
+    }
+}
+
+void GridView::startDecode(int index, qint64 targetUs)
+{
+    GridTile* pTile = m_tiles[index];
+    QSize size = tileRect(index).size();
+    CancelToken token = m_seekToken;
+    pTile->pWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Interactive, token, [pTile, targetUs, size, token]()
+    {
+        decodeTile(pTile, targetUs, size, token);
+    }));
+}
+
+void GridView::onDecoded(int index)
+{
+    GridTile* pTile = m_tiles[index];
+    pTile->error = pTile->resultError;
+    pTile->bEnded = pTile->bResultEnded;
+    if (!pTile->resultImage.isNull())
+    {
+        pTile->image = pTile->resultImage;
+        pTile->resultImage = QImage();
+        pTile->positionUs = pTile->resultPositionUs;
+    }
+    update(tileRect(index));
+}
+
+void GridView::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    painter.setPen(Qt::white);
+
+    for (int i = 0; i < m_tiles.size(); ++i)
+    {
+        const GridTile* pTile = m_tiles[i];
+        QRect cell = tileRect(i).adjusted(1, 1, -1, -1);
+
+        if (!pTile->image.isNull())
+        {
+            QSize size = pTile->image.size().scaled(cell.size(), Qt::KeepAspectRatio);
+            QRect target(QPoint(0, 0), size);
+            target.moveCenter(cell.center());
+            painter.drawImage(target, pTile->image);
+        }
+
+        QString label = QFileInfo(pTile->fileName).fileName();
+        if (!pTile->error.isEmpty())
+        {
+            label += " - " + pTile->error;
+        }
+        else if (pTile->positionUs >= 0)
+        {
+            label += QString(" %1 s").arg(pTile->positionUs / 1000000.0, 0, 'f', 2);
+        }
+        painter.drawText(cell.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop, label);
+    }
+}
+
+void GridView::keyPressEvent(QKeyEvent* event)
+{
+    switch (event->key())
+    {
+    case Qt::Key_Space:
+        setPlaying(!m_bPlaying);
+        break;
+    case Qt::Key_Home:
+        restart();
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+        break;
+    }
+}
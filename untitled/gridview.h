@@ -0,0 +1,59 @@
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+#include "taskscheduler.h"
+
+struct GridTile;
+
+// Plays several recordings side by side in one tiled window, aligned on
+// their timestamps relative to each recording's first frame. Every tile
+// decodes through its own RecordingReader, as interactive tasks of the
+// scheduler with at most one per tile in flight; a restart drops the
+// decodes for the old position. Tiles that are scrolled out, covered or
+// minimized are not decoded at all and catch up with a seek once they
+// show again.
+// Space pauses and resumes, Home restarts.
+class GridView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit GridView(const QStringList& fileNames, QWidget* parent = nullptr);
+    ~GridView();
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+    void keyPressEvent(QKeyEvent* event) override;
+
+private:
+    qint64 positionUs() const;
+
+    void setPlaying(bool bPlaying);
+
+    void restart();
+
+    QRect tileRect(int index) const;
+
+    void onTick();
+
+    void startDecode(int index, qint64 targetUs);
+
+    void onDecoded(int index);
+
+    QVector<GridTile*> m_tiles;
+    // Renewed on every restart.
+    CancelToken m_seekToken;
+    QTimer m_tickTimer;
+
+    QElapsedTimer m_clock;
+    qint64 m_clockBaseUs = 0;
+    bool m_bPlaying = false;
+};
+
+#endif // GRIDVIEW_H
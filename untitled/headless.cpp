@@ -0,0 +1,666 @@
+#include "headless.h"
+#include "healthscanner.h"
+#include "onistreamcopy.h"
+#include "opennisession.h"
+#include "backgroundmodel.h"
+#include "planedetector.h"
+#include "recordingreader.h"
+#include "archivereader.h"
+#include "archivewriter.h"
+#include "depthcodec.h"
+#include "depthstats.h"
+#include "videoexport.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <string.h>
+#include "OpenNI.h"
+
+namespace
+{
+    const char* const kHeadlessOptions[] = {"--scan-health", "--trim", "--concat", "--foreground", "--plane", "--archive", "--depth-codec", "--export-video", "--depth-stats"};
+
+    // Matches the chunk length of the archive writer.
+    const int kCodecKeyInterval = 16;
+
+    int runHealthScan(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        if (files.isEmpty())
+        {
+            QTextStream(stderr) << "No recordings given\n";
+            return 2;
+        }
+
+        bool bHash = !parser.isSet("no-hash");
+
+        // Scans are disk bound, a few in flight keep a RAID busy without thrashing it.
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMax(1, parser.value("jobs").toInt()));
+
+        QVector<RecordingHealth> results(files.size());
+        QVector<QFuture<void> > futures;
+        for (int i = 0; i < files.size(); ++i)
+        {
+            RecordingHealth* pResult = &results[i];
+            QString fileName = files[i];
+            futures.append(QtConcurrent::run(&pool, [pResult, fileName, bHash]()
+            {
+                *pResult = scanRecordingHealth(fileName, bHash);
+            }));
+        }
+        for (int i = 0; i < futures.size(); ++i)
+        {
+            futures[i].waitForFinished();
+        }
+
+        QFile reportFile;
+        QTextStream out(stdout);
+        if (parser.isSet("report"))
+        {
+            reportFile.setFileName(parser.value("report"));
+            if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                QTextStream(stderr) << "Cannot write " << parser.value("report") << "\n";
+                return 2;
+            }
+        }
+        QTextStream report(&reportFile);
+
+        int unhealthy = 0;
+        for (int i = 0; i < results.size(); ++i)
+        {
+            QString text = formatHealthReport(results[i]);
+            out << text;
+            if (reportFile.isOpen())
+            {
+                report << text;
+            }
+            if (!results[i].isHealthy())
+            {
+                ++unhealthy;
+            }
+        }
+
+        return unhealthy == 0 ? 0 : 1;
+    }
+
+    int runStreamCopy(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        QString output = parser.value("output");
+        if (files.isEmpty() || output.isEmpty())
+        {
+            QTextStream(stderr) << "Need input recordings and --output\n";
+            return 2;
+        }
+
+        QVector<OniClip> clips;
+        for (int i = 0; i < files.size(); ++i)
+        {
+            OniClip clip;
+            clip.fileName = files[i];
+            clips.append(clip);
+        }
+
+        if (parser.isSet("trim"))
+        {
+            if (clips.size() != 1)
+            {
+                QTextStream(stderr) << "--trim takes exactly one recording\n";
+                return 2;
+            }
+            clips[0].firstFrame = parser.value("first").toInt();
+            clips[0].lastFrame = parser.value("last").toInt();
+        }
+
+        QString error;
+        if (!copyOniClips(clips, output, &error))
+        {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int runForeground(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        if (files.size() != 1)
+        {
+            QTextStream(stderr) << "--foreground takes exactly one recording\n";
+            return 2;
+        }
+
+        RecordingReader reader;
+        if (reader.open(files[0]) != openni::STATUS_OK || !reader.hasStream(openni::SENSOR_DEPTH))
+        {
+            QTextStream(stderr) << "Cannot read depth from " << files[0] << "\n";
+            return 1;
+        }
+
+        QFile outputFile;
+        if (parser.isSet("output"))
+        {
+            outputFile.setFileName(parser.value("output"));
+            if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                QTextStream(stderr) << "Cannot write " << parser.value("output") << "\n";
+                return 2;
+            }
+        }
+        else
+        {
+            outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+        }
+        QTextStream out(&outputFile);
+
+        BackgroundModelSettings settings;
+        if (parser.isSet("min-blob"))
+        {
+            settings.minBlobPixels = parser.value("min-blob").toInt();
+        }
+        BackgroundModel model;
+        model.setSettings(settings);
+
+        // One sequential pass, the model learns as it goes.
+        writeForegroundCsvHeader(out);
+        for (const openni::VideoFrameRef& frame : reader.frames(openni::SENSOR_DEPTH))
+        {
+            QVector<ForegroundBlob> blobs = model.process(static_cast<const openni::DepthPixel*>(frame.getData()),
+                                                          frame.getWidth(), frame.getHeight(), frame.getStrideInBytes());
+            writeForegroundCsv(out, frame.getFrameIndex(), blobs);
+        }
+
+        return 0;
+    }
+
+    int runPlane(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        if (files.size() != 1)
+        {
+            QTextStream(stderr) << "--plane takes exactly one recording\n";
+            return 2;
+        }
+
+        RecordingReader reader;
+        if (reader.open(files[0]) != openni::STATUS_OK || !reader.hasStream(openni::SENSOR_DEPTH))
+        {
+            QTextStream(stderr) << "Cannot read depth from " << files[0] << "\n";
+            return 1;
+        }
+
+        QFile outputFile;
+        if (parser.isSet("output"))
+        {
+            outputFile.setFileName(parser.value("output"));
+            if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                QTextStream(stderr) << "Cannot write " << parser.value("output") << "\n";
+                return 2;
+            }
+        }
+        else
+        {
+            outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+        }
+        QTextStream out(&outputFile);
+
+        PlaneDetectorSettings settings;
+        if (parser.isSet("max-tilt"))
+        {
+            settings.maxTiltDegrees = parser.value("max-tilt").toFloat();
+        }
+        PlaneDetector detector;
+        detector.setSettings(settings);
+        openni::VideoStream* pStream = reader.stream(openni::SENSOR_DEPTH);
+        detector.setFieldOfView(pStream->getHorizontalFieldOfView(), pStream->getVerticalFieldOfView());
+
+        writePlaneCsvHeader(out);
+        int numberOfFrames = 0;
+        int found = 0;
+        double totalMs = 0;
+        for (const openni::VideoFrameRef& frame : reader.frames(openni::SENSOR_DEPTH))
+        {
+            ++numberOfFrames;
+            PlaneFit plane = detector.detect(static_cast<const openni::DepthPixel*>(frame.getData()),
+                                             frame.getWidth(), frame.getHeight(), frame.getStrideInBytes());
+            writePlaneCsv(out, frame.getFrameIndex(), plane);
+            totalMs += plane.elapsedMs;
+            if (plane.bFound)
+            {
+                ++found;
+            }
+        }
+
+        QTextStream(stderr) << "Plane found in " << found << " of " << numberOfFrames << " frames, "
+                            << (numberOfFrames > 0 ? totalMs / numberOfFrames : 0) << " ms per frame\n";
+
+        return 0;
+    }
+
+    int runDepthStats(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        if (files.size() != 1)
+        {
+            QTextStream(stderr) << "--depth-stats takes exactly one recording\n";
+            return 2;
+        }
+
+        RecordingReader reader;
+        if (reader.open(files[0]) != openni::STATUS_OK || !reader.hasStream(openni::SENSOR_DEPTH))
+        {
+            QTextStream(stderr) << "Cannot read depth from " << files[0] << "\n";
+            return 1;
+        }
+
+        QFile outputFile;
+        if (parser.isSet("output"))
+        {
+            outputFile.setFileName(parser.value("output"));
+            if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                QTextStream(stderr) << "Cannot write " << parser.value("output") << "\n";
+                return 2;
+            }
+        }
+        else
+        {
+            outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+        }
+        QTextStream out(&outputFile);
+
+        bool bHistogram = parser.isSet("histogram");
+        writeDepthStatsCsvHeader(out, bHistogram);
+
+        QElapsedTimer timer;
+        timer.start();
+        int numberOfFrames = 0;
+        for (const openni::VideoFrameRef& frame : reader.frames(openni::SENSOR_DEPTH))
+        {
+            ++numberOfFrames;
+            DepthStats stats = computeDepthStats(static_cast<const openni::DepthPixel*>(frame.getData()),
+                                                 frame.getWidth(), frame.getHeight(), frame.getStrideInBytes());
+            writeDepthStatsCsv(out, frame.getFrameIndex(), frame.getTimestamp(), stats, bHistogram);
+        }
+        out.flush();
+
+        double seconds = qMax(0.001, timer.elapsed() / 1000.0);
+        int fps = reader.getFps(openni::SENSOR_DEPTH);
+        QTextStream(stderr) << numberOfFrames << " frames in " << seconds << " s, "
+                            << numberOfFrames / seconds << " fps ("
+                            << (fps > 0 ? numberOfFrames / seconds / fps : 0) << "x real time)\n";
+
+        return 0;
+    }
+
+    // Decodes every frame of the archive and compares it with the frame
+    // OpenNI reads from the recording, pixels and timestamp.
+    bool verifyArchive(const QString& oniFileName, const QString& archiveFileName, int* pFrames, QString* pError)
+    {
+        RecordingReader oniReader;
+        ArchiveReader archiveReader;
+        if (oniReader.open(oniFileName) != openni::STATUS_OK)
+        {
+            *pError = QString::fromLatin1(openni::OpenNI::getExtendedError());
+            return false;
+        }
+        if (!archiveReader.open(archiveFileName))
+        {
+            *pError = archiveReader.errorString();
+            return false;
+        }
+
+        *pFrames = 0;
+        const openni::SensorType sensors[] = {openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR};
+        for (int i = 0; i < 3; ++i)
+        {
+            int stream = archiveReader.findStream(sensors[i]);
+            if (stream < 0)
+            {
+                continue;
+            }
+
+            const archive::StreamDesc& desc = archiveReader.streamDesc(stream);
+            int rowBytes = int(desc.width * desc.bytesPerPixel);
+            openni::VideoFrameRef frame;
+            ArchiveFrame archiveFrame;
+            for (int frameId = 1; frameId <= archiveReader.getNumberOfFrames(stream); ++frameId)
+            {
+                openni::Status nRetVal = frameId == 1 ? oniReader.readFrameAt(sensors[i], 1, &frame)
+                                                      : oniReader.readNextFrame(sensors[i], &frame);
+                if (nRetVal != openni::STATUS_OK || !archiveReader.readFrame(stream, frameId, &archiveFrame))
+                {
+                    *pError = QObject::tr("Stream %1, frame %2: cannot read it back").arg(stream).arg(frameId);
+                    return false;
+                }
+
+                bool bSame = frame.getTimestamp() == archiveFrame.timestamp &&
+                             frame.getWidth() == archiveFrame.width && frame.getHeight() == archiveFrame.height;
+                for (int y = 0; y < archiveFrame.height && bSame; ++y)
+                {
+                    bSame = memcmp(static_cast<const char*>(frame.getData()) + qint64(y) * frame.getStrideInBytes(),
+                                   static_cast<const char*>(archiveFrame.data) + qint64(y) * archiveFrame.strideBytes,
+                                   rowBytes) == 0;
+                }
+                if (!bSame)
+                {
+                    *pError = QObject::tr("Stream %1, frame %2 differs from the recording").arg(stream).arg(frameId);
+                    return false;
+                }
+                ++*pFrames;
+            }
+        }
+
+        return true;
+    }
+
+    int runArchive(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        QString output = parser.value("output");
+        if (files.size() != 1 || output.isEmpty())
+        {
+            QTextStream(stderr) << "--archive takes exactly one recording and --output\n";
+            return 2;
+        }
+
+        QString error;
+        ArchiveStats stats;
+        if (!transcodeToArchive(files[0], output, &error, &stats))
+        {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+
+        QTextStream(stderr) << stats.frames << " frames in " << stats.seconds << " s: recording "
+                            << (stats.sourceBytes >> 20) << " MB, raw " << (stats.rawBytes >> 20) << " MB, archive "
+                            << (stats.archiveBytes >> 20) << " MB ("
+                            << double(stats.rawBytes) / qMax<qint64>(1, stats.archiveBytes) << ":1 over raw)\n";
+
+        if (parser.isSet("verify"))
+        {
+            int frames = 0;
+            if (!verifyArchive(files[0], output, &frames, &error))
+            {
+                QTextStream(stderr) << "Verify failed: " << error << "\n";
+                return 1;
+            }
+            QTextStream(stderr) << "Verified " << frames << " frames against the recording\n";
+        }
+
+        // Sequential depth read speed of both, to compare the formats.
+        RecordingReader oniReader;
+        ArchiveReader archiveReader;
+        if (oniReader.open(files[0]) != openni::STATUS_OK || !oniReader.hasStream(openni::SENSOR_DEPTH) ||
+            !archiveReader.open(output) || archiveReader.findStream(openni::SENSOR_DEPTH) < 0)
+        {
+            return 0;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        int numberOfFrames = oniReader.getNumberOfFrames(openni::SENSOR_DEPTH);
+        openni::VideoFrameRef frame;
+        openni::Status nRetVal = oniReader.readFrameAt(openni::SENSOR_DEPTH, 1, &frame);
+        int oniFrames = 0;
+        for (; oniFrames < numberOfFrames && nRetVal == openni::STATUS_OK; ++oniFrames)
+        {
+            nRetVal = oniReader.readNextFrame(openni::SENSOR_DEPTH, &frame);
+        }
+        double oniMs = qMax<qint64>(1, timer.restart());
+
+        int depthStream = archiveReader.findStream(openni::SENSOR_DEPTH);
+        int archiveFrames = 0;
+        ArchiveFrame archiveFrame;
+        while (archiveReader.readFrame(depthStream, archiveFrames + 1, &archiveFrame))
+        {
+            ++archiveFrames;
+        }
+        double archiveMs = qMax<qint64>(1, timer.elapsed());
+
+        QTextStream(stderr) << "Depth read: recording " << oniFrames * 1000.0 / oniMs << " fps, archive "
+                            << archiveFrames * 1000.0 / archiveMs << " fps\n";
+
+        return 0;
+    }
+
+    int runDepthCodec(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        if (files.size() != 1)
+        {
+            QTextStream(stderr) << "--depth-codec takes exactly one recording\n";
+            return 2;
+        }
+
+        RecordingReader reader;
+        if (reader.open(files[0]) != openni::STATUS_OK || !reader.hasStream(openni::SENSOR_DEPTH))
+        {
+            QTextStream(stderr) << "Cannot read depth from " << files[0] << "\n";
+            return 1;
+        }
+
+        // Every frame is copied, encoded and decoded in turn; only the
+        // codec work is timed, the recording is read outside the clock.
+        DepthEncoder encoder;
+        DepthDecoder decoder;
+        QElapsedTimer timer;
+        qint64 copyNs = 0;
+        qint64 encodeNs = 0;
+        qint64 decodeNs = 0;
+        qint64 rawBytes = 0;
+        qint64 encodedBytes = 0;
+        int frames = 0;
+        QVector<openni::DepthPixel> copy;
+        QVector<openni::DepthPixel> decoded;
+
+        int numberOfFrames = reader.getNumberOfFrames(openni::SENSOR_DEPTH);
+        openni::VideoFrameRef frame;
+        openni::Status nRetVal = reader.readFrameAt(openni::SENSOR_DEPTH, 1, &frame);
+        for (; frames < numberOfFrames && nRetVal == openni::STATUS_OK; ++frames)
+        {
+            int width = frame.getWidth();
+            int height = frame.getHeight();
+            int rowBytes = width * int(sizeof(openni::DepthPixel));
+            copy.resize(width * height);
+            decoded.resize(width * height);
+
+            timer.start();
+            for (int y = 0; y < height; ++y)
+            {
+                memcpy(copy.data() + y * width, static_cast<const char*>(frame.getData()) + y * frame.getStrideInBytes(), rowBytes);
+            }
+            copyNs += timer.nsecsElapsed();
+
+            timer.start();
+            QByteArray encoded = encoder.encode(frame, frames % kCodecKeyInterval == 0);
+            encodeNs += timer.nsecsElapsed();
+
+            timer.start();
+            bool bOk = decoder.decode(encoded.constData(), encoded.size(), decoded.data(), width, height);
+            decodeNs += timer.nsecsElapsed();
+
+            if (!bOk || memcmp(decoded.constData(), copy.constData(), rowBytes * height) != 0)
+            {
+                QTextStream(stderr) << "Frame " << frame.getFrameIndex() << " did not survive the round trip\n";
+                return 1;
+            }
+
+            rawBytes += qint64(rowBytes) * height;
+            encodedBytes += encoded.size();
+            nRetVal = reader.readNextFrame(openni::SENSOR_DEPTH, &frame);
+        }
+
+        double megabytes = rawBytes / 1048576.0;
+        QTextStream(stderr) << frames << " depth frames, raw " << megabytes << " MB, encoded " << encodedBytes / 1048576.0
+                            << " MB, ratio " << double(rawBytes) / qMax<qint64>(1, encodedBytes) << ":1\n"
+                            << "raw copy " << megabytes * 1e9 / qMax<qint64>(1, copyNs) << " MB/s, encode "
+                            << megabytes * 1e9 / qMax<qint64>(1, encodeNs) << " MB/s, decode "
+                            << megabytes * 1e9 / qMax<qint64>(1, decodeNs) << " MB/s ("
+                            << frames * 1e9 / qMax<qint64>(1, decodeNs) << " fps)\n";
+
+        return 0;
+    }
+
+    int runExportVideo(const QCommandLineParser& parser)
+    {
+        QStringList files = parser.positionalArguments();
+        QString output = parser.value("output");
+        if (files.size() != 1 || output.isEmpty())
+        {
+            QTextStream(stderr) << "--export-video takes exactly one recording and --output\n";
+            return 2;
+        }
+
+        VideoExportSettings settings;
+        QString view = parser.value("view");
+        if (view == "depth")
+        {
+            settings.view = VideoExportSettings::View_Depth;
+        }
+        else if (view == "color")
+        {
+            settings.view = VideoExportSettings::View_Color;
+        }
+        else if (view == "side")
+        {
+            settings.view = VideoExportSettings::View_SideBySide;
+        }
+        else
+        {
+            QTextStream(stderr) << "--view is depth, color or side\n";
+            return 2;
+        }
+        settings.format = parser.value("format") == "y16" ? VideoExportSettings::Format_RawY16 : VideoExportSettings::Format_MjpegAvi;
+        settings.jpegQuality = parser.value("quality").toInt();
+        settings.firstFrame = parser.value("first").toInt();
+        settings.lastFrame = parser.value("last").toInt();
+        if (parser.isSet("region"))
+        {
+            QStringList parts = parser.value("region").split(',');
+            if (parts.size() != 4)
+            {
+                QTextStream(stderr) << "--region is x,y,width,height as fractions of the frame\n";
+                return 2;
+            }
+            settings.region = QRectF(parts[0].toDouble(), parts[1].toDouble(), parts[2].toDouble(), parts[3].toDouble())
+                              & QRectF(0, 0, 1, 1);
+        }
+
+        QString error;
+        VideoExportStats stats;
+        if (!exportVideo(files[0], output, settings, &error, &stats))
+        {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+
+        double videoSeconds = double(stats.frames) / qMax(1, stats.fps);
+        QTextStream(stderr) << stats.frames << " frames " << stats.width << "x" << stats.height << " at " << stats.fps
+                            << " fps, " << (stats.bytes >> 20) << " MB in " << stats.seconds << " s ("
+                            << videoSeconds / qMax(0.001, stats.seconds) << "x real time)\n";
+
+        return 0;
+    }
+}
+
+bool isHeadlessInvocation(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        for (size_t j = 0; j < sizeof(kHeadlessOptions) / sizeof(kHeadlessOptions[0]); ++j)
+        {
+            if (strcmp(argv[i], kHeadlessOptions[j]) == 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+int runHeadless(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("ONI player batch tools");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("scan-health", "Check recordings for dropped, stalled and repeated frames, and how far cut-off ones play."));
+    parser.addOption(QCommandLineOption("no-hash", "Health scan: only read record headers, skip duplicate detection."));
+    parser.addOption(QCommandLineOption("jobs", "Number of files processed at once.", "n", "2"));
+    parser.addOption(QCommandLineOption("report", "Also write the report to <file>.", "file"));
+    parser.addOption(QCommandLineOption("trim", "Copy frames --first to --last of a recording to --output without re-encoding."));
+    parser.addOption(QCommandLineOption("concat", "Append the recordings into --output without re-encoding."));
+    parser.addOption(QCommandLineOption("first", "Trim: first frame.", "frame", "0"));
+    parser.addOption(QCommandLineOption("last", "Trim: last frame.", "frame", "0"));
+    parser.addOption(QCommandLineOption("foreground", "Write the foreground blobs of every frame as CSV to --output or stdout."));
+    parser.addOption(QCommandLineOption("min-blob", "Foreground: smallest blob in pixels.", "pixels"));
+    parser.addOption(QCommandLineOption("plane", "Fit the floor plane of every frame, CSV to --output or stdout."));
+    parser.addOption(QCommandLineOption("max-tilt", "Plane: largest angle between the plane normal and the camera's vertical axis, 0 for any.", "degrees"));
+    parser.addOption(QCommandLineOption("depth-stats", "Write min, max, mean, standard deviation and invalid ratio of every depth frame as CSV to --output or stdout."));
+    parser.addOption(QCommandLineOption("histogram", "Depth stats: also write the 32 mm histogram bins."));
+    parser.addOption(QCommandLineOption("archive", "Transcode a recording into a random-access .oca archive at --output."));
+    parser.addOption(QCommandLineOption("verify", "Archive: decode every frame of the archive and compare it with the recording."));
+    parser.addOption(QCommandLineOption("depth-codec", "Round-trip the depth frames of a recording through the lossless depth codec and report ratio and speed."));
+    parser.addOption(QCommandLineOption("export-video", "Write a view of a recording as MJPEG AVI or raw Y16 to --output; --first and --last limit the range."));
+    parser.addOption(QCommandLineOption("view", "Video export: depth, color or side.", "view", "depth"));
+    parser.addOption(QCommandLineOption("format", "Video export: avi or y16 (depth view only).", "format", "avi"));
+    parser.addOption(QCommandLineOption("quality", "Video export: JPEG quality.", "0-100", "85"));
+    parser.addOption(QCommandLineOption("region", "Video export: only this part of the frames, as fractions, e.g. 0.25,0.25,0.5,0.5.", "x,y,w,h"));
+    parser.addOption(QCommandLineOption("output", "Output file.", "file"));
+    parser.addPositionalArgument("files", "Recordings to process.", "files...");
+    parser.process(app);
+
+    OpenNISession session;
+    if (!session.isOk())
+    {
+        QTextStream(stderr) << "OpenNI: " << session.errorString() << "\n";
+        return 2;
+    }
+
+    int result = 2;
+    if (parser.isSet("scan-health"))
+    {
+        result = runHealthScan(parser);
+    }
+    else if (parser.isSet("trim") || parser.isSet("concat"))
+    {
+        result = runStreamCopy(parser);
+    }
+    else if (parser.isSet("foreground"))
+    {
+        result = runForeground(parser);
+    }
+    else if (parser.isSet("plane"))
+    {
+        result = runPlane(parser);
+    }
+    else if (parser.isSet("depth-stats"))
+    {
+        result = runDepthStats(parser);
+    }
+    else if (parser.isSet("archive"))
+    {
+        result = runArchive(parser);
+    }
+    else if (parser.isSet("depth-codec"))
+    {
+        result = runDepthCodec(parser);
+    }
+    else if (parser.isSet("export-video"))
+    {
+        result = runExportVideo(parser);
+    }
+
+    return result;
+}
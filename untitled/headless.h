@@ -0,0 +1,11 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Batch modes that run from the command line without opening a window.
+
+// True when the arguments ask for one of the batch modes.
+bool isHeadlessInvocation(int argc, char* argv[]);
+
+int runHeadless(int argc, char* argv[]);
+
+#endif // HEADLESS_H
@@ -0,0 +1,393 @@
+#include "healthscanner.h"
+#include "fasthash.h"
+#include "onifilereader.h"
+#include "recordingreader.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Only the first problems of a stream are listed individually.
+    const int kMaxEvents = 20;
+
+    // A delta above this many frame periods counts as dropped frames.
+    const double kGapFactor = 1.5;
+
+    class StreamHealthAccumulator
+    {
+    public:
+        void addFrame(int frameIndex, quint64 timestamp, const void* payload, int payloadSize)
+        {
+            if (m_health.frames == 0)
+            {
+                m_health.firstFrameIndex = frameIndex;
+            }
+            else if (frameIndex == m_health.lastFrameIndex)
+            {
+                ++m_health.repeatedIndices;
+                addEvent(QObject::tr("frame %1: index repeated").arg(frameIndex));
+            }
+            else if (frameIndex < m_health.lastFrameIndex)
+            {
+                ++m_health.backwardIndices;
+                addEvent(QObject::tr("frame %1: index went back from %2").arg(frameIndex).arg(m_health.lastFrameIndex));
+            }
+            else if (frameIndex > m_health.lastFrameIndex + 1)
+            {
+                m_health.missingFrames += frameIndex - m_health.lastFrameIndex - 1;
+                addEvent(QObject::tr("frame %1: %2 indices missing").arg(frameIndex).arg(frameIndex - m_health.lastFrameIndex - 1));
+            }
+
+            if (payload != NULL)
+            {
+                quint64 hash = fastHash64(payload, size_t(payloadSize));
+                if (m_health.frames > 0 && hash == m_lastHash)
+                {
+                    ++m_health.consecutiveDuplicates;
+                    addEvent(QObject::tr("frame %1: same payload as previous frame").arg(frameIndex));
+                }
+                if (m_hashes.contains(hash))
+                {
+                    ++m_health.duplicates;
+                }
+                else
+                {
+                    m_hashes.insert(hash);
+                }
+                m_lastHash = hash;
+            }
+
+            m_frameIndices.push_back(frameIndex);
+            m_timestamps.push_back(timestamp);
+            m_health.lastFrameIndex = frameIndex;
+            ++m_health.frames;
+        }
+
+        StreamHealth finish()
+        {
+            // The period is the median delta, robust against the gaps we look for.
+            std::vector<quint64> deltas;
+            deltas.reserve(m_timestamps.size());
+            for (size_t i = 1; i < m_timestamps.size(); ++i)
+            {
+                if (m_timestamps[i] > m_timestamps[i - 1])
+                {
+                    deltas.push_back(m_timestamps[i] - m_timestamps[i - 1]);
+                }
+            }
+            if (!deltas.empty())
+            {
+                std::nth_element(deltas.begin(), deltas.begin() + deltas.size() / 2, deltas.end());
+                m_health.framePeriod = deltas[deltas.size() / 2];
+            }
+
+            for (size_t i = 1; i < m_timestamps.size(); ++i)
+            {
+                int frameIndex = m_frameIndices[i];
+                if (m_timestamps[i] == m_timestamps[i - 1])
+                {
+                    ++m_health.stalledTimestamps;
+                    addEvent(QObject::tr("frame %1: timestamp did not advance").arg(frameIndex));
+                }
+                else if (m_timestamps[i] < m_timestamps[i - 1])
+                {
+                    ++m_health.backwardTimestamps;
+                    addEvent(QObject::tr("frame %1: timestamp went back").arg(frameIndex));
+                }
+                else if (m_health.framePeriod > 0 && m_timestamps[i] - m_timestamps[i - 1] > kGapFactor * m_health.framePeriod)
+                {
+                    quint64 delta = m_timestamps[i] - m_timestamps[i - 1];
+                    int dropped = qMax(1, int(double(delta) / m_health.framePeriod + 0.5) - 1);
+                    ++m_health.timestampGaps;
+                    m_health.droppedByTimestamp += dropped;
+                    addEvent(QObject::tr("frame %1: %2 ms gap, about %3 frames dropped")
+                             .arg(frameIndex).arg(delta / 1000.0, 0, 'f', 1).arg(dropped));
+                }
+            }
+
+            return m_health;
+        }
+
+        void setName(const QString& name) { m_health.name = name; }
+
+    private:
+        void addEvent(const QString& text)
+        {
+            if (m_health.events.size() < kMaxEvents)
+            {
+                m_health.events.append(text);
+            }
+        }
+
+        StreamHealth m_health;
+        std::vector<int> m_frameIndices;
+        std::vector<quint64> m_timestamps;
+        QSet<quint64> m_hashes;
+        quint64 m_lastHash = 0;
+    };
+
+    bool scanNative(const QString& fileName, bool bHashPayloads, const QAtomicInt* pCanceled, RecordingHealth* pHealth)
+    {
+        OniFileReader reader;
+        if (!reader.open(fileName))
+        {
+            return false;
+        }
+
+        QMap<quint32, StreamHealthAccumulator> accumulators;
+        OniRecord record;
+        while (reader.readRecord(&record, bHashPayloads))
+        {
+            if (pCanceled != NULL && pCanceled->load())
+            {
+                pHealth->error = QObject::tr("Canceled");
+                break;
+            }
+
+            if (record.header.recordType != oni::RECORD_NEW_DATA)
+            {
+                continue;
+            }
+
+            StreamHealthAccumulator& accumulator = accumulators[record.header.nodeId];
+            accumulator.addFrame(int(record.frameNumber), record.timestamp,
+                                 bHashPayloads ? record.payload.constData() : NULL, record.payload.size());
+        }
+
+        if (accumulators.isEmpty())
+        {
+            // Nothing recognizable, let OpenNI have a go at it.
+            return false;
+        }
+
+        if (pHealth->error.isEmpty())
+        {
+            pHealth->error = reader.errorString();
+        }
+
+        for (QMap<quint32, StreamHealthAccumulator>::iterator it = accumulators.begin(); it != accumulators.end(); ++it)
+        {
+            QString name = reader.nodeName(it.key());
+            it.value().setName(name.isEmpty() ? QObject::tr("Node %1").arg(it.key()) : name);
+            pHealth->streams.append(it.value().finish());
+        }
+
+        pHealth->bNative = true;
+        // The reader stops at the end record, with its header read.
+        pHealth->bTruncated = record.header.recordType != oni::RECORD_END;
+        return true;
+    }
+
+    void scanOpenNI(const QString& fileName, bool bHashPayloads, const QAtomicInt* pCanceled, RecordingHealth* pHealth)
+    {
+        RecordingReader reader;
+        if (reader.open(fileName) != openni::STATUS_OK)
+        {
+            pHealth->error = QString::fromLatin1(openni::OpenNI::getExtendedError());
+            return;
+        }
+
+        const openni::SensorType sensors[] = {openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR};
+        const char* names[] = {"Depth", "Color", "IR"};
+
+        for (int i = 0; i < 3; ++i)
+        {
+            if (!reader.hasStream(sensors[i]))
+            {
+                continue;
+            }
+
+            StreamHealthAccumulator accumulator;
+            accumulator.setName(QString::fromLatin1(names[i]));
+
+            int numberOfFrames = reader.getNumberOfFrames(sensors[i]);
+            openni::VideoFrameRef frame;
+            openni::Status nRetVal = reader.readFrameAt(sensors[i], 1, &frame);
+            for (int n = 0; n < numberOfFrames && nRetVal == openni::STATUS_OK; ++n)
+            {
+                if (pCanceled != NULL && pCanceled->load())
+                {
+                    pHealth->error = QObject::tr("Canceled");
+                    break;
+                }
+
+                accumulator.addFrame(frame.getFrameIndex(), frame.getTimestamp(),
+                                     bHashPayloads ? frame.getData() : NULL, frame.getDataSize());
+
+                if (n + 1 < numberOfFrames)
+                {
+                    nRetVal = reader.readNextFrame(sensors[i], &frame);
+                }
+            }
+
+            pHealth->streams.append(accumulator.finish());
+        }
+    }
+
+    // Reads every stream up to the frame total of the header, which the
+    // recorder updates every few seconds, and counts what actually plays.
+    void checkPlayback(const QString& fileName, const QAtomicInt* pCanceled, RecordingHealth* pHealth)
+    {
+        RecordingReader reader;
+        if (reader.open(fileName) != openni::STATUS_OK)
+        {
+            pHealth->playbackError = QString::fromLatin1(openni::OpenNI::getExtendedError());
+            return;
+        }
+
+        const openni::SensorType sensors[] = {openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR};
+        const char* names[] = {"Depth", "Color", "IR"};
+
+        for (int i = 0; i < 3; ++i)
+        {
+            if (!reader.hasStream(sensors[i]))
+            {
+                continue;
+            }
+
+            PlaybackCheck check;
+            check.name = QString::fromLatin1(names[i]);
+            check.frames = reader.getNumberOfFrames(sensors[i]);
+
+            openni::VideoFrameRef frame;
+            openni::Status nRetVal = reader.readFrameAt(sensors[i], 1, &frame);
+            while (nRetVal == openni::STATUS_OK && frame.isValid())
+            {
+                if (pCanceled != NULL && pCanceled->load())
+                {
+                    return;
+                }
+
+                ++check.playedFrames;
+                if (check.playedFrames >= check.frames)
+                {
+                    break;
+                }
+                nRetVal = reader.readNextFrame(sensors[i], &frame);
+            }
+
+            pHealth->playback.append(check);
+        }
+    }
+}
+
+bool StreamHealth::isHealthy() const
+{
+    return missingFrames == 0 && repeatedIndices == 0 && backwardIndices == 0 &&
+           timestampGaps == 0 && stalledTimestamps == 0 && backwardTimestamps == 0 &&
+           consecutiveDuplicates == 0;
+}
+
+bool RecordingHealth::isHealthy() const
+{
+    if (!error.isEmpty() || streams.isEmpty() || !playbackError.isEmpty())
+    {
+        return false;
+    }
+
+    for (int i = 0; i < playback.size(); ++i)
+    {
+        if (playback[i].playedFrames < playback[i].frames)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < streams.size(); ++i)
+    {
+        if (!streams[i].isHealthy())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+RecordingHealth scanRecordingHealth(const QString& fileName, bool bHashPayloads, const QAtomicInt* pCanceled)
+{
+    RecordingHealth health;
+    health.fileName = fileName;
+    health.bHashed = bHashPayloads;
+    health.bytes = QFileInfo(fileName).size();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!scanNative(fileName, bHashPayloads, pCanceled, &health))
+    {
+        scanOpenNI(fileName, bHashPayloads, pCanceled, &health);
+    }
+    else if (health.bTruncated && (pCanceled == NULL || !pCanceled->load()))
+    {
+        checkPlayback(fileName, pCanceled, &health);
+    }
+
+    health.elapsedMs = timer.elapsed();
+
+    return health;
+}
+
+QString formatHealthReport(const RecordingHealth& health)
+{
+    QString report;
+
+    double seconds = qMax<qint64>(1, health.elapsedMs) / 1000.0;
+    report += QObject::tr("%1: %2\n").arg(health.fileName).arg(health.isHealthy() ? QObject::tr("OK") : QObject::tr("PROBLEMS FOUND"));
+    report += QObject::tr("  %1 MB in %2 s (%3 MB/s), %4 scan%5\n")
+            .arg(health.bytes / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(seconds, 0, 'f', 1)
+            .arg(health.bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1)
+            .arg(health.bNative ? QObject::tr("record") : QObject::tr("OpenNI"))
+            .arg(health.bHashed ? QObject::tr(" with payload hashes") : QString());
+
+    if (!health.error.isEmpty())
+    {
+        report += QObject::tr("  error: %1\n").arg(health.error);
+    }
+
+    if (health.bTruncated)
+    {
+        report += QObject::tr("  no end record, the recording was cut off\n");
+        if (!health.playbackError.isEmpty())
+        {
+            report += QObject::tr("  OpenNI cannot open it: %1\n").arg(health.playbackError);
+        }
+        for (int i = 0; i < health.playback.size(); ++i)
+        {
+            const PlaybackCheck& check = health.playback[i];
+            report += QObject::tr("  %1: OpenNI plays %2 of the %3 frames in the header\n")
+                    .arg(check.name).arg(check.playedFrames).arg(check.frames);
+        }
+    }
+
+    for (int i = 0; i < health.streams.size(); ++i)
+    {
+        const StreamHealth& stream = health.streams[i];
+        report += QObject::tr("  %1: %2 frames, index %3-%4, period %5 ms\n")
+                .arg(stream.name).arg(stream.frames)
+                .arg(stream.firstFrameIndex).arg(stream.lastFrameIndex)
+                .arg(stream.framePeriod / 1000.0, 0, 'f', 2);
+        report += QObject::tr("    indices: %1 missing, %2 repeated, %3 backwards\n")
+                .arg(stream.missingFrames).arg(stream.repeatedIndices).arg(stream.backwardIndices);
+        report += QObject::tr("    timestamps: %1 gaps (~%2 frames dropped), %3 stalled, %4 backwards\n")
+                .arg(stream.timestampGaps).arg(stream.droppedByTimestamp)
+                .arg(stream.stalledTimestamps).arg(stream.backwardTimestamps);
+        if (health.bHashed)
+        {
+            report += QObject::tr("    payloads: %1 repeated from previous frame, %2 seen before\n")
+                    .arg(stream.consecutiveDuplicates).arg(stream.duplicates);
+        }
+        for (int j = 0; j < stream.events.size(); ++j)
+        {
+            report += QString("      %1\n").arg(stream.events[j]);
+        }
+    }
+
+    return report;
+}
@@ -0,0 +1,79 @@
+#ifndef HEALTHSCANNER_H
+#define HEALTHSCANNER_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+// Per-stream findings of a health scan. Timestamps are in microseconds.
+struct StreamHealth
+{
+    QString name;
+
+    int frames = 0;
+    int firstFrameIndex = 0;
+    int lastFrameIndex = 0;
+
+    // Frame index sequence.
+    int missingFrames = 0;
+    int repeatedIndices = 0;
+    int backwardIndices = 0;
+
+    // Timestamp sequence, judged against the median frame period.
+    quint64 framePeriod = 0;
+    int timestampGaps = 0;
+    int droppedByTimestamp = 0;
+    int stalledTimestamps = 0;
+    int backwardTimestamps = 0;
+
+    // Payload hashes, only when the scan hashes payloads.
+    int consecutiveDuplicates = 0;
+    int duplicates = 0;
+
+    // First problems found, for the report.
+    QVector<QString> events;
+
+    bool isHealthy() const;
+};
+
+// How far OpenNI plays a stream of a recording that was cut off.
+struct PlaybackCheck
+{
+    QString name;
+    // Frame total in the header, as of the writer's last update.
+    int frames = 0;
+    // Frames read before the first failure.
+    int playedFrames = 0;
+};
+
+struct RecordingHealth
+{
+    QString fileName;
+    QString error;
+
+    bool bNative = false;
+    bool bHashed = false;
+    qint64 bytes = 0;
+    qint64 elapsedMs = 0;
+
+    QVector<StreamHealth> streams;
+
+    // No end record, e.g. the recorder crashed. Only then is the file also
+    // played through OpenNI up to the totals in its header.
+    bool bTruncated = false;
+    QString playbackError;
+    QVector<PlaybackCheck> playback;
+
+    bool isHealthy() const;
+};
+
+// Single pass over a recording checking frame indices, timestamps and
+// (optionally) payload duplicates of every stream. Reads the raw records
+// of the file without decoding and skips payloads when not hashing; falls
+// back to reading through OpenNI if the file layout is not recognized.
+// A recording without an end record is then played through OpenNI too.
+RecordingHealth scanRecordingHealth(const QString& fileName, bool bHashPayloads, const QAtomicInt* pCanceled = NULL);
+
+QString formatHealthReport(const RecordingHealth& health);
+
+#endif // HEALTHSCANNER_H
@@ -0,0 +1,67 @@
+#include "livestreamlistener.h"
+#include "recordingwriter.h"
+#include <QMutexLocker>
+#include <chrono>
+
+qint64 liveClockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LiveStreamListener::LiveStreamListener(QObject* pReceiver, const char* slotName)
+    : m_pReceiver(pReceiver)
+    , m_slotName(slotName)
+{
+}
+
+void LiveStreamListener::onNewFrame(openni::VideoStream& stream)
+{
+    Slot& slot = m_mailbox.back();
+    if (stream.readFrame(&slot.frame) != openni::STATUS_OK)
+    {
+        return;
+    }
+    slot.arrivalUs = liveClockUs();
+
+    // The slot belongs to the GUI once published.
+    openni::VideoFrameRef frame = slot.frame;
+
+    if (m_mailbox.publish())
+    {
+        m_dropped.fetchAndAddRelaxed(1);
+    }
+
+    if (m_notifyPending.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(m_pReceiver, m_slotName, Qt::QueuedConnection);
+    }
+
+    QMutexLocker locker(&m_recorderMutex);
+    if (m_pRecorder != nullptr)
+    {
+        m_pRecorder->push(frame);
+    }
+}
+
+void LiveStreamListener::setRecorder(RecordingWriter* pRecorder)
+{
+    QMutexLocker locker(&m_recorderMutex);
+    m_pRecorder = pRecorder;
+}
+
+bool LiveStreamListener::takeLatest(openni::VideoFrameRef* pFrame, qint64* pArrivalUs)
+{
+    // Cleared before taking, so a frame published right after still
+    // triggers a new notification.
+    m_notifyPending.store(0);
+
+    if (!m_mailbox.take())
+    {
+        return false;
+    }
+
+    *pFrame = m_mailbox.front().frame;
+    *pArrivalUs = m_mailbox.front().arrivalUs;
+    return true;
+}
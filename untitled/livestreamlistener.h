@@ -0,0 +1,57 @@
+#ifndef LIVESTREAMLISTENER_H
+#define LIVESTREAMLISTENER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QMutex>
+#include "OpenNI.h"
+#include "framemailbox.h"
+
+class RecordingWriter;
+
+// Monotonic host clock in microseconds, shared by the live display path
+// for latency measurement.
+qint64 liveClockUs();
+
+// Receives frames of a live stream on the OpenNI thread and parks the
+// newest one in a FrameMailbox. The receiver is told through a queued
+// call to slotName, at most once per frame it has not picked up yet, so
+// the GUI event queue never fills with stale frames.
+class LiveStreamListener : public openni::VideoStream::NewFrameListener
+{
+public:
+    LiveStreamListener(QObject* pReceiver, const char* slotName);
+
+    void onNewFrame(openni::VideoStream& stream) override;
+
+    // GUI side. Returns false if no new frame arrived since the last call.
+    // pArrivalUs is the liveClockUs() time the frame reached the host.
+    bool takeLatest(openni::VideoFrameRef* pFrame, qint64* pArrivalUs);
+
+    // Frames overwritten before the GUI took them.
+    int droppedFrames() const { return m_dropped.load(); }
+
+    // Every frame is also handed to pRecorder, after the GUI was notified.
+    // Once this returns the previous recorder is no longer used.
+    void setRecorder(RecordingWriter* pRecorder);
+
+private:
+    struct Slot
+    {
+        openni::VideoFrameRef frame;
+        qint64 arrivalUs = 0;
+    };
+
+    FrameMailbox<Slot> m_mailbox;
+
+    QAtomicInt m_dropped;
+    QAtomicInt m_notifyPending;
+
+    QObject* m_pReceiver;
+    const char* m_slotName;
+
+    QMutex m_recorderMutex;
+    RecordingWriter* m_pRecorder = nullptr;
+};
+
+#endif // LIVESTREAMLISTENER_H
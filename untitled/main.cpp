@@ -1,10 +1,16 @@
 #include "mainwindow.h"
+#include "headless.h"
 #include <QApplication>
 #include <QPainter>
 
 
 int main(int argc, char *argv[])
 {
+    if (isHeadlessInvocation(argc, argv))
+    {
+        return runHeadless(argc, argv);
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
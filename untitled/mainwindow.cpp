@@ -1,5 +1,30 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "framequerydialog.h"
+#include "depthfilterdialog.h"
+#include "gridview.h"
+#include "frameconvert.h"
+#include <QPainter>
+#include <QFile>
+#include <math.h>
+
+namespace
+{
+    // Subscribers attach to the ring under this name.
+    const char* const kFrameRingName = "oniplayer-frames";
+    const int kFrameRingFramesPerStream = 4;
+
+    const int kMaxGridRecordings = 16;
+
+    const float kPlaySpeeds[] = {0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f};
+    const int kPlaySpeedCount = int(sizeof(kPlaySpeeds) / sizeof(kPlaySpeeds[0]));
+
+    // The recorder keeps about a second of VGA depth and color even when
+    // the memory budget is exceeded.
+    const qint64 kMinRecordQueueBytes = qint64(32) << 20;
+
+    const int kTaskStatsIntervalMs = 500;
+}
 
 
 
@@ -58,14 +83,8 @@ openni::Status MainWindow::openCommon(openni::Device& device)
 
 openni::Status MainWindow::openDevice(const char* uri)
 {
-    openni::Status nRetVal = openni::OpenNI::initialize();
-    if (nRetVal != openni::STATUS_OK)
-    {
-        return nRetVal;
-    }
-
     // Open the requested device.
-    nRetVal = g_device.open(uri);
+    openni::Status nRetVal = g_device.open(uri);
     if (nRetVal != openni::STATUS_OK)
     {
         return nRetVal;
@@ -82,6 +101,49 @@ openni::Status MainWindow::openDevice(const char* uri)
 
 void MainWindow::closeDevice()
 {
+    // Before the listeners go away, they may still feed the recorder.
+    stopRecording();
+    stopLive();
+
+    g_backgroundModel.reset();
+    g_lastForegroundFrame = 0;
+    g_foregroundBlobs.clear();
+    g_foregroundLog.clear();
+
+    g_planeDetector.reset();
+    g_lastPlaneFrame = 0;
+    g_planeFit = PlaneFit();
+
+    g_lastStatsFrame = 0;
+    pDepthStatsPanel->clear();
+
+    stopReverse();
+
+    g_framePublisher.close();
+    g_lastPublishedDepth = 0;
+    g_lastPublishedColor = 0;
+
+    cancelQuery();
+    pQueryResults->clear();
+    cancelHealthScan();
+    // The export reads the file on its own; it stops with the file
+    // anyway and reports when it has.
+    g_videoExportToken.cancel();
+
+    delete pThumbnailWorker;
+    pThumbnailWorker = nullptr;
+    pThumbnailStrip->clear();
+
+    g_depthSource.stop();
+    g_colorSource.stop();
+    pSlider->hide();
+
+    pMemoryGovernor->removeOwner(pPrefetcher);
+    delete pPrefetcher;
+    pPrefetcher = nullptr;
+    pIoStatsTimer->stop();
+    pIoStatusLabel->hide();
+
     g_depthStream.stop();
     g_colorStream.stop();
     g_irStream.stop();
@@ -92,7 +154,191 @@ void MainWindow::closeDevice()
 
     g_device.close();
 
-    openni::OpenNI::shutdown();
+    g_bIsDepthOn = false;
+    g_bIsColorOn = false;
+    g_bIsIROn = false;
+    g_pPlaybackControl = NULL;
+}
+
+void MainWindow::startOpenDevice(const QString& uri, bool bLive)
+{
+    g_bIsOpening = true;
+    g_bOpenAsLive = bLive;
+    g_openingFileName = uri;
+    g_openTimer.start();
+
+    // Device and stream setup, including the first frame of every stream,
+    // runs off the GUI thread. Nothing else touches the device until
+    // onDeviceOpened() clears g_bIsOpening.
+    std::string uriString = uri.toStdString();
+    pOpenWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Interactive, [this, uriString]() -> QString
+    {
+        openni::Status nRetVal = openDevice(uriString.empty() ? openni::ANY_DEVICE : uriString.c_str());
+        if (nRetVal != openni::STATUS_OK)
+        {
+            // The extended error is per thread, so it is collected here.
+            return QString::fromLatin1(OpenNI::getExtendedError());
+        }
+        return QString();
+    }));
+
+    ui->statusBar->showMessage(tr("Opening %1...").arg(uri));
+}
+
+void MainWindow::onDeviceOpened()
+{
+    g_bIsOpening = false;
+
+    QString error = pOpenWatcher->result();
+    if (!error.isEmpty() || !g_device.isValid())
+    {
+        if (g_device.isValid())
+        {
+            closeDevice();
+        }
+        ui->statusBar->clearMessage();
+        QMessageBox::information(this, tr("Error open Device"), error);
+        return;
+    }
+
+    if (g_bPublishOn)
+    {
+        startPublisher();
+    }
+
+    displayFrames();
+    qint64 firstFrameMs = g_openTimer.elapsed();
+
+    if (g_bOpenAsLive || g_pPlaybackControl == NULL)
+    {
+        startLive();
+        ui->statusBar->showMessage(tr("Live, first frame after %1 ms").arg(firstFrameMs));
+        return;
+    }
+
+    g_fileName = g_openingFileName;
+    startThumbnails(g_fileName);
+    startPrefetcher(g_fileName);
+
+    on_actionPlay_triggered();
+    ui->statusBar->showMessage(tr("Playing, first frame after %1 ms").arg(firstFrameMs));
+}
+
+void MainWindow::startLive()
+{
+    g_bIsLive = true;
+
+    // A recording opened as a live source plays in real time through the
+    // same listener path, which is how this mode is tested without a sensor.
+    if (g_pPlaybackControl != NULL)
+    {
+        g_pPlaybackControl->setSpeed(1.0f);
+        g_pPlaybackControl->setRepeatEnabled(true);
+    }
+
+    g_liveFramesShown = 0;
+    g_liveLatencySumUs = 0;
+    g_liveLatencyMaxUs = 0;
+
+    if (g_bIsDepthOn)
+    {
+        pDepthListener = new LiveStreamListener(this, "onLiveFrame");
+        g_depthStream.addNewFrameListener(pDepthListener);
+    }
+    if (g_bIsColorOn)
+    {
+        pColorListener = new LiveStreamListener(this, "onLiveFrame");
+        g_colorStream.addNewFrameListener(pColorListener);
+    }
+
+    applyDeviceCropping();
+
+    pLiveStatsTimer->start(1000);
+}
+
+void MainWindow::stopLive()
+{
+    if (pDepthListener != nullptr)
+    {
+        g_depthStream.removeNewFrameListener(pDepthListener);
+        delete pDepthListener;
+        pDepthListener = nullptr;
+    }
+    if (pColorListener != nullptr)
+    {
+        g_colorStream.removeNewFrameListener(pColorListener);
+        delete pColorListener;
+        pColorListener = nullptr;
+    }
+
+    pLiveStatsTimer->stop();
+    g_bIsLive = false;
+}
+
+void MainWindow::onLiveFrame()
+{
+    if (!g_bIsLive)
+    {
+        return;
+    }
+
+    bool bNewFrame = false;
+    qint64 oldestArrivalUs = 0;
+    qint64 arrivalUs = 0;
+
+    if (pDepthListener != nullptr && pDepthListener->takeLatest(&g_depthFrame, &arrivalUs))
+    {
+        oldestArrivalUs = arrivalUs;
+        bNewFrame = true;
+    }
+    if (pColorListener != nullptr && pColorListener->takeLatest(&g_colorFrame, &arrivalUs))
+    {
+        oldestArrivalUs = bNewFrame ? qMin(oldestArrivalUs, arrivalUs) : arrivalUs;
+        bNewFrame = true;
+    }
+
+    if (!bNewFrame)
+    {
+        return;
+    }
+
+    displayFrames();
+
+    // Paint right away instead of on the next update so the measured
+    // latency runs from the driver handing over the frame to the screen.
+    ui->colorView->repaint();
+    ui->depthView->repaint();
+
+    qint64 latencyUs = liveClockUs() - oldestArrivalUs;
+    g_liveFramesShown++;
+    g_liveLatencySumUs += latencyUs;
+    g_liveLatencyMaxUs = qMax(g_liveLatencyMaxUs, latencyUs);
+}
+
+void MainWindow::onLiveStatsTimeout()
+{
+    int dropped = 0;
+    if (pDepthListener != nullptr)
+    {
+        dropped += pDepthListener->droppedFrames();
+    }
+    if (pColorListener != nullptr)
+    {
+        dropped += pColorListener->droppedFrames();
+    }
+
+    if (g_liveFramesShown > 0)
+    {
+        ui->statusBar->showMessage(tr("Live: %1 fps, latency %2 ms avg / %3 ms max, %4 stale frames skipped")
+                                   .arg(g_liveFramesShown)
+                                   .arg(g_liveLatencySumUs / g_liveFramesShown / 1000.0, 0, 'f', 1)
+                                   .arg(g_liveLatencyMaxUs / 1000.0, 0, 'f', 1)
+                                   .arg(dropped));
+    }
+
+    g_liveFramesShown = 0;
+    g_liveLatencySumUs = 0;
+    g_liveLatencyMaxUs = 0;
 }
 
 openni::Status MainWindow::readFrame()
@@ -126,7 +372,7 @@ openni::Status MainWindow::readFrame()
 
 openni::VideoStream* MainWindow::getSeekingStream(openni::VideoFrameRef*& pCurFrame)
 {
-    if (g_pPlaybackControl == NULL)
+    if (g_bIsOpening || g_bIsLive || g_pPlaybackControl == NULL)
     {
         return NULL;
     }
@@ -159,6 +405,8 @@ void MainWindow::seekStream(openni::VideoStream* pStream, openni::VideoFrameRef*
     // Get number of frames
     numberOfFrames = g_pPlaybackControl->getNumberOfFrames(*pStream);
 
+    int previousFrameId = pCurFrame->getFrameIndex();
+
     // Seek
     openni::Status rc = g_pPlaybackControl->seek(*pStream, frameId);
     if (rc == openni::STATUS_OK)
@@ -180,6 +428,11 @@ void MainWindow::seekStream(openni::VideoStream* pStream, openni::VideoFrameRef*
         // the new frameId might be different than expected (due to clipping to edges)
         frameId = pCurFrame->getFrameIndex();
 
+        if (pPrefetcher != nullptr)
+        {
+            pPrefetcher->setPlayhead(frameId, frameId >= previousFrameId ? 1 : -1);
+        }
+
     }
     else if ((rc == openni::STATUS_NOT_IMPLEMENTED) || (rc == openni::STATUS_NOT_SUPPORTED) || (rc == openni::STATUS_BAD_PARAMETER) || (rc == openni::STATUS_NO_DEVICE))
     {
@@ -226,154 +479,1822 @@ void MainWindow::seekFrameAbs(int frameId)
     seekStream(pStream, pCurFrame, frameId);
 }
 
-MainWindow::MainWindow(QWidget *parent) :
-    QMainWindow(parent),
-    ui(new Ui::MainWindow)
+void MainWindow::displayFrames()
 {
+    if (g_bIsOpening)
+    {
+        return;
+    }
 
-    ui->setupUi(this);
+    publishFrames();
+    recordFrames();
 
-    if (ONIMode)
+    // Frames cropped on the device are shown whole, the others are cut
+    // down here so that everything after works on the region only.
+    if (g_bIsColorOn && g_colorFrame.isValid())
     {
-        Status rc = OpenNI::initialize();
-        if (rc != STATUS_OK)
+        QRect region = g_colorFrame.getCroppingEnabled() ? QRect(0, 0, g_colorFrame.getWidth(), g_colorFrame.getHeight())
+                                                         : regionRect(g_region, g_colorFrame.getWidth(), g_colorFrame.getHeight());
+        displayColor(regionData(g_colorFrame.getData(), g_colorFrame.getStrideInBytes(), 3, region),
+                     region.width(), region.height(), g_colorFrame.getStrideInBytes());
+    }
+
+    if (g_bIsDepthOn && g_depthFrame.isValid())
+    {
+        g_planeDetector.setFieldOfView(g_depthStream.getHorizontalFieldOfView(), g_depthStream.getVerticalFieldOfView());
+        QRect region(0, 0, g_depthFrame.getWidth(), g_depthFrame.getHeight());
+        if (g_depthFrame.getCroppingEnabled())
+        {
+            openni::VideoMode mode = g_depthStream.getVideoMode();
+            g_planeDetector.setCrop(g_depthFrame.getCropOriginX(), g_depthFrame.getCropOriginY(),
+                                    mode.getResolutionX(), mode.getResolutionY());
+        }
+        else
         {
-            QMessageBox::information(this, tr("Error Init"), OpenNI::getExtendedError());
+            region = regionRect(g_region, g_depthFrame.getWidth(), g_depthFrame.getHeight());
+            g_planeDetector.setCrop(region.x(), region.y(), g_depthFrame.getWidth(), g_depthFrame.getHeight());
         }
+        displayDepth(reinterpret_cast<const openni::DepthPixel*>(regionData(g_depthFrame.getData(), g_depthFrame.getStrideInBytes(),
+                                                                            int(sizeof(openni::DepthPixel)), region)),
+                     region.width(), region.height(), g_depthFrame.getStrideInBytes(), g_depthFrame.getFrameIndex());
     }
-    else // Standart player
-    {
-        pMediaPlayer = new QMediaPlayer(this);
-        pVideoWidget = new QVideoWidget(this);
-        pMediaPlayer->setVideoOutput(pVideoWidget);
-        this->setCentralWidget(pVideoWidget);
-        pSlider = new QSlider(this);
-        pProgressBar = new QProgressBar(this);
-
-        pSlider->setOrientation(Qt::Horizontal);
-        ui->statusBar->addPermanentWidget(pSlider);
-        ui->statusBar->addPermanentWidget(pProgressBar);
-
-        connect(pMediaPlayer, &QMediaPlayer::durationChanged, pSlider, &QSlider::setMaximum);
-        connect(pMediaPlayer, &QMediaPlayer::positionChanged, pSlider, &QSlider::setValue);
-
-        connect(pSlider, &QSlider::sliderMoved, pMediaPlayer, &QMediaPlayer::setPosition);
 
-        connect(pMediaPlayer, &QMediaPlayer::durationChanged, pProgressBar, &QProgressBar::setMaximum);
-        connect(pMediaPlayer, &QMediaPlayer::positionChanged, pProgressBar, &QProgressBar::setValue);
+    openni::VideoFrameRef* pCurFrame = NULL;
+    openni::VideoStream* pStream = getSeekingStream(pCurFrame);
+    if (pStream != NULL)
+    {
+        pThumbnailStrip->setCurrentFrame(pCurFrame->getFrameIndex());
+        showPosition(pCurFrame->getFrameIndex(), g_pPlaybackControl->getNumberOfFrames(*pStream));
     }
+}
 
+void MainWindow::showPosition(int frameId, int numberOfFrames)
+{
+    // Same wiring as the standard player, in frames instead of milliseconds.
+    pSlider->setMaximum(numberOfFrames);
+    pSlider->setValue(frameId);
+    pSlider->show();
 }
 
-MainWindow::~MainWindow()
+void MainWindow::displayColor(const uchar* data, int width, int height, int stride)
 {
-    if (ONIMode)
+    QImage image(data, width, height, stride, QImage::Format_RGB888);
+    if (pPreviewServer != nullptr)
     {
-        OpenNI::shutdown();
+        pPreviewServer->submitFrame(PreviewServer::View_Color, image);
     }
-    delete ui;
+    g_colorSource.present(image);
 }
 
-
-void MainWindow::on_action_openFile_triggered()
+void MainWindow::displayDepth(const openni::DepthPixel* data, int width, int height, int stride, int frameIndex)
 {
-    if(ONIMode)
+    if (g_bDepthFilterOn)
     {
-        QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "C:\\", "ONI files (*.oni)");
-        if (fileName.isEmpty())
+        // Temporal smoothing only holds across consecutive frames.
+        if (!g_bIsLive && frameIndex != g_lastFilteredFrame + 1)
         {
-            return;
+            g_depthFilter.reset();
         }
+        g_lastFilteredFrame = frameIndex;
 
-        openni::Status nRetVal = openDevice(fileName.toStdString().c_str());
-        if(nRetVal != openni::STATUS_OK)
+        data = g_depthFilter.process(data, width, height, stride);
+        stride = width * sizeof(openni::DepthPixel);
+    }
+    // Redraws of the same frame keep its numbers and the sparkline.
+    if ((g_bDepthStatsOn || g_bHistogramColorsOn) && frameIndex != g_lastStatsFrame)
+    {
+        g_depthStats = computeDepthStats(data, width, height, stride);
+        pDepthStatsPanel->addFrame(frameIndex, g_depthStats);
+        g_lastStatsFrame = frameIndex;
+    }
+    QImage image = g_bHistogramColorsOn ? colorizeDepth(data, width, height, stride, g_depthStats)
+                                        : QImage(reinterpret_cast<const uchar*>(data), width, height, stride, QImage::Format_RGB16);
+    if (g_bForegroundOn)
+    {
+        // The model learns from every frame once, redraws reuse the result.
+        if (frameIndex != g_lastForegroundFrame)
         {
-            QMessageBox::information(this, tr("Error open Device"), OpenNI::getExtendedError());
-            return;
+            g_foregroundBlobs = g_backgroundModel.process(data, width, height, stride);
+            g_foregroundLog[frameIndex] = g_foregroundBlobs;
+            g_lastForegroundFrame = frameIndex;
         }
-
-        int curCountOfFrames = 0;
-        int numberOfFrames = g_pPlaybackControl->getNumberOfFrames(g_depthStream);
-        while(curCountOfFrames < numberOfFrames)
+        image = image.convertToFormat(QImage::Format_RGB32);
+        drawForeground(&image);
+    }
+    if (g_bPlaneOn)
+    {
+        if (frameIndex != g_lastPlaneFrame)
         {
+            g_planeFit = g_planeDetector.detect(data, width, height, stride);
+            g_planeMask.fill(0, width * height);
+            g_planeDetector.markInliers(g_planeFit, data, width, height, stride, g_planeMask.data());
+            g_lastPlaneFrame = frameIndex;
+        }
+        image = image.convertToFormat(QImage::Format_RGB32);
+        drawMask(&image, g_planeMask.constData(), qRgba(0, 120, 255, 90));
+        showPlaneStatus();
+    }
+    if (pPreviewServer != nullptr)
+    {
+        pPreviewServer->submitFrame(PreviewServer::View_Depth, image);
+    }
+    g_depthSource.present(image);
+    ui->depthView->setPixelValues(data, width, height, stride);
+}
 
-            openni::Status rc = g_pPlaybackControl->seek(g_colorStream, curCountOfFrames);
-            if (rc != openni::STATUS_OK)
-            {
-                return;
-            }
-            g_colorStream.readFrame(&g_colorFrame);
-            uchar *data = (uchar *)(g_colorFrame.getData());
-            int imageWidth = 640;
-            int imageHeight = 480;
-            QImage image(data, imageWidth, imageHeight, QImage::Format_RGB888);
-            ui->label->setPixmap(QPixmap::fromImage(image).scaled(ui->label->width(), ui->label->height(), Qt::KeepAspectRatio));
-
-            rc = g_pPlaybackControl->seek(g_depthStream, curCountOfFrames);
-            if (rc != openni::STATUS_OK)
-            {
-                return;
-            }
-            g_depthStream.readFrame(&g_depthFrame);
-            data = (uchar *)(g_depthFrame.getData());
-            image = QImage(data, imageWidth, imageHeight, QImage::Format_RGB16);
-            ui->label_2->setPixmap(QPixmap::fromImage(image).scaled(ui->label_2->width(), ui->label->height(), Qt::KeepAspectRatio));
+void MainWindow::drawMask(QImage* pImage, const quint8* mask, QRgb color)
+{
+    // One byte per pixel of pImage, 255 marks the pixels to tint.
+    QImage maskImage(mask, pImage->width(), pImage->height(), pImage->width(), QImage::Format_Indexed8);
+    QVector<QRgb> colors(256, qRgba(0, 0, 0, 0));
+    colors[255] = color;
+    maskImage.setColorTable(colors);
+
+    QPainter painter(pImage);
+    painter.drawImage(0, 0, maskImage);
+}
 
-            setUpdatesEnabled(true);
-            repaint();
-            setUpdatesEnabled(false);
-            curCountOfFrames++;
-        }
+void MainWindow::drawForeground(QImage* pImage)
+{
+    if (g_backgroundModel.width() != pImage->width() || g_backgroundModel.height() != pImage->height())
+    {
+        return;
     }
-    else // Standart player
+
+    drawMask(pImage, g_backgroundModel.mask(), qRgba(255, 64, 0, 110));
+
+    QPainter painter(pImage);
+    painter.setPen(Qt::green);
+    for (int i = 0; i < g_foregroundBlobs.size(); ++i)
     {
-        QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "C:\\", "Video files (*.*)");
-        if (fileName.isEmpty())
-        {
-            return;
-        }
-        on_actionStop_triggered();
-        pMediaPlayer->setMedia(QUrl(fileName));
-        on_actionPlay_triggered();
+        painter.drawRect(g_foregroundBlobs[i].bounds);
     }
 }
 
-void MainWindow::on_actionPlay_triggered()
+void MainWindow::showPlaneStatus()
 {
-    if(ONIMode)
+    if (!g_planeFit.bFound)
     {
-        //TODO
+        ui->statusBar->showMessage(tr("No floor plane, %1 ms").arg(g_planeFit.elapsedMs, 0, 'f', 1));
+        return;
     }
-    else
+
+    // Angle between the camera's vertical axis and the floor normal.
+    double tilt = acos(qBound(-1.0, double(g_planeFit.ny), 1.0)) * 180 / 3.14159265358979323846;
+    ui->statusBar->showMessage(tr("Floor %1 mm below, tilt %2 deg, %3% inliers, %4 iterations, %5 ms")
+                               .arg(g_planeFit.d, 0, 'f', 0)
+                               .arg(tilt, 0, 'f', 1)
+                               .arg(100.0 * g_planeFit.inliers / qMax(1, g_planeFit.points), 0, 'f', 0)
+                               .arg(g_planeFit.iterations)
+                               .arg(g_planeFit.elapsedMs, 0, 'f', 1));
+}
+
+void MainWindow::startPrefetcher(const QString& fileName)
+{
+    pMemoryGovernor->removeOwner(pPrefetcher);
+    delete pPrefetcher;
+
+    openni::VideoFrameRef* pCurFrame = NULL;
+    openni::VideoStream* pStream = getSeekingStream(pCurFrame);
+    int numberOfFrames = (pStream != NULL) ? g_pPlaybackControl->getNumberOfFrames(*pStream) : 0;
+
+    pPrefetcher = new ReadAheadPrefetcher(fileName, numberOfFrames, this);
+    pPrefetcher->setWindowBytes(qint64(g_readAheadMegabytes) << 20);
+    pMemoryGovernor->addOwner(pPrefetcher, tr("Read-ahead"), MemoryGovernor::Priority_Prefetch);
+    pPrefetcher->start(TaskScheduler::threadPriority(TaskScheduler::Priority_Prefetch));
+
+    pIoStatusLabel->clear();
+    pIoStatusLabel->show();
+    pIoStatsTimer->start(1000);
+}
+
+void MainWindow::onIoStatsTimeout()
+{
+    if (pPrefetcher == nullptr)
     {
-        pMediaPlayer->play();
-        ui->statusBar->showMessage("Playing");
+        return;
     }
 
+    ReadAheadPrefetcher::Stats stats = pPrefetcher->stats();
+    pIoStatusLabel->setText(tr("Read-ahead %1/%2 MB, %3 stalls, %4 misses, %5 seeks")
+                            .arg(stats.bytesAhead >> 20)
+                            .arg(g_readAheadMegabytes)
+                            .arg(stats.stalls)
+                            .arg(stats.misses)
+                            .arg(stats.seeks));
 }
 
-void MainWindow::on_actionPause_triggered()
+void MainWindow::startPublisher()
 {
-    if(ONIMode)
+    // Slots are sized for the largest stream, with room for a few frames
+    // per stream so slow subscribers do not lose every other one.
+    int slotSize = 0;
+    int streamCount = 0;
+    if (g_bIsDepthOn)
     {
-        //TODO
+        openni::VideoMode mode = g_depthStream.getVideoMode();
+        slotSize = qMax(slotSize, mode.getResolutionX() * mode.getResolutionY() * int(sizeof(openni::DepthPixel)));
+        streamCount++;
     }
-    else
+    if (g_bIsColorOn)
     {
-        pMediaPlayer->pause();
-        ui->statusBar->showMessage("Pause");
+        openni::VideoMode mode = g_colorStream.getVideoMode();
+        slotSize = qMax(slotSize, mode.getResolutionX() * mode.getResolutionY() * int(sizeof(openni::RGB888Pixel)));
+        streamCount++;
+    }
+    if (slotSize == 0)
+    {
+        return;
+    }
+
+    g_lastPublishedDepth = 0;
+    g_lastPublishedColor = 0;
+    if (!g_framePublisher.create(kFrameRingName, qMax(1, streamCount) * kFrameRingFramesPerStream, slotSize))
+    {
+        QMessageBox::information(this, tr("Publish frames"), tr("Cannot create shared memory \"%1\": %2")
+                                 .arg(kFrameRingName).arg(g_framePublisher.errorString()));
+        ui->actionPublishFrames->setChecked(false);
     }
 }
 
-void MainWindow::on_actionStop_triggered()
+void MainWindow::publishFrames()
 {
-    if(ONIMode)
+    if (!g_framePublisher.isOpen())
     {
-        //TODO
+        return;
     }
-    else
+
+    // Redraws show the same frame again, each one is published once.
+    if (g_bIsDepthOn && g_depthFrame.isValid() && g_depthFrame.getFrameIndex() != g_lastPublishedDepth)
     {
-        pMediaPlayer->stop();
-        ui->statusBar->showMessage("Stoping");
+        g_framePublisher.publish(framering::STREAM_DEPTH, g_depthFrame);
+        g_lastPublishedDepth = g_depthFrame.getFrameIndex();
+    }
+    if (g_bIsColorOn && g_colorFrame.isValid() && g_colorFrame.getFrameIndex() != g_lastPublishedColor)
+    {
+        g_framePublisher.publish(framering::STREAM_COLOR, g_colorFrame);
+        g_lastPublishedColor = g_colorFrame.getFrameIndex();
+    }
+}
+
+void MainWindow::startRecording(const QString& fileName)
+{
+    stopRecording();
+
+    pRecorder = new RecordingWriter(fileName, this);
+    if (g_bIsDepthOn)
+    {
+        pRecorder->addStream(openni::SENSOR_DEPTH, g_depthStream);
+    }
+    if (g_bIsColorOn)
+    {
+        pRecorder->addStream(openni::SENSOR_COLOR, g_colorStream);
+    }
+    // Live mode only listens to depth and color.
+    if (g_bIsIROn && !g_bIsLive)
+    {
+        pRecorder->addStream(openni::SENSOR_IR, g_irStream);
+    }
+    pMemoryGovernor->addOwner(pRecorder, tr("Recording queue"), MemoryGovernor::Priority_Recording, kMinRecordQueueBytes);
+    RecordingWriter* pWriter = pRecorder;
+    connect(pWriter, &QThread::finished, this, [this, pWriter]()
+    {
+        onRecorderFinished(pWriter);
+    });
+    pRecorder->start();
+
+    g_lastRecordedDepth = 0;
+    g_lastRecordedColor = 0;
+    g_lastRecordedIR = 0;
+
+    // Live frames go to the recorder straight from the OpenNI threads,
+    // including the ones the display skips.
+    if (pDepthListener != nullptr)
+    {
+        pDepthListener->setRecorder(pRecorder);
+    }
+    if (pColorListener != nullptr)
+    {
+        pColorListener->setRecorder(pRecorder);
+    }
+
+    g_recordTimer.start();
+    pRecordStatusLabel->clear();
+    pRecordStatusLabel->show();
+    pRecordStatsTimer->start(1000);
+}
+
+void MainWindow::stopRecording()
+{
+    if (pRecorder == nullptr)
+    {
+        return;
+    }
+
+    if (pDepthListener != nullptr)
+    {
+        pDepthListener->setRecorder(nullptr);
     }
+    if (pColorListener != nullptr)
+    {
+        pColorListener->setRecorder(nullptr);
+    }
+
+    // Draining the queue and writing the trailer can take a while, the
+    // writer reports through onRecorderFinished when done.
+    pMemoryGovernor->removeOwner(pRecorder);
+    pRecorder->finish();
+    bool bFinished = pRecorder->isFinished();
+    pRecorder = nullptr;
+
+    pRecordStatsTimer->stop();
+    pRecordStatusLabel->hide();
+    ui->actionRecord->setChecked(false);
+    if (!bFinished)
+    {
+        ui->statusBar->showMessage(tr("Finishing recording..."));
+    }
+}
+
+void MainWindow::onRecorderFinished(RecordingWriter* pWriter)
+{
+    if (pWriter == pRecorder)
+    {
+        // Writing failed, the thread ended while still recording.
+        stopRecording();
+    }
+
+    // finished() comes just before the thread is done.
+    pWriter->wait();
+    RecordingWriter::Stats stats = pWriter->stats();
+    QString error = pWriter->errorString();
+    pWriter->deleteLater();
+
+    if (!error.isEmpty())
+    {
+        QMessageBox::information(this, tr("Record"), tr("Recording failed: %1").arg(error));
+        return;
+    }
+    ui->statusBar->showMessage(tr("Recorded %1 frames, %2 MB, %3 dropped")
+                               .arg(stats.framesWritten)
+                               .arg(stats.bytesWritten >> 20)
+                               .arg(stats.framesDropped));
+}
+
+void MainWindow::recordFrames()
+{
+    if (pRecorder == nullptr || g_bIsLive)
+    {
+        return;
+    }
+
+    // Only forward progress is recorded, seeking back would make timestamps run backwards.
+    if (g_bIsDepthOn && g_depthFrame.isValid() && g_depthFrame.getFrameIndex() > g_lastRecordedDepth)
+    {
+        pRecorder->push(g_depthFrame);
+        g_lastRecordedDepth = g_depthFrame.getFrameIndex();
+    }
+    if (g_bIsColorOn && g_colorFrame.isValid() && g_colorFrame.getFrameIndex() > g_lastRecordedColor)
+    {
+        pRecorder->push(g_colorFrame);
+        g_lastRecordedColor = g_colorFrame.getFrameIndex();
+    }
+    if (g_bIsIROn && g_irFrame.isValid() && g_irFrame.getFrameIndex() > g_lastRecordedIR)
+    {
+        pRecorder->push(g_irFrame);
+        g_lastRecordedIR = g_irFrame.getFrameIndex();
+    }
+}
+
+void MainWindow::onRecordStatsTimeout()
+{
+    if (pRecorder == nullptr)
+    {
+        return;
+    }
+
+    QString error = pRecorder->errorString();
+    if (!error.isEmpty())
+    {
+        stopRecording();
+        return;
+    }
+
+    RecordingWriter::Stats stats = pRecorder->stats();
+    qint64 seconds = g_recordTimer.elapsed() / 1000;
+    pRecordStatusLabel->setText(tr("REC %1:%2, %3 frames, %4 MB, %5 dropped, %6 MB queued")
+                                .arg(seconds / 60)
+                                .arg(seconds % 60, 2, 10, QChar('0'))
+                                .arg(stats.framesWritten)
+                                .arg(stats.bytesWritten >> 20)
+                                .arg(stats.framesDropped)
+                                .arg(stats.queuedBytes >> 20));
+}
+
+void MainWindow::startThumbnails(const QString& fileName)
+{
+    delete pThumbnailWorker;
+    pThumbnailStrip->clear();
+
+    pThumbnailWorker = new ThumbnailWorker(fileName, this);
+    connect(pThumbnailWorker, &ThumbnailWorker::layoutReady, pThumbnailStrip, &ThumbnailStrip::setThumbnailCount);
+    connect(pThumbnailWorker, &ThumbnailWorker::thumbnailReady, pThumbnailStrip, &ThumbnailStrip::setThumbnail);
+    connect(pThumbnailStrip, &ThumbnailStrip::visibleCenterChanged, pThumbnailWorker, &ThumbnailWorker::setFocusIndex, Qt::DirectConnection);
+
+    // Playback keeps priority, thumbnails only use otherwise idle time.
+    pThumbnailWorker->start(TaskScheduler::threadPriority(TaskScheduler::Priority_Background));
+}
+
+int MainWindow::playbackFps()
+{
+    int fps = 30;
+    if (pArchiveReader != nullptr)
+    {
+        fps = int(pArchiveReader->streamDesc(g_archiveDepthStream >= 0 ? g_archiveDepthStream : g_archiveColorStream).fps);
+    }
+    else if (g_bIsDepthOn)
+    {
+        fps = g_depthStream.getVideoMode().getFps();
+    }
+    else if (g_bIsColorOn)
+    {
+        fps = g_colorStream.getVideoMode().getFps();
+    }
+
+    return qMax(1, fps);
+}
+
+void MainWindow::restartPlayClock()
+{
+    openni::VideoFrameRef* pCurFrame = NULL;
+    if (pArchiveReader != nullptr)
+    {
+        g_playStartFrame = g_archiveFrameId;
+    }
+    else if (getSeekingStream(pCurFrame) != NULL)
+    {
+        g_playStartFrame = pCurFrame->getFrameIndex();
+        if (pReverseReader != nullptr)
+        {
+            pReverseReader->setPlayhead(g_playStartFrame);
+        }
+    }
+    g_playClock.start();
+}
+
+int MainWindow::playClockFrame(int numberOfFrames)
+{
+    // The frame due by the playback clock: frames are skipped above 1x and
+    // shown for several ticks below it.
+    int framesDue = int(g_playClock.elapsed() * playbackFps() * kPlaySpeeds[g_playSpeedIndex] / 1000);
+    int targetId = g_bReverse ? g_playStartFrame - framesDue : g_playStartFrame + framesDue;
+    return qBound(1, targetId, qMax(1, numberOfFrames));
+}
+
+void MainWindow::showPlaybackStatus()
+{
+    QString speed = QString("%1x").arg(kPlaySpeeds[g_playSpeedIndex]);
+    if (g_bReverse)
+    {
+        speed = tr("reverse %1").arg(speed);
+    }
+    ui->statusBar->showMessage(pPlayTimer->isActive() ? tr("Playing %1").arg(speed) : tr("Speed %1").arg(speed));
+}
+
+void MainWindow::stopReverse()
+{
+    pMemoryGovernor->removeOwner(pReverseReader);
+    delete pReverseReader;
+    pReverseReader = nullptr;
+}
+
+void MainWindow::onPlayTimerTimeout()
+{
+    if (pArchiveReader != nullptr)
+    {
+        // Any frame is one lookup away, reverse needs no extra reader.
+        int numberOfFrames = pArchiveReader->getNumberOfFrames(g_archiveDepthStream >= 0 ? g_archiveDepthStream : g_archiveColorStream);
+        int targetId = playClockFrame(numberOfFrames);
+        if (targetId != g_archiveFrameId)
+        {
+            showArchiveFrame(targetId);
+        }
+        else if (targetId == (g_bReverse ? 1 : numberOfFrames))
+        {
+            on_actionPause_triggered();
+        }
+        return;
+    }
+
+    openni::VideoFrameRef* pCurFrame = NULL;
+    openni::VideoStream* pStream = getSeekingStream(pCurFrame);
+    if (pStream == NULL)
+    {
+        pPlayTimer->stop();
+        return;
+    }
+
+    int frameId = pCurFrame->getFrameIndex();
+    int numberOfFrames = g_pPlaybackControl->getNumberOfFrames(*pStream);
+
+    int targetId = playClockFrame(numberOfFrames);
+    if (targetId == frameId)
+    {
+        if (frameId == (g_bReverse ? 1 : numberOfFrames))
+        {
+            on_actionPause_triggered();
+        }
+        return;
+    }
+
+    if (g_bReverse && pReverseReader != nullptr)
+    {
+        // Not decoded yet: keep the current frame, the clock runs on.
+        BufferedFrames frames;
+        int bufferedId = 0;
+        if (!pReverseReader->takeFrame(targetId, &frames, &bufferedId))
+        {
+            return;
+        }
+
+        if (frames.depth.isValid())
+        {
+            g_depthFrame = frames.depth;
+        }
+        if (frames.color.isValid())
+        {
+            g_colorFrame = frames.color;
+        }
+        if (frames.ir.isValid())
+        {
+            g_irFrame = frames.ir;
+        }
+        if (pPrefetcher != nullptr)
+        {
+            pPrefetcher->setPlayhead(bufferedId, -1);
+        }
+        displayFrames();
+        return;
+    }
+
+    QElapsedTimer readTimer;
+    readTimer.start();
+    seekFrame(targetId - frameId);
+    if (pPrefetcher != nullptr && readTimer.elapsed() > pPlayTimer->interval())
+    {
+        pPrefetcher->addStall();
+    }
+    displayFrames();
+
+    // End of recording, the seek was clipped to the last frame.
+    if (pCurFrame->getFrameIndex() == frameId)
+    {
+        on_actionPause_triggered();
+    }
+}
+
+void MainWindow::onThumbnailFrameRequested(int frameId)
+{
+    seekFrameAbs(frameId);
+    displayFrames();
+    restartPlayClock();
+}
+
+void MainWindow::onPositionSliderMoved(int frameId)
+{
+    if (pArchiveReader != nullptr)
+    {
+        showArchiveFrame(frameId);
+        restartPlayClock();
+        return;
+    }
+
+    onThumbnailFrameRequested(frameId);
+}
+
+void MainWindow::cancelQuery()
+{
+    if (pQueryEngine)
+    {
+        pQueryEngine->cancel();
+        pQueryWatcher->waitForFinished();
+        pQueryEngine.clear();
+    }
+
+    pQueryProgressTimer->stop();
+    pProgressBar->hide();
+}
+
+void MainWindow::onQueryProgress()
+{
+    if (pQueryEngine)
+    {
+        pProgressBar->setMaximum(pQueryEngine->numberOfFrames());
+        pProgressBar->setValue(pQueryEngine->framesScanned());
+    }
+}
+
+void MainWindow::onQueryFinished()
+{
+    // A canceled query only leaves partial results behind.
+    if (!pQueryEngine)
+    {
+        return;
+    }
+
+    pQueryProgressTimer->stop();
+    pProgressBar->hide();
+    pQueryEngine.clear();
+
+    QVector<FrameRange> ranges = pQueryWatcher->result();
+
+    pQueryResults->clear();
+    for (int i = 0; i < ranges.size(); ++i)
+    {
+        QString text = (ranges[i].first == ranges[i].last)
+                ? tr("Frame %1").arg(ranges[i].first)
+                : tr("Frames %1 - %2").arg(ranges[i].first).arg(ranges[i].last);
+        QListWidgetItem* pItem = new QListWidgetItem(text, pQueryResults);
+        pItem->setData(Qt::UserRole, ranges[i].first);
+    }
+
+    pQueryDock->show();
+    ui->statusBar->showMessage(tr("Found %1 matching ranges").arg(ranges.size()));
+}
+
+void MainWindow::onQueryResultActivated(QListWidgetItem* item)
+{
+    on_actionPause_triggered();
+    seekFrameAbs(item->data(Qt::UserRole).toInt());
+    displayFrames();
+}
+
+void MainWindow::cancelHealthScan()
+{
+    g_healthToken.cancel();
+    pHealthWatcher->waitForFinished();
+}
+
+void MainWindow::onHealthScanFinished()
+{
+    // A scan dropped before it started has no result.
+    if (g_healthToken.isCanceled())
+    {
+        return;
+    }
+    RecordingHealth health = pHealthWatcher->result();
+
+    ui->statusBar->clearMessage();
+
+    QMessageBox box(health.isHealthy() ? QMessageBox::Information : QMessageBox::Warning,
+                    tr("Recording health"),
+                    health.isHealthy() ? tr("No problems found.") : tr("Problems found, see details."),
+                    QMessageBox::Ok, this);
+    box.setDetailedText(formatHealthReport(health));
+    box.exec();
+}
+
+void MainWindow::startStreamCopy(const QVector<OniClip>& clips, const QString& outputFileName)
+{
+    g_copyToken = CancelToken();
+    CancelToken token = g_copyToken;
+    g_copyProgress.store(0);
+    g_copyFileName = outputFileName;
+    pCopyWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [this, clips, outputFileName, token]()
+    {
+        QString error;
+        copyOniClips(clips, outputFileName, &error, token.flag(), &g_copyProgress);
+        return error;
+    }));
+
+    onStreamCopyProgress();
+    pCopyProgressTimer->start(500);
+}
+
+void MainWindow::onStreamCopyProgress()
+{
+    ui->statusBar->showMessage(tr("Writing %1... %2%").arg(g_copyFileName)
+                               .arg(g_copyProgress.load() / 10.0, 0, 'f', 1));
+}
+
+void MainWindow::onStreamCopyFinished()
+{
+    pCopyProgressTimer->stop();
+
+    QString error = pCopyWatcher->result();
+    if (error.isEmpty())
+    {
+        ui->statusBar->showMessage(tr("Recording written"));
+    }
+    else
+    {
+        ui->statusBar->clearMessage();
+        QMessageBox::information(this, tr("Error writing recording"), error);
+    }
+}
+
+void MainWindow::openArchive(const QString& fileName)
+{
+    pArchiveReader = new ArchiveReader();
+    if (!pArchiveReader->open(fileName))
+    {
+        QMessageBox::information(this, tr("Error open archive"), pArchiveReader->errorString());
+        closeArchive();
+        return;
+    }
+
+    g_archiveDepthStream = pArchiveReader->findStream(openni::SENSOR_DEPTH);
+    g_archiveColorStream = pArchiveReader->findStream(openni::SENSOR_COLOR);
+    if ((g_archiveDepthStream < 0 && g_archiveColorStream < 0) || !showArchiveFrame(1))
+    {
+        QMessageBox::information(this, tr("Error open archive"), tr("No depth or color frames in %1").arg(fileName));
+        closeArchive();
+        return;
+    }
+
+    on_actionPlay_triggered();
+}
+
+void MainWindow::closeArchive()
+{
+    delete pArchiveReader;
+    pArchiveReader = nullptr;
+    g_archiveDepthStream = -1;
+    g_archiveColorStream = -1;
+    g_archiveFrameId = 0;
+
+    g_backgroundModel.reset();
+    g_lastForegroundFrame = 0;
+    g_foregroundBlobs.clear();
+    g_foregroundLog.clear();
+
+    g_planeDetector.reset();
+    g_lastPlaneFrame = 0;
+    g_planeFit = PlaneFit();
+
+    g_lastStatsFrame = 0;
+    pDepthStatsPanel->clear();
+
+    g_depthSource.stop();
+    g_colorSource.stop();
+    pSlider->hide();
+}
+
+bool MainWindow::showArchiveFrame(int frameId)
+{
+    // Depth sets the pace when present, color follows by timestamp.
+    int referenceStream = g_archiveDepthStream >= 0 ? g_archiveDepthStream : g_archiveColorStream;
+    ArchiveFrame frame;
+    if (!pArchiveReader->readFrame(referenceStream, frameId, &frame))
+    {
+        return false;
+    }
+    g_archiveFrameId = frameId;
+
+    if (g_archiveDepthStream >= 0)
+    {
+        const archive::StreamDesc& desc = pArchiveReader->streamDesc(g_archiveDepthStream);
+        g_planeDetector.setFieldOfView(desc.horizontalFov, desc.verticalFov);
+        QRect region = regionRect(g_region, frame.width, frame.height);
+        g_planeDetector.setCrop(region.x(), region.y(), frame.width, frame.height);
+        displayDepth(reinterpret_cast<const openni::DepthPixel*>(regionData(frame.data, frame.strideBytes, int(sizeof(openni::DepthPixel)), region)),
+                     region.width(), region.height(), frame.strideBytes, frameId);
+    }
+
+    if (g_archiveColorStream >= 0)
+    {
+        ArchiveFrame colorFrame = frame;
+        if (referenceStream != g_archiveColorStream)
+        {
+            int colorId = pArchiveReader->frameAtTimestamp(g_archiveColorStream, frame.timestamp);
+            if (!pArchiveReader->readFrame(g_archiveColorStream, colorId, &colorFrame))
+            {
+                return true;
+            }
+        }
+        QRect region = regionRect(g_region, colorFrame.width, colorFrame.height);
+        displayColor(regionData(colorFrame.data, colorFrame.strideBytes, 3, region), region.width(), region.height(), colorFrame.strideBytes);
+    }
+
+    showPosition(frameId, pArchiveReader->getNumberOfFrames(referenceStream));
+    return true;
+}
+
+void MainWindow::onArchiveExportFinished()
+{
+    QString error = pArchiveWatcher->result();
+    if (!error.isEmpty())
+    {
+        ui->statusBar->clearMessage();
+        QMessageBox::information(this, tr("Error writing archive"), error);
+        return;
+    }
+
+    ui->statusBar->showMessage(tr("Archive written: %1 frames, %2 MB (recording %3 MB, raw %4 MB) in %5 s")
+                               .arg(g_archiveStats.frames)
+                               .arg(g_archiveStats.archiveBytes / 1048576.0, 0, 'f', 1)
+                               .arg(g_archiveStats.sourceBytes / 1048576.0, 0, 'f', 1)
+                               .arg(g_archiveStats.rawBytes / 1048576.0, 0, 'f', 1)
+                               .arg(g_archiveStats.seconds, 0, 'f', 1));
+}
+
+void MainWindow::onVideoExportProgress()
+{
+    ui->statusBar->showMessage(tr("Writing %1... %2%").arg(g_videoExportFileName)
+                               .arg(g_videoExportProgress.load() / 10.0, 0, 'f', 1));
+}
+
+void MainWindow::onVideoExportFinished()
+{
+    pVideoExportProgressTimer->stop();
+
+    if (g_videoExportToken.isCanceled())
+    {
+        ui->statusBar->showMessage(tr("Video export canceled"));
+        return;
+    }
+
+    QString error = pVideoExportWatcher->result();
+    if (!error.isEmpty())
+    {
+        ui->statusBar->clearMessage();
+        QMessageBox::information(this, tr("Error writing video"), error);
+        return;
+    }
+
+    double videoSeconds = double(g_videoExportStats.frames) / qMax(1, g_videoExportStats.fps);
+    ui->statusBar->showMessage(tr("Video written: %1 frames %2x%3, %4 MB in %5 s (%6x real time)")
+                               .arg(g_videoExportStats.frames)
+                               .arg(g_videoExportStats.width)
+                               .arg(g_videoExportStats.height)
+                               .arg(g_videoExportStats.bytes / 1048576.0, 0, 'f', 1)
+                               .arg(g_videoExportStats.seconds, 0, 'f', 1)
+                               .arg(videoSeconds / qMax(0.001, g_videoExportStats.seconds), 0, 'f', 1));
+}
+
+MainWindow::MainWindow(QWidget *parent) :
+    QMainWindow(parent),
+    ui(new Ui::MainWindow)
+{
+
+    ui->setupUi(this);
+
+    if (ONIMode)
+    {
+        // Drivers are loaded once here and stay loaded while files are
+        // opened and closed.
+        pOpenNISession.reset(new OpenNISession());
+        if (!pOpenNISession->isOk())
+        {
+            QMessageBox::information(this, tr("Error Init"), pOpenNISession->errorString());
+        }
+
+        pPlayTimer = new QTimer(this);
+        connect(pPlayTimer, &QTimer::timeout, this, &MainWindow::onPlayTimerTimeout);
+
+        g_depthSource.setVideoSurface(ui->depthView->videoSurface());
+        g_colorSource.setVideoSurface(ui->colorView->videoSurface());
+
+        connect(ui->depthView, &VideoSurfaceView::regionSelected, this, &MainWindow::onRegionSelected);
+        connect(ui->colorView, &VideoSurfaceView::regionSelected, this, &MainWindow::onRegionSelected);
+        connect(ui->depthView, &VideoSurfaceView::viewChanged, ui->colorView, &VideoSurfaceView::setView);
+        connect(ui->colorView, &VideoSurfaceView::viewChanged, ui->depthView, &VideoSurfaceView::setView);
+
+        pSlider = new QSlider(this);
+        pSlider->setOrientation(Qt::Horizontal);
+        pSlider->setMinimum(1);
+        ui->statusBar->addPermanentWidget(pSlider);
+        pSlider->hide();
+
+        connect(pSlider, &QSlider::sliderMoved, this, &MainWindow::onPositionSliderMoved);
+
+        pThumbnailStrip = new ThumbnailStrip(this);
+        pThumbnailDock = new QDockWidget(tr("Timeline"), this);
+        pThumbnailDock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+        pThumbnailDock->setWidget(pThumbnailStrip);
+        addDockWidget(Qt::BottomDockWidgetArea, pThumbnailDock);
+
+        connect(pThumbnailStrip, &ThumbnailStrip::frameRequested, this, &MainWindow::onThumbnailFrameRequested);
+
+        pDepthStatsPanel = new DepthStatsPanel(this);
+        pDepthStatsDock = new QDockWidget(tr("Depth statistics"), this);
+        // Closed through the menu action only, so both stay in step.
+        pDepthStatsDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+        pDepthStatsDock->setWidget(pDepthStatsPanel);
+        addDockWidget(Qt::RightDockWidgetArea, pDepthStatsDock);
+        pDepthStatsDock->hide();
+
+        pMemoryGovernor = new MemoryGovernor(this);
+        pMemoryGovernor->addOwner(pThumbnailStrip, tr("Thumbnails"), MemoryGovernor::Priority_Thumbnails);
+        connect(pThumbnailStrip, &ThumbnailStrip::memoryWantedChanged, pMemoryGovernor, &MemoryGovernor::rebalance);
+
+        pMemoryList = new QListWidget(this);
+        pMemoryDock = new QDockWidget(tr("Memory"), this);
+        pMemoryDock->setWidget(pMemoryList);
+        addDockWidget(Qt::RightDockWidgetArea, pMemoryDock);
+        pMemoryDock->hide();
+
+        connect(pMemoryGovernor, &MemoryGovernor::usageChanged, this, &MainWindow::onMemoryUsageChanged);
+
+        pTaskList = new QListWidget(this);
+        pTaskDock = new QDockWidget(tr("Tasks"), this);
+        // Closed through the menu action only, so both stay in step.
+        pTaskDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+        pTaskDock->setWidget(pTaskList);
+        addDockWidget(Qt::RightDockWidgetArea, pTaskDock);
+        pTaskDock->hide();
+
+        pTaskStatsTimer = new QTimer(this);
+        connect(pTaskStatsTimer, &QTimer::timeout, this, &MainWindow::onTaskStatsTimeout);
+
+        pQueryResults = new QListWidget(this);
+        pQueryDock = new QDockWidget(tr("Found frames"), this);
+        pQueryDock->setWidget(pQueryResults);
+        addDockWidget(Qt::RightDockWidgetArea, pQueryDock);
+        pQueryDock->hide();
+
+        connect(pQueryResults, &QListWidget::itemActivated, this, &MainWindow::onQueryResultActivated);
+
+        pProgressBar = new QProgressBar(this);
+        ui->statusBar->addPermanentWidget(pProgressBar);
+        pProgressBar->hide();
+
+        pQueryProgressTimer = new QTimer(this);
+        connect(pQueryProgressTimer, &QTimer::timeout, this, &MainWindow::onQueryProgress);
+
+        pQueryWatcher = new QFutureWatcher<QVector<FrameRange> >(this);
+        connect(pQueryWatcher, &QFutureWatcher<QVector<FrameRange> >::finished, this, &MainWindow::onQueryFinished);
+
+        pHealthWatcher = new QFutureWatcher<RecordingHealth>(this);
+        connect(pHealthWatcher, &QFutureWatcher<RecordingHealth>::finished, this, &MainWindow::onHealthScanFinished);
+
+        pCopyWatcher = new QFutureWatcher<QString>(this);
+        connect(pCopyWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onStreamCopyFinished);
+
+        pCopyProgressTimer = new QTimer(this);
+        connect(pCopyProgressTimer, &QTimer::timeout, this, &MainWindow::onStreamCopyProgress);
+
+        pArchiveWatcher = new QFutureWatcher<QString>(this);
+        connect(pArchiveWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onArchiveExportFinished);
+
+        pVideoExportWatcher = new QFutureWatcher<QString>(this);
+        connect(pVideoExportWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onVideoExportFinished);
+
+        pVideoExportProgressTimer = new QTimer(this);
+        connect(pVideoExportProgressTimer, &QTimer::timeout, this, &MainWindow::onVideoExportProgress);
+
+        pOpenWatcher = new QFutureWatcher<QString>(this);
+        connect(pOpenWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onDeviceOpened);
+
+        pLiveStatsTimer = new QTimer(this);
+        connect(pLiveStatsTimer, &QTimer::timeout, this, &MainWindow::onLiveStatsTimeout);
+
+        pIoStatusLabel = new QLabel(this);
+        ui->statusBar->addPermanentWidget(pIoStatusLabel);
+        pIoStatusLabel->hide();
+
+        pIoStatsTimer = new QTimer(this);
+        connect(pIoStatsTimer, &QTimer::timeout, this, &MainWindow::onIoStatsTimeout);
+
+        pRecordStatusLabel = new QLabel(this);
+        ui->statusBar->addPermanentWidget(pRecordStatusLabel);
+        pRecordStatusLabel->hide();
+
+        pRecordStatsTimer = new QTimer(this);
+        connect(pRecordStatsTimer, &QTimer::timeout, this, &MainWindow::onRecordStatsTimeout);
+    }
+    else // Standart player
+    {
+        pMediaPlayer = new QMediaPlayer(this);
+        pVideoView = new VideoSurfaceView(this);
+        pMediaPlayer->setVideoOutput(pVideoView->videoSurface());
+        this->setCentralWidget(pVideoView);
+        pSlider = new QSlider(this);
+        pProgressBar = new QProgressBar(this);
+
+        pSlider->setOrientation(Qt::Horizontal);
+        ui->statusBar->addPermanentWidget(pSlider);
+        ui->statusBar->addPermanentWidget(pProgressBar);
+
+        connect(pMediaPlayer, &QMediaPlayer::durationChanged, pSlider, &QSlider::setMaximum);
+        connect(pMediaPlayer, &QMediaPlayer::positionChanged, pSlider, &QSlider::setValue);
+
+        connect(pSlider, &QSlider::sliderMoved, pMediaPlayer, &QMediaPlayer::setPosition);
+
+        connect(pMediaPlayer, &QMediaPlayer::durationChanged, pProgressBar, &QProgressBar::setMaximum);
+        connect(pMediaPlayer, &QMediaPlayer::positionChanged, pProgressBar, &QProgressBar::setValue);
+    }
+
+}
+
+MainWindow::~MainWindow()
+{
+    if (ONIMode)
+    {
+        cancelQuery();
+        cancelHealthScan();
+        g_copyToken.cancel();
+        pCopyWatcher->waitForFinished();
+        g_archiveToken.cancel();
+        pArchiveWatcher->waitForFinished();
+        g_videoExportToken.cancel();
+        pVideoExportWatcher->waitForFinished();
+        pOpenWatcher->waitForFinished();
+        stopRecording();
+        stopLive();
+        // Their readers must close while OpenNI is still up.
+        for (int i = 0; i < pGridViews.size(); ++i)
+        {
+            delete pGridViews[i].data();
+        }
+        // Owners go away below, no more rebalancing.
+        delete pMemoryGovernor;
+        delete pThumbnailWorker;
+        delete pPrefetcher;
+        delete pPreviewServer;
+        delete pReverseReader;
+        delete pArchiveReader;
+    }
+    delete ui;
+}
+
+
+void MainWindow::on_action_openFile_triggered()
+{
+    if(ONIMode)
+    {
+        if (g_bIsOpening)
+        {
+            return;
+        }
+
+        QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "C:\\", "Recordings (*.oni *.oca)");
+        if (fileName.isEmpty())
+        {
+            return;
+        }
+
+        pPlayTimer->stop();
+        if (g_device.isValid())
+        {
+            closeDevice();
+        }
+        closeArchive();
+        g_fileName.clear();
+
+        if (fileName.endsWith(".oca", Qt::CaseInsensitive))
+        {
+            openArchive(fileName);
+            return;
+        }
+        startOpenDevice(fileName);
+    }
+    else // Standart player
+    {
+        QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "C:\\", "Video files (*.*)");
+        if (fileName.isEmpty())
+        {
+            return;
+        }
+        on_actionStop_triggered();
+        pMediaPlayer->setMedia(QUrl(fileName));
+        on_actionPlay_triggered();
+    }
+}
+
+void MainWindow::on_actionOpenDevice_triggered()
+{
+    if (!ONIMode || g_bIsOpening)
+    {
+        return;
+    }
+
+    bool bOk = false;
+    QString uri = QInputDialog::getText(this, tr("Open live device"),
+                                        tr("Device URI (empty for the first connected sensor,\nor an .oni file to replay as a live source):"),
+                                        QLineEdit::Normal, QString(), &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+
+    pPlayTimer->stop();
+    if (g_device.isValid())
+    {
+        closeDevice();
+    }
+    closeArchive();
+    g_fileName.clear();
+
+    startOpenDevice(uri, true);
+}
+
+void MainWindow::on_actionOpenGrid_triggered()
+{
+    if (!ONIMode)
+    {
+        return;
+    }
+
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open grid"), "C:\\", "ONI files (*.oni)");
+    if (fileNames.isEmpty())
+    {
+        return;
+    }
+    if (fileNames.size() > kMaxGridRecordings)
+    {
+        QMessageBox::information(this, tr("Open grid"), tr("At most %1 recordings fit the grid").arg(kMaxGridRecordings));
+        return;
+    }
+
+    // A window of its own, closed with this one before the OpenNI session.
+    GridView* pGridView = new GridView(fileNames, this);
+    pGridView->setWindowFlags(Qt::Window);
+    pGridView->setAttribute(Qt::WA_DeleteOnClose);
+    pGridView->show();
+    pGridViews.removeAll(nullptr);
+    pGridViews.append(pGridView);
+}
+
+void MainWindow::on_actionPlay_triggered()
+{
+    if(ONIMode)
+    {
+        if (pArchiveReader != nullptr)
+        {
+            restartPlayClock();
+            pPlayTimer->start(1000 / playbackFps());
+            showPlaybackStatus();
+            return;
+        }
+        if (g_bIsOpening || g_bIsLive || !g_device.isValid())
+        {
+            return;
+        }
+
+        // Frames are fetched by seeking, the clock sets the pace; the
+        // driver speed only matters for its own sequential reads.
+        if (g_pPlaybackControl != NULL)
+        {
+            g_pPlaybackControl->setSpeed(kPlaySpeeds[g_playSpeedIndex]);
+        }
+        if (g_bReverse && pReverseReader == nullptr && !g_fileName.isEmpty())
+        {
+            pReverseReader = new ReverseReader(g_fileName, this);
+            pMemoryGovernor->addOwner(pReverseReader, tr("Reverse buffer"), MemoryGovernor::Priority_Playback);
+            pReverseReader->start();
+        }
+
+        restartPlayClock();
+        pPlayTimer->start(1000 / playbackFps());
+        showPlaybackStatus();
+    }
+    else
+    {
+        pMediaPlayer->play();
+        ui->statusBar->showMessage("Playing");
+    }
+
+}
+
+void MainWindow::on_actionSlower_triggered()
+{
+    g_playSpeedIndex = qMax(0, g_playSpeedIndex - 1);
+    if (g_pPlaybackControl != NULL && !g_bIsLive)
+    {
+        g_pPlaybackControl->setSpeed(kPlaySpeeds[g_playSpeedIndex]);
+    }
+    restartPlayClock();
+    showPlaybackStatus();
+}
+
+void MainWindow::on_actionFaster_triggered()
+{
+    g_playSpeedIndex = qMin(kPlaySpeedCount - 1, g_playSpeedIndex + 1);
+    if (g_pPlaybackControl != NULL && !g_bIsLive)
+    {
+        g_pPlaybackControl->setSpeed(kPlaySpeeds[g_playSpeedIndex]);
+    }
+    restartPlayClock();
+    showPlaybackStatus();
+}
+
+void MainWindow::on_actionReverse_toggled(bool checked)
+{
+    g_bReverse = checked;
+
+    // Forward playback seeks to absolute frames, so the player streams
+    // need no resync after reverse.
+    if (checked && pReverseReader == nullptr && !g_fileName.isEmpty())
+    {
+        pReverseReader = new ReverseReader(g_fileName, this);
+        pMemoryGovernor->addOwner(pReverseReader, tr("Reverse buffer"), MemoryGovernor::Priority_Playback);
+        pReverseReader->start();
+    }
+    else if (!checked)
+    {
+        stopReverse();
+    }
+
+    restartPlayClock();
+    showPlaybackStatus();
+}
+
+void MainWindow::on_actionPause_triggered()
+{
+    if(ONIMode)
+    {
+        pPlayTimer->stop();
+        ui->statusBar->showMessage("Pause");
+    }
+    else
+    {
+        pMediaPlayer->pause();
+        ui->statusBar->showMessage("Pause");
+    }
+}
+
+void MainWindow::on_actionStop_triggered()
+{
+    if(ONIMode)
+    {
+        pPlayTimer->stop();
+        if (pArchiveReader != nullptr)
+        {
+            showArchiveFrame(1);
+        }
+        else if (g_device.isValid())
+        {
+            seekFrameAbs(1);
+            displayFrames();
+        }
+        ui->statusBar->showMessage("Stoping");
+    }
+    else
+    {
+        pMediaPlayer->stop();
+        ui->statusBar->showMessage("Stoping");
+    }
+}
+
+void MainWindow::on_actionFindFrames_triggered()
+{
+    if (!ONIMode || g_fileName.isEmpty() || !g_bIsDepthOn)
+    {
+        return;
+    }
+
+    FrameQueryDialog dialog(g_lastQuery, this);
+    if (dialog.exec() != QDialog::Accepted)
+    {
+        return;
+    }
+    g_lastQuery = dialog.query();
+
+    cancelQuery();
+
+    QSharedPointer<FrameQueryEngine> pEngine(new FrameQueryEngine(g_fileName, g_lastQuery));
+    pQueryEngine = pEngine;
+    pQueryWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [pEngine]() { return pEngine->run(); }));
+
+    pProgressBar->setValue(0);
+    pProgressBar->show();
+    pQueryProgressTimer->start(200);
+    ui->statusBar->showMessage(tr("Searching..."));
+}
+
+void MainWindow::on_actionCheckHealth_triggered()
+{
+    if (!ONIMode || g_fileName.isEmpty() || pHealthWatcher->isRunning())
+    {
+        return;
+    }
+
+    g_healthToken = CancelToken();
+
+    QString fileName = g_fileName;
+    CancelToken token = g_healthToken;
+    pHealthWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, token, [fileName, token]()
+    {
+        return scanRecordingHealth(fileName, true, token.flag());
+    }));
+
+    ui->statusBar->showMessage(tr("Checking recording health..."));
+}
+
+void MainWindow::on_actionSaveClip_triggered()
+{
+    if (!ONIMode || g_fileName.isEmpty() || pCopyWatcher->isRunning())
+    {
+        return;
+    }
+
+    openni::VideoFrameRef* pCurFrame = NULL;
+    openni::VideoStream* pStream = getSeekingStream(pCurFrame);
+    if (pStream == NULL)
+    {
+        return;
+    }
+
+    int numberOfFrames = g_pPlaybackControl->getNumberOfFrames(*pStream);
+    int currentFrame = qMax(1, pCurFrame->getFrameIndex());
+
+    bool bOk = false;
+    int firstFrame = QInputDialog::getInt(this, tr("Save clip"), tr("First frame:"), currentFrame, 1, numberOfFrames, 1, &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+    int lastFrame = QInputDialog::getInt(this, tr("Save clip"), tr("Last frame:"),
+                                         qMin(numberOfFrames, firstFrame + 30 * pStream->getVideoMode().getFps()),
+                                         firstFrame, numberOfFrames, 1, &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+
+    QString outputFileName = QFileDialog::getSaveFileName(this, tr("Save clip"), QString(), "ONI files (*.oni)");
+    if (outputFileName.isEmpty())
+    {
+        return;
+    }
+
+    OniClip clip;
+    clip.fileName = g_fileName;
+    clip.firstFrame = firstFrame;
+    clip.lastFrame = lastFrame;
+
+    startStreamCopy(QVector<OniClip>() << clip, outputFileName);
+}
+
+void MainWindow::on_actionConcatenate_triggered()
+{
+    if (!ONIMode || pCopyWatcher->isRunning())
+    {
+        return;
+    }
+
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Recordings to join, in order"), QString(), "ONI files (*.oni)");
+    if (fileNames.size() < 2)
+    {
+        return;
+    }
+
+    QString outputFileName = QFileDialog::getSaveFileName(this, tr("Save joined recording"), QString(), "ONI files (*.oni)");
+    if (outputFileName.isEmpty())
+    {
+        return;
+    }
+
+    QVector<OniClip> clips;
+    for (int i = 0; i < fileNames.size(); ++i)
+    {
+        OniClip clip;
+        clip.fileName = fileNames[i];
+        clips.append(clip);
+    }
+
+    startStreamCopy(clips, outputFileName);
+}
+
+void MainWindow::on_actionExportArchive_triggered()
+{
+    if (!ONIMode || g_fileName.isEmpty() || pArchiveWatcher->isRunning())
+    {
+        return;
+    }
+
+    QString outputFileName = QFileDialog::getSaveFileName(this, tr("Export archive"), QString(), "Frame archives (*.oca)");
+    if (outputFileName.isEmpty())
+    {
+        return;
+    }
+
+    // Decoded through a reader of its own, playback goes on meanwhile.
+    QString fileName = g_fileName;
+    g_archiveToken = CancelToken();
+    CancelToken token = g_archiveToken;
+    pArchiveWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [this, fileName, outputFileName, token]()
+    {
+        QString error;
+        transcodeToArchive(fileName, outputFileName, &error, &g_archiveStats, token.flag());
+        return error;
+    }));
+
+    ui->statusBar->showMessage(tr("Writing %1...").arg(outputFileName));
+}
+
+void MainWindow::on_actionExportVideo_triggered()
+{
+    if (!ONIMode || g_fileName.isEmpty() || pVideoExportWatcher->isRunning())
+    {
+        return;
+    }
+
+    QStringList views;
+    views << tr("Depth") << tr("Color") << tr("Side by side");
+    bool bOk = false;
+    QString view = QInputDialog::getItem(this, tr("Export video"), tr("View:"), views, 0, false, &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+
+    VideoExportSettings settings;
+    settings.view = VideoExportSettings::View(views.indexOf(view));
+    settings.region = g_region;
+
+    // Raw Y16 keeps the depth values, so it only exists for the depth view.
+    QString filter = "MJPEG AVI (*.avi)";
+    if (settings.view == VideoExportSettings::View_Depth)
+    {
+        filter += ";;Raw Y16 depth (*.y16)";
+    }
+    QString selectedFilter;
+    QString outputFileName = QFileDialog::getSaveFileName(this, tr("Export video"), QString(), filter, &selectedFilter);
+    if (outputFileName.isEmpty())
+    {
+        return;
+    }
+    settings.format = selectedFilter.contains("y16") ? VideoExportSettings::Format_RawY16 : VideoExportSettings::Format_MjpegAvi;
+
+    QString fileName = g_fileName;
+    g_videoExportToken = CancelToken();
+    CancelToken token = g_videoExportToken;
+    g_videoExportProgress.store(0);
+    g_videoExportFileName = outputFileName;
+    pVideoExportWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [this, fileName, outputFileName, settings, token]()
+    {
+        QString error;
+        exportVideo(fileName, outputFileName, settings, &error, &g_videoExportStats, token.flag(), &g_videoExportProgress);
+        return error;
+    }));
+
+    onVideoExportProgress();
+    pVideoExportProgressTimer->start(500);
+}
+
+void MainWindow::applyDeviceCropping()
+{
+    if (!g_bIsLive)
+    {
+        return;
+    }
+
+    // Only the region crosses the USB link; drivers without cropping
+    // leave the frames whole and displayFrames() crops them instead.
+    openni::VideoStream* streams[] = {&g_depthStream, &g_colorStream, &g_irStream};
+    for (int i = 0; i < 3; ++i)
+    {
+        openni::VideoStream& stream = *streams[i];
+        if (!stream.isValid() || !stream.isCroppingSupported())
+        {
+            continue;
+        }
+
+        if (g_region.isNull())
+        {
+            stream.resetCropping();
+            continue;
+        }
+
+        openni::VideoMode mode = stream.getVideoMode();
+        QRect region = regionRect(g_region, mode.getResolutionX(), mode.getResolutionY());
+        if (stream.setCropping(region.x(), region.y(), region.width(), region.height()) != openni::STATUS_OK)
+        {
+            stream.resetCropping();
+        }
+    }
+}
+
+void MainWindow::setRegion(const QRectF& region)
+{
+    g_region = region;
+
+    // The models hold per pixel state of the old region.
+    g_depthFilter.reset();
+    g_backgroundModel.reset();
+    g_lastForegroundFrame = 0;
+    g_planeDetector.reset();
+    g_lastPlaneFrame = 0;
+    g_lastStatsFrame = 0;
+
+    applyDeviceCropping();
+    ui->actionClearRegion->setEnabled(!g_region.isNull());
+
+    if (pArchiveReader != nullptr)
+    {
+        showArchiveFrame(g_archiveFrameId);
+    }
+    else
+    {
+        displayFrames();
+    }
+}
+
+void MainWindow::onRegionSelected(const QRectF& region)
+{
+    // The views show the current region, selections narrow it further.
+    QRectF current = g_region.isNull() ? QRectF(0, 0, 1, 1) : g_region;
+    setRegion(QRectF(current.x() + region.x() * current.width(), current.y() + region.y() * current.height(),
+                     region.width() * current.width(), region.height() * current.height()));
+    ui->actionSelectRegion->setChecked(false);
+}
+
+void MainWindow::on_actionSelectRegion_toggled(bool checked)
+{
+    ui->depthView->setSelecting(checked);
+    ui->colorView->setSelecting(checked);
+}
+
+void MainWindow::on_actionClearRegion_triggered()
+{
+    setRegion(QRectF());
+}
+
+void MainWindow::on_actionDepthStats_toggled(bool checked)
+{
+    g_bDepthStatsOn = checked;
+    g_lastStatsFrame = 0;
+    pDepthStatsPanel->clear();
+    pDepthStatsDock->setVisible(checked);
+    displayFrames();
+}
+
+void MainWindow::on_actionHistogramColors_toggled(bool checked)
+{
+    g_bHistogramColorsOn = checked;
+    g_lastStatsFrame = 0;
+    displayFrames();
+}
+
+void MainWindow::on_actionDepthFilter_toggled(bool checked)
+{
+    g_bDepthFilterOn = checked;
+    g_depthFilter.reset();
+    displayFrames();
+}
+
+void MainWindow::on_actionDepthFilterSettings_triggered()
+{
+    DepthFilterDialog dialog(g_depthFilter.settings(), this);
+    if (dialog.exec() != QDialog::Accepted)
+    {
+        return;
+    }
+
+    g_depthFilter.setSettings(dialog.settings());
+    ui->actionDepthFilter->setChecked(true);
+    displayFrames();
+}
+
+void MainWindow::on_actionForeground_toggled(bool checked)
+{
+    g_bForegroundOn = checked;
+    g_lastForegroundFrame = 0;
+    displayFrames();
+}
+
+void MainWindow::on_actionExportForeground_triggered()
+{
+    if (g_foregroundLog.isEmpty())
+    {
+        QMessageBox::information(this, tr("Export foreground"), tr("Play the recording with Show foreground on first."));
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export foreground"), QString(), "CSV files (*.csv)");
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QMessageBox::information(this, tr("Export foreground"), file.errorString());
+        return;
+    }
+
+    QTextStream out(&file);
+    writeForegroundCsvHeader(out);
+    for (QMap<int, QVector<ForegroundBlob> >::const_iterator it = g_foregroundLog.constBegin(); it != g_foregroundLog.constEnd(); ++it)
+    {
+        writeForegroundCsv(out, it.key(), it.value());
+    }
+
+    ui->statusBar->showMessage(tr("Foreground of %1 frames exported").arg(g_foregroundLog.size()));
+}
+
+void MainWindow::on_actionFloorPlane_toggled(bool checked)
+{
+    g_bPlaneOn = checked;
+    g_lastPlaneFrame = 0;
+    displayFrames();
+}
+
+void MainWindow::on_actionReadAhead_triggered()
+{
+    bool bOk = false;
+    int megabytes = QInputDialog::getInt(this, tr("Read-ahead"), tr("Read this much of the recording ahead of the playhead (0 turns it off):"),
+                                         g_readAheadMegabytes, 0, 4096, 16, &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+
+    g_readAheadMegabytes = megabytes;
+    if (pPrefetcher != nullptr)
+    {
+        pPrefetcher->setWindowBytes(qint64(megabytes) << 20);
+    }
+}
+
+void MainWindow::on_actionMemoryBudget_triggered()
+{
+    bool bOk = false;
+    int megabytes = QInputDialog::getInt(this, tr("Memory budget"), tr("Caches, queues and buffers together stay below (MB):"),
+                                         int(pMemoryGovernor->budget() >> 20), 64, 65536, 64, &bOk);
+    if (!bOk)
+    {
+        return;
+    }
+
+    pMemoryGovernor->setBudget(qint64(megabytes) << 20);
+    pMemoryDock->show();
+}
+
+void MainWindow::onMemoryUsageChanged()
+{
+    if (!pMemoryDock->isVisible())
+    {
+        return;
+    }
+
+    QVector<MemoryGovernor::OwnerUsage> usage = pMemoryGovernor->usage();
+    QStringList lines;
+    lines << tr("Total %1 of %2 MB").arg(pMemoryGovernor->totalUsage() >> 20).arg(pMemoryGovernor->budget() >> 20);
+    for (int i = 0; i < usage.size(); ++i)
+    {
+        // A limit below the want means the owner was shrunk.
+        lines << tr("%1: %2 MB, limit %3 of %4 MB")
+                 .arg(usage[i].name)
+                 .arg(usage[i].bytes >> 20)
+                 .arg(usage[i].limit >> 20)
+                 .arg(usage[i].wanted >> 20);
+    }
+
+    while (pMemoryList->count() > lines.size())
+    {
+        delete pMemoryList->takeItem(pMemoryList->count() - 1);
+    }
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        if (i < pMemoryList->count())
+        {
+            pMemoryList->item(i)->setText(lines[i]);
+        }
+        else
+        {
+            pMemoryList->addItem(lines[i]);
+        }
+    }
+}
+
+void MainWindow::on_actionTaskScheduler_toggled(bool checked)
+{
+    pTaskDock->setVisible(checked);
+    if (checked)
+    {
+        onTaskStatsTimeout();
+        pTaskStatsTimer->start(kTaskStatsIntervalMs);
+    }
+    else
+    {
+        pTaskStatsTimer->stop();
+    }
+}
+
+void MainWindow::onTaskStatsTimeout()
+{
+    TaskScheduler* pScheduler = TaskScheduler::instance();
+    QStringList names;
+    names << tr("Interactive") << tr("Prefetch") << tr("Background");
+
+    QStringList lines;
+    lines << tr("%1 workers").arg(pScheduler->workerCount());
+    for (int i = 0; i < TaskScheduler::PriorityCount; ++i)
+    {
+        TaskScheduler::Stats stats = pScheduler->stats(TaskScheduler::Priority(i));
+        lines << tr("%1: %2 queued, %3 running, %4 done, %5 canceled, wait %6 ms avg / %7 ms max")
+                 .arg(names[i])
+                 .arg(stats.queued)
+                 .arg(stats.running)
+                 .arg(stats.completed)
+                 .arg(stats.canceled)
+                 .arg(stats.meanWaitMs, 0, 'f', 1)
+                 .arg(stats.maxWaitMs, 0, 'f', 1);
+    }
+
+    while (pTaskList->count() > lines.size())
+    {
+        delete pTaskList->takeItem(pTaskList->count() - 1);
+    }
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        if (i < pTaskList->count())
+        {
+            pTaskList->item(i)->setText(lines[i]);
+        }
+        else
+        {
+            pTaskList->addItem(lines[i]);
+        }
+    }
+}
+
+void MainWindow::on_actionPublishFrames_toggled(bool checked)
+{
+    g_bPublishOn = checked;
+    if (!checked)
+    {
+        if (g_framePublisher.isOpen())
+        {
+            ui->statusBar->showMessage(tr("%1 frames published, %2 too large for a slot")
+                                       .arg(g_framePublisher.published())
+                                       .arg(g_framePublisher.oversized()));
+        }
+        g_framePublisher.close();
+        return;
+    }
+
+    if (g_device.isValid() && !g_bIsOpening)
+    {
+        startPublisher();
+        publishFrames();
+    }
+    if (g_bPublishOn)
+    {
+        ui->statusBar->showMessage(tr("Publishing frames to shared memory \"%1\"").arg(kFrameRingName));
+    }
+}
+
+void MainWindow::on_actionPreviewServer_toggled(bool checked)
+{
+    if (!checked)
+    {
+        delete pPreviewServer;
+        pPreviewServer = nullptr;
+        ui->statusBar->clearMessage();
+        return;
+    }
+
+    bool bOk = false;
+    int port = QInputDialog::getInt(this, tr("Preview server"), tr("Serve the views on http://127.0.0.1 at port:"),
+                                    g_previewPort, 1, 65535, 1, &bOk);
+    if (!bOk)
+    {
+        ui->actionPreviewServer->setChecked(false);
+        return;
+    }
+    g_previewPort = port;
+
+    pPreviewServer = new PreviewServer(this);
+    if (!pPreviewServer->listen(quint16(port)))
+    {
+        QMessageBox::information(this, tr("Preview server"), tr("Cannot listen on port %1: %2")
+                                 .arg(port).arg(pPreviewServer->errorString()));
+        ui->actionPreviewServer->setChecked(false);
+        return;
+    }
+
+    ui->statusBar->showMessage(tr("Preview at http://127.0.0.1:%1/").arg(pPreviewServer->serverPort()));
+}
+
+void MainWindow::on_actionRecord_toggled(bool checked)
+{
+    if (!checked)
+    {
+        stopRecording();
+        return;
+    }
+    if (pRecorder != nullptr)
+    {
+        return;
+    }
+
+    if (g_bIsOpening || !g_device.isValid())
+    {
+        ui->actionRecord->setChecked(false);
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record"), QString(), tr("ONI files (*.oni)"));
+    if (fileName.isEmpty())
+    {
+        ui->actionRecord->setChecked(false);
+        return;
+    }
+
+    startRecording(fileName);
 }
@@ -3,15 +3,50 @@
 
 #include <QMainWindow>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QMediaPlayer>
-#include <QVideoWidget>
 #include <QVideoFrame>
 #include <QImage>
 #include <QProgressBar>
+#include <QLabel>
 #include <QSlider>
+#include <QDockWidget>
+#include <QTimer>
+#include <QListWidget>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QMap>
+#include <QScopedPointer>
+#include <QPointer>
+#include <QElapsedTimer>
 #include <iostream>
 #include "OpenNI.h" 
+#include "opennisession.h"
+#include "thumbnailstrip.h"
+#include "thumbnailworker.h"
+#include "framequery.h"
+#include "healthscanner.h"
+#include "onistreamcopy.h"
+#include "livestreamlistener.h"
+#include "depthfilter.h"
+#include "backgroundmodel.h"
+#include "planedetector.h"
+#include "readaheadprefetcher.h"
+#include "framepublisher.h"
+#include "previewserver.h"
+#include "recordingwriter.h"
+#include "reversereader.h"
+#include "archivereader.h"
+#include "archivewriter.h"
+#include "videoexport.h"
+#include "videosurfaceview.h"
+#include "onivideosource.h"
+#include "memorygovernor.h"
+#include "depthstats.h"
+#include "depthstatspanel.h"
+#include "taskscheduler.h"
+#include "gridview.h"
 
 namespace Ui {
 class MainWindow;
@@ -29,12 +64,52 @@ private slots:
 
     void on_action_openFile_triggered();
 
+    void on_actionOpenDevice_triggered();
+
+    void on_actionOpenGrid_triggered();
+
     void on_actionPlay_triggered();
 
     void on_actionPause_triggered();
 
     void on_actionStop_triggered();
 
+    void on_actionSlower_triggered();
+
+    void on_actionFaster_triggered();
+
+    void on_actionReverse_toggled(bool checked);
+
+    void on_actionFindFrames_triggered();
+
+    void on_actionCheckHealth_triggered();
+
+    void on_actionSaveClip_triggered();
+
+    void on_actionConcatenate_triggered();
+
+    void on_actionExportArchive_triggered();
+
+    void on_actionExportVideo_triggered();
+
+    void on_actionDepthFilter_toggled(bool checked);
+
+    void on_actionDepthFilterSettings_triggered();
+
+    void on_actionForeground_toggled(bool checked);
+
+    void on_actionExportForeground_triggered();
+
+    void on_actionFloorPlane_toggled(bool checked);
+
+    void on_actionReadAhead_triggered();
+
+    void on_actionPublishFrames_toggled(bool checked);
+
+    void on_actionPreviewServer_toggled(bool checked);
+
+    void on_actionRecord_toggled(bool checked);
+
     openni::Status openStream(openni::Device& device, openni::SensorType sensorType,
                    openni::VideoStream& stream, const openni::SensorInfo** ppSensorInfo, bool* pbIsStreamOn,
                               openni::VideoFrameRef* frame);
@@ -43,6 +118,18 @@ private slots:
 
     openni::Status openDevice(const char* uri);
 
+    void startOpenDevice(const QString& uri, bool bLive = false);
+
+    void onDeviceOpened();
+
+    void startLive();
+
+    void stopLive();
+
+    void onLiveFrame();
+
+    void onLiveStatsTimeout();
+
     void closeDevice();
 
     openni::Status readFrame();
@@ -55,6 +142,106 @@ private slots:
 
     void seekFrameAbs(int frameId);
 
+    void displayFrames();
+
+    void displayColor(const uchar* data, int width, int height, int stride);
+
+    void displayDepth(const openni::DepthPixel* data, int width, int height, int stride, int frameIndex);
+
+    void showPosition(int frameId, int numberOfFrames);
+
+    void applyDeviceCropping();
+
+    void setRegion(const QRectF& region);
+
+    void onRegionSelected(const QRectF& region);
+
+    void on_actionSelectRegion_toggled(bool checked);
+
+    void on_actionClearRegion_triggered();
+
+    void on_actionDepthStats_toggled(bool checked);
+
+    void on_actionHistogramColors_toggled(bool checked);
+
+    void drawMask(QImage* pImage, const quint8* mask, QRgb color);
+
+    void drawForeground(QImage* pImage);
+
+    void showPlaneStatus();
+
+    void startThumbnails(const QString& fileName);
+
+    void startPrefetcher(const QString& fileName);
+
+    void startPublisher();
+
+    void publishFrames();
+
+    void startRecording(const QString& fileName);
+
+    void stopRecording();
+
+    void recordFrames();
+
+    void onRecorderFinished(RecordingWriter* pWriter);
+
+    void onRecordStatsTimeout();
+
+    void onIoStatsTimeout();
+
+    int playbackFps();
+
+    void restartPlayClock();
+
+    int playClockFrame(int numberOfFrames);
+
+    void showPlaybackStatus();
+
+    void stopReverse();
+
+    void onPlayTimerTimeout();
+
+    void onThumbnailFrameRequested(int frameId);
+
+    void onPositionSliderMoved(int frameId);
+
+    void cancelQuery();
+
+    void onQueryProgress();
+
+    void onQueryFinished();
+
+    void onQueryResultActivated(QListWidgetItem* item);
+
+    void cancelHealthScan();
+
+    void onHealthScanFinished();
+
+    void startStreamCopy(const QVector<OniClip>& clips, const QString& outputFileName);
+
+    void onStreamCopyProgress();
+    void onStreamCopyFinished();
+
+    void openArchive(const QString& fileName);
+
+    void closeArchive();
+
+    bool showArchiveFrame(int frameId);
+
+    void onArchiveExportFinished();
+
+    void onVideoExportProgress();
+    void onVideoExportFinished();
+
+    void on_actionMemoryBudget_triggered();
+
+    void onMemoryUsageChanged();
+
+    void on_actionTaskScheduler_toggled(bool checked);
+
+    void onTaskStatsTimeout();
+
 private:
     Ui::MainWindow *ui;
 
@@ -62,16 +249,143 @@ private:
 
     QMediaPlayer* pMediaPlayer;
     QProgressBar* pProgressBar;
-    QVideoWidget* pVideoWidget;
+    VideoSurfaceView* pVideoView;
     QSlider* pSlider;
 
+    // ONI frames reach the views through the same surfaces QMediaPlayer uses.
+    OniVideoSource g_depthSource;
+    OniVideoSource g_colorSource;
+
+    // Region of interest as a fraction of the frame, null for whole frames.
+    QRectF g_region;
+
+    bool g_bDepthStatsOn = false;
+    bool g_bHistogramColorsOn = false;
+    DepthStats g_depthStats;
+    int g_lastStatsFrame = 0;
+    DepthStatsPanel* pDepthStatsPanel;
+    QDockWidget* pDepthStatsDock;
+
+    QTimer* pPlayTimer;
+    QElapsedTimer g_playClock;
+    int g_playStartFrame = 1;
+    int g_playSpeedIndex = 2;
+    bool g_bReverse = false;
+    ReverseReader* pReverseReader = nullptr;
+    QDockWidget* pThumbnailDock;
+    ThumbnailStrip* pThumbnailStrip;
+    ThumbnailWorker* pThumbnailWorker = nullptr;
+
+    ReadAheadPrefetcher* pPrefetcher = nullptr;
+    QLabel* pIoStatusLabel;
+    QTimer* pIoStatsTimer;
+    int g_readAheadMegabytes = 64;
+
+    QDockWidget* pQueryDock;
+    QListWidget* pQueryResults;
+    QTimer* pQueryProgressTimer;
+    QFutureWatcher<QVector<FrameRange> >* pQueryWatcher;
+    QSharedPointer<FrameQueryEngine> pQueryEngine;
+    FrameQuery g_lastQuery;
+
+    QFutureWatcher<RecordingHealth>* pHealthWatcher;
+    // Canceled when the scanned file closes.
+    CancelToken g_healthToken;
+
+    QFutureWatcher<QString>* pCopyWatcher;
+    // Canceled when the window closes.
+    CancelToken g_copyToken;
+    QAtomicInt g_copyProgress;
+    QString g_copyFileName;
+    QTimer* pCopyProgressTimer;
+
+    QFutureWatcher<QString>* pArchiveWatcher;
+    ArchiveStats g_archiveStats;
+    // Canceled when the window closes.
+    CancelToken g_archiveToken;
+
+    QFutureWatcher<QString>* pVideoExportWatcher;
+    VideoExportStats g_videoExportStats;
+    // Canceled when the file or the window closes.
+    CancelToken g_videoExportToken;
+    QAtomicInt g_videoExportProgress;
+    QString g_videoExportFileName;
+    QTimer* pVideoExportProgressTimer;
+
+    // Set while an .oca archive is shown instead of an OpenNI device.
+    ArchiveReader* pArchiveReader = nullptr;
+    int g_archiveDepthStream = -1;
+    int g_archiveColorStream = -1;
+    int g_archiveFrameId = 0;
+
+    QFutureWatcher<QString>* pOpenWatcher;
+    QElapsedTimer g_openTimer;
+    QString g_openingFileName;
+    bool g_bIsOpening = false;
+    bool g_bOpenAsLive = false;
+
+    bool g_bIsLive = false;
+    LiveStreamListener* pDepthListener = nullptr;
+    LiveStreamListener* pColorListener = nullptr;
+    QTimer* pLiveStatsTimer;
+    int g_liveFramesShown = 0;
+    qint64 g_liveLatencySumUs = 0;
+    qint64 g_liveLatencyMaxUs = 0;
+
+    QString g_fileName;
+
+    DepthFilter g_depthFilter;
+    bool g_bDepthFilterOn = false;
+    int g_lastFilteredFrame = 0;
+
+    BackgroundModel g_backgroundModel;
+    bool g_bForegroundOn = false;
+    int g_lastForegroundFrame = 0;
+    QVector<ForegroundBlob> g_foregroundBlobs;
+    QMap<int, QVector<ForegroundBlob> > g_foregroundLog;
+
+    PlaneDetector g_planeDetector;
+    bool g_bPlaneOn = false;
+    int g_lastPlaneFrame = 0;
+    PlaneFit g_planeFit;
+    QVector<quint8> g_planeMask;
+
+    FramePublisher g_framePublisher;
+    bool g_bPublishOn = false;
+    int g_lastPublishedDepth = 0;
+    int g_lastPublishedColor = 0;
+
+    PreviewServer* pPreviewServer = nullptr;
+    int g_previewPort = 8090;
+
+    RecordingWriter* pRecorder = nullptr;
+
+    // Open grid windows, closed before the OpenNI session shuts down.
+    QList<QPointer<GridView> > pGridViews;
+
+    MemoryGovernor* pMemoryGovernor;
+    QDockWidget* pMemoryDock;
+    QListWidget* pMemoryList;
+    QDockWidget* pTaskDock;
+    QListWidget* pTaskList;
+    QTimer* pTaskStatsTimer;
+    QLabel* pRecordStatusLabel;
+    QTimer* pRecordStatsTimer;
+    QElapsedTimer g_recordTimer;
+    int g_lastRecordedDepth = 0;
+    int g_lastRecordedColor = 0;
+    int g_lastRecordedIR = 0;
+
     bool g_bIsDepthOn = false;
     bool g_bIsColorOn = false;
     bool g_bIsIROn = false;
 
+    // Declared before the device and streams so it outlives them.
+    QScopedPointer<OpenNISession> pOpenNISession;
+
     openni::Device g_device;
 
-    openni::PlaybackControl* g_pPlaybackControl;
+    openni::PlaybackControl* g_pPlaybackControl = NULL;
 
     openni::VideoStream g_depthStream;
     openni::VideoStream g_colorStream;
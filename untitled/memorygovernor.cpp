@@ -0,0 +1,109 @@
+#include "memorygovernor.h"
+
+namespace
+{
+    // Sized for the 8 GB machines, leaves room for the OS and the drivers.
+    const qint64 kDefaultBudget = qint64(1024) << 20;
+
+    const int kPollMs = 500;
+}
+
+MemoryGovernor::MemoryGovernor(QObject* parent) :
+    QObject(parent),
+    m_budget(kDefaultBudget)
+{
+    connect(&m_pollTimer, &QTimer::timeout, this, &MemoryGovernor::rebalance);
+    m_pollTimer.start(kPollMs);
+}
+
+void MemoryGovernor::setBudget(qint64 bytes)
+{
+    m_budget = qMax(qint64(0), bytes);
+    rebalance();
+}
+
+void MemoryGovernor::addOwner(MemoryOwner* pOwner, const QString& name, Priority priority, qint64 minimum)
+{
+    Owner owner;
+    owner.pOwner = pOwner;
+    owner.usage.name = name;
+    owner.usage.priority = priority;
+    owner.usage.bytes = 0;
+    owner.usage.wanted = 0;
+    owner.usage.limit = -1;
+    owner.minimum = minimum;
+
+    // Equal priorities keep the order they were added in.
+    int i = 0;
+    while (i < m_owners.size() && m_owners[i].usage.priority >= priority)
+    {
+        ++i;
+    }
+    m_owners.insert(i, owner);
+
+    rebalance();
+}
+
+void MemoryGovernor::removeOwner(MemoryOwner* pOwner)
+{
+    for (int i = 0; i < m_owners.size(); ++i)
+    {
+        if (m_owners[i].pOwner == pOwner)
+        {
+            m_owners.remove(i);
+            rebalance();
+            return;
+        }
+    }
+}
+
+QVector<MemoryGovernor::OwnerUsage> MemoryGovernor::usage() const
+{
+    QVector<OwnerUsage> usage;
+    usage.reserve(m_owners.size());
+    for (int i = 0; i < m_owners.size(); ++i)
+    {
+        usage.append(m_owners[i].usage);
+    }
+    return usage;
+}
+
+qint64 MemoryGovernor::totalUsage() const
+{
+    qint64 total = 0;
+    for (int i = 0; i < m_owners.size(); ++i)
+    {
+        total += m_owners[i].usage.bytes;
+    }
+    return total;
+}
+
+void MemoryGovernor::rebalance()
+{
+    qint64 remaining = m_budget;
+    for (int i = 0; i < m_owners.size(); ++i)
+    {
+        Owner& owner = m_owners[i];
+        owner.usage.bytes = owner.pOwner->memoryUsage();
+        owner.usage.wanted = owner.pOwner->memoryWanted();
+        remaining -= qMin(owner.minimum, owner.usage.wanted);
+    }
+
+    // m_owners is kept sorted, highest priority first.
+    for (int i = 0; i < m_owners.size(); ++i)
+    {
+        Owner& owner = m_owners[i];
+        qint64 minimum = qMin(owner.minimum, owner.usage.wanted);
+        qint64 extra = qBound(qint64(0), owner.usage.wanted - minimum, qMax(qint64(0), remaining));
+        remaining -= extra;
+
+        qint64 limit = minimum + extra;
+        if (limit != owner.usage.limit)
+        {
+            owner.usage.limit = limit;
+            owner.pOwner->setMemoryLimit(limit);
+        }
+    }
+
+    emit usageChanged();
+}
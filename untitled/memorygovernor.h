@@ -0,0 +1,90 @@
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+// Implemented by everything that holds a sizeable amount of memory for the
+// player: caches, queues, thumbnails, prefetch buffers. The governor calls
+// these on the GUI thread, owners running threads of their own guard them.
+class MemoryOwner
+{
+public:
+    virtual ~MemoryOwner() {}
+
+    virtual qint64 memoryUsage() const = 0;
+
+    // What the owner would use with memory to spare.
+    virtual qint64 memoryWanted() const = 0;
+
+    // The owner stays below limit from now on and releases what it holds
+    // above it as soon as it can.
+    virtual void setMemoryLimit(qint64 bytes) = 0;
+};
+
+// Keeps the owners together within one memory budget. The budget is
+// shared out in priority order: every owner first gets its minimum, then
+// the owners from the highest priority down get what they want until the
+// budget is used up, so the lowest priorities shrink first. Usage and
+// wants are polled, limits are only sent when they change.
+class MemoryGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Shrunk first to last.
+    enum Priority
+    {
+        Priority_Prefetch,
+        Priority_Thumbnails,
+        Priority_Playback,
+        Priority_Recording
+    };
+
+    struct OwnerUsage
+    {
+        QString name;
+        int priority;
+        qint64 bytes;
+        qint64 wanted;
+        qint64 limit;
+    };
+
+    explicit MemoryGovernor(QObject* parent = nullptr);
+
+    void setBudget(qint64 bytes);
+
+    qint64 budget() const { return m_budget; }
+
+    // minimum is what the owner keeps even when the budget is exceeded.
+    void addOwner(MemoryOwner* pOwner, const QString& name, Priority priority, qint64 minimum = 0);
+
+    void removeOwner(MemoryOwner* pOwner);
+
+    // As of the last rebalance, highest priority first.
+    QVector<OwnerUsage> usage() const;
+
+    qint64 totalUsage() const;
+
+public slots:
+    void rebalance();
+
+signals:
+    void usageChanged();
+
+private:
+    struct Owner
+    {
+        MemoryOwner* pOwner;
+        OwnerUsage usage;
+        qint64 minimum;
+    };
+
+    QVector<Owner> m_owners;
+    qint64 m_budget;
+    QTimer m_pollTimer;
+};
+
+#endif // MEMORYGOVERNOR_H
@@ -0,0 +1,122 @@
+#include "mipmappyramid.h"
+#include "simd.h"
+#include <QPainter>
+#include <math.h>
+
+MipmapPyramid MipmapPyramid::build(const QImage& image)
+{
+    MipmapPyramid pyramid;
+    if (image.isNull())
+    {
+        return pyramid;
+    }
+
+    QImage level = image.convertToFormat(QImage::Format_RGB32);
+    if (level.constBits() == image.constBits())
+    {
+        // Already RGB32, the conversion shared the pixels.
+        level = image.copy();
+    }
+    pyramid.m_levels.append(level);
+    while (level.width() > kTileSize || level.height() > kTileSize)
+    {
+        level = halveImage(level);
+        pyramid.m_levels.append(level);
+    }
+
+    return pyramid;
+}
+
+int MipmapPyramid::levelFor(double scale)
+{
+    if (scale >= 1 || scale <= 0)
+    {
+        return 0;
+    }
+    return int(floor(log2(1 / scale)));
+}
+
+QImage halveImage(const QImage& image)
+{
+    // Odd last rows and columns are dropped.
+    int width = qMax(1, image.width() / 2);
+    int height = qMax(1, image.height() / 2);
+    if (image.width() < 2 || image.height() < 2)
+    {
+        return image.scaled(width, height);
+    }
+
+    QImage half(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y)
+    {
+        const quint32* top = reinterpret_cast<const quint32*>(image.constScanLine(2 * y));
+        const quint32* bottom = reinterpret_cast<const quint32*>(image.constScanLine(2 * y + 1));
+        quint32* output = reinterpret_cast<quint32*>(half.scanLine(y));
+        int x = 0;
+
+#ifdef ONI_HAVE_SSE2
+        // Four output pixels from two rows of eight.
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i left = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x)));
+            __m128i right = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x + 4)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x + 4)));
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right), _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right), _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), _mm_avg_epu8(even, odd));
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            quint32 pixels[4] = {top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1]};
+            quint32 mean = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                quint32 sum = 2;
+                for (int i = 0; i < 4; ++i)
+                {
+                    sum += (pixels[i] >> shift) & 0xff;
+                }
+                mean |= (sum / 4) << shift;
+            }
+            output[x] = mean;
+        }
+    }
+
+    return half;
+}
+
+void drawTiles(QPainter* pPainter, const QImage& level, double levelScale, const QPointF& origin, const QRect& clip)
+{
+    if (level.isNull() || levelScale <= 0)
+    {
+        return;
+    }
+
+    // Level pixels under the clip rectangle.
+    int left = qMax(0, int(floor((clip.left() - origin.x()) / levelScale)));
+    int top = qMax(0, int(floor((clip.top() - origin.y()) / levelScale)));
+    int right = qMin(level.width(), int(ceil((clip.right() + 1 - origin.x()) / levelScale)));
+    int bottom = qMin(level.height(), int(ceil((clip.bottom() + 1 - origin.y()) / levelScale)));
+    if (left >= right || top >= bottom)
+    {
+        return;
+    }
+
+    // Blocky when magnified, so single pixels can be told apart.
+    pPainter->setRenderHint(QPainter::SmoothPixmapTransform, levelScale < 1);
+
+    const int tileSize = MipmapPyramid::kTileSize;
+    for (int tileY = top / tileSize * tileSize; tileY < bottom; tileY += tileSize)
+    {
+        for (int tileX = left / tileSize * tileSize; tileX < right; tileX += tileSize)
+        {
+            QRect source(tileX, tileY, qMin(tileSize, level.width() - tileX), qMin(tileSize, level.height() - tileY));
+            QRectF target(origin.x() + source.x() * levelScale, origin.y() + source.y() * levelScale,
+                          source.width() * levelScale, source.height() * levelScale);
+            pPainter->drawImage(target, level, source);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef MIPMAPPYRAMID_H
+#define MIPMAPPYRAMID_H
+
+#include <QImage>
+#include <QVector>
+
+class QPainter;
+
+// A frame and its half-size copies down to a single tile, all RGB32.
+// Views draw from the level closest to their zoom and only the tiles
+// that are on screen, so drawing costs about the same for any frame
+// size. Building touches every pixel once more than the frame itself and
+// is meant for a worker thread.
+class MipmapPyramid
+{
+public:
+    static const int kTileSize = 256;
+
+    // image is converted, the pyramid holds no reference to it.
+    static MipmapPyramid build(const QImage& image);
+
+    bool isNull() const { return m_levels.isEmpty(); }
+
+    QSize frameSize() const { return isNull() ? QSize() : m_levels[0].size(); }
+
+    int levelCount() const { return m_levels.size(); }
+
+    const QImage& level(int index) const { return m_levels[index]; }
+
+    // Coarsest level that still has at least one pixel per screen pixel
+    // at scale screen pixels per frame pixel; 0 when zoomed in.
+    static int levelFor(double scale);
+
+private:
+    QVector<QImage> m_levels;
+};
+
+// Half the width and height, every output pixel the mean of four, off by
+// at most one step on the SSE2 path.
+QImage halveImage(const QImage& image);
+
+// Draws the tiles of level that fall inside clip. level is scaled by
+// levelScale and its top left corner is placed at origin.
+void drawTiles(QPainter* pPainter, const QImage& level, double levelScale, const QPointF& origin, const QRect& clip);
+
+#endif // MIPMAPPYRAMID_H
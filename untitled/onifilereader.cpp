@@ -0,0 +1,203 @@
+#include "onifilereader.h"
+#include <string.h>
+
+namespace
+{
+    // Large sequential reads keep spinning disks and network mounts streaming.
+    const int kReadBufferSize = 4 * 1024 * 1024;
+
+    // Anything larger is a damaged header rather than a real frame.
+    const quint32 kMaxRecordSize = 256 * 1024 * 1024;
+}
+
+OniFileReader::OniFileReader()
+{
+    memset(&m_fileHeader, 0, sizeof(m_fileHeader));
+}
+
+bool OniFileReader::open(const QString& fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    char data[oni::kFileHeaderSize];
+    if (!read(data, sizeof(data)) || memcmp(data, oni::kFileIdentity, sizeof(oni::kFileIdentity)) != 0)
+    {
+        m_errorString = QObject::tr("Not an ONI file");
+        close();
+        return false;
+    }
+
+    memcpy(m_fileHeader.identity, data, 4);
+    m_fileHeader.versionMajor = quint8(data[4]);
+    m_fileHeader.versionMinor = quint8(data[5]);
+    m_fileHeader.versionMaintenance = quint16(quint8(data[6]) | (quint8(data[7]) << 8));
+    m_fileHeader.versionBuild = oni::readUInt32(data + 8);
+    m_fileHeader.maxTimestamp = oni::readUInt64(data + 12);
+    m_fileHeader.maxNodeId = oni::readUInt32(data + 20);
+
+    return true;
+}
+
+void OniFileReader::close()
+{
+    m_file.close();
+    m_buffer.clear();
+    m_bufferStart = 0;
+    m_position = 0;
+    m_nodeNames.clear();
+    m_seekTablePositions.clear();
+    m_errorString.clear();
+}
+
+bool OniFileReader::read(char* data, qint64 size)
+{
+    while (size > 0)
+    {
+        qint64 offset = m_position - m_bufferStart;
+        if (offset < 0 || offset >= m_buffer.size())
+        {
+            m_buffer.resize(kReadBufferSize);
+            if (!m_file.seek(m_position))
+            {
+                return false;
+            }
+            qint64 bytesRead = m_file.read(m_buffer.data(), m_buffer.size());
+            if (bytesRead <= 0)
+            {
+                m_buffer.clear();
+                return false;
+            }
+            m_buffer.resize(int(bytesRead));
+            m_bufferStart = m_position;
+            offset = 0;
+        }
+
+        qint64 chunk = qMin(size, qint64(m_buffer.size()) - offset);
+        memcpy(data, m_buffer.constData() + offset, size_t(chunk));
+        data += chunk;
+        size -= chunk;
+        m_position += chunk;
+    }
+
+    return true;
+}
+
+bool OniFileReader::skip(qint64 size)
+{
+    // Stays inside the buffer for small skips, otherwise the next read seeks.
+    m_position += size;
+    return m_position <= m_file.size();
+}
+
+bool OniFileReader::seek(qint64 position)
+{
+    if (position < 0 || position > m_file.size())
+    {
+        return false;
+    }
+
+    m_position = position;
+    return true;
+}
+
+bool OniFileReader::readRecord(OniRecord* record, bool bReadPayload)
+{
+    record->position = m_position;
+    record->fields.clear();
+    record->payload.clear();
+    record->timestamp = 0;
+    record->frameNumber = 0;
+
+    char data[oni::kRecordHeaderSize];
+    if (!read(data, sizeof(data)))
+    {
+        return false;
+    }
+
+    oni::RecordHeader& header = record->header;
+    header.magic = oni::readUInt32(data);
+    header.recordType = oni::readUInt32(data + 4);
+    header.nodeId = oni::readUInt32(data + 8);
+    header.fieldsSize = oni::readUInt32(data + 12);
+    header.payloadSize = oni::readUInt32(data + 16);
+    header.undoRecordPos = oni::readUInt64(data + 20);
+
+    if (header.magic != oni::kRecordMagic || header.fieldsSize < quint32(oni::kRecordHeaderSize) ||
+        header.fieldsSize > kMaxRecordSize || header.payloadSize > kMaxRecordSize)
+    {
+        m_errorString = QObject::tr("Damaged record at offset %1").arg(record->position);
+        return false;
+    }
+
+    if (header.recordType == oni::RECORD_END)
+    {
+        return false;
+    }
+
+    record->fields.resize(int(header.fieldsSize) - oni::kRecordHeaderSize);
+    if (!read(record->fields.data(), record->fields.size()))
+    {
+        m_errorString = QObject::tr("Truncated record at offset %1").arg(record->position);
+        return false;
+    }
+
+    if (header.recordType == oni::RECORD_NEW_DATA && record->fields.size() >= 12)
+    {
+        record->timestamp = oni::readUInt64(record->fields.constData());
+        record->frameNumber = oni::readUInt32(record->fields.constData() + 8);
+    }
+    else if ((header.recordType == oni::RECORD_NODE_ADDED || header.recordType == oni::RECORD_NODE_ADDED_1_0_0_5 ||
+              header.recordType == oni::RECORD_NODE_ADDED_1_0_0_4) && record->fields.size() >= 4)
+    {
+        // Fields start with the node name: length including the terminator, then the characters.
+        quint32 nameLength = oni::readUInt32(record->fields.constData());
+        if (nameLength > 0 && nameLength <= quint32(record->fields.size() - 4))
+        {
+            m_nodeNames.insert(header.nodeId, QString::fromLatin1(record->fields.constData() + 4, int(nameLength) - 1));
+
+            // Then node type, codec, frame count, min and max timestamp.
+            int seekTableOffset = 4 + int(nameLength) + 28;
+            if (header.recordType == oni::RECORD_NODE_ADDED && record->fields.size() >= seekTableOffset + 8)
+            {
+                m_seekTablePositions.insert(header.nodeId, qint64(oni::readUInt64(record->fields.constData() + seekTableOffset)));
+            }
+        }
+    }
+
+    bool bOk;
+    if (bReadPayload)
+    {
+        record->payload.resize(int(header.payloadSize));
+        bOk = read(record->payload.data(), record->payload.size());
+    }
+    else
+    {
+        bOk = skip(header.payloadSize);
+    }
+
+    if (!bOk)
+    {
+        m_errorString = QObject::tr("Truncated record at offset %1").arg(record->position);
+    }
+
+    return bOk;
+}
+
+bool OniFileReader::readPayload(const OniRecord& record, QByteArray* payload)
+{
+    qint64 position = m_position;
+
+    m_position = record.position + record.header.fieldsSize;
+    payload->resize(int(record.header.payloadSize));
+    bool bOk = read(payload->data(), payload->size());
+
+    m_position = position;
+    return bOk;
+}
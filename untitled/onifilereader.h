@@ -0,0 +1,75 @@
+#ifndef ONIFILEREADER_H
+#define ONIFILEREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include "onirecord.h"
+
+// One record of an .oni file. fields holds the bytes between the header and
+// the payload; payload is only filled when it was requested.
+struct OniRecord
+{
+    qint64 position = 0;
+    oni::RecordHeader header;
+    QByteArray fields;
+    QByteArray payload;
+
+    // Valid for RECORD_NEW_DATA only.
+    quint64 timestamp = 0;
+    quint32 frameNumber = 0;
+};
+
+// Sequential reader of the raw record stream of an .oni file, without
+// decoding anything. Payloads can be skipped so a scan only touches headers.
+class OniFileReader
+{
+public:
+    OniFileReader();
+
+    bool open(const QString& fileName);
+
+    void close();
+
+    const oni::FileHeader& fileHeader() const { return m_fileHeader; }
+
+    qint64 size() const { return m_file.size(); }
+
+    qint64 position() const { return m_position; }
+
+    // Reads the next record. Returns false at RECORD_END, end of file or on
+    // a damaged record, see errorString().
+    bool readRecord(OniRecord* record, bool bReadPayload);
+
+    bool seek(qint64 position);
+
+    // Reads the payload of a record that was read without it.
+    bool readPayload(const OniRecord& record, QByteArray* payload);
+
+    // Node names collected from the node-added records read so far.
+    QString nodeName(quint32 nodeId) const { return m_nodeNames.value(nodeId); }
+
+    // Seek table record positions per node, as announced by the node-added
+    // records read so far. Zero means the recorder did not write one.
+    QHash<quint32, qint64> seekTablePositions() const { return m_seekTablePositions; }
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    bool read(char* data, qint64 size);
+
+    bool skip(qint64 size);
+
+    QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_bufferStart = 0;
+    qint64 m_position = 0;
+
+    oni::FileHeader m_fileHeader;
+    QHash<quint32, QString> m_nodeNames;
+    QHash<quint32, qint64> m_seekTablePositions;
+    QString m_errorString;
+};
+
+#endif // ONIFILEREADER_H
@@ -0,0 +1,110 @@
+#include "onifilewriter.h"
+
+namespace
+{
+    const int kWriteBufferSize = 4 * 1024 * 1024;
+}
+
+OniFileWriter::OniFileWriter()
+{
+}
+
+OniFileWriter::~OniFileWriter()
+{
+    close();
+}
+
+bool OniFileWriter::open(const QString& fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+    {
+        return false;
+    }
+
+    m_buffer.clear();
+    m_buffer.reserve(kWriteBufferSize);
+    m_position = 0;
+
+    return true;
+}
+
+bool OniFileWriter::close()
+{
+    if (!m_file.isOpen())
+    {
+        return true;
+    }
+
+    bool bOk = flush();
+    m_file.close();
+
+    return bOk;
+}
+
+bool OniFileWriter::flush()
+{
+    if (m_buffer.isEmpty())
+    {
+        return true;
+    }
+
+    bool bOk = m_file.write(m_buffer) == m_buffer.size();
+    m_buffer.clear();
+
+    return bOk;
+}
+
+bool OniFileWriter::write(const char* data, qint64 size)
+{
+    m_position += size;
+
+    if (m_buffer.size() + size > kWriteBufferSize)
+    {
+        if (!flush())
+        {
+            return false;
+        }
+
+        // Big payloads go straight to the file.
+        if (size >= kWriteBufferSize)
+        {
+            return m_file.write(data, size) == size;
+        }
+    }
+
+    m_buffer.append(data, int(size));
+
+    return true;
+}
+
+qint64 OniFileWriter::writeRecord(oni::RecordHeader header, const QByteArray& fields, const QByteArray& payload)
+{
+    qint64 position = m_position;
+
+    header.fieldsSize = quint32(oni::kRecordHeaderSize + fields.size());
+    header.payloadSize = quint32(payload.size());
+
+    char data[oni::kRecordHeaderSize];
+    oni::packRecordHeader(header, data);
+
+    if (!write(data, sizeof(data)) || !write(fields.constData(), fields.size()) || !write(payload.constData(), payload.size()))
+    {
+        return -1;
+    }
+
+    return position;
+}
+
+bool OniFileWriter::patch(qint64 position, const char* data, int size)
+{
+    if (!flush())
+    {
+        return false;
+    }
+
+    qint64 end = m_file.pos();
+    bool bOk = m_file.seek(position) && m_file.write(data, size) == size;
+
+    return m_file.seek(end) && bOk;
+}
@@ -0,0 +1,42 @@
+#ifndef ONIFILEWRITER_H
+#define ONIFILEWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include "onirecord.h"
+
+// Buffered writer for the raw record stream of an .oni file. Records are
+// written as given, already encoded; earlier bytes can be patched in place
+// once totals such as frame counts are known.
+class OniFileWriter
+{
+public:
+    OniFileWriter();
+    ~OniFileWriter();
+
+    bool open(const QString& fileName);
+
+    bool close();
+
+    qint64 position() const { return m_position; }
+
+    bool write(const char* data, qint64 size);
+
+    // Writes header, fields and payload; fieldsSize and payloadSize are
+    // taken from the byte arrays. Returns the record position or -1.
+    qint64 writeRecord(oni::RecordHeader header, const QByteArray& fields, const QByteArray& payload);
+
+    bool patch(qint64 position, const char* data, int size);
+
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    bool flush();
+
+    QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_position = 0;
+};
+
+#endif // ONIFILEWRITER_H
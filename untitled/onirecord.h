@@ -0,0 +1,117 @@
+#ifndef ONIRECORD_H
+#define ONIRECORD_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// On-disk layout of .oni recordings as written by the OniFile driver.
+// A file starts with OniFileHeader followed by a flat sequence of records.
+// Every record starts with OniRecordHeader; fieldsSize counts the header and
+// the typed fields after it, payloadSize the raw data that follows them.
+// All values are little endian and the structures are packed.
+
+namespace oni
+{
+    const char kFileIdentity[4] = {'N', 'I', '1', '0'};
+    const quint32 kRecordMagic = 0x0052494E; // "NIR\0"
+
+    const int kFileHeaderSize = 24;
+    const int kRecordHeaderSize = 28;
+
+    enum RecordType
+    {
+        RECORD_NODE_ADDED_1_0_0_4 = 0x02,
+        RECORD_INT_PROPERTY = 0x03,
+        RECORD_REAL_PROPERTY = 0x04,
+        RECORD_STRING_PROPERTY = 0x05,
+        RECORD_GENERAL_PROPERTY = 0x06,
+        RECORD_NODE_REMOVED = 0x07,
+        RECORD_NODE_DATA_BEGIN = 0x08,
+        RECORD_NODE_STATE_READY = 0x09,
+        RECORD_NEW_DATA = 0x0A,
+        RECORD_END = 0x0B,
+        RECORD_NODE_ADDED_1_0_0_5 = 0x0C,
+        RECORD_NODE_ADDED = 0x0D,
+        RECORD_SEEK_TABLE = 0x0E
+    };
+
+    struct FileHeader
+    {
+        char identity[4];
+        quint8 versionMajor;
+        quint8 versionMinor;
+        quint16 versionMaintenance;
+        quint32 versionBuild;
+        quint64 maxTimestamp;
+        quint32 maxNodeId;
+    };
+
+    struct RecordHeader
+    {
+        quint32 magic;
+        quint32 recordType;
+        quint32 nodeId;
+        quint32 fieldsSize;
+        quint32 payloadSize;
+        quint64 undoRecordPos;
+    };
+
+    // Seek table payload entry, one per frame of a node.
+    struct SeekTableEntry
+    {
+        quint64 timestamp;
+        quint32 configurationId;
+        quint64 seekPos;
+    };
+    const int kSeekTableEntrySize = 20;
+
+    inline quint32 readUInt32(const char* data)
+    {
+        const uchar* p = reinterpret_cast<const uchar*>(data);
+        return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+    }
+
+    inline quint64 readUInt64(const char* data)
+    {
+        return quint64(readUInt32(data)) | (quint64(readUInt32(data + 4)) << 32);
+    }
+
+    inline void writeUInt32(char* data, quint32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            data[i] = char((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    inline void writeUInt64(char* data, quint64 value)
+    {
+        writeUInt32(data, quint32(value));
+        writeUInt32(data + 4, quint32(value >> 32));
+    }
+
+    inline void packRecordHeader(const RecordHeader& header, char* data)
+    {
+        writeUInt32(data, header.magic);
+        writeUInt32(data + 4, header.recordType);
+        writeUInt32(data + 8, header.nodeId);
+        writeUInt32(data + 12, header.fieldsSize);
+        writeUInt32(data + 16, header.payloadSize);
+        writeUInt64(data + 20, header.undoRecordPos);
+    }
+
+    // Node types and codec of the node-added records written by RecordingWriter.
+    const quint32 kNodeTypeDepth = 2;
+    const quint32 kNodeTypeImage = 3;
+    const quint32 kNodeTypeIR = 5;
+    const quint32 kCodecUncompressed = 0x454E4F4E; // "NONE"
+
+    // Byte offsets inside the fields of the records the copy tools rewrite.
+    const int kNewDataTimestampOffset = 0;
+    const int kNewDataFrameOffset = 8;
+    const int kDataBeginFramesOffset = 0;
+    const int kDataBeginMaxTimestampOffset = 4;
+    const int kFileHeaderMaxTimestampOffset = 12;
+}
+
+#endif // ONIRECORD_H
@@ -0,0 +1,593 @@
+#include "onistreamcopy.h"
+#include "onifilereader.h"
+#include "onifilewriter.h"
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    struct DataRecordInfo
+    {
+        qint64 position;
+        quint32 nodeId;
+        quint64 timestamp;
+        quint32 frame;
+    };
+
+    struct NodeInfo
+    {
+        QString name;
+        quint32 recordType = 0;
+        qint64 addedPosition = -1;
+        QByteArray addedFields;
+        qint64 dataBeginPosition = -1;
+        int dataBeginFieldsSize = 0;
+
+        bool bHasSeekTable = false;
+        QByteArray seekTableFields;
+        QVector<quint32> configurationIds;
+        bool bSeekTableDummy = false;
+
+        // Stream layout properties, compared before concatenating.
+        QMap<QString, QByteArray> layoutProperties;
+
+        int frames = 0;
+    };
+
+    struct ClipIndex
+    {
+        QByteArray fileHeader;
+        qint64 headerEnd = 0;
+        QMap<quint32, NodeInfo> nodes;
+        std::vector<DataRecordInfo> data;
+        std::vector<OniRecord> tailRecords;
+    };
+
+    bool isNodeAdded(quint32 recordType)
+    {
+        return recordType == oni::RECORD_NODE_ADDED || recordType == oni::RECORD_NODE_ADDED_1_0_0_5 ||
+               recordType == oni::RECORD_NODE_ADDED_1_0_0_4;
+    }
+
+    bool isProperty(quint32 recordType)
+    {
+        return recordType == oni::RECORD_INT_PROPERTY || recordType == oni::RECORD_REAL_PROPERTY ||
+               recordType == oni::RECORD_STRING_PROPERTY || recordType == oni::RECORD_GENERAL_PROPERTY;
+    }
+
+    // Length-prefixed string at the start of record fields, or empty.
+    QString leadingString(const QByteArray& fields, int* pEnd)
+    {
+        *pEnd = 0;
+        if (fields.size() < 4)
+        {
+            return QString();
+        }
+
+        quint32 length = oni::readUInt32(fields.constData());
+        if (length == 0 || length > quint32(fields.size() - 4))
+        {
+            return QString();
+        }
+
+        *pEnd = 4 + int(length);
+        return QString::fromLatin1(fields.constData() + 4, int(length) - 1);
+    }
+
+    bool isLayoutProperty(const QString& name)
+    {
+        static const char* const keys[] = {"VideoMode", "Codec", "PixelFormat", "Resolution", "Cropping", "Mirror"};
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+        {
+            if (name.contains(QString::fromLatin1(keys[i]), Qt::CaseInsensitive))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool indexClip(const QString& fileName, ClipIndex* pIndex, QString* pError)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            *pError = QObject::tr("%1: %2").arg(fileName).arg(file.errorString());
+            return false;
+        }
+        pIndex->fileHeader = file.read(oni::kFileHeaderSize);
+        file.close();
+
+        OniFileReader reader;
+        if (!reader.open(fileName))
+        {
+            *pError = QObject::tr("%1: %2").arg(fileName).arg(reader.errorString());
+            return false;
+        }
+
+        OniRecord record;
+        while (reader.readRecord(&record, false))
+        {
+            quint32 type = record.header.recordType;
+            NodeInfo& node = pIndex->nodes[record.header.nodeId];
+
+            if (type == oni::RECORD_NEW_DATA)
+            {
+                if (pIndex->headerEnd == 0)
+                {
+                    pIndex->headerEnd = record.position;
+                }
+                DataRecordInfo info = { record.position, record.header.nodeId, record.timestamp, record.frameNumber };
+                pIndex->data.push_back(info);
+                ++node.frames;
+            }
+            else if (type == oni::RECORD_SEEK_TABLE)
+            {
+                QByteArray payload;
+                if (reader.readPayload(record, &payload))
+                {
+                    node.bHasSeekTable = true;
+                    node.seekTableFields = record.fields;
+                    int entries = payload.size() / oni::kSeekTableEntrySize;
+                    node.configurationIds.resize(entries);
+                    for (int i = 0; i < entries; ++i)
+                    {
+                        node.configurationIds[i] = oni::readUInt32(payload.constData() + i * oni::kSeekTableEntrySize + 8);
+                    }
+                }
+            }
+            else if (pIndex->headerEnd == 0)
+            {
+                if (isNodeAdded(type))
+                {
+                    int end = 0;
+                    node.name = leadingString(record.fields, &end);
+                    node.recordType = type;
+                    node.addedPosition = record.position;
+                    node.addedFields = record.fields;
+                }
+                else if (type == oni::RECORD_NODE_DATA_BEGIN)
+                {
+                    node.dataBeginPosition = record.position;
+                    node.dataBeginFieldsSize = record.fields.size();
+                }
+                else if (isProperty(type))
+                {
+                    int end = 0;
+                    QString name = leadingString(record.fields, &end);
+                    if (isLayoutProperty(name))
+                    {
+                        QByteArray payload;
+                        reader.readPayload(record, &payload);
+                        node.layoutProperties.insert(name, record.fields.mid(end) + payload);
+                    }
+                }
+            }
+            else if (type == oni::RECORD_NODE_REMOVED)
+            {
+                pIndex->tailRecords.push_back(record);
+            }
+            // Property changes in the middle of the data are not carried over.
+        }
+
+        if (pIndex->data.empty())
+        {
+            *pError = QObject::tr("%1: no frames found. %2").arg(fileName).arg(reader.errorString());
+            return false;
+        }
+
+        for (QMap<quint32, NodeInfo>::iterator it = pIndex->nodes.begin(); it != pIndex->nodes.end(); ++it)
+        {
+            // Seek tables may carry an empty entry for the nonexistent frame 0.
+            it.value().bSeekTableDummy = it.value().configurationIds.size() == it.value().frames + 1;
+        }
+
+        return true;
+    }
+
+    quint32 referenceNode(const ClipIndex& index)
+    {
+        for (QMap<quint32, NodeInfo>::const_iterator it = index.nodes.constBegin(); it != index.nodes.constEnd(); ++it)
+        {
+            if (it.value().frames > 0 && it.value().name.contains("Depth", Qt::CaseInsensitive))
+            {
+                return it.key();
+            }
+        }
+        return index.data.front().nodeId;
+    }
+
+    QString checkCompatible(const ClipIndex& first, const ClipIndex& other, const QString& fileName)
+    {
+        for (QMap<quint32, NodeInfo>::const_iterator it = first.nodes.constBegin(); it != first.nodes.constEnd(); ++it)
+        {
+            if (it.value().frames == 0)
+            {
+                continue;
+            }
+
+            bool bFound = false;
+            for (QMap<quint32, NodeInfo>::const_iterator jt = other.nodes.constBegin(); jt != other.nodes.constEnd(); ++jt)
+            {
+                if (jt.value().name != it.value().name)
+                {
+                    continue;
+                }
+                bFound = true;
+
+                // Node type and codec follow the name in the node-added fields.
+                int end = 0;
+                leadingString(it.value().addedFields, &end);
+                if (it.value().addedFields.mid(end, 8) != jt.value().addedFields.mid(end, 8) ||
+                    it.value().layoutProperties != jt.value().layoutProperties)
+                {
+                    return QObject::tr("%1: stream %2 has different settings").arg(fileName).arg(it.value().name);
+                }
+            }
+
+            if (!bFound)
+            {
+                return QObject::tr("%1: stream %2 is missing").arg(fileName).arg(it.value().name);
+            }
+        }
+
+        return QString();
+    }
+
+    bool copyBytes(QFile& file, qint64 begin, qint64 end, OniFileWriter& writer)
+    {
+        if (!file.seek(begin))
+        {
+            return false;
+        }
+
+        while (begin < end)
+        {
+            QByteArray chunk = file.read(qMin<qint64>(end - begin, 4 * 1024 * 1024));
+            if (chunk.isEmpty() || !writer.write(chunk.constData(), chunk.size()))
+            {
+                return false;
+            }
+            begin += chunk.size();
+        }
+
+        return true;
+    }
+
+    struct OutputNode
+    {
+        quint32 frames = 0;
+        quint64 minTimestamp = 0;
+        quint64 maxTimestamp = 0;
+        qint64 lastDataPosition = 0;
+        QByteArray seekTable;
+    };
+
+    // Pass 2 and the trailer, into the opened writer.
+    bool writeClips(const QVector<OniClip>& clips, const QVector<ClipIndex>& indices,
+                    const QVector<std::vector<size_t> >& selections, size_t totalRecords, OniFileWriter& writer,
+                    QString* pError, const QAtomicInt* pCanceled, QAtomicInt* pProgress)
+    {
+        const ClipIndex& first = indices[0];
+
+        // The file header and everything before the first frame come from the
+        // first clip unchanged, so the positions of those records stay valid.
+        {
+            QFile source(clips[0].fileName);
+            if (!source.open(QIODevice::ReadOnly) || !copyBytes(source, 0, first.headerEnd, writer))
+            {
+                *pError = QObject::tr("Cannot copy the header of %1").arg(clips[0].fileName);
+                return false;
+            }
+        }
+
+        QMap<quint32, OutputNode> outputNodes;
+        quint64 fileMinTimestamp = first.data.front().timestamp;
+        for (size_t i = 0; i < first.data.size(); ++i)
+        {
+            fileMinTimestamp = qMin(fileMinTimestamp, first.data[i].timestamp);
+        }
+
+        quint64 lastTimestamp = 0;
+        size_t copiedRecords = 0;
+
+        // Pass 2: copy the selected frame records.
+        for (int c = 0; c < clips.size(); ++c)
+        {
+            const ClipIndex& index = indices[c];
+            const std::vector<size_t>& selection = selections[c];
+
+            // Same node ids as in the first clip, matched by stream name.
+            QHash<quint32, quint32> nodeMap;
+            for (QMap<quint32, NodeInfo>::const_iterator it = index.nodes.constBegin(); it != index.nodes.constEnd(); ++it)
+            {
+                for (QMap<quint32, NodeInfo>::const_iterator jt = first.nodes.constBegin(); jt != first.nodes.constEnd(); ++jt)
+                {
+                    if (it.value().name == jt.value().name)
+                    {
+                        nodeMap.insert(it.key(), jt.key());
+                    }
+                }
+            }
+
+            // Median reference period spaces consecutive clips by one frame.
+            quint64 period = 0;
+            {
+                std::vector<quint64> deltas;
+                quint32 reference = referenceNode(index);
+                quint64 previous = 0;
+                for (size_t i = 0; i < selection.size(); ++i)
+                {
+                    const DataRecordInfo& info = index.data[selection[i]];
+                    if (info.nodeId == reference)
+                    {
+                        if (previous != 0 && info.timestamp > previous)
+                        {
+                            deltas.push_back(info.timestamp - previous);
+                        }
+                        previous = info.timestamp;
+                    }
+                }
+                if (!deltas.empty())
+                {
+                    std::nth_element(deltas.begin(), deltas.begin() + deltas.size() / 2, deltas.end());
+                    period = deltas[deltas.size() / 2];
+                }
+            }
+
+            quint64 clipBegin = index.data[selection.front()].timestamp;
+            for (size_t i = 0; i < selection.size(); ++i)
+            {
+                clipBegin = qMin(clipBegin, index.data[selection[i]].timestamp);
+            }
+            quint64 newBegin = (c == 0) ? fileMinTimestamp : lastTimestamp + qMax<quint64>(period, 1);
+
+            OniFileReader reader;
+            if (!reader.open(clips[c].fileName))
+            {
+                *pError = QObject::tr("%1: %2").arg(clips[c].fileName).arg(reader.errorString());
+                return false;
+            }
+
+            OniRecord record;
+            for (size_t i = 0; i < selection.size(); ++i)
+            {
+                if (pCanceled != NULL && pCanceled->load())
+                {
+                    *pError = QObject::tr("Canceled");
+                    return false;
+                }
+
+                const DataRecordInfo& info = index.data[selection[i]];
+                if (!nodeMap.contains(info.nodeId))
+                {
+                    continue;
+                }
+
+                if (!reader.seek(info.position) || !reader.readRecord(&record, true))
+                {
+                    *pError = QObject::tr("%1: %2").arg(clips[c].fileName).arg(reader.errorString());
+                    return false;
+                }
+
+                quint32 nodeId = nodeMap.value(info.nodeId);
+                OutputNode& node = outputNodes[nodeId];
+
+                quint64 timestamp = info.timestamp - clipBegin + newBegin;
+                ++node.frames;
+                if (node.frames == 1)
+                {
+                    node.minTimestamp = timestamp;
+                }
+                node.maxTimestamp = qMax(node.maxTimestamp, timestamp);
+                lastTimestamp = qMax(lastTimestamp, timestamp);
+
+                oni::writeUInt64(record.fields.data() + oni::kNewDataTimestampOffset, timestamp);
+                oni::writeUInt32(record.fields.data() + oni::kNewDataFrameOffset, node.frames);
+
+                // Data records link back to the previous frame of their stream.
+                record.header.nodeId = nodeId;
+                record.header.undoRecordPos = (record.header.undoRecordPos != 0) ? quint64(node.lastDataPosition) : 0;
+
+                qint64 position = writer.writeRecord(record.header, record.fields, record.payload);
+                if (position < 0)
+                {
+                    *pError = writer.errorString();
+                    return false;
+                }
+                node.lastDataPosition = position;
+
+                const NodeInfo& sourceNode = index.nodes.constFind(info.nodeId).value();
+                int entry = int(info.frame) - (sourceNode.bSeekTableDummy ? 0 : 1);
+                quint32 configurationId = (entry >= 0 && entry < sourceNode.configurationIds.size()) ? sourceNode.configurationIds[entry] : 0;
+
+                char entryData[oni::kSeekTableEntrySize];
+                oni::writeUInt64(entryData, timestamp);
+                oni::writeUInt32(entryData + 8, configurationId);
+                oni::writeUInt64(entryData + 12, quint64(position));
+                node.seekTable.append(entryData, sizeof(entryData));
+
+                ++copiedRecords;
+                if (pProgress != NULL)
+                {
+                    pProgress->store(int(copiedRecords * 1000 / qMax<size_t>(1, totalRecords)));
+                }
+            }
+        }
+
+        // Trailer: seek tables, node removals and the end marker.
+        QMap<quint32, qint64> seekTablePositions;
+        for (QMap<quint32, OutputNode>::const_iterator it = outputNodes.constBegin(); it != outputNodes.constEnd(); ++it)
+        {
+            const NodeInfo& sourceNode = first.nodes.constFind(it.key()).value();
+            if (!sourceNode.bHasSeekTable)
+            {
+                continue;
+            }
+
+            QByteArray payload;
+            if (sourceNode.bSeekTableDummy)
+            {
+                payload.fill(0, oni::kSeekTableEntrySize);
+            }
+            payload.append(it.value().seekTable);
+
+            oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_SEEK_TABLE, it.key(), 0, 0, 0 };
+            seekTablePositions.insert(it.key(), writer.writeRecord(header, sourceNode.seekTableFields, payload));
+        }
+
+        for (size_t i = 0; i < first.tailRecords.size(); ++i)
+        {
+            oni::RecordHeader header = first.tailRecords[i].header;
+            header.undoRecordPos = 0;
+            writer.writeRecord(header, first.tailRecords[i].fields, QByteArray());
+        }
+
+        oni::RecordHeader endHeader = { oni::kRecordMagic, oni::RECORD_END, 0, 0, 0, 0 };
+        writer.writeRecord(endHeader, QByteArray(), QByteArray());
+
+        // Patch the totals now that they are known.
+        char data[8];
+        oni::writeUInt64(data, lastTimestamp);
+        bool bOk = writer.patch(oni::kFileHeaderMaxTimestampOffset, data, 8);
+
+        for (QMap<quint32, OutputNode>::const_iterator it = outputNodes.constBegin(); it != outputNodes.constEnd(); ++it)
+        {
+            const NodeInfo& sourceNode = first.nodes.constFind(it.key()).value();
+            const OutputNode& node = it.value();
+
+            if (sourceNode.addedPosition >= 0 && sourceNode.recordType != oni::RECORD_NODE_ADDED_1_0_0_4)
+            {
+                // Name, node type and codec come before the totals.
+                int offset = 0;
+                leadingString(sourceNode.addedFields, &offset);
+                offset += 8;
+
+                qint64 base = sourceNode.addedPosition + oni::kRecordHeaderSize + offset;
+                if (sourceNode.addedFields.size() >= offset + 20)
+                {
+                    oni::writeUInt32(data, node.frames);
+                    bOk = bOk && writer.patch(base, data, 4);
+                    oni::writeUInt64(data, node.minTimestamp);
+                    bOk = bOk && writer.patch(base + 4, data, 8);
+                    oni::writeUInt64(data, node.maxTimestamp);
+                    bOk = bOk && writer.patch(base + 12, data, 8);
+                }
+                if (sourceNode.addedFields.size() >= offset + 28 && sourceNode.recordType == oni::RECORD_NODE_ADDED)
+                {
+                    oni::writeUInt64(data, quint64(seekTablePositions.value(it.key(), 0)));
+                    bOk = bOk && writer.patch(base + 20, data, 8);
+                }
+            }
+
+            if (sourceNode.dataBeginPosition >= 0 && sourceNode.dataBeginFieldsSize >= 12)
+            {
+                qint64 base = sourceNode.dataBeginPosition + oni::kRecordHeaderSize;
+                oni::writeUInt32(data, node.frames);
+                bOk = bOk && writer.patch(base + oni::kDataBeginFramesOffset, data, 4);
+                oni::writeUInt64(data, node.maxTimestamp);
+                bOk = bOk && writer.patch(base + oni::kDataBeginMaxTimestampOffset, data, 8);
+            }
+        }
+
+        if (!writer.close() || !bOk)
+        {
+            *pError = writer.errorString();
+            return false;
+        }
+
+        return true;
+    }
+}
+
+bool copyOniClips(const QVector<OniClip>& clips, const QString& outputFileName, QString* pError,
+                  const QAtomicInt* pCanceled, QAtomicInt* pProgress)
+{
+    if (clips.isEmpty())
+    {
+        *pError = QObject::tr("Nothing to copy");
+        return false;
+    }
+
+    // Pass 1: index record headers of every clip and pick the records in range.
+    QVector<ClipIndex> indices(clips.size());
+    QVector<std::vector<size_t> > selections(clips.size());
+    size_t totalRecords = 0;
+
+    for (int c = 0; c < clips.size(); ++c)
+    {
+        ClipIndex& index = indices[c];
+        if (!indexClip(clips[c].fileName, &index, pError))
+        {
+            return false;
+        }
+
+        if (c > 0)
+        {
+            *pError = checkCompatible(indices[0], index, clips[c].fileName);
+            if (!pError->isEmpty())
+            {
+                return false;
+            }
+        }
+
+        quint32 reference = referenceNode(index);
+        quint64 begin = 0;
+        quint64 end = 0;
+        bool bBegin = false;
+        for (size_t i = 0; i < index.data.size(); ++i)
+        {
+            const DataRecordInfo& info = index.data[i];
+            if (info.nodeId != reference)
+            {
+                continue;
+            }
+            if ((clips[c].firstFrame <= 0 || int(info.frame) >= clips[c].firstFrame) &&
+                (clips[c].lastFrame <= 0 || int(info.frame) <= clips[c].lastFrame))
+            {
+                if (!bBegin)
+                {
+                    begin = info.timestamp;
+                    bBegin = true;
+                }
+                end = qMax(end, info.timestamp);
+            }
+        }
+
+        if (!bBegin)
+        {
+            *pError = QObject::tr("%1: no frames in the selected range").arg(clips[c].fileName);
+            return false;
+        }
+
+        for (size_t i = 0; i < index.data.size(); ++i)
+        {
+            if (index.data[i].timestamp >= begin && index.data[i].timestamp <= end)
+            {
+                selections[c].push_back(i);
+            }
+        }
+        totalRecords += selections[c].size();
+    }
+
+    OniFileWriter writer;
+    if (!writer.open(outputFileName))
+    {
+        *pError = writer.errorString();
+        return false;
+    }
+
+    // A partial file is no recording, leave nothing behind.
+    if (!writeClips(clips, indices, selections, totalRecords, writer, pError, pCanceled, pProgress))
+    {
+        writer.close();
+        QFile::remove(outputFileName);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef ONISTREAMCOPY_H
+#define ONISTREAMCOPY_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+// A frame range of one recording. Frame numbers refer to the reference
+// stream (depth when present); 0 means the start or end of the file.
+struct OniClip
+{
+    QString fileName;
+    int firstFrame = 0;
+    int lastFrame = 0;
+};
+
+// Writes the clips one after another into a new .oni file by copying the
+// encoded frame records as they are: nothing is decoded or re-encoded.
+// Frame numbers, timestamps, seek tables and stream totals are rewritten
+// so the result plays and seeks like an ordinary recording. All clips must
+// have the same streams with the same video modes and codecs. A copy that
+// fails or is canceled removes what it wrote of the output.
+// pProgress, when given, receives the progress in per mille.
+bool copyOniClips(const QVector<OniClip>& clips, const QString& outputFileName, QString* pError,
+                  const QAtomicInt* pCanceled = NULL, QAtomicInt* pProgress = NULL);
+
+#endif // ONISTREAMCOPY_H
@@ -0,0 +1,95 @@
+#include "onivideosource.h"
+#include <QVideoSurfaceFormat>
+#include <string.h>
+
+namespace
+{
+    // The surface keeps the frame on screen until the next one arrives;
+    // with this many frames the one being filled is never shown.
+    const int kRingFrames = 3;
+}
+
+OniVideoSource::OniVideoSource()
+{
+}
+
+OniVideoSource::~OniVideoSource()
+{
+    stop();
+}
+
+void OniVideoSource::setVideoSurface(QAbstractVideoSurface* pSurface)
+{
+    stop();
+    m_pSurface = pSurface;
+}
+
+void OniVideoSource::stop()
+{
+    if (!m_pSurface.isNull() && m_pSurface->isActive())
+    {
+        m_pSurface->stop();
+    }
+    m_frames.clear();
+    m_bytesPerLine = 0;
+    m_nextFrame = 0;
+}
+
+bool OniVideoSource::startSurface(const QSize& size, QVideoFrame::PixelFormat pixelFormat, int bytesPerLine)
+{
+    stop();
+    if (!m_pSurface->start(QVideoSurfaceFormat(size, pixelFormat)))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < kRingFrames; ++i)
+    {
+        m_frames.append(QVideoFrame(bytesPerLine * size.height(), size, bytesPerLine, pixelFormat));
+    }
+    m_bytesPerLine = bytesPerLine;
+
+    return true;
+}
+
+bool OniVideoSource::present(const QImage& image)
+{
+    if (m_pSurface.isNull() || image.isNull())
+    {
+        return false;
+    }
+
+    QImage source = image;
+    QVideoFrame::PixelFormat pixelFormat = QVideoFrame::pixelFormatFromImageFormat(source.format());
+    if (pixelFormat != QVideoFrame::Format_RGB24 && pixelFormat != QVideoFrame::Format_RGB565 &&
+        pixelFormat != QVideoFrame::Format_RGB32)
+    {
+        source = image.convertToFormat(QImage::Format_RGB32);
+        pixelFormat = QVideoFrame::Format_RGB32;
+    }
+
+    int bytesPerLine = source.bytesPerLine();
+    QVideoSurfaceFormat format = m_pSurface->surfaceFormat();
+    if (m_frames.isEmpty() || !m_pSurface->isActive() || format.frameSize() != source.size() ||
+        format.pixelFormat() != pixelFormat || m_bytesPerLine != bytesPerLine)
+    {
+        if (!startSurface(source.size(), pixelFormat, bytesPerLine))
+        {
+            return false;
+        }
+    }
+
+    QVideoFrame& frame = m_frames[m_nextFrame];
+    m_nextFrame = (m_nextFrame + 1) % m_frames.size();
+    if (!frame.map(QAbstractVideoBuffer::WriteOnly))
+    {
+        return false;
+    }
+    for (int y = 0; y < source.height(); ++y)
+    {
+        memcpy(frame.bits() + y * frame.bytesPerLine(), source.constScanLine(y), bytesPerLine);
+    }
+    frame.unmap();
+
+    return m_pSurface->present(frame);
+}
@@ -0,0 +1,40 @@
+#ifndef ONIVIDEOSOURCE_H
+#define ONIVIDEOSOURCE_H
+
+#include <QAbstractVideoSurface>
+#include <QImage>
+#include <QPointer>
+#include <QVector>
+#include <QVideoFrame>
+
+// Presents player images on a QAbstractVideoSurface as QVideoFrames.
+// Images are copied into a small ring of frames that are mapped and
+// reused, so presenting allocates nothing while the size stays the same.
+// The surface is restarted whenever the size or the format changes.
+class OniVideoSource
+{
+public:
+    OniVideoSource();
+    ~OniVideoSource();
+
+    void setVideoSurface(QAbstractVideoSurface* pSurface);
+
+    // image is copied; RGB888, RGB16 and RGB32 images are presented
+    // as they are, other formats are converted to RGB32 first.
+    bool present(const QImage& image);
+
+    void stop();
+
+private:
+    OniVideoSource(const OniVideoSource&);
+    OniVideoSource& operator=(const OniVideoSource&);
+
+    bool startSurface(const QSize& size, QVideoFrame::PixelFormat pixelFormat, int bytesPerLine);
+
+    QPointer<QAbstractVideoSurface> m_pSurface;
+    QVector<QVideoFrame> m_frames;
+    int m_bytesPerLine = 0;
+    int m_nextFrame = 0;
+};
+
+#endif // ONIVIDEOSOURCE_H
@@ -0,0 +1,18 @@
+#include "opennisession.h"
+
+OpenNISession::OpenNISession()
+{
+    m_status = openni::OpenNI::initialize();
+    if (m_status != openni::STATUS_OK)
+    {
+        m_errorString = QString::fromLatin1(openni::OpenNI::getExtendedError());
+    }
+}
+
+OpenNISession::~OpenNISession()
+{
+    if (m_status == openni::STATUS_OK)
+    {
+        openni::OpenNI::shutdown();
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef OPENNISESSION_H
+#define OPENNISESSION_H
+
+#include <QString>
+#include "OpenNI.h"
+
+// Keeps OpenNI initialized, with its drivers loaded, for the lifetime of
+// the object. One session lives as long as the process does, so opening
+// and closing devices never reloads the driver libraries.
+class OpenNISession
+{
+public:
+    OpenNISession();
+    ~OpenNISession();
+
+    bool isOk() const { return m_status == openni::STATUS_OK; }
+
+    openni::Status status() const { return m_status; }
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    OpenNISession(const OpenNISession&);
+    OpenNISession& operator=(const OpenNISession&);
+
+    openni::Status m_status;
+    QString m_errorString;
+};
+
+#endif // OPENNISESSION_H
@@ -0,0 +1,395 @@
+#include "planedetector.h"
+#include "simd.h"
+#include "taskscheduler.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <math.h>
+#include <random>
+
+using openni::DepthPixel;
+
+namespace
+{
+    const double kPi = 3.14159265358979323846;
+
+    struct Plane
+    {
+        float nx;
+        float ny;
+        float nz;
+        float d;
+    };
+
+    int countInliers(const float* xs, const float* ys, const float* zs, int count, const Plane& plane, float threshold)
+    {
+        int i = 0;
+        int inliers = 0;
+
+#ifdef ONI_HAVE_SSE2
+        const __m128 nx = _mm_set1_ps(plane.nx);
+        const __m128 ny = _mm_set1_ps(plane.ny);
+        const __m128 nz = _mm_set1_ps(plane.nz);
+        const __m128 d = _mm_set1_ps(plane.d);
+        const __m128 limit = _mm_set1_ps(threshold);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(xs + i)), _mm_mul_ps(ny, _mm_loadu_ps(ys + i))),
+                                         _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(zs + i)), d));
+            __m128 isInlier = _mm_cmplt_ps(_mm_andnot_ps(signBit, distance), limit);
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(isInlier));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        inliers = _mm_cvtsi128_si32(acc);
+#endif
+
+        for (; i < count; ++i)
+        {
+            if (fabsf(plane.nx * xs[i] + plane.ny * ys[i] + plane.nz * zs[i] + plane.d) < threshold)
+            {
+                ++inliers;
+            }
+        }
+
+        return inliers;
+    }
+
+    // Normalizes and orients the normal towards the camera. Fails on
+    // degenerate input.
+    bool makePlane(float nx, float ny, float nz, float px, float py, float pz, Plane* pPlane)
+    {
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        if (length < 1e-6f)
+        {
+            return false;
+        }
+        nx /= length;
+        ny /= length;
+        nz /= length;
+        float d = -(nx * px + ny * py + nz * pz);
+        if (d < 0)
+        {
+            nx = -nx;
+            ny = -ny;
+            nz = -nz;
+            d = -d;
+        }
+        Plane plane = { nx, ny, nz, d };
+        *pPlane = plane;
+        return true;
+    }
+
+    // Least squares plane through the inliers of plane: the eigenvector of
+    // the smallest eigenvalue of their covariance, by the closed form for
+    // symmetric 3x3 matrices.
+    bool refinePlane(const float* xs, const float* ys, const float* zs, int count, const Plane& plane, float threshold, Plane* pRefined)
+    {
+        double sx = 0, sy = 0, sz = 0;
+        double sxx = 0, syy = 0, szz = 0, sxy = 0, sxz = 0, syz = 0;
+        int n = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (fabsf(plane.nx * xs[i] + plane.ny * ys[i] + plane.nz * zs[i] + plane.d) >= threshold)
+            {
+                continue;
+            }
+            double x = xs[i], y = ys[i], z = zs[i];
+            sx += x; sy += y; sz += z;
+            sxx += x * x; syy += y * y; szz += z * z;
+            sxy += x * y; sxz += x * z; syz += y * z;
+            ++n;
+        }
+        if (n < 3)
+        {
+            return false;
+        }
+
+        double cx = sx / n, cy = sy / n, cz = sz / n;
+        double a00 = sxx / n - cx * cx, a11 = syy / n - cy * cy, a22 = szz / n - cz * cz;
+        double a01 = sxy / n - cx * cy, a02 = sxz / n - cx * cz, a12 = syz / n - cy * cz;
+
+        double q = (a00 + a11 + a22) / 3;
+        double p1 = a01 * a01 + a02 * a02 + a12 * a12;
+        double p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2 * p1;
+        double p = sqrt(p2 / 6);
+        if (p < 1e-12)
+        {
+            return false;
+        }
+
+        double b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p;
+        double b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+        double r = (b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02)) / 2;
+        r = qBound(-1.0, r, 1.0);
+        double smallest = q + 2 * p * cos(acos(r) / 3 + 2 * kPi / 3);
+
+        // Any two rows of (A - smallest * I) span the plane orthogonal to
+        // the eigenvector, take the most stable cross product.
+        double rows[3][3] = { { a00 - smallest, a01, a02 },
+                              { a01, a11 - smallest, a12 },
+                              { a02, a12, a22 - smallest } };
+        double best[3] = { 0, 0, 0 };
+        double bestLength = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            const double* u = rows[i];
+            const double* v = rows[(i + 1) % 3];
+            double c[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+            double length = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+            if (length > bestLength)
+            {
+                bestLength = length;
+                best[0] = c[0];
+                best[1] = c[1];
+                best[2] = c[2];
+            }
+        }
+
+        return makePlane(float(best[0]), float(best[1]), float(best[2]), float(cx), float(cy), float(cz), pRefined);
+    }
+
+    // Iterations after which a better plane than one with inlierRatio
+    // would have been drawn with the given confidence.
+    int requiredIterations(double inlierRatio, double confidence, int maxIterations)
+    {
+        double allInliers = inlierRatio * inlierRatio * inlierRatio;
+        if (allInliers >= 1)
+        {
+            return 1;
+        }
+        if (allInliers <= 0)
+        {
+            return maxIterations;
+        }
+        double iterations = log(1 - confidence) / log(1 - allInliers);
+        return qBound(1, int(ceil(iterations)), maxIterations);
+    }
+}
+
+PlaneDetector::PlaneDetector()
+{
+}
+
+void PlaneDetector::setSettings(const PlaneDetectorSettings& settings)
+{
+    m_settings = settings;
+    reset();
+}
+
+void PlaneDetector::setFieldOfView(float horizontal, float vertical)
+{
+    if (horizontal > 0 && vertical > 0)
+    {
+        m_horizontalFov = horizontal;
+        m_verticalFov = vertical;
+    }
+}
+
+void PlaneDetector::setCrop(int originX, int originY, int fullWidth, int fullHeight)
+{
+    m_cropX = originX;
+    m_cropY = originY;
+    m_fullWidth = fullWidth;
+    m_fullHeight = fullHeight;
+}
+
+void PlaneDetector::projection(int width, int height, float* pFx, float* pFy, float* pCx, float* pCy) const
+{
+    int fullWidth = (m_fullWidth > 0) ? m_fullWidth : width;
+    int fullHeight = (m_fullHeight > 0) ? m_fullHeight : height;
+    int cropX = (m_fullWidth > 0) ? m_cropX : 0;
+    int cropY = (m_fullWidth > 0) ? m_cropY : 0;
+
+    *pFx = (fullWidth / 2.0f) / tanf(m_horizontalFov / 2);
+    *pFy = (fullHeight / 2.0f) / tanf(m_verticalFov / 2);
+    *pCx = fullWidth / 2.0f - cropX;
+    *pCy = fullHeight / 2.0f - cropY;
+}
+
+void PlaneDetector::reset()
+{
+    m_previous = PlaneFit();
+}
+
+PlaneFit PlaneDetector::detect(const DepthPixel* pDepth, int width, int height, int strideBytes)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const PlaneDetectorSettings settings = m_settings;
+    const int step = qMax(1, settings.sampleStep);
+    float fx, fy, cx, cy;
+    projection(width, height, &fx, &fy, &cx, &cy);
+
+    // Camera space with Y up, so a floor has a normal close to the Y axis.
+    m_x.resize(0);
+    m_y.resize(0);
+    m_z.resize(0);
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    for (int y = step / 2; y < height; y += step)
+    {
+        const DepthPixel* row = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+        for (int x = step / 2; x < width; x += step)
+        {
+            float z = row[x];
+            if (z > 0)
+            {
+                m_x.append((x - cx) * z / fx);
+                m_y.append((cy - y) * z / fy);
+                m_z.append(z);
+            }
+        }
+    }
+
+    PlaneFit result;
+    const int count = m_x.size();
+    result.points = count;
+    if (count < 3)
+    {
+        m_previous = result;
+        result.elapsedMs = timer.nsecsElapsed() / 1e6;
+        return result;
+    }
+
+    const float* xs = m_x.constData();
+    const float* ys = m_y.constData();
+    const float* zs = m_z.constData();
+    const float threshold = settings.inlierDistance;
+    const float minUp = (settings.maxTiltDegrees > 0) ? cosf(settings.maxTiltDegrees * float(kPi) / 180) : -1;
+    const int maxIterations = qMax(1, settings.maxIterations);
+
+    QMutex bestMutex;
+    Plane bestPlane = { 0, 1, 0, 0 };
+    int bestInliers = 0;
+    QAtomicInt iterationsStarted;
+    QAtomicInt iterationLimit(maxIterations);
+
+    // A still camera sees the same floor, so last frame's plane usually
+    // settles the question after a handful of draws.
+    if (settings.bWarmStart && m_previous.bFound)
+    {
+        Plane previous = { m_previous.nx, m_previous.ny, m_previous.nz, m_previous.d };
+        bestPlane = previous;
+        bestInliers = countInliers(xs, ys, zs, count, previous, threshold);
+        iterationLimit.store(requiredIterations(double(bestInliers) / count, settings.confidence, maxIterations));
+    }
+
+    int workerCount = TaskScheduler::instance()->workerCount();
+    unsigned seed = ++m_frameCounter * 7919u;
+
+    TaskScheduler::instance()->map(TaskScheduler::Priority_Interactive, workerCount, [&](int worker)
+    {
+        std::mt19937 random(seed + unsigned(worker));
+        std::uniform_int_distribution<int> pick(0, count - 1);
+
+        while (iterationsStarted.fetchAndAddRelaxed(1) < iterationLimit.load())
+        {
+            int a = pick(random);
+            int b = pick(random);
+            int c = pick(random);
+            if (a == b || a == c || b == c)
+            {
+                continue;
+            }
+
+            float ux = xs[b] - xs[a], uy = ys[b] - ys[a], uz = zs[b] - zs[a];
+            float vx = xs[c] - xs[a], vy = ys[c] - ys[a], vz = zs[c] - zs[a];
+            Plane plane;
+            if (!makePlane(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx, xs[a], ys[a], zs[a], &plane))
+            {
+                continue;
+            }
+            if (fabsf(plane.ny) < minUp)
+            {
+                continue;
+            }
+
+            int inliers = countInliers(xs, ys, zs, count, plane, threshold);
+
+            QMutexLocker locker(&bestMutex);
+            if (inliers > bestInliers)
+            {
+                bestInliers = inliers;
+                bestPlane = plane;
+                int limit = requiredIterations(double(inliers) / count, settings.confidence, maxIterations);
+                if (limit < iterationLimit.load())
+                {
+                    iterationLimit.store(limit);
+                }
+            }
+        }
+    });
+
+    result.iterations = qMin(iterationsStarted.load(), iterationLimit.load());
+
+    if (bestInliers >= settings.minInlierRatio * count)
+    {
+        Plane refined;
+        if (refinePlane(xs, ys, zs, count, bestPlane, threshold, &refined) && fabsf(refined.ny) >= minUp)
+        {
+            int refinedInliers = countInliers(xs, ys, zs, count, refined, threshold);
+            if (refinedInliers >= bestInliers)
+            {
+                bestPlane = refined;
+                bestInliers = refinedInliers;
+            }
+        }
+
+        result.bFound = true;
+        result.nx = bestPlane.nx;
+        result.ny = bestPlane.ny;
+        result.nz = bestPlane.nz;
+        result.d = bestPlane.d;
+        result.inliers = bestInliers;
+    }
+
+    m_previous = result;
+    result.elapsedMs = timer.nsecsElapsed() / 1e6;
+    return result;
+}
+
+void PlaneDetector::markInliers(const PlaneFit& plane, const DepthPixel* pDepth, int width, int height,
+                                int strideBytes, quint8* mask) const
+{
+    if (!plane.bFound)
+    {
+        return;
+    }
+
+    float fx, fy, cx, cy;
+    projection(width, height, &fx, &fy, &cx, &cy);
+    const float threshold = m_settings.inlierDistance;
+
+    const uchar* pInput = reinterpret_cast<const uchar*>(pDepth);
+    for (int y = 0; y < height; ++y)
+    {
+        const DepthPixel* row = reinterpret_cast<const DepthPixel*>(pInput + qint64(y) * strideBytes);
+        // Distance is linear in z along a row: z * (a * x + b) + d.
+        float a = plane.nx / fx;
+        float b = plane.ny * (cy - y) / fy - plane.nx * cx / fx + plane.nz;
+        for (int x = 0; x < width; ++x)
+        {
+            float z = row[x];
+            if (z > 0 && fabsf(z * (a * x + b) + plane.d) < threshold)
+            {
+                mask[y * width + x] = 255;
+            }
+        }
+    }
+}
+
+void writePlaneCsvHeader(QTextStream& out)
+{
+    out << "frame,found,nx,ny,nz,d_mm,inliers,points,iterations,ms\n";
+}
+
+void writePlaneCsv(QTextStream& out, int frameIndex, const PlaneFit& plane)
+{
+    out << frameIndex << ',' << (plane.bFound ? 1 : 0) << ','
+        << plane.nx << ',' << plane.ny << ',' << plane.nz << ',' << plane.d << ','
+        << plane.inliers << ',' << plane.points << ',' << plane.iterations << ','
+        << plane.elapsedMs << '\n';
+}
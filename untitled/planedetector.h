@@ -0,0 +1,105 @@
+#ifndef PLANEDETECTOR_H
+#define PLANEDETECTOR_H
+
+#include <QTextStream>
+#include <QVector>
+#include "OpenNI.h"
+
+struct PlaneDetectorSettings
+{
+    // Every sampleStep-th pixel in both directions is used.
+    int sampleStep = 4;
+
+    // Points closer than this to the plane (mm) are inliers.
+    float inlierDistance = 20;
+
+    int maxIterations = 500;
+
+    // Stop once a better plane is this unlikely to exist.
+    double confidence = 0.99;
+
+    // Only accept planes whose normal is within this angle of the camera's
+    // vertical axis, 0 accepts any orientation.
+    float maxTiltDegrees = 50;
+
+    // A plane needs at least this share of the sampled points.
+    double minInlierRatio = 0.1;
+
+    // Start from the previous frame's plane.
+    bool bWarmStart = true;
+};
+
+// Plane in camera space (mm): nx * X + ny * Y + nz * Z + d = 0, with the
+// unit normal oriented towards the camera so that d is its distance.
+struct PlaneFit
+{
+    bool bFound = false;
+    float nx = 0;
+    float ny = 0;
+    float nz = 0;
+    float d = 0;
+    int inliers = 0;
+    int points = 0;
+    int iterations = 0;
+    double elapsedMs = 0;
+};
+
+// Finds the dominant (by default floor-like) plane of depth frames with
+// RANSAC. Depth is projected with the stream's field of view; hypotheses
+// are drawn on all worker threads at once, scored with SSE inlier counts
+// and stopped as soon as the confidence is reached. The best plane is
+// refined with a least squares fit over its inliers.
+class PlaneDetector
+{
+public:
+    PlaneDetector();
+
+    void setSettings(const PlaneDetectorSettings& settings);
+
+    const PlaneDetectorSettings& settings() const { return m_settings; }
+
+    // Radians, as reported by VideoStream.
+    void setFieldOfView(float horizontal, float vertical);
+
+    // Frames are a crop at originX, originY of a fullWidth x fullHeight
+    // sensor image; the projection stays that of the full image. A
+    // fullWidth of 0 means the frames are the full image.
+    void setCrop(int originX, int originY, int fullWidth, int fullHeight);
+
+    // Drops the warm start plane.
+    void reset();
+
+    PlaneFit detect(const openni::DepthPixel* pDepth, int width, int height, int strideBytes);
+
+    // Sets mask bytes of pixels within the inlier distance of plane to 255.
+    void markInliers(const PlaneFit& plane, const openni::DepthPixel* pDepth, int width, int height,
+                     int strideBytes, quint8* mask) const;
+
+private:
+    void projection(int width, int height, float* pFx, float* pFy, float* pCx, float* pCy) const;
+
+    PlaneDetectorSettings m_settings;
+
+    // PS1080 depth defaults until the stream reports its own.
+    float m_horizontalFov = 1.0145f;
+    float m_verticalFov = 0.7898f;
+
+    int m_cropX = 0;
+    int m_cropY = 0;
+    int m_fullWidth = 0;
+    int m_fullHeight = 0;
+
+    PlaneFit m_previous;
+    unsigned m_frameCounter = 0;
+
+    // Sampled points, structure of arrays for SIMD scoring.
+    QVector<float> m_x;
+    QVector<float> m_y;
+    QVector<float> m_z;
+};
+
+void writePlaneCsvHeader(QTextStream& out);
+
+void writePlaneCsv(QTextStream& out, int frameIndex, const PlaneFit& plane);
+
+#endif // PLANEDETECTOR_H
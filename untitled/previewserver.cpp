@@ -0,0 +1,280 @@
+#include "previewserver.h"
+#include "taskscheduler.h"
+#include <QBuffer>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace
+{
+    const int kJpegQuality = 75;
+
+    // Per-client frame interval bounds, about 30 fps down to 1 fps.
+    const int kMinIntervalMs = 33;
+    const int kMaxIntervalMs = 1000;
+
+    // A client with more than this queued is treated as congested.
+    const qint64 kMaxBacklogBytes = 256 * 1024;
+
+    const int kMaxRequestBytes = 8192;
+
+    const char* const kViewNames[] = {"color", "depth"};
+
+    const char kIndexPage[] =
+        "<!DOCTYPE html><html><head><title>ONI preview</title></head>"
+        "<body style=\"background:#222;margin:0\">"
+        "<img src=\"/color.mjpg\" style=\"max-width:50%\">"
+        "<img src=\"/depth.mjpg\" style=\"max-width:50%\">"
+        "</body></html>";
+
+    QByteArray encodeJpeg(const QImage& image)
+    {
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "JPG", kJpegQuality);
+        return jpeg;
+    }
+}
+
+PreviewServer::PreviewServer(QObject* parent) :
+    QObject(parent),
+    m_pServer(new QTcpServer(this))
+{
+    m_clock.start();
+
+    for (int view = 0; view < ViewCount; ++view)
+    {
+        m_pEncodeWatchers[view] = new QFutureWatcher<QByteArray>(this);
+        connect(m_pEncodeWatchers[view], &QFutureWatcher<QByteArray>::finished, this, [this, view]()
+        {
+            onEncoded(view);
+        });
+    }
+
+    connect(m_pServer, &QTcpServer::newConnection, this, &PreviewServer::onNewConnection);
+}
+
+PreviewServer::~PreviewServer()
+{
+    m_pServer->close();
+    for (int view = 0; view < ViewCount; ++view)
+    {
+        m_pEncodeWatchers[view]->waitForFinished();
+    }
+}
+
+bool PreviewServer::listen(quint16 port)
+{
+    // Loopback only, the preview has no authentication.
+    return m_pServer->listen(QHostAddress(QHostAddress::LocalHost), port);
+}
+
+quint16 PreviewServer::serverPort() const
+{
+    return m_pServer->serverPort();
+}
+
+QString PreviewServer::errorString() const
+{
+    return m_pServer->errorString();
+}
+
+PreviewServer::Stats PreviewServer::stats() const
+{
+    Stats stats = { m_clients.size(), m_framesEncoded, m_framesSent, m_framesSkipped };
+    return stats;
+}
+
+bool PreviewServer::isClientDue(const Client& client, qint64 nowMs) const
+{
+    return client.lastSentMs < 0 || nowMs - client.lastSentMs >= client.intervalMs;
+}
+
+void PreviewServer::submitFrame(View view, const QImage& image)
+{
+    qint64 nowMs = m_clock.elapsed();
+    bool bDue = false;
+    for (QHash<QTcpSocket*, Client>::const_iterator it = m_clients.constBegin(); it != m_clients.constEnd(); ++it)
+    {
+        if (it.value().bStreaming && it.value().view == view && isClientDue(it.value(), nowMs))
+        {
+            bDue = true;
+            break;
+        }
+    }
+    if (!bDue || image.isNull())
+    {
+        return;
+    }
+
+    // The image may point into a frame buffer the player is about to reuse.
+    if (m_pEncodeWatchers[view]->isRunning())
+    {
+        m_pending[view] = image.copy();
+        return;
+    }
+
+    startEncode(view, image.copy());
+}
+
+void PreviewServer::startEncode(int view, const QImage& image)
+{
+    m_pEncodeWatchers[view]->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [image]() -> QByteArray
+    {
+        return encodeJpeg(image);
+    }));
+}
+
+void PreviewServer::onEncoded(int view)
+{
+    QByteArray jpeg = m_pEncodeWatchers[view]->result();
+    if (!jpeg.isEmpty())
+    {
+        m_framesEncoded++;
+        m_lastJpeg[view] = jpeg;
+
+        qint64 nowMs = m_clock.elapsed();
+        for (QHash<QTcpSocket*, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+        {
+            Client& client = it.value();
+            if (client.bStreaming && client.view == view && isClientDue(client, nowMs))
+            {
+                sendFrame(it.key(), client, jpeg);
+            }
+        }
+    }
+
+    // Only the newest frame that came in meanwhile is worth encoding.
+    if (!m_pending[view].isNull())
+    {
+        QImage image = m_pending[view];
+        m_pending[view] = QImage();
+        startEncode(view, image);
+    }
+}
+
+void PreviewServer::sendFrame(QTcpSocket* pSocket, Client& client, const QByteArray& jpeg)
+{
+    if (pSocket->bytesToWrite() > kMaxBacklogBytes)
+    {
+        // The client cannot keep up: skip this frame and back off.
+        // Counts as sent, so no frame is encoded for it before the longer
+        // interval is up.
+        client.intervalMs = qMin(kMaxIntervalMs, client.intervalMs * 2);
+        client.lastSentMs = m_clock.elapsed();
+        m_framesSkipped++;
+        return;
+    }
+    if (pSocket->bytesToWrite() == 0)
+    {
+        client.intervalMs = qMax(kMinIntervalMs, client.intervalMs * 3 / 4);
+    }
+
+    QByteArray part = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + QByteArray::number(jpeg.size()) + "\r\n\r\n";
+    pSocket->write(part);
+    pSocket->write(jpeg);
+    pSocket->write("\r\n");
+
+    client.lastSentMs = m_clock.elapsed();
+    m_framesSent++;
+}
+
+void PreviewServer::onNewConnection()
+{
+    while (m_pServer->hasPendingConnections())
+    {
+        QTcpSocket* pSocket = m_pServer->nextPendingConnection();
+        m_clients.insert(pSocket, Client());
+
+        connect(pSocket, &QTcpSocket::readyRead, this, [this, pSocket]()
+        {
+            onReadyRead(pSocket);
+        });
+        connect(pSocket, &QTcpSocket::disconnected, this, [this, pSocket]()
+        {
+            onDisconnected(pSocket);
+        });
+    }
+}
+
+void PreviewServer::onDisconnected(QTcpSocket* pSocket)
+{
+    m_clients.remove(pSocket);
+    pSocket->deleteLater();
+}
+
+void PreviewServer::onReadyRead(QTcpSocket* pSocket)
+{
+    QHash<QTcpSocket*, Client>::iterator it = m_clients.find(pSocket);
+    if (it == m_clients.end())
+    {
+        return;
+    }
+
+    Client& client = it.value();
+    QByteArray data = pSocket->readAll();
+    if (client.bStreaming)
+    {
+        // Nothing more is expected from a streaming client.
+        return;
+    }
+
+    client.request += data;
+    if (client.request.indexOf("\r\n\r\n") >= 0)
+    {
+        respond(pSocket, client);
+    }
+    else if (client.request.size() > kMaxRequestBytes)
+    {
+        pSocket->abort();
+    }
+}
+
+void PreviewServer::respond(QTcpSocket* pSocket, Client& client)
+{
+    // Request line: "GET /path HTTP/1.1".
+    QList<QByteArray> requestLine = client.request.left(client.request.indexOf("\r\n")).split(' ');
+    QByteArray path = requestLine.size() >= 2 ? requestLine[1] : QByteArray();
+    client.request.clear();
+
+    if (requestLine.isEmpty() || requestLine[0] != "GET")
+    {
+        pSocket->write("HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n");
+        pSocket->disconnectFromHost();
+        return;
+    }
+
+    if (path == "/" || path == "/index.html")
+    {
+        QByteArray page(kIndexPage);
+        pSocket->write("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\nContent-Length: " + QByteArray::number(page.size()) +
+                       "\r\nConnection: close\r\n\r\n");
+        pSocket->write(page);
+        pSocket->disconnectFromHost();
+        return;
+    }
+
+    for (int view = 0; view < ViewCount; ++view)
+    {
+        QByteArray name = QByteArray("/") + kViewNames[view];
+        if (path == name + ".mjpg")
+        {
+            pSocket->write("HTTP/1.0 200 OK\r\n"
+                           "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                           "Cache-Control: no-cache\r\n"
+                           "Connection: close\r\n\r\n");
+            client.view = view;
+            client.bStreaming = true;
+            client.intervalMs = kMinIntervalMs;
+            if (!m_lastJpeg[view].isEmpty())
+            {
+                sendFrame(pSocket, client, m_lastJpeg[view]);
+            }
+            return;
+        }
+    }
+
+    pSocket->write("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+    pSocket->disconnectFromHost();
+}
@@ -0,0 +1,97 @@
+#ifndef PREVIEWSERVER_H
+#define PREVIEWSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+
+class QTcpServer;
+class QTcpSocket;
+
+// Serves the rendered views as MJPEG over HTTP on 127.0.0.1, so a replay
+// on a machine nobody looks at can be watched from a browser:
+//   /            page with both views
+//   /color.mjpg  /depth.mjpg  multipart JPEG streams
+// JPEG encoding runs as background work on the scheduler, one frame per
+// view in flight, so it never delays the player's own frames. Every
+// client gets its own frame interval that grows while its socket backs up
+// and shrinks again once it drains, and frames are only encoded when some
+// client is due, so slow viewers cost the player nothing.
+class PreviewServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum View
+    {
+        View_Color,
+        View_Depth,
+        ViewCount
+    };
+
+    struct Stats
+    {
+        int clients;
+        int framesEncoded;
+        int framesSent;
+        int framesSkipped;
+    };
+
+    explicit PreviewServer(QObject* parent = nullptr);
+    ~PreviewServer();
+
+    bool listen(quint16 port);
+
+    quint16 serverPort() const;
+
+    QString errorString() const;
+
+    // Called with every displayed image; returns at once if nobody is due
+    // a frame of this view.
+    void submitFrame(View view, const QImage& image);
+
+    Stats stats() const;
+
+private:
+    struct Client
+    {
+        QByteArray request;
+        int view = -1;
+        bool bStreaming = false;
+        int intervalMs = 0;
+        qint64 lastSentMs = -1;
+    };
+
+    void onNewConnection();
+
+    void onReadyRead(QTcpSocket* pSocket);
+
+    void onDisconnected(QTcpSocket* pSocket);
+
+    void onEncoded(int view);
+
+    void startEncode(int view, const QImage& image);
+
+    void respond(QTcpSocket* pSocket, Client& client);
+
+    void sendFrame(QTcpSocket* pSocket, Client& client, const QByteArray& jpeg);
+
+    bool isClientDue(const Client& client, qint64 nowMs) const;
+
+    QTcpServer* m_pServer;
+    QHash<QTcpSocket*, Client> m_clients;
+
+    QFutureWatcher<QByteArray>* m_pEncodeWatchers[ViewCount];
+    QImage m_pending[ViewCount];
+    QByteArray m_lastJpeg[ViewCount];
+
+    QElapsedTimer m_clock;
+    int m_framesEncoded = 0;
+    int m_framesSent = 0;
+    int m_framesSkipped = 0;
+};
+
+#endif // PREVIEWSERVER_H
@@ -0,0 +1,241 @@
+#include "readaheadprefetcher.h"
+#include "onifilereader.h"
+#include <QFile>
+
+namespace
+{
+    // Read size; large enough for streaming throughput, small enough that
+    // a seek does not wait long for the read in flight.
+    const qint64 kChunkSize = 1 << 20;
+
+    // How often the thread looks at the playhead when nothing wakes it.
+    const unsigned long kIdleWaitMs = 200;
+}
+
+ReadAheadPrefetcher::ReadAheadPrefetcher(const QString& fileName, int numberOfFrames, QObject* parent) :
+    QThread(parent),
+    m_fileName(fileName),
+    m_numberOfFrames(numberOfFrames)
+{
+}
+
+ReadAheadPrefetcher::~ReadAheadPrefetcher()
+{
+    requestInterruption();
+    m_wakeUp.wakeAll();
+    wait();
+}
+
+void ReadAheadPrefetcher::setWindowBytes(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_windowBytes = bytes;
+    m_bPlayheadChanged = true;
+    m_wakeUp.wakeAll();
+}
+
+void ReadAheadPrefetcher::setPlayhead(int frameId, int direction)
+{
+    QMutexLocker locker(&m_mutex);
+    m_playhead = frameId;
+    m_direction = (direction < 0) ? -1 : 1;
+    m_bPlayheadChanged = true;
+    m_wakeUp.wakeAll();
+}
+
+void ReadAheadPrefetcher::addStall()
+{
+    m_stalls.fetchAndAddRelaxed(1);
+}
+
+ReadAheadPrefetcher::Stats ReadAheadPrefetcher::stats() const
+{
+    Stats stats = { m_stalls.load(), m_misses.load(), m_seeks.load(), m_bytesRead.load(), m_bytesAhead.load() };
+    return stats;
+}
+
+qint64 ReadAheadPrefetcher::memoryUsage() const
+{
+    return m_bytesAhead.load();
+}
+
+qint64 ReadAheadPrefetcher::memoryWanted() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_windowBytes;
+}
+
+void ReadAheadPrefetcher::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryLimit = bytes;
+    m_bPlayheadChanged = true;
+    m_wakeUp.wakeAll();
+}
+
+bool ReadAheadPrefetcher::playheadChanged()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bPlayheadChanged;
+}
+
+void ReadAheadPrefetcher::buildIndex()
+{
+    OniFileReader reader;
+    if (!reader.open(m_fileName))
+    {
+        return;
+    }
+    m_fileSize = reader.size();
+
+    // Node-added records, and with them the seek table positions, all come
+    // before the first frame.
+    OniRecord record;
+    while (reader.readRecord(&record, false))
+    {
+        if (record.header.recordType == oni::RECORD_NEW_DATA)
+        {
+            m_dataStart = record.position;
+            break;
+        }
+    }
+
+    QHash<quint32, qint64> tables = reader.seekTablePositions();
+    QVector<qint64> offsets;
+    for (QHash<quint32, qint64>::const_iterator it = tables.constBegin(); it != tables.constEnd(); ++it)
+    {
+        if (it.value() <= 0 || !reader.seek(it.value()) || !reader.readRecord(&record, true) ||
+            record.header.recordType != oni::RECORD_SEEK_TABLE)
+        {
+            continue;
+        }
+
+        // Some recorders put a dummy entry for frame 0 first.
+        int entries = record.payload.size() / oni::kSeekTableEntrySize;
+        int first = (entries == m_numberOfFrames + 1) ? 1 : 0;
+        if (offsets.size() < entries - first)
+        {
+            offsets.resize(entries - first);
+        }
+        for (int i = first; i < entries; ++i)
+        {
+            qint64 position = qint64(oni::readUInt64(record.payload.constData() + i * oni::kSeekTableEntrySize + 12));
+            qint64& offset = offsets[i - first];
+            // Streams are interleaved, a frame starts at its earliest record.
+            if (position > 0 && (offset == 0 || position < offset))
+            {
+                offset = position;
+            }
+        }
+    }
+
+    m_frameOffsets = offsets;
+}
+
+qint64 ReadAheadPrefetcher::frameOffset(int frameId) const
+{
+    if (frameId >= 1 && frameId <= m_frameOffsets.size() && m_frameOffsets[frameId - 1] > 0)
+    {
+        return m_frameOffsets[frameId - 1];
+    }
+
+    // No seek table, assume frames of similar size.
+    int frames = qMax(1, m_numberOfFrames);
+    return m_dataStart + (m_fileSize - m_dataStart) * qBound(0, frameId - 1, frames) / frames;
+}
+
+void ReadAheadPrefetcher::run()
+{
+    buildIndex();
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        return;
+    }
+    m_fileSize = file.size();
+
+    QByteArray buffer(int(kChunkSize), 0);
+
+    // Byte range known to be in the cache, around the playhead.
+    qint64 cachedStart = -1;
+    qint64 cachedEnd = -1;
+
+    while (!isInterruptionRequested())
+    {
+        int playhead;
+        int direction;
+        qint64 windowBytes;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_bPlayheadChanged)
+            {
+                m_wakeUp.wait(&m_mutex, kIdleWaitMs);
+            }
+            playhead = m_playhead;
+            direction = m_direction;
+            windowBytes = qMin(m_windowBytes, m_memoryLimit);
+            m_bPlayheadChanged = false;
+        }
+
+        if (windowBytes <= 0 || isInterruptionRequested())
+        {
+            cachedStart = cachedEnd = -1;
+            m_bytesAhead.store(0);
+            continue;
+        }
+
+        qint64 position = frameOffset(playhead);
+        if (position < cachedStart || position > cachedEnd)
+        {
+            if (cachedStart >= 0)
+            {
+                // Just past the window means reading fell behind, anything
+                // further is a jump of the playhead.
+                qint64 distance = (position > cachedEnd) ? position - cachedEnd : cachedStart - position;
+                if (distance < windowBytes)
+                {
+                    m_misses.fetchAndAddRelaxed(1);
+                }
+                else
+                {
+                    m_seeks.fetchAndAddRelaxed(1);
+                }
+            }
+            cachedStart = cachedEnd = position;
+        }
+
+        if (direction > 0)
+        {
+            cachedStart = position;
+            qint64 target = qMin(m_fileSize, position + windowBytes);
+            while (cachedEnd < target && !isInterruptionRequested() && !playheadChanged())
+            {
+                qint64 size = qMin(kChunkSize, target - cachedEnd);
+                if (!file.seek(cachedEnd) || file.read(buffer.data(), size) <= 0)
+                {
+                    break;
+                }
+                cachedEnd += size;
+                m_bytesRead.fetchAndAddRelaxed(size);
+                m_bytesAhead.store(cachedEnd - position);
+            }
+        }
+        else
+        {
+            cachedEnd = qMax(cachedEnd, position);
+            qint64 target = qMax(m_dataStart, position - windowBytes);
+            while (cachedStart > target && !isInterruptionRequested() && !playheadChanged())
+            {
+                qint64 size = qMin(kChunkSize, cachedStart - target);
+                if (!file.seek(cachedStart - size) || file.read(buffer.data(), size) <= 0)
+                {
+                    break;
+                }
+                cachedStart -= size;
+                m_bytesRead.fetchAndAddRelaxed(size);
+                m_bytesAhead.store(position - cachedStart);
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef READAHEADPREFETCHER_H
+#define READAHEADPREFETCHER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+#include "memorygovernor.h"
+
+// Keeps the part of a recording just ahead of the playhead in the OS file
+// cache, so the synchronous reads the OniFile driver does in readFrame()
+// hit memory instead of a cold disk or network mount. Frame offsets come
+// from the seek tables of the recording and are interpolated when it has
+// none. The window is read through a separate unbuffered handle, in the
+// direction of playback, and starts over wherever the playhead jumps to.
+// Under memory pressure the window shrinks to the governor's limit.
+class ReadAheadPrefetcher : public QThread, public MemoryOwner
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        // Frame reads that took longer than the frame interval.
+        int stalls;
+        // Playhead ran past the prefetched window.
+        int misses;
+        // Playhead jumped and the window was started over.
+        int seeks;
+        qint64 bytesRead;
+        qint64 bytesAhead;
+    };
+
+    ReadAheadPrefetcher(const QString& fileName, int numberOfFrames, QObject* parent = nullptr);
+    ~ReadAheadPrefetcher();
+
+    // 0 stops reading ahead but keeps counting stalls.
+    void setWindowBytes(qint64 bytes);
+
+    // Reports the frame the player just read; direction is 1 when playing
+    // forward and -1 backward.
+    void setPlayhead(int frameId, int direction);
+
+    void addStall();
+
+    Stats stats() const;
+
+    qint64 memoryUsage() const override;
+
+    qint64 memoryWanted() const override;
+
+    void setMemoryLimit(qint64 bytes) override;
+
+protected:
+    void run() override;
+
+private:
+    void buildIndex();
+
+    qint64 frameOffset(int frameId) const;
+
+    bool playheadChanged();
+
+    QString m_fileName;
+    int m_numberOfFrames;
+
+    // Only written by buildIndex() before the loop starts.
+    QVector<qint64> m_frameOffsets;
+    qint64 m_dataStart = 0;
+    qint64 m_fileSize = 0;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    int m_playhead = 1;
+    int m_direction = 1;
+    bool m_bPlayheadChanged = true;
+    qint64 m_windowBytes = 0;
+    qint64 m_memoryLimit = Q_INT64_C(0x7fffffffffffffff);
+
+    QAtomicInt m_stalls;
+    QAtomicInt m_misses;
+    QAtomicInt m_seeks;
+    QAtomicInteger<qint64> m_bytesRead;
+    QAtomicInteger<qint64> m_bytesAhead;
+};
+
+#endif // READAHEADPREFETCHER_H
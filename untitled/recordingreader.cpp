@@ -0,0 +1,247 @@
+#include "recordingreader.h"
+
+namespace
+{
+    // A stream that has run past its last frame never becomes ready again,
+    // so reads are bounded instead of blocking forever.
+    const int kReadTimeoutMs = 2000;
+
+    // Past the frame count only frames the header does not know of are
+    // left, e.g. of a cut-off recording, and those are ready right away.
+    const int kEndReadTimeoutMs = 50;
+}
+
+RecordingReader::RecordingReader()
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+    close();
+}
+
+openni::Status RecordingReader::openStream(openni::SensorType sensorType, openni::VideoStream& stream, bool* pbIsStreamOn)
+{
+    *pbIsStreamOn = false;
+
+    if (m_device.getSensorInfo(sensorType) == NULL)
+    {
+        return openni::STATUS_ERROR;
+    }
+
+    openni::Status nRetVal = stream.create(m_device, sensorType);
+    if (nRetVal != openni::STATUS_OK)
+    {
+        return nRetVal;
+    }
+
+    nRetVal = stream.start();
+    if (nRetVal != openni::STATUS_OK)
+    {
+        stream.destroy();
+        return nRetVal;
+    }
+
+    *pbIsStreamOn = true;
+
+    return openni::STATUS_OK;
+}
+
+openni::Status RecordingReader::open(const QString& fileName)
+{
+    close();
+
+    openni::Status nRetVal = m_device.open(fileName.toStdString().c_str());
+    if (nRetVal != openni::STATUS_OK)
+    {
+        return nRetVal;
+    }
+
+    m_pPlaybackControl = m_device.getPlaybackControl();
+    if (m_pPlaybackControl == NULL)
+    {
+        m_device.close();
+        return openni::STATUS_NOT_SUPPORTED;
+    }
+
+    // Read as fast as requested instead of in real time, and stop at the end.
+    m_pPlaybackControl->setSpeed(-1);
+    m_pPlaybackControl->setRepeatEnabled(false);
+
+    openStream(openni::SENSOR_DEPTH, m_depthStream, &m_bIsDepthOn);
+    openStream(openni::SENSOR_COLOR, m_colorStream, &m_bIsColorOn);
+    openStream(openni::SENSOR_IR, m_irStream, &m_bIsIROn);
+
+    if (!(m_bIsDepthOn || m_bIsColorOn || m_bIsIROn))
+    {
+        m_device.close();
+        m_pPlaybackControl = NULL;
+        return openni::STATUS_ERROR;
+    }
+
+    const openni::SensorType sensors[] = {openni::SENSOR_DEPTH, openni::SENSOR_COLOR, openni::SENSOR_IR};
+    for (int i = 0; i < 3; ++i)
+    {
+        StreamPosition* pPosition = position(sensors[i]);
+        pPosition->frames = getNumberOfFrames(sensors[i]);
+        pPosition->nextFrame = 1;
+    }
+
+    m_bIsOpen = true;
+
+    return openni::STATUS_OK;
+}
+
+void RecordingReader::close()
+{
+    if (!m_bIsOpen)
+    {
+        return;
+    }
+
+    m_depthStream.stop();
+    m_colorStream.stop();
+    m_irStream.stop();
+
+    m_depthStream.destroy();
+    m_colorStream.destroy();
+    m_irStream.destroy();
+
+    m_device.close();
+
+    m_bIsDepthOn = false;
+    m_bIsColorOn = false;
+    m_bIsIROn = false;
+    m_pPlaybackControl = NULL;
+    m_bIsOpen = false;
+}
+
+bool RecordingReader::hasStream(openni::SensorType sensorType) const
+{
+    switch (sensorType)
+    {
+    case openni::SENSOR_DEPTH:
+        return m_bIsDepthOn;
+    case openni::SENSOR_COLOR:
+        return m_bIsColorOn;
+    case openni::SENSOR_IR:
+        return m_bIsIROn;
+    default:
+        return false;
+    }
+}
+
+openni::VideoStream* RecordingReader::stream(openni::SensorType sensorType)
+{
+    if (!hasStream(sensorType))
+    {
+        return NULL;
+    }
+
+    switch (sensorType)
+    {
+    case openni::SENSOR_DEPTH:
+        return &m_depthStream;
+    case openni::SENSOR_COLOR:
+        return &m_colorStream;
+    case openni::SENSOR_IR:
+        return &m_irStream;
+    default:
+        return NULL;
+    }
+}
+
+RecordingReader::StreamPosition* RecordingReader::position(openni::SensorType sensorType)
+{
+    switch (sensorType)
+    {
+    case openni::SENSOR_COLOR:
+        return &m_colorPosition;
+    case openni::SENSOR_IR:
+        return &m_irPosition;
+    default:
+        return &m_depthPosition;
+    }
+}
+
+int RecordingReader::getNumberOfFrames(openni::SensorType sensorType)
+{
+    openni::VideoStream* pStream = stream(sensorType);
+    if (pStream == NULL || m_pPlaybackControl == NULL)
+    {
+        return 0;
+    }
+
+    return m_pPlaybackControl->getNumberOfFrames(*pStream);
+}
+
+int RecordingReader::getFps(openni::SensorType sensorType)
+{
+    openni::VideoStream* pStream = stream(sensorType);
+    if (pStream == NULL)
+    {
+        return 0;
+    }
+
+    return pStream->getVideoMode().getFps();
+}
+
+openni::Status RecordingReader::readFrameAt(openni::SensorType sensorType, int frameId, openni::VideoFrameRef* frame)
+{
+    openni::VideoStream* pStream = stream(sensorType);
+    if (pStream == NULL)
+    {
+        return openni::STATUS_BAD_PARAMETER;
+    }
+
+    openni::Status nRetVal = m_pPlaybackControl->seek(*pStream, frameId);
+    if (nRetVal != openni::STATUS_OK)
+    {
+        return nRetVal;
+    }
+    // The other streams land near the same time, where exactly is unknown;
+    // they keep the long timeout until sought themselves.
+    m_depthPosition.nextFrame = 1;
+    m_colorPosition.nextFrame = 1;
+    m_irPosition.nextFrame = 1;
+    position(sensorType)->nextFrame = frameId;
+
+    return readNextFrame(sensorType, frame);
+}
+
+openni::Status RecordingReader::readNextFrame(openni::SensorType sensorType, openni::VideoFrameRef* frame)
+{
+    openni::VideoStream* pStream = stream(sensorType);
+    if (pStream == NULL)
+    {
+        return openni::STATUS_BAD_PARAMETER;
+    }
+
+    StreamPosition* pPosition = position(sensorType);
+    int timeoutMs = pPosition->nextFrame > pPosition->frames ? kEndReadTimeoutMs : kReadTimeoutMs;
+
+    int changedIndex = -1;
+    openni::Status nRetVal = openni::OpenNI::waitForAnyStream(&pStream, 1, &changedIndex, timeoutMs);
+    if (nRetVal != openni::STATUS_OK)
+    {
+        return nRetVal;
+    }
+
+    nRetVal = pStream->readFrame(frame);
+    if (nRetVal == openni::STATUS_OK)
+    {
+        ++pPosition->nextFrame;
+    }
+
+    return nRetVal;
+}
+
+FrameSequence RecordingReader::frames(openni::SensorType sensorType, int firstFrame, int lastFrame, int stride)
+{
+    return FrameSequence(this, sensorType, firstFrame, lastFrame, stride);
+}
+
+FrameSequence RecordingReader::framesBetween(openni::SensorType sensorType, quint64 firstTimestamp, quint64 lastTimestamp, int stride)
+{
+    return FrameSequence::byTimestamp(this, sensorType, firstTimestamp, lastTimestamp, stride);
+}
@@ -0,0 +1,79 @@
+#ifndef RECORDINGREADER_H
+#define RECORDINGREADER_H
+
+#include <QString>
+#include "OpenNI.h"
+#include "framesequence.h"
+
+// Independent read-only handle on an ONI recording.
+// Owns its own openni::Device so it can be used from a worker thread
+// without touching the streams that MainWindow is displaying.
+// OpenNI must already be initialized by the caller.
+class RecordingReader
+{
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    openni::Status open(const QString& fileName);
+
+    void close();
+
+    bool isOpen() const { return m_bIsOpen; }
+
+    bool hasStream(openni::SensorType sensorType) const;
+
+    openni::VideoStream* stream(openni::SensorType sensorType);
+
+    int getNumberOfFrames(openni::SensorType sensorType);
+
+    int getFps(openni::SensorType sensorType);
+
+    // Seeks all streams to frameId and reads the frame of the requested stream.
+    openni::Status readFrameAt(openni::SensorType sensorType, int frameId, openni::VideoFrameRef* frame);
+
+    // Reads the next frame of the requested stream without seeking. Past
+    // the frame count of the file it gives up after a short wait.
+    openni::Status readNextFrame(openni::SensorType sensorType, openni::VideoFrameRef* frame);
+
+    // Lazy range over the frames of one stream, see FrameSequence.
+    FrameSequence frames(openni::SensorType sensorType, int firstFrame = 1, int lastFrame = 0, int stride = 1);
+
+    FrameSequence framesBetween(openni::SensorType sensorType, quint64 firstTimestamp, quint64 lastTimestamp, int stride = 1);
+
+private:
+    RecordingReader(const RecordingReader&);
+    RecordingReader& operator=(const RecordingReader&);
+
+    // Where a stream stands in the file, so reads at the end need not wait
+    // out the full timeout.
+    struct StreamPosition
+    {
+        int frames = 0;
+        int nextFrame = 1;
+    };
+
+    openni::Status openStream(openni::SensorType sensorType, openni::VideoStream& stream, bool* pbIsStreamOn);
+
+    StreamPosition* position(openni::SensorType sensorType);
+
+    bool m_bIsOpen = false;
+
+    bool m_bIsDepthOn = false;
+    bool m_bIsColorOn = false;
+    bool m_bIsIROn = false;
+
+    openni::Device m_device;
+
+    openni::PlaybackControl* m_pPlaybackControl = NULL;
+
+    openni::VideoStream m_depthStream;
+    openni::VideoStream m_colorStream;
+    openni::VideoStream m_irStream;
+
+    StreamPosition m_depthPosition;
+    StreamPosition m_colorPosition;
+    StreamPosition m_irPosition;
+};
+
+#endif // RECORDINGREADER_H
@@ -0,0 +1,518 @@
+#include "recordingwriter.h"
+#include "onifilewriter.h"
+#include "onirecord.h"
+#include "frameconvert.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <string.h>
+
+namespace
+{
+    const qint64 kDefaultQueueBytes = 256 * 1024 * 1024;
+
+    // How often the totals are patched, bounding what a crash loses.
+    const int kIndexFlushMs = 2000;
+
+    // Spare frame buffers kept for reuse so push() rarely allocates.
+    const int kMaxFreeBuffers = 16;
+
+    void appendUInt32(QByteArray* pFields, quint32 value)
+    {
+        char data[4];
+        oni::writeUInt32(data, value);
+        pFields->append(data, 4);
+    }
+
+    void appendUInt64(QByteArray* pFields, quint64 value)
+    {
+        char data[8];
+        oni::writeUInt64(data, value);
+        pFields->append(data, 8);
+    }
+
+    void appendDouble(QByteArray* pFields, double value)
+    {
+        quint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        appendUInt64(pFields, bits);
+    }
+
+    // Length-prefixed, zero terminated, as the OniFile driver stores names.
+    void appendString(QByteArray* pFields, const char* value)
+    {
+        quint32 length = quint32(strlen(value) + 1);
+        appendUInt32(pFields, length);
+        pFields->append(value, int(length));
+    }
+
+    bool writeIntProperty(OniFileWriter& writer, quint32 nodeId, const char* name, quint64 value)
+    {
+        QByteArray fields;
+        appendString(&fields, name);
+        appendUInt64(&fields, value);
+
+        oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_INT_PROPERTY, nodeId, 0, 0, 0 };
+        return writer.writeRecord(header, fields, QByteArray()) >= 0;
+    }
+
+    bool writeGeneralProperty(OniFileWriter& writer, quint32 nodeId, const char* name, const QByteArray& value)
+    {
+        QByteArray fields;
+        appendString(&fields, name);
+        appendUInt32(&fields, quint32(value.size()));
+        fields.append(value);
+
+        oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_GENERAL_PROPERTY, nodeId, 0, 0, 0 };
+        return writer.writeRecord(header, fields, QByteArray()) >= 0;
+    }
+
+    // OpenNI 1.x pixel format, still read by the OniFile driver for image and IR nodes.
+    quint64 legacyPixelFormat(int pixelFormat)
+    {
+        switch (pixelFormat)
+        {
+        case openni::PIXEL_FORMAT_RGB888:
+            return 1;
+        case openni::PIXEL_FORMAT_YUV422:
+            return 2;
+        case openni::PIXEL_FORMAT_GRAY8:
+            return 3;
+        default:
+            return 4;
+        }
+    }
+}
+
+RecordingWriter::RecordingWriter(const QString& fileName, QObject* parent) :
+    QThread(parent),
+    m_fileName(fileName),
+    m_maxQueuedBytes(kDefaultQueueBytes)
+{
+    Stats stats = { 0, 0, 0, 0 };
+    m_stats = stats;
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    stop();
+}
+
+void RecordingWriter::addStream(openni::SensorType sensorType, openni::VideoStream& stream)
+{
+    openni::VideoMode mode = stream.getVideoMode();
+
+    StreamInfo info;
+    info.sensorType = sensorType;
+    info.nodeId = quint32(m_streams.size() + 1);
+    info.pixelFormat = mode.getPixelFormat();
+    info.width = mode.getResolutionX();
+    info.height = mode.getResolutionY();
+    int cropX, cropY, cropWidth, cropHeight;
+    if (stream.getCropping(&cropX, &cropY, &cropWidth, &cropHeight))
+    {
+        // Cropped on the device, frames arrive at the cropped size.
+        info.width = cropWidth;
+        info.height = cropHeight;
+    }
+    info.fps = mode.getFps();
+    info.bytesPerPixel = bytesPerPixel(mode.getPixelFormat());
+    info.maxDepth = (sensorType == openni::SENSOR_DEPTH) ? stream.getMaxPixelValue() : 0;
+    info.horizontalFov = stream.getHorizontalFieldOfView();
+    info.verticalFov = stream.getVerticalFieldOfView();
+    m_streams.append(info);
+}
+
+void RecordingWriter::setQueueBytes(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxQueuedBytes = bytes;
+}
+
+bool RecordingWriter::push(const openni::VideoFrameRef& frame)
+{
+    if (!frame.isValid())
+    {
+        return false;
+    }
+
+    int stream = -1;
+    for (int i = 0; i < m_streams.size(); ++i)
+    {
+        if (m_streams[i].sensorType == frame.getSensorType())
+        {
+            stream = i;
+        }
+    }
+    if (stream < 0)
+    {
+        return false;
+    }
+
+    const StreamInfo& info = m_streams[stream];
+    int rowBytes = info.width * info.bytesPerPixel;
+    int size = rowBytes * info.height;
+
+    QMutexLocker locker(&m_mutex);
+
+    // A changed video mode would not match the recorded one.
+    if (m_bStopping || m_bFailed || frame.getWidth() != info.width || frame.getHeight() != info.height ||
+        m_queuedBytes + size > qMin(m_maxQueuedBytes, m_memoryLimit))
+    {
+        m_stats.framesDropped++;
+        return false;
+    }
+
+    QueuedFrame entry;
+    entry.stream = stream;
+    entry.timestamp = frame.getTimestamp();
+    if (!m_freeBuffers.isEmpty())
+    {
+        entry.data = m_freeBuffers.takeLast();
+    }
+    entry.data.resize(size);
+
+    // Uncompressed frames are stored without row padding.
+    const char* source = static_cast<const char*>(frame.getData());
+    int stride = frame.getStrideInBytes();
+    if (stride == rowBytes)
+    {
+        memcpy(entry.data.data(), source, size_t(size));
+    }
+    else
+    {
+        for (int y = 0; y < info.height; ++y)
+        {
+            memcpy(entry.data.data() + y * rowBytes, source + y * stride, size_t(rowBytes));
+        }
+    }
+
+    m_queue.append(entry);
+    m_queuedBytes += size;
+    m_condition.wakeOne();
+
+    return true;
+}
+
+void RecordingWriter::stop()
+{
+    finish();
+    wait();
+}
+
+void RecordingWriter::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    m_bStopping = true;
+    m_condition.wakeOne();
+}
+
+RecordingWriter::Stats RecordingWriter::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    Stats stats = m_stats;
+    stats.queuedBytes = m_queuedBytes;
+    return stats;
+}
+
+qint64 RecordingWriter::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = m_queuedBytes;
+    for (int i = 0; i < m_freeBuffers.size(); ++i)
+    {
+        bytes += m_freeBuffers[i].capacity();
+    }
+    return bytes;
+}
+
+qint64 RecordingWriter::memoryWanted() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxQueuedBytes;
+}
+
+void RecordingWriter::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryLimit = bytes;
+}
+
+QString RecordingWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+void RecordingWriter::fail(const QString& error)
+{
+    QMutexLocker locker(&m_mutex);
+    m_bFailed = true;
+    m_errorString = error;
+    m_stats.framesDropped += m_queue.size();
+    m_queue.clear();
+    m_queuedBytes = 0;
+}
+
+bool RecordingWriter::writeHeader(OniFileWriter& writer)
+{
+    char fileHeader[oni::kFileHeaderSize];
+    memset(fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader, oni::kFileIdentity, sizeof(oni::kFileIdentity));
+    fileHeader[4] = 1;
+    fileHeader[6] = 1;
+    oni::writeUInt32(fileHeader + 20, quint32(m_streams.size()));
+    if (!writer.write(fileHeader, sizeof(fileHeader)))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < m_streams.size(); ++i)
+    {
+        StreamInfo& info = m_streams[i];
+
+        const char* name = "Depth";
+        quint32 nodeType = oni::kNodeTypeDepth;
+        if (info.sensorType == openni::SENSOR_COLOR)
+        {
+            name = "Image";
+            nodeType = oni::kNodeTypeImage;
+        }
+        else if (info.sensorType == openni::SENSOR_IR)
+        {
+            name = "IR";
+            nodeType = oni::kNodeTypeIR;
+        }
+
+        // Totals start empty and are patched as frames come in.
+        QByteArray fields;
+        appendString(&fields, name);
+        appendUInt32(&fields, nodeType);
+        appendUInt32(&fields, oni::kCodecUncompressed);
+        info.totalsOffset = oni::kRecordHeaderSize + fields.size();
+        appendUInt32(&fields, 0);
+        appendUInt64(&fields, 0);
+        appendUInt64(&fields, 0);
+        appendUInt64(&fields, 0);
+
+        oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_NODE_ADDED, info.nodeId, 0, 0, 0 };
+        info.addedPosition = writer.writeRecord(header, fields, QByteArray());
+        if (info.addedPosition < 0)
+        {
+            return false;
+        }
+
+        QByteArray outputMode;
+        appendUInt32(&outputMode, quint32(info.width));
+        appendUInt32(&outputMode, quint32(info.height));
+        appendUInt32(&outputMode, quint32(info.fps));
+
+        QByteArray fieldOfView;
+        appendDouble(&fieldOfView, info.horizontalFov);
+        appendDouble(&fieldOfView, info.verticalFov);
+
+        bool bOk = writeIntProperty(writer, info.nodeId, "xnIsGenerating", 1) &&
+                   writeGeneralProperty(writer, info.nodeId, "xnMapOutputMode", outputMode) &&
+                   writeIntProperty(writer, info.nodeId, "oniPixelFormat", quint64(info.pixelFormat)) &&
+                   writeGeneralProperty(writer, info.nodeId, "xnFOV", fieldOfView);
+        if (info.sensorType == openni::SENSOR_DEPTH)
+        {
+            bOk = bOk && writeIntProperty(writer, info.nodeId, "xnDeviceMaxDepth", quint64(info.maxDepth));
+        }
+        else
+        {
+            bOk = bOk && writeIntProperty(writer, info.nodeId, "xnPixelFormat", legacyPixelFormat(info.pixelFormat));
+        }
+        if (!bOk)
+        {
+            return false;
+        }
+
+        oni::RecordHeader readyHeader = { oni::kRecordMagic, oni::RECORD_NODE_STATE_READY, info.nodeId, 0, 0, 0 };
+        if (writer.writeRecord(readyHeader, QByteArray(), QByteArray()) < 0)
+        {
+            return false;
+        }
+
+        QByteArray dataBegin;
+        appendUInt32(&dataBegin, 0);
+        appendUInt64(&dataBegin, 0);
+        oni::RecordHeader dataBeginHeader = { oni::kRecordMagic, oni::RECORD_NODE_DATA_BEGIN, info.nodeId, 0, 0, 0 };
+        info.dataBeginPosition = writer.writeRecord(dataBeginHeader, dataBegin, QByteArray());
+        if (info.dataBeginPosition < 0)
+        {
+            return false;
+        }
+
+        // Seek tables index frames from 1, entry 0 stays empty.
+        info.seekTable.fill(0, oni::kSeekTableEntrySize);
+    }
+
+    return true;
+}
+
+bool RecordingWriter::writeFrame(OniFileWriter& writer, const QueuedFrame& frame)
+{
+    StreamInfo& info = m_streams[frame.stream];
+
+    info.frames++;
+    if (info.frames == 1)
+    {
+        info.minTimestamp = frame.timestamp;
+    }
+    info.maxTimestamp = qMax(info.maxTimestamp, frame.timestamp);
+    m_maxTimestamp = qMax(m_maxTimestamp, frame.timestamp);
+
+    QByteArray fields;
+    appendUInt64(&fields, frame.timestamp);
+    appendUInt32(&fields, quint32(info.frames));
+
+    // Data records link back to the previous frame of their stream.
+    oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_NEW_DATA, info.nodeId, 0, 0, quint64(info.lastDataPosition) };
+    qint64 position = writer.writeRecord(header, fields, frame.data);
+    if (position < 0)
+    {
+        return false;
+    }
+    info.lastDataPosition = position;
+
+    char entry[oni::kSeekTableEntrySize];
+    oni::writeUInt64(entry, frame.timestamp);
+    oni::writeUInt32(entry + 8, 0);
+    oni::writeUInt64(entry + 12, quint64(position));
+    info.seekTable.append(entry, sizeof(entry));
+
+    return true;
+}
+
+bool RecordingWriter::writeTotals(OniFileWriter& writer)
+{
+    char data[8];
+    oni::writeUInt64(data, m_maxTimestamp);
+    bool bOk = writer.patch(oni::kFileHeaderMaxTimestampOffset, data, 8);
+
+    for (int i = 0; i < m_streams.size() && bOk; ++i)
+    {
+        const StreamInfo& info = m_streams[i];
+
+        qint64 base = info.addedPosition + info.totalsOffset;
+        oni::writeUInt32(data, quint32(info.frames));
+        bOk = bOk && writer.patch(base, data, 4);
+        oni::writeUInt64(data, info.minTimestamp);
+        bOk = bOk && writer.patch(base + 4, data, 8);
+        oni::writeUInt64(data, info.maxTimestamp);
+        bOk = bOk && writer.patch(base + 12, data, 8);
+
+        base = info.dataBeginPosition + oni::kRecordHeaderSize;
+        oni::writeUInt32(data, quint32(info.frames));
+        bOk = bOk && writer.patch(base + oni::kDataBeginFramesOffset, data, 4);
+        oni::writeUInt64(data, info.maxTimestamp);
+        bOk = bOk && writer.patch(base + oni::kDataBeginMaxTimestampOffset, data, 8);
+    }
+
+    return bOk;
+}
+
+bool RecordingWriter::writeTrailer(OniFileWriter& writer)
+{
+    for (int i = 0; i < m_streams.size(); ++i)
+    {
+        StreamInfo& info = m_streams[i];
+
+        oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_SEEK_TABLE, info.nodeId, 0, 0, 0 };
+        qint64 position = writer.writeRecord(header, QByteArray(), info.seekTable);
+        if (position < 0)
+        {
+            return false;
+        }
+
+        char data[8];
+        oni::writeUInt64(data, quint64(position));
+        if (!writer.patch(info.addedPosition + info.totalsOffset + 20, data, 8))
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < m_streams.size(); ++i)
+    {
+        oni::RecordHeader header = { oni::kRecordMagic, oni::RECORD_NODE_REMOVED, m_streams[i].nodeId, 0, 0, 0 };
+        if (writer.writeRecord(header, QByteArray(), QByteArray()) < 0)
+        {
+            return false;
+        }
+    }
+
+    oni::RecordHeader endHeader = { oni::kRecordMagic, oni::RECORD_END, 0, 0, 0, 0 };
+    return writer.writeRecord(endHeader, QByteArray(), QByteArray()) >= 0 && writeTotals(writer);
+}
+
+void RecordingWriter::run()
+{
+    OniFileWriter writer;
+    if (!writer.open(m_fileName) || !writeHeader(writer))
+    {
+        fail(writer.errorString());
+        return;
+    }
+
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+
+    QVector<QueuedFrame> batch;
+    for (;;)
+    {
+        bool bStopping = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty() && !m_bStopping)
+            {
+                m_condition.wait(&m_mutex, kIndexFlushMs);
+            }
+            batch.swap(m_queue);
+            bStopping = m_bStopping;
+        }
+
+        qint64 batchBytes = 0;
+        for (int i = 0; i < batch.size(); ++i)
+        {
+            if (!writeFrame(writer, batch[i]))
+            {
+                fail(writer.errorString());
+                return;
+            }
+            batchBytes += batch[i].data.size();
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_queuedBytes -= batchBytes;
+            m_stats.framesWritten += batch.size();
+            m_stats.bytesWritten = writer.position();
+            for (int i = 0; i < batch.size() && m_freeBuffers.size() < kMaxFreeBuffers; ++i)
+            {
+                m_freeBuffers.append(batch[i].data);
+            }
+        }
+
+        if (bStopping && batch.isEmpty())
+        {
+            break;
+        }
+        batch.clear();
+
+        if (flushTimer.elapsed() >= kIndexFlushMs)
+        {
+            if (!writeTotals(writer))
+            {
+                fail(writer.errorString());
+                return;
+            }
+            flushTimer.restart();
+        }
+    }
+
+    if (!writeTrailer(writer) || !writer.close())
+    {
+        fail(writer.errorString());
+    }
+}
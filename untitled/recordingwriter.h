@@ -0,0 +1,126 @@
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include "OpenNI.h"
+#include "memorygovernor.h"
+
+class OniFileWriter;
+
+// Records frames of the open streams into an uncompressed .oni file on a
+// thread of its own. push() copies the frame into a bounded queue and
+// never blocks: when the writer falls behind by more than the queue size
+// the frame is dropped and counted instead. The writer batches records
+// into large sequential writes and every couple of seconds patches the
+// frame totals in the file header, so a crash loses only the last few
+// seconds of frames; the health scan checks how far such a file plays.
+// A memory limit below the queue size shortens the queue, so frames are
+// dropped sooner.
+class RecordingWriter : public QThread, public MemoryOwner
+{
+public:
+    struct Stats
+    {
+        int framesWritten;
+        int framesDropped;
+        qint64 bytesWritten;
+        qint64 queuedBytes;
+    };
+
+    explicit RecordingWriter(const QString& fileName, QObject* parent = nullptr);
+    ~RecordingWriter();
+
+    // Before start(). The stream's current video mode is recorded.
+    void addStream(openni::SensorType sensorType, openni::VideoStream& stream);
+
+    void setQueueBytes(qint64 bytes);
+
+    // Any thread. Returns false when the frame was dropped.
+    bool push(const openni::VideoFrameRef& frame);
+
+    // Writes what is queued, finishes the file and waits for the thread.
+    void stop();
+
+    // Like stop() but returns at once; finished() follows once the file
+    // is complete.
+    void finish();
+
+    Stats stats() const;
+
+    qint64 memoryUsage() const override;
+
+    qint64 memoryWanted() const override;
+
+    void setMemoryLimit(qint64 bytes) override;
+
+    // Empty unless writing failed.
+    QString errorString() const;
+
+protected:
+    void run() override;
+
+private:
+    struct StreamInfo
+    {
+        openni::SensorType sensorType;
+        quint32 nodeId;
+        int pixelFormat;
+        int width;
+        int height;
+        int fps;
+        int bytesPerPixel;
+        int maxDepth;
+        float horizontalFov;
+        float verticalFov;
+
+        // Writer thread only.
+        int frames = 0;
+        quint64 minTimestamp = 0;
+        quint64 maxTimestamp = 0;
+        qint64 addedPosition = -1;
+        int totalsOffset = 0;
+        qint64 dataBeginPosition = -1;
+        qint64 lastDataPosition = 0;
+        QByteArray seekTable;
+    };
+
+    struct QueuedFrame
+    {
+        int stream;
+        quint64 timestamp;
+        QByteArray data;
+    };
+
+    bool writeHeader(OniFileWriter& writer);
+
+    bool writeFrame(OniFileWriter& writer, const QueuedFrame& frame);
+
+    bool writeTotals(OniFileWriter& writer);
+
+    bool writeTrailer(OniFileWriter& writer);
+
+    void fail(const QString& error);
+
+    QString m_fileName;
+    QVector<StreamInfo> m_streams;
+    quint64 m_maxTimestamp = 0;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QVector<QueuedFrame> m_queue;
+    QVector<QByteArray> m_freeBuffers;
+    qint64 m_maxQueuedBytes;
+    qint64 m_memoryLimit = Q_INT64_C(0x7fffffffffffffff);
+    qint64 m_queuedBytes = 0;
+    bool m_bStopping = false;
+    bool m_bFailed = false;
+    Stats m_stats;
+    QString m_errorString;
+};
+
+#endif // RECORDINGWRITER_H
@@ -0,0 +1,220 @@
+#include "reversereader.h"
+#include "recordingreader.h"
+#include <QMutexLocker>
+
+namespace
+{
+    // One seek per chunk, the rest are sequential reads.
+    const int kChunkFrames = 20;
+
+    // How far below the playhead the buffer reaches.
+    const int kBufferFrames = 60;
+
+    const int kIdleWaitMs = 100;
+}
+
+ReverseReader::ReverseReader(const QString& fileName, QObject* parent) :
+    QThread(parent),
+    m_fileName(fileName),
+    m_stalls(0)
+{
+}
+
+ReverseReader::~ReverseReader()
+{
+    requestInterruption();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_wakeUp.wakeOne();
+    }
+    wait();
+}
+
+void ReverseReader::setPlayhead(int frameId)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_frames.contains(frameId - 1))
+    {
+        m_frames.clear();
+    }
+    else
+    {
+        // Frames at and above the playhead were shown already.
+        while (!m_frames.isEmpty() && m_frames.lastKey() >= frameId)
+        {
+            m_frames.remove(m_frames.lastKey());
+        }
+    }
+
+    m_playhead = frameId;
+    m_wakeUp.wakeOne();
+}
+
+qint64 ReverseReader::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frames.size() * m_frameBytes;
+}
+
+qint64 ReverseReader::memoryWanted() const
+{
+    QMutexLocker locker(&m_mutex);
+    return kBufferFrames * m_frameBytes;
+}
+
+void ReverseReader::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryLimit = bytes;
+
+    // The lowest frames are the ones shown last.
+    int maxFrames = maxBufferFrames();
+    while (m_frames.size() > maxFrames)
+    {
+        m_frames.remove(m_frames.firstKey());
+    }
+    m_wakeUp.wakeOne();
+}
+
+int ReverseReader::maxBufferFrames() const
+{
+    if (m_frameBytes <= 0)
+    {
+        return kBufferFrames;
+    }
+
+    // Fewer frames than a chunk would leave nothing to play while the
+    // next one decodes.
+    return int(qBound(qint64(kChunkFrames), m_memoryLimit / m_frameBytes, qint64(kBufferFrames)));
+}
+
+bool ReverseReader::takeFrame(int frameId, BufferedFrames* pFrames, int* pFrameId)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QMap<int, BufferedFrames>::iterator it = m_frames.lowerBound(frameId);
+    if (it == m_frames.end() || it.key() >= m_playhead)
+    {
+        m_stalls.fetchAndAddRelaxed(1);
+        return false;
+    }
+    if (it.key() != frameId)
+    {
+        m_stalls.fetchAndAddRelaxed(1);
+    }
+
+    *pFrames = it.value();
+    *pFrameId = it.key();
+
+    m_playhead = it.key();
+    while (!m_frames.isEmpty() && m_frames.lastKey() >= m_playhead)
+    {
+        m_frames.remove(m_frames.lastKey());
+    }
+
+    m_wakeUp.wakeOne();
+    return true;
+}
+
+void ReverseReader::run()
+{
+    RecordingReader reader;
+    if (reader.open(m_fileName) != openni::STATUS_OK)
+    {
+        return;
+    }
+
+    openni::SensorType reference = openni::SENSOR_DEPTH;
+    if (!reader.hasStream(openni::SENSOR_DEPTH))
+    {
+        reference = reader.hasStream(openni::SENSOR_COLOR) ? openni::SENSOR_COLOR : openni::SENSOR_IR;
+    }
+
+    while (!isInterruptionRequested())
+    {
+        int first = 0;
+        int last = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+
+            // Extend the buffer below its lowest frame.
+            int lowest = m_frames.isEmpty() ? m_playhead : m_frames.firstKey();
+            if (lowest <= 1 || m_playhead - lowest >= maxBufferFrames())
+            {
+                m_wakeUp.wait(&m_mutex, kIdleWaitMs);
+                continue;
+            }
+
+            last = lowest - 1;
+            first = qMax(1, last - kChunkFrames + 1);
+        }
+
+        QMap<int, BufferedFrames> chunk;
+        openni::VideoFrameRef frame;
+        openni::Status nRetVal = reader.readFrameAt(reference, first, &frame);
+        while (nRetVal == openni::STATUS_OK && frame.getFrameIndex() <= last && !isInterruptionRequested())
+        {
+            BufferedFrames& frames = chunk[frame.getFrameIndex()];
+            if (reference == openni::SENSOR_DEPTH)
+            {
+                frames.depth = frame;
+            }
+            else if (reference == openni::SENSOR_COLOR)
+            {
+                frames.color = frame;
+            }
+            else
+            {
+                frames.ir = frame;
+            }
+
+            // The other streams advance in step with the reference.
+            if (reference != openni::SENSOR_COLOR && reader.hasStream(openni::SENSOR_COLOR))
+            {
+                reader.readNextFrame(openni::SENSOR_COLOR, &frames.color);
+            }
+            if (reference != openni::SENSOR_IR && reader.hasStream(openni::SENSOR_IR))
+            {
+                reader.readNextFrame(openni::SENSOR_IR, &frames.ir);
+            }
+
+            if (frame.getFrameIndex() == last)
+            {
+                break;
+            }
+            nRetVal = reader.readNextFrame(reference, &frame);
+        }
+
+        QMutexLocker locker(&m_mutex);
+
+        // Dropped if the playhead jumped away meanwhile.
+        int lowest = m_frames.isEmpty() ? m_playhead : m_frames.firstKey();
+        if (lowest <= first || lowest > last + 1)
+        {
+            continue;
+        }
+
+        for (QMap<int, BufferedFrames>::const_iterator it = chunk.constBegin(); it != chunk.constEnd(); ++it)
+        {
+            if (it.key() < lowest)
+            {
+                m_frames.insert(it.key(), it.value());
+            }
+        }
+
+        if (m_frameBytes == 0 && !chunk.isEmpty())
+        {
+            const BufferedFrames& frames = chunk.first();
+            m_frameBytes = (frames.depth.isValid() ? frames.depth.getDataSize() : 0) +
+                           (frames.color.isValid() ? frames.color.getDataSize() : 0) +
+                           (frames.ir.isValid() ? frames.ir.getDataSize() : 0);
+        }
+
+        if (chunk.isEmpty())
+        {
+            // Nothing decodable below this point, stop extending.
+            m_wakeUp.wait(&m_mutex, kIdleWaitMs);
+        }
+    }
+}
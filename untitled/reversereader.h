@@ -0,0 +1,72 @@
+#ifndef REVERSEREADER_H
+#define REVERSEREADER_H
+
+#include <QAtomicInt>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include "OpenNI.h"
+#include "memorygovernor.h"
+
+// Frames of all streams that belong to one frame of the reference stream.
+struct BufferedFrames
+{
+    openni::VideoFrameRef depth;
+    openni::VideoFrameRef color;
+    openni::VideoFrameRef ir;
+};
+
+// Decodes a recording backward for reverse playback. Seeking the player
+// for every frame is slow, so the recording is read forward in chunks,
+// each starting with one seek, and the chunks are taken from further and
+// further back. The frames are kept in a buffer below the playhead. The
+// reader has its own RecordingReader, so the player streams stay where
+// they are. The reference stream is depth, else color, else IR.
+// A memory limit trims the buffer from its far end, never below one chunk.
+class ReverseReader : public QThread, public MemoryOwner
+{
+public:
+    explicit ReverseReader(const QString& fileName, QObject* parent = nullptr);
+    ~ReverseReader();
+
+    // The frame on screen; frames are buffered below it. A jump out of the
+    // buffer starts it over.
+    void setPlayhead(int frameId);
+
+    // Takes frameId, or the closest buffered frame above it when decoding
+    // has not got that far yet, and makes it the playhead. Never blocks;
+    // returns false if nothing below the playhead is buffered.
+    bool takeFrame(int frameId, BufferedFrames* pFrames, int* pFrameId);
+
+    // Times takeFrame() could not deliver the requested frame.
+    int stalls() const { return m_stalls.load(); }
+
+    qint64 memoryUsage() const override;
+
+    qint64 memoryWanted() const override;
+
+    void setMemoryLimit(qint64 bytes) override;
+
+protected:
+    void run() override;
+
+private:
+    // Called with m_mutex held.
+    int maxBufferFrames() const;
+
+    QString m_fileName;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    int m_playhead = 1;
+    QMap<int, BufferedFrames> m_frames;
+    // Size of one entry of m_frames, known after the first chunk.
+    qint64 m_frameBytes = 0;
+    qint64 m_memoryLimit = Q_INT64_C(0x7fffffffffffffff);
+
+    QAtomicInt m_stalls;
+};
+
+#endif // REVERSEREADER_H
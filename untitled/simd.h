@@ -0,0 +1,24 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is part of the x86-64 baseline, so the MSVC x64 kit always has it.
+// Everything that uses it keeps a plain C++ path for other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ONI_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef ONI_HAVE_SSE2
+
+// Sums the eight 16-bit lanes of a counter register.
+inline int sumCounts16(__m128i counts)
+{
+    __m128i sums = _mm_madd_epi16(counts, _mm_set1_epi16(1));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sums);
+}
+
+#endif // ONI_HAVE_SSE2
+
+#endif // SIMD_H
@@ -0,0 +1,449 @@
+#include "taskscheduler.h"
+
+namespace
+{
+    // Wait times kept per class for the stats.
+    const int kWaitSamples = 64;
+
+    // With fewer workers the reserved ones would leave none for
+    // background work.
+    const int kMinWorkers = 3;
+}
+
+class SchedulerThread : public QThread
+{
+public:
+    SchedulerThread(TaskScheduler* pScheduler, int index) :
+        m_pScheduler(pScheduler),
+        m_index(index)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_pScheduler->workerLoop(m_index);
+    }
+
+private:
+    TaskScheduler* m_pScheduler;
+    int m_index;
+};
+
+Q_GLOBAL_STATIC(TaskScheduler, g_scheduler)
+
+void CancelToken::cancel()
+{
+    if (m_pCanceled->fetchAndStoreOrdered(1) == 0 && g_scheduler.exists() && !g_scheduler.isDestroyed())
+    {
+        g_scheduler->discardCanceled();
+    }
+}
+
+TaskScheduler* TaskScheduler::instance()
+{
+    return g_scheduler;
+}
+
+TaskScheduler::TaskScheduler()
+{
+    int count = qMax(kMinWorkers, QThread::idealThreadCount());
+    m_limits[Priority_Interactive] = count;
+    m_limits[Priority_Prefetch] = count - 1;
+    m_limits[Priority_Background] = count - 2;
+    for (int priority = 0; priority < PriorityCount; ++priority)
+    {
+        m_running[priority] = 0;
+        m_completed[priority] = 0;
+        m_canceled[priority] = 0;
+        m_nextWait[priority] = 0;
+    }
+    m_clock.start();
+
+    // All workers exist before any of them looks at the others.
+    for (int i = 0; i < count; ++i)
+    {
+        Worker* pWorker = new Worker;
+        pWorker->pThread = new SchedulerThread(this, i);
+        m_workers.append(pWorker);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        m_workers[i]->pThread->start(threadPriority(Priority_Interactive));
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_stopping.store(1);
+        m_wakeUp.wakeAll();
+    }
+
+    QList<ScheduledTask*> left;
+    for (int i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->pThread->wait();
+        delete m_workers[i]->pThread;
+        for (int priority = 0; priority < PriorityCount; ++priority)
+        {
+            left += m_workers[i]->queues[priority];
+        }
+        delete m_workers[i];
+    }
+    for (int priority = 0; priority < PriorityCount; ++priority)
+    {
+        left += m_queues[priority];
+    }
+
+    // Nobody will run them, but their futures must finish.
+    for (int i = 0; i < left.size(); ++i)
+    {
+        left[i]->discard();
+        delete left[i];
+    }
+}
+
+QThread::Priority TaskScheduler::threadPriority(Priority priority)
+{
+    switch (priority)
+    {
+    case Priority_Interactive:
+        return QThread::NormalPriority;
+    case Priority_Prefetch:
+        return QThread::LowPriority;
+    default:
+        return QThread::LowestPriority;
+    }
+}
+
+int TaskScheduler::currentWorker() const
+{
+    QThread* pThread = QThread::currentThread();
+    for (int i = 0; i < m_workers.size(); ++i)
+    {
+        if (m_workers[i]->pThread == pThread)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TaskScheduler::schedule(ScheduledTask* pTask)
+{
+    pTask->scheduledNs = m_clock.nsecsElapsed();
+
+    int index = currentWorker();
+    pTask->bChild = (index >= 0);
+    if (pTask->bChild)
+    {
+        QMutexLocker locker(&m_workers[index]->mutex);
+        m_workers[index]->queues[pTask->priority].append(pTask);
+        m_queuedChildren[pTask->priority].ref();
+    }
+    else
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_queues[pTask->priority].append(pTask);
+        m_queued[pTask->priority].ref();
+    }
+
+    QMutexLocker locker(&m_idleMutex);
+    m_wakeUp.wakeOne();
+}
+
+bool TaskScheduler::canStart(Priority priority, bool bChild) const
+{
+    // A class shares its workers with the classes below it.
+    int busy = 0;
+    for (int below = priority; below < PriorityCount; ++below)
+    {
+        busy += m_running[below];
+    }
+    return busy < m_limits[priority] + (bChild ? 1 : 0);
+}
+
+bool TaskScheduler::reserveSlot(Priority priority, bool bChild)
+{
+    QMutexLocker locker(&m_slotMutex);
+    if (!canStart(priority, bChild))
+    {
+        return false;
+    }
+    ++m_running[priority];
+    return true;
+}
+
+void TaskScheduler::releaseSlot(Priority priority)
+{
+    QMutexLocker locker(&m_slotMutex);
+    --m_running[priority];
+}
+
+bool TaskScheduler::hasStartableWork() const
+{
+    QMutexLocker locker(&m_slotMutex);
+    for (int priority = 0; priority < PriorityCount; ++priority)
+    {
+        if ((m_queued[priority].load() > 0 && canStart(Priority(priority), false)) ||
+            (m_queuedChildren[priority].load() > 0 && canStart(Priority(priority), true)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ScheduledTask* TaskScheduler::takeChild(int index, Priority priority)
+{
+    // Newest first from the own queue, it is the likeliest to be waited on.
+    {
+        Worker* pWorker = m_workers[index];
+        QMutexLocker locker(&pWorker->mutex);
+        if (!pWorker->queues[priority].isEmpty())
+        {
+            m_queuedChildren[priority].deref();
+            return pWorker->queues[priority].takeLast();
+        }
+    }
+
+    // Oldest first from the others.
+    for (int i = 1; i < m_workers.size(); ++i)
+    {
+        Worker* pWorker = m_workers[(index + i) % m_workers.size()];
+        QMutexLocker locker(&pWorker->mutex);
+        if (!pWorker->queues[priority].isEmpty())
+        {
+            m_queuedChildren[priority].deref();
+            return pWorker->queues[priority].takeFirst();
+        }
+    }
+
+    return nullptr;
+}
+
+ScheduledTask* TaskScheduler::takeOwn(int index)
+{
+    Worker* pWorker = m_workers[index];
+    QMutexLocker locker(&pWorker->mutex);
+    for (int priority = 0; priority < PriorityCount; ++priority)
+    {
+        if (!pWorker->queues[priority].isEmpty())
+        {
+            m_queuedChildren[priority].deref();
+            return pWorker->queues[priority].takeLast();
+        }
+    }
+    return nullptr;
+}
+
+ScheduledTask* TaskScheduler::takeTask(int index)
+{
+    for (int i = 0; i < PriorityCount; ++i)
+    {
+        Priority priority = Priority(i);
+        if (m_queuedChildren[priority].load() > 0 && reserveSlot(priority, true))
+        {
+            ScheduledTask* pTask = takeChild(index, priority);
+            if (pTask != nullptr)
+            {
+                return pTask;
+            }
+            releaseSlot(priority);
+        }
+
+        if (m_queued[priority].load() > 0 && reserveSlot(priority, false))
+        {
+            QMutexLocker locker(&m_queueMutex);
+            if (!m_queues[priority].isEmpty())
+            {
+                m_queued[priority].deref();
+                return m_queues[priority].takeFirst();
+            }
+            locker.unlock();
+            releaseSlot(priority);
+        }
+    }
+
+    return nullptr;
+}
+
+void TaskScheduler::workerLoop(int index)
+{
+    Priority threadClass = Priority_Interactive;
+    while (m_stopping.load() == 0)
+    {
+        ScheduledTask* pTask = takeTask(index);
+        if (pTask == nullptr)
+        {
+            QMutexLocker locker(&m_idleMutex);
+            if (m_stopping.load() == 0 && !hasStartableWork())
+            {
+                m_wakeUp.wait(&m_idleMutex);
+            }
+            continue;
+        }
+
+        Priority priority = pTask->priority;
+        if (priority != threadClass && !pTask->isCanceled())
+        {
+            QThread::currentThread()->setPriority(threadPriority(priority));
+            threadClass = priority;
+        }
+        runTask(index, pTask);
+
+        finishTask(priority);
+    }
+}
+
+void TaskScheduler::runTask(int index, ScheduledTask* pTask)
+{
+    Priority priority = pTask->priority;
+    bool bRun = !pTask->isCanceled();
+    if (bRun)
+    {
+        // Tasks run in place by waitFor() nest.
+        Priority outer = m_workers[index]->current;
+        m_workers[index]->current = priority;
+        recordWait(priority, (m_clock.nsecsElapsed() - pTask->scheduledNs) / 1e6);
+        pTask->run();
+        m_workers[index]->current = outer;
+    }
+    else
+    {
+        pTask->discard();
+    }
+    delete pTask;
+
+    QMutexLocker locker(&m_statsMutex);
+    if (bRun)
+    {
+        ++m_completed[priority];
+    }
+    else
+    {
+        ++m_canceled[priority];
+    }
+}
+
+void TaskScheduler::finishTask(Priority priority)
+{
+    releaseSlot(priority);
+
+    // The freed slot may be what a capped task waits for.
+    QMutexLocker locker(&m_idleMutex);
+    m_wakeUp.wakeOne();
+}
+
+void TaskScheduler::waitFor(QFuture<void> future)
+{
+    // What the future waits for is in the own queue or running on another
+    // worker, which helps in turn when it waits.
+    int index = currentWorker();
+    while (index >= 0 && !future.isFinished())
+    {
+        ScheduledTask* pTask = takeOwn(index);
+        if (pTask == nullptr)
+        {
+            break;
+        }
+        runTask(index, pTask);
+    }
+    future.waitForFinished();
+}
+
+TaskScheduler::Priority TaskScheduler::partPriority(Priority priority) const
+{
+    int index = currentWorker();
+    return index >= 0 ? m_workers[index]->current : priority;
+}
+
+void TaskScheduler::recordWait(Priority priority, double waitMs)
+{
+    QMutexLocker locker(&m_statsMutex);
+    QVector<double>& waits = m_waits[priority];
+    if (waits.size() < kWaitSamples)
+    {
+        waits.append(waitMs);
+    }
+    else
+    {
+        waits[m_nextWait[priority]] = waitMs;
+        m_nextWait[priority] = (m_nextWait[priority] + 1) % kWaitSamples;
+    }
+}
+
+void TaskScheduler::discardCanceled()
+{
+    QList<ScheduledTask*> canceled;
+    {
+        QMutexLocker locker(&m_queueMutex);
+        for (int priority = 0; priority < PriorityCount; ++priority)
+        {
+            QList<ScheduledTask*>& queue = m_queues[priority];
+            for (int i = queue.size() - 1; i >= 0; --i)
+            {
+                if (queue[i]->isCanceled())
+                {
+                    canceled.append(queue.takeAt(i));
+                    m_queued[priority].deref();
+                }
+            }
+        }
+    }
+    for (int worker = 0; worker < m_workers.size(); ++worker)
+    {
+        QMutexLocker locker(&m_workers[worker]->mutex);
+        for (int priority = 0; priority < PriorityCount; ++priority)
+        {
+            QList<ScheduledTask*>& queue = m_workers[worker]->queues[priority];
+            for (int i = queue.size() - 1; i >= 0; --i)
+            {
+                if (queue[i]->isCanceled())
+                {
+                    canceled.append(queue.takeAt(i));
+                    m_queuedChildren[priority].deref();
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < canceled.size(); ++i)
+    {
+        {
+            QMutexLocker locker(&m_statsMutex);
+            ++m_canceled[canceled[i]->priority];
+        }
+        canceled[i]->discard();
+        delete canceled[i];
+    }
+}
+
+TaskScheduler::Stats TaskScheduler::stats(Priority priority) const
+{
+    Stats stats;
+    stats.queued = m_queued[priority].load() + m_queuedChildren[priority].load();
+    {
+        QMutexLocker locker(&m_slotMutex);
+        stats.running = m_running[priority];
+    }
+
+    QMutexLocker locker(&m_statsMutex);
+    stats.completed = m_completed[priority];
+    stats.canceled = m_canceled[priority];
+    stats.meanWaitMs = 0;
+    stats.maxWaitMs = 0;
+    const QVector<double>& waits = m_waits[priority];
+    for (int i = 0; i < waits.size(); ++i)
+    {
+        stats.meanWaitMs += waits[i];
+        stats.maxWaitMs = qMax(stats.maxWaitMs, waits[i]);
+    }
+    if (!waits.isEmpty())
+    {
+        stats.meanWaitMs /= waits.size();
+    }
+    return stats;
+}
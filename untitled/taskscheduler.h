@@ -0,0 +1,296 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+// Shared flag that stops the work scheduled with it: tasks that have not
+// started are dropped, running ones see it through isCanceled() or flag().
+// Copies share the flag; make a new token after a seek or a close.
+class CancelToken
+{
+public:
+    CancelToken() : m_pCanceled(new QAtomicInt(0)) {}
+
+    // Also drops the waiting tasks of this token from the scheduler queues.
+    void cancel();
+
+    bool isCanceled() const { return m_pCanceled->load() != 0; }
+
+    // For the functions that poll a const QAtomicInt*.
+    const QAtomicInt* flag() const { return m_pCanceled.data(); }
+
+    bool operator==(const CancelToken& other) const { return m_pCanceled == other.m_pCanceled; }
+
+private:
+    QSharedPointer<QAtomicInt> m_pCanceled;
+};
+
+class ScheduledTask;
+class SchedulerThread;
+
+// The worker threads every part of the player shares, instead of one
+// QThreadPool each. Work comes in three classes, taken strictly in order:
+// interactive decoding and rendering, prefetching, and background jobs
+// such as scans and exports. Prefetch never takes the last worker and
+// background work never the last two, so a frame to show always finds a
+// free thread right away however many jobs are queued; background tasks
+// also run at low OS priority. Tasks scheduled from a worker go to that
+// worker's own queue and are taken newest first; idle workers steal the
+// oldest from the others, and may go one worker past the share of their
+// class doing so. A worker waiting through waitFor() runs the tasks of its
+// own queue meanwhile, so jobs that wait on their own tasks cannot stall
+// however deep they nest. Other waits on a worker are only safe one level
+// deep. Results come back through QFuture as with QtConcurrent::run.
+class TaskScheduler
+{
+public:
+    enum Priority
+    {
+        Priority_Interactive,
+        Priority_Prefetch,
+        Priority_Background,
+        PriorityCount
+    };
+
+    struct Stats
+    {
+        int queued;
+        int running;
+        qint64 completed;
+        qint64 canceled;
+        // Between scheduling and start, over the last tasks of the class.
+        double meanWaitMs;
+        double maxWaitMs;
+    };
+
+    static TaskScheduler* instance();
+
+    TaskScheduler();
+    ~TaskScheduler();
+
+    int workerCount() const { return m_workers.size(); }
+
+    template <typename Function>
+    auto run(Priority priority, Function function) -> QFuture<decltype(function())>
+    {
+        return run(priority, CancelToken(), function);
+    }
+
+    template <typename Function>
+    auto run(Priority priority, const CancelToken& token, Function function) -> QFuture<decltype(function())>;
+
+    // Returns once future is finished. Use it instead of waitForFinished()
+    // and result() in tasks.
+    void waitFor(QFuture<void> future);
+
+    // Runs function(0) to function(count - 1) spread over the workers and
+    // returns when all are done. From a worker the parts take the class
+    // of the task running there instead of priority.
+    template <typename Function>
+    void map(Priority priority, int count, Function function);
+
+    Stats stats(Priority priority) const;
+
+    // OS priority for threads of their own that do work of this class.
+    static QThread::Priority threadPriority(Priority priority);
+
+private:
+    friend class CancelToken;
+    friend class SchedulerThread;
+
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+
+    struct Worker
+    {
+        SchedulerThread* pThread = nullptr;
+        QMutex mutex;
+        QList<ScheduledTask*> queues[PriorityCount];
+        // Class of the task running, worker thread only.
+        Priority current = Priority_Interactive;
+    };
+
+    void schedule(ScheduledTask* pTask);
+
+    void workerLoop(int index);
+
+    // Takes a task the worker may start and reserves its slot.
+    ScheduledTask* takeTask(int index);
+
+    ScheduledTask* takeChild(int index, Priority priority);
+
+    // Newest task of the worker's own queue, highest class first; needs
+    // no slot, the worker runs it in place of the task that waits.
+    ScheduledTask* takeOwn(int index);
+
+    // Runs or discards pTask on worker index and deletes it.
+    void runTask(int index, ScheduledTask* pTask);
+
+    Priority partPriority(Priority priority) const;
+
+    // Called with m_slotMutex held.
+    bool canStart(Priority priority, bool bChild) const;
+
+    bool reserveSlot(Priority priority, bool bChild);
+
+    void releaseSlot(Priority priority);
+
+    bool hasStartableWork() const;
+
+    void finishTask(Priority priority);
+
+    void recordWait(Priority priority, double waitMs);
+
+    int currentWorker() const;
+
+    void discardCanceled();
+
+    QVector<Worker*> m_workers;
+    QList<ScheduledTask*> m_queues[PriorityCount];
+    QMutex m_queueMutex;
+
+    // Running tasks per class, and how many workers a class and the ones
+    // below it may keep busy together.
+    mutable QMutex m_slotMutex;
+    int m_running[PriorityCount];
+    int m_limits[PriorityCount];
+
+    // Waiting in m_queues, and in the queues of the workers.
+    QAtomicInt m_queued[PriorityCount];
+    QAtomicInt m_queuedChildren[PriorityCount];
+
+    QMutex m_idleMutex;
+    QWaitCondition m_wakeUp;
+    QAtomicInt m_stopping;
+
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_statsMutex;
+    qint64 m_completed[PriorityCount];
+    qint64 m_canceled[PriorityCount];
+    QVector<double> m_waits[PriorityCount];
+    int m_nextWait[PriorityCount];
+};
+
+// A queued function and the future it reports to.
+class ScheduledTask
+{
+public:
+    virtual ~ScheduledTask() {}
+
+    virtual void run() = 0;
+
+    // Resolves the future as canceled without running the function.
+    virtual void discard() = 0;
+
+    virtual bool isCanceled() const = 0;
+
+    TaskScheduler::Priority priority = TaskScheduler::Priority_Background;
+    // Scheduled from a worker, by the task running there.
+    bool bChild = false;
+    qint64 scheduledNs = 0;
+};
+
+namespace taskscheduler
+{
+    template <typename T>
+    struct Result
+    {
+        template <typename Function>
+        static void run(QFutureInterface<T>* pInterface, Function& function)
+        {
+            pInterface->reportResult(function());
+        }
+    };
+
+    template <>
+    struct Result<void>
+    {
+        template <typename Function>
+        static void run(QFutureInterface<void>* pInterface, Function& function)
+        {
+            Q_UNUSED(pInterface);
+            function();
+        }
+    };
+
+    template <typename T, typename Function>
+    class FunctionTask : public ScheduledTask
+    {
+    public:
+        FunctionTask(const CancelToken& token, const Function& function) :
+            m_token(token),
+            m_function(function)
+        {
+            m_interface.reportStarted();
+        }
+
+        QFuture<T> future() { return m_interface.future(); }
+
+        void run() override
+        {
+            if (!isCanceled())
+            {
+                Result<T>::run(&m_interface, m_function);
+            }
+            m_interface.reportFinished();
+        }
+
+        void discard() override
+        {
+            m_interface.reportCanceled();
+            m_interface.reportFinished();
+        }
+
+        bool isCanceled() const override
+        {
+            return m_token.isCanceled() || m_interface.isCanceled();
+        }
+
+    private:
+        QFutureInterface<T> m_interface;
+        CancelToken m_token;
+        Function m_function;
+    };
+}
+
+template <typename Function>
+auto TaskScheduler::run(Priority priority, const CancelToken& token, Function function) -> QFuture<decltype(function())>
+{
+    typedef decltype(function()) T;
+    taskscheduler::FunctionTask<T, Function>* pTask = new taskscheduler::FunctionTask<T, Function>(token, function);
+    pTask->priority = priority;
+    QFuture<T> future = pTask->future();
+    schedule(pTask);
+    return future;
+}
+
+template <typename Function>
+void TaskScheduler::map(Priority priority, int count, Function function)
+{
+    priority = partPriority(priority);
+    QVector<QFuture<void> > parts;
+    parts.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        parts.append(run(priority, [function, i]()
+        {
+            function(i);
+        }));
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        waitFor(parts[i]);
+    }
+}
+
+#endif // TASKSCHEDULER_H
@@ -0,0 +1,208 @@
+#include "thumbnailstrip.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+namespace
+{
+    const int kCellWidth = 84;
+    const int kImageWidth = 80;
+    const int kImageHeight = 60;
+    const int kSpacing = 2;
+
+    // Depth and color of one index at 32 bits per pixel, for the memory
+    // wanted before the first thumbnail is in.
+    const qint64 kEstimatedThumbnailBytes = 2 * kImageWidth * kImageHeight * 4;
+}
+
+ThumbnailStrip::ThumbnailStrip(QWidget* parent) :
+    QAbstractScrollArea(parent)
+{
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    horizontalScrollBar()->setSingleStep(kCellWidth);
+    setFixedHeight(2 * kImageHeight + 3 * kSpacing + horizontalScrollBar()->sizeHint().height() + 2 * frameWidth());
+}
+
+void ThumbnailStrip::clear()
+{
+    m_depthThumbnails.clear();
+    m_colorThumbnails.clear();
+    m_interval = 1;
+    m_currentFrame = 0;
+    m_bytes = 0;
+    m_thumbnailBytes = 0;
+    updateScrollRange();
+    viewport()->update();
+}
+
+void ThumbnailStrip::setThumbnailCount(int count, int interval)
+{
+    m_depthThumbnails = QVector<QImage>(count);
+    m_colorThumbnails = QVector<QImage>(count);
+    m_bytes = 0;
+    m_interval = qMax(1, interval);
+    updateScrollRange();
+    viewport()->update();
+    emit visibleCenterChanged(visibleCenterIndex());
+    emit memoryWantedChanged();
+}
+
+void ThumbnailStrip::setThumbnail(int index, const QImage& depth, const QImage& color)
+{
+    if (index < 0 || index >= m_depthThumbnails.size())
+    {
+        return;
+    }
+
+    m_bytes -= m_depthThumbnails[index].sizeInBytes() + m_colorThumbnails[index].sizeInBytes();
+    m_depthThumbnails[index] = depth;
+    m_colorThumbnails[index] = color;
+    m_bytes += depth.sizeInBytes() + color.sizeInBytes();
+    if (m_thumbnailBytes == 0)
+    {
+        m_thumbnailBytes = depth.sizeInBytes() + color.sizeInBytes();
+    }
+    evictToLimit();
+
+    int x = index * kCellWidth - horizontalScrollBar()->value();
+    if (x + kCellWidth >= 0 && x < viewport()->width())
+    {
+        viewport()->update(x, 0, kCellWidth, viewport()->height());
+    }
+}
+
+void ThumbnailStrip::setCurrentFrame(int frameId)
+{
+    m_currentFrame = frameId;
+
+    // Keep the playhead in view while playing.
+    int x = (frameId - 1) / m_interval * kCellWidth;
+    QScrollBar* pScrollBar = horizontalScrollBar();
+    if (x < pScrollBar->value() || x + kCellWidth > pScrollBar->value() + viewport()->width())
+    {
+        pScrollBar->setValue(x - viewport()->width() / 2);
+    }
+
+    viewport()->update();
+}
+
+qint64 ThumbnailStrip::memoryWanted() const
+{
+    return m_depthThumbnails.size() * (m_thumbnailBytes > 0 ? m_thumbnailBytes : kEstimatedThumbnailBytes);
+}
+
+void ThumbnailStrip::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimit = bytes;
+    evictToLimit();
+}
+
+void ThumbnailStrip::evictToLimit()
+{
+    // The visible thumbnails stay whatever the limit.
+    int offset = horizontalScrollBar()->value();
+    int firstVisible = offset / kCellWidth;
+    int lastVisible = (offset + viewport()->width()) / kCellWidth;
+
+    int left = 0;
+    int right = m_depthThumbnails.size() - 1;
+    while (m_bytes > m_memoryLimit && (left < firstVisible || right > lastVisible))
+    {
+        // Drop from the side farther from the view first.
+        int index = (firstVisible - left > right - lastVisible) ? left++ : right--;
+        m_bytes -= m_depthThumbnails[index].sizeInBytes() + m_colorThumbnails[index].sizeInBytes();
+        m_depthThumbnails[index] = QImage();
+        m_colorThumbnails[index] = QImage();
+    }
+}
+
+int ThumbnailStrip::visibleCenterIndex() const
+{
+    int center = horizontalScrollBar()->value() + viewport()->width() / 2;
+    return qBound(0, center / kCellWidth, qMax(0, m_depthThumbnails.size() - 1));
+}
+
+void ThumbnailStrip::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(viewport());
+    painter.fillRect(viewport()->rect(), palette().dark());
+
+    int count = m_depthThumbnails.size();
+    int offset = horizontalScrollBar()->value();
+    int first = qMax(0, offset / kCellWidth);
+    int last = qMin(count - 1, (offset + viewport()->width()) / kCellWidth);
+
+    for (int index = first; index <= last; ++index)
+    {
+        int x = index * kCellWidth - offset + kSpacing;
+        QRect depthRect(x, kSpacing, kImageWidth, kImageHeight);
+        QRect colorRect(x, 2 * kSpacing + kImageHeight, kImageWidth, kImageHeight);
+
+        if (m_depthThumbnails[index].isNull())
+        {
+            painter.fillRect(depthRect, palette().mid());
+        }
+        else
+        {
+            painter.drawImage(depthRect, m_depthThumbnails[index]);
+        }
+
+        if (m_colorThumbnails[index].isNull())
+        {
+            painter.fillRect(colorRect, palette().mid());
+        }
+        else
+        {
+            painter.drawImage(colorRect, m_colorThumbnails[index]);
+        }
+    }
+
+    if (m_currentFrame > 0)
+    {
+        // Playhead marker, placed proportionally inside its cell.
+        int x = (m_currentFrame - 1) * kCellWidth / m_interval - offset + kSpacing;
+        painter.setPen(QPen(Qt::red, 2));
+        painter.drawLine(x, 0, x, viewport()->height());
+    }
+}
+
+void ThumbnailStrip::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton)
+    {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+
+    int index = (event->pos().x() + horizontalScrollBar()->value()) / kCellWidth;
+    if (index >= 0 && index < m_depthThumbnails.size())
+    {
+        emit frameRequested(index * m_interval + 1);
+    }
+}
+
+void ThumbnailStrip::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollRange();
+    emit visibleCenterChanged(visibleCenterIndex());
+}
+
+void ThumbnailStrip::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+
+    viewport()->update();
+    emit visibleCenterChanged(visibleCenterIndex());
+}
+
+void ThumbnailStrip::updateScrollRange()
+{
+    int contentWidth = m_depthThumbnails.size() * kCellWidth;
+    horizontalScrollBar()->setRange(0, qMax(0, contentWidth - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
@@ -0,0 +1,72 @@
+#ifndef THUMBNAILSTRIP_H
+#define THUMBNAILSTRIP_H
+
+#include <QAbstractScrollArea>
+#include <QImage>
+#include <QVector>
+#include "memorygovernor.h"
+
+// Horizontally scrolling timeline of depth (top) and color (bottom)
+// thumbnails taken every interval frames. Thumbnails that are not generated
+// yet are drawn as placeholders. Over its memory limit the strip drops the
+// thumbnails farthest from the visible part, those show as placeholders too.
+class ThumbnailStrip : public QAbstractScrollArea, public MemoryOwner
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailStrip(QWidget* parent = nullptr);
+
+    void clear();
+
+    void setCurrentFrame(int frameId);
+
+    int visibleCenterIndex() const;
+
+    qint64 memoryUsage() const override { return m_bytes; }
+
+    qint64 memoryWanted() const override;
+
+    void setMemoryLimit(qint64 bytes) override;
+
+public slots:
+    void setThumbnailCount(int count, int interval);
+
+    void setThumbnail(int index, const QImage& depth, const QImage& color);
+
+signals:
+    void frameRequested(int frameId);
+
+    void visibleCenterChanged(int index);
+
+    // The thumbnail count changed, the memory limit is worth recomputing.
+    void memoryWantedChanged();
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+    void mousePressEvent(QMouseEvent* event) override;
+
+    void resizeEvent(QResizeEvent* event) override;
+
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    void updateScrollRange();
+
+    void evictToLimit();
+
+    QVector<QImage> m_depthThumbnails;
+    QVector<QImage> m_colorThumbnails;
+
+    int m_interval = 1;
+    int m_currentFrame = 0;
+
+    qint64 m_bytes = 0;
+    // Depth and color of one index, known after the first thumbnail and
+    // estimated until then.
+    qint64 m_thumbnailBytes = 0;
+    qint64 m_memoryLimit = Q_INT64_C(0x7fffffffffffffff);
+};
+
+#endif // THUMBNAILSTRIP_H
@@ -0,0 +1,201 @@
+#include "thumbnailworker.h"
+#include "recordingreader.h"
+#include "frameconvert.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+namespace
+{
+    const quint32 kCacheMagic = 0x544e4f54; // "TONT"
+    const quint32 kCacheVersion = 1;
+
+    const int kThumbnailWidth = 160;
+    const int kMaxThumbnails = 600;
+}
+
+ThumbnailWorker::ThumbnailWorker(const QString& fileName, QObject* parent) :
+    QThread(parent),
+    m_fileName(fileName),
+    m_focusIndex(0)
+{
+}
+
+ThumbnailWorker::~ThumbnailWorker()
+{
+    requestInterruption();
+    wait();
+}
+
+void ThumbnailWorker::setFocusIndex(int index)
+{
+    m_focusIndex.store(index);
+}
+
+QString ThumbnailWorker::cacheFilePath() const
+{
+    QFileInfo info(m_fileName);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+    QString dirPath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    QDir().mkpath(dirPath);
+
+    return dirPath + "/" + QString::fromLatin1(hash.result().toHex()) + ".thumbs";
+}
+
+int ThumbnailWorker::nextIndex(const QVector<bool>& done) const
+{
+    int count = done.size();
+    int focus = qBound(0, m_focusIndex.load(), count - 1);
+
+    // Walk outward from the visible region.
+    for (int distance = 0; distance < count; ++distance)
+    {
+        int right = focus + distance;
+        if (right < count && !done[right])
+        {
+            return right;
+        }
+
+        int left = focus - distance;
+        if (left >= 0 && !done[left])
+        {
+            return left;
+        }
+    }
+
+    return -1;
+}
+
+void ThumbnailWorker::run()
+{
+    RecordingReader reader;
+    if (reader.open(m_fileName) != openni::STATUS_OK)
+    {
+        return;
+    }
+
+    openni::SensorType masterSensor = reader.hasStream(openni::SENSOR_DEPTH) ? openni::SENSOR_DEPTH : openni::SENSOR_COLOR;
+    int numberOfFrames = reader.getNumberOfFrames(masterSensor);
+    if (numberOfFrames <= 0)
+    {
+        return;
+    }
+
+    int fps = qMax(1, reader.getFps(masterSensor));
+    int interval = qMax(fps, (numberOfFrames + kMaxThumbnails - 1) / kMaxThumbnails);
+    int count = (numberOfFrames + interval - 1) / interval;
+
+    emit layoutReady(count, interval);
+
+    QVector<bool> done(count, false);
+    int remaining = count;
+
+    // Replay what a previous run left in the cache.
+    QFile cacheFile(cacheFilePath());
+    bool bCacheValid = false;
+    qint64 validSize = 0;
+    if (cacheFile.open(QIODevice::ReadOnly))
+    {
+        QDataStream in(&cacheFile);
+        quint32 magic = 0, version = 0;
+        qint32 cachedFrames = 0, cachedInterval = 0;
+        in >> magic >> version >> cachedFrames >> cachedInterval;
+
+        bCacheValid = (in.status() == QDataStream::Ok && magic == kCacheMagic && version == kCacheVersion &&
+                       cachedFrames == numberOfFrames && cachedInterval == interval);
+        validSize = cacheFile.pos();
+
+        while (bCacheValid && !in.atEnd() && !isInterruptionRequested())
+        {
+            qint32 index = -1;
+            QImage depth, color;
+            in >> index >> depth >> color;
+            if (in.status() != QDataStream::Ok || index < 0 || index >= count)
+            {
+                // Truncated tail from an interrupted run, regenerate from here.
+                break;
+            }
+            validSize = cacheFile.pos();
+
+            if (!done[index])
+            {
+                done[index] = true;
+                --remaining;
+            }
+            emit thumbnailReady(index, depth, color);
+        }
+        cacheFile.close();
+    }
+
+    if (remaining == 0 || isInterruptionRequested())
+    {
+        return;
+    }
+
+    if (bCacheValid)
+    {
+        cacheFile.resize(validSize);
+    }
+
+    if (!cacheFile.open(bCacheValid ? QIODevice::Append : (QIODevice::WriteOnly | QIODevice::Truncate)))
+    {
+        return;
+    }
+
+    QDataStream out(&cacheFile);
+    if (!bCacheValid)
+    {
+        out << kCacheMagic << kCacheVersion << qint32(numberOfFrames) << qint32(interval);
+    }
+
+    while (remaining > 0 && !isInterruptionRequested())
+    {
+        int index = nextIndex(done);
+        if (index < 0)
+        {
+            break;
+        }
+
+        // ONI frame indices start at 1.
+        int frameId = index * interval + 1;
+
+        QImage depth, color;
+        openni::VideoFrameRef frame;
+
+        if (reader.readFrameAt(masterSensor, frameId, &frame) == openni::STATUS_OK)
+        {
+            int step = qMax(1, frame.getWidth() / kThumbnailWidth);
+            if (masterSensor == openni::SENSOR_DEPTH)
+            {
+                depth = depthFrameToImage(frame, step);
+            }
+            else
+            {
+                color = colorFrameToImage(frame, step);
+            }
+        }
+
+        if (masterSensor == openni::SENSOR_DEPTH && reader.hasStream(openni::SENSOR_COLOR) &&
+            reader.readNextFrame(openni::SENSOR_COLOR, &frame) == openni::STATUS_OK)
+        {
+            color = colorFrameToImage(frame, qMax(1, frame.getWidth() / kThumbnailWidth));
+        }
+
+        out << qint32(index) << depth << color;
+        cacheFile.flush();
+
+        done[index] = true;
+        --remaining;
+
+        emit thumbnailReady(index, depth, color);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef THUMBNAILWORKER_H
+#define THUMBNAILWORKER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+// Background generator for the timeline thumbnails of one recording.
+// Opens the file through its own RecordingReader, so it never competes with
+// the streams used for playback, and appends every thumbnail to an on-disk
+// cache keyed by file path, size and modification time. Thumbnails nearest to
+// the focus index are generated first.
+class ThumbnailWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailWorker(const QString& fileName, QObject* parent = nullptr);
+    ~ThumbnailWorker();
+
+    // Index of the thumbnail in the middle of the visible part of the strip.
+    void setFocusIndex(int index);
+
+signals:
+    void layoutReady(int count, int interval);
+
+    void thumbnailReady(int index, const QImage& depth, const QImage& color);
+
+protected:
+    void run() override;
+
+private:
+    QString cacheFilePath() const;
+
+    int nextIndex(const QVector<bool>& done) const;
+
+    QString m_fileName;
+
+    QAtomicInt m_focusIndex;
+};
+
+#endif // THUMBNAILWORKER_H
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui widgets multimedia multimediawidgets
+QT       += core gui widgets multimedia multimediawidgets concurrent network
 
 TARGET = untitled
 TEMPLATE = app
@@ -24,10 +24,95 @@ CONFIG += c++11
 
 SOURCES += \
         main.cpp \
-        mainwindow.cpp
+        mainwindow.cpp \
+        recordingreader.cpp \
+        frameconvert.cpp \
+        thumbnailworker.cpp \
+        thumbnailstrip.cpp \
+        framequery.cpp \
+        framequerydialog.cpp \
+        onifilereader.cpp \
+        fasthash.cpp \
+        healthscanner.cpp \
+        headless.cpp \
+        onifilewriter.cpp \
+        onistreamcopy.cpp \
+        opennisession.cpp \
+        livestreamlistener.cpp \
+        depthfilter.cpp \
+        depthfilterdialog.cpp \
+        backgroundmodel.cpp \
+        planedetector.cpp \
+        readaheadprefetcher.cpp \
+        framepublisher.cpp \
+        previewserver.cpp \
+        recordingwriter.cpp \
+        gridview.cpp \
+        reversereader.cpp \
+        archiveformat.cpp \
+        archivewriter.cpp \
+        archivereader.cpp \
+        depthcodec.cpp \
+        aviwriter.cpp \
+        videoexport.cpp \
+        videosurfaceview.cpp \
+        onivideosource.cpp \
+        memorygovernor.cpp \
+        framesequence.cpp \
+        depthstats.cpp \
+        depthstatspanel.cpp \
+        mipmappyramid.cpp \
+        taskscheduler.cpp
 
 HEADERS += \
-        mainwindow.h
+        mainwindow.h \
+        recordingreader.h \
+        frameconvert.h \
+        thumbnailworker.h \
+        thumbnailstrip.h \
+        framequery.h \
+        framequerydialog.h \
+        simd.h \
+        onirecord.h \
+        onifilereader.h \
+        fasthash.h \
+        healthscanner.h \
+        headless.h \
+        onifilewriter.h \
+        onistreamcopy.h \
+        opennisession.h \
+        framemailbox.h \
+        livestreamlistener.h \
+        depthfilter.h \
+        depthfilterdialog.h \
+        backgroundmodel.h \
+        planedetector.h \
+        readaheadprefetcher.h \
+        framering.h \
+        framepublisher.h \
+        previewserver.h \
+        recordingwriter.h \
+        gridview.h \
+        reversereader.h \
+        archiveformat.h \
+        archivewriter.h \
+        archivereader.h \
+        depthcodec.h \
+        aviwriter.h \
+        videoexport.h \
+        videosurfaceview.h \
+        onivideosource.h \
+        memorygovernor.h \
+        framesequence.h \
+        depthstats.h \
+        depthstatspanel.h \
+        mipmappyramid.h \
+        taskscheduler.h \
+        depthprediction.h
+
+# Subscriber side of the frame ring, for other processes.
+DISTFILES += \
+        framering.pri
 
 FORMS += \
         mainwindow.ui
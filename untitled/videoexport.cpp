@@ -0,0 +1,318 @@
+#include "videoexport.h"
+#include "aviwriter.h"
+#include "frameconvert.h"
+#include "recordingreader.h"
+#include "taskscheduler.h"
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFuture>
+#include <QImage>
+#include <QObject>
+#include <QPainter>
+#include <QQueue>
+
+namespace
+{
+    // Frames being rendered or waiting to be written, per worker thread.
+    const int kFramesInFlightPerThread = 2;
+
+    // Rows packed without padding, copied off the reader's frames.
+    struct ExportFrame
+    {
+        QByteArray depth;
+        QByteArray color;
+    };
+
+    struct FrameLayout
+    {
+        int depthWidth = 0;
+        int depthHeight = 0;
+        int colorWidth = 0;
+        int colorHeight = 0;
+    };
+
+    // Only the rows and columns of region are copied.
+    QByteArray packRows(const openni::VideoFrameRef& frame, int bytesPerPixel, const QRect& region)
+    {
+        int rowBytes = region.width() * bytesPerPixel;
+        QByteArray data;
+        data.reserve(rowBytes * region.height());
+        const char* src = reinterpret_cast<const char*>(regionData(frame.getData(), frame.getStrideInBytes(), bytesPerPixel, region));
+        for (int y = 0; y < region.height(); ++y)
+        {
+            data.append(src + y * frame.getStrideInBytes(), rowBytes);
+        }
+        return data;
+    }
+
+    QByteArray renderFrame(const ExportFrame& frame, const FrameLayout& layout, const VideoExportSettings& settings)
+    {
+        if (settings.format == VideoExportSettings::Format_RawY16)
+        {
+            return frame.depth;
+        }
+
+        QImage depthImage;
+        QImage colorImage;
+        if (settings.view != VideoExportSettings::View_Color)
+        {
+            depthImage = colorizeDepth(reinterpret_cast<const openni::DepthPixel*>(frame.depth.constData()),
+                                       layout.depthWidth, layout.depthHeight, layout.depthWidth * int(sizeof(openni::DepthPixel)));
+        }
+        if (settings.view != VideoExportSettings::View_Depth)
+        {
+            colorImage = QImage(reinterpret_cast<const uchar*>(frame.color.constData()), layout.colorWidth, layout.colorHeight,
+                                layout.colorWidth * 3, QImage::Format_RGB888);
+        }
+
+        QImage image;
+        switch (settings.view)
+        {
+        case VideoExportSettings::View_Depth:
+            image = depthImage;
+            break;
+        case VideoExportSettings::View_Color:
+            image = colorImage;
+            break;
+        case VideoExportSettings::View_SideBySide:
+        {
+            image = QImage(layout.depthWidth + layout.colorWidth, qMax(layout.depthHeight, layout.colorHeight), QImage::Format_RGB32);
+            image.fill(Qt::black);
+            QPainter painter(&image);
+            painter.drawImage(0, 0, depthImage);
+            painter.drawImage(layout.depthWidth, 0, colorImage);
+            break;
+        }
+        }
+
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "JPG", settings.jpegQuality);
+        return jpeg;
+    }
+}
+
+bool exportVideo(const QString& oniFileName, const QString& outputFileName, const VideoExportSettings& settings,
+                 QString* pError, VideoExportStats* pStats, const QAtomicInt* pCanceled, QAtomicInt* pProgress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (settings.format == VideoExportSettings::Format_RawY16 && settings.view != VideoExportSettings::View_Depth)
+    {
+        *pError = QObject::tr("Raw Y16 holds depth only");
+        return false;
+    }
+
+    RecordingReader reader;
+    if (reader.open(oniFileName) != openni::STATUS_OK)
+    {
+        *pError = QObject::tr("%1: %2").arg(oniFileName).arg(QString::fromLatin1(openni::OpenNI::getExtendedError()));
+        return false;
+    }
+
+    bool bDepth = settings.view != VideoExportSettings::View_Color;
+    bool bColor = settings.view != VideoExportSettings::View_Depth;
+    if ((bDepth && !reader.hasStream(openni::SENSOR_DEPTH)) || (bColor && !reader.hasStream(openni::SENSOR_COLOR)))
+    {
+        *pError = QObject::tr("%1: the recording lacks a stream of this view").arg(oniFileName);
+        return false;
+    }
+
+    // Depth sets the frame numbers and the pace when it is part of the view.
+    openni::SensorType reference = bDepth ? openni::SENSOR_DEPTH : openni::SENSOR_COLOR;
+    int numberOfFrames = reader.getNumberOfFrames(reference);
+    int firstFrame = settings.firstFrame > 0 ? settings.firstFrame : 1;
+    int lastFrame = settings.lastFrame > 0 ? qMin(settings.lastFrame, numberOfFrames) : numberOfFrames;
+    if (firstFrame > lastFrame)
+    {
+        *pError = QObject::tr("%1: no frames in the selected range").arg(oniFileName);
+        return false;
+    }
+
+    openni::VideoFrameRef referenceFrame;
+    openni::VideoFrameRef colorFrame;
+    openni::Status nRetVal = reader.readFrameAt(reference, firstFrame, &referenceFrame);
+    if (nRetVal == openni::STATUS_OK && reference != openni::SENSOR_COLOR && bColor)
+    {
+        nRetVal = reader.readNextFrame(openni::SENSOR_COLOR, &colorFrame);
+    }
+    if (nRetVal != openni::STATUS_OK)
+    {
+        *pError = QObject::tr("%1: cannot read frame %2").arg(oniFileName).arg(firstFrame);
+        return false;
+    }
+    if (reference == openni::SENSOR_COLOR)
+    {
+        colorFrame = referenceFrame;
+    }
+
+    // Frames of a stream keep their size, so does the region.
+    QRect depthRegion;
+    QRect colorRegion;
+    FrameLayout layout;
+    if (bDepth)
+    {
+        depthRegion = regionRect(settings.region, referenceFrame.getWidth(), referenceFrame.getHeight());
+        layout.depthWidth = depthRegion.width();
+        layout.depthHeight = depthRegion.height();
+    }
+    if (bColor)
+    {
+        colorRegion = regionRect(settings.region, colorFrame.getWidth(), colorFrame.getHeight());
+        layout.colorWidth = colorRegion.width();
+        layout.colorHeight = colorRegion.height();
+    }
+    int depthFrameWidth = referenceFrame.getWidth();
+    int depthFrameHeight = referenceFrame.getHeight();
+    int colorFrameWidth = colorFrame.isValid() ? colorFrame.getWidth() : 0;
+    int colorFrameHeight = colorFrame.isValid() ? colorFrame.getHeight() : 0;
+    int width = layout.depthWidth + layout.colorWidth;
+    int height = qMax(layout.depthHeight, layout.colorHeight);
+    int fps = reader.getFps(reference);
+
+    AviWriter aviWriter;
+    QFile rawFile(outputFileName);
+    bool bAvi = settings.format == VideoExportSettings::Format_MjpegAvi;
+    bool bOpened = bAvi ? aviWriter.open(outputFileName, width, height, fps)
+                        : rawFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!bOpened)
+    {
+        *pError = QObject::tr("%1: %2").arg(outputFileName).arg(bAvi ? aviWriter.errorString() : rawFile.errorString());
+        return false;
+    }
+
+    QQueue<QFuture<QByteArray> > pending;
+    int maxInFlight = qMax(2, TaskScheduler::instance()->workerCount() * kFramesInFlightPerThread);
+    int framesRead = 0;
+    int framesWritten = 0;
+    qint64 bytesWritten = 0;
+    bool bOk = true;
+
+    // Writes the oldest frame; rendering finishes out of order, the file
+    // gets the frames in the order they were read.
+    auto writeNext = [&]() -> bool
+    {
+        QFuture<QByteArray> rendered = pending.dequeue();
+        TaskScheduler::instance()->waitFor(rendered);
+        QByteArray data = rendered.result();
+        if (data.isEmpty())
+        {
+            *pError = QObject::tr("Encoding frame %1 failed").arg(firstFrame + framesWritten);
+            return false;
+        }
+        bool bWritten = bAvi ? aviWriter.writeFrame(data) : rawFile.write(data) == data.size();
+        if (!bWritten)
+        {
+            *pError = bAvi ? aviWriter.errorString() : rawFile.errorString();
+            return false;
+        }
+        ++framesWritten;
+        bytesWritten += data.size();
+        return true;
+    };
+
+    int total = lastFrame - firstFrame + 1;
+    while (nRetVal == openni::STATUS_OK && bOk)
+    {
+        if (pCanceled != NULL && pCanceled->load())
+        {
+            *pError = QObject::tr("Canceled");
+            bOk = false;
+            break;
+        }
+
+        // A mode change mid-file would not fit the video, the export ends there.
+        if ((bDepth && (referenceFrame.getWidth() != depthFrameWidth || referenceFrame.getHeight() != depthFrameHeight)) ||
+            (bColor && (colorFrame.getWidth() != colorFrameWidth || colorFrame.getHeight() != colorFrameHeight)))
+        {
+            break;
+        }
+
+        ExportFrame frame;
+        if (bDepth)
+        {
+            frame.depth = packRows(referenceFrame, int(sizeof(openni::DepthPixel)), depthRegion);
+        }
+        if (bColor)
+        {
+            frame.color = packRows(colorFrame, 3, colorRegion);
+        }
+        pending.enqueue(TaskScheduler::instance()->run(TaskScheduler::Priority_Background, [frame, layout, settings]()
+        {
+            return renderFrame(frame, layout, settings);
+        }));
+        ++framesRead;
+
+        while (pending.size() >= maxInFlight && bOk)
+        {
+            bOk = writeNext();
+        }
+
+        if (pProgress != NULL)
+        {
+            pProgress->store(framesRead * 1000 / total);
+        }
+
+        if (referenceFrame.getFrameIndex() >= lastFrame || framesRead >= total)
+        {
+            break;
+        }
+
+        // The color stream advances in step with the reference.
+        nRetVal = reader.readNextFrame(reference, &referenceFrame);
+        if (reference == openni::SENSOR_COLOR)
+        {
+            colorFrame = referenceFrame;
+        }
+        else if (nRetVal == openni::STATUS_OK && bColor)
+        {
+            nRetVal = reader.readNextFrame(openni::SENSOR_COLOR, &colorFrame);
+        }
+    }
+
+    while (!pending.isEmpty())
+    {
+        if (bOk)
+        {
+            bOk = writeNext();
+        }
+        else
+        {
+            TaskScheduler::instance()->waitFor(pending.dequeue());
+        }
+    }
+
+    if (bAvi)
+    {
+        bOk = aviWriter.close() && bOk;
+        if (!bOk && pError->isEmpty())
+        {
+            *pError = aviWriter.errorString();
+        }
+    }
+    else
+    {
+        rawFile.close();
+    }
+
+    if (!bOk)
+    {
+        QFile::remove(outputFileName);
+        return false;
+    }
+
+    if (pStats != NULL)
+    {
+        pStats->frames = framesWritten;
+        pStats->width = bAvi ? width : layout.depthWidth;
+        pStats->height = bAvi ? height : layout.depthHeight;
+        pStats->fps = fps;
+        pStats->bytes = bytesWritten;
+        pStats->seconds = timer.elapsed() / 1000.0;
+    }
+
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef VIDEOEXPORT_H
+#define VIDEOEXPORT_H
+
+#include <QAtomicInt>
+#include <QRectF>
+#include <QString>
+
+struct VideoExportSettings
+{
+    enum View
+    {
+        View_Depth,
+        View_Color,
+        // Colorized depth on the left, color on the right.
+        View_SideBySide
+    };
+
+    enum Format
+    {
+        Format_MjpegAvi,
+        // Depth values as 16-bit little endian frames without any header,
+        // e.g. for ffmpeg -f rawvideo -pix_fmt gray16le. Depth view only.
+        Format_RawY16
+    };
+
+    View view = View_Depth;
+    Format format = Format_MjpegAvi;
+    int jpegQuality = 85;
+    // Frame numbers of the reference stream, 0 means the start or end of the file.
+    int firstFrame = 0;
+    int lastFrame = 0;
+    // Part of the frames to export as a fraction of their size, the same
+    // part of depth and color; null exports whole frames.
+    QRectF region;
+};
+
+struct VideoExportStats
+{
+    int frames = 0;
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    qint64 bytes = 0;
+    double seconds = 0;
+};
+
+// Renders a view of an .oni recording into an ordinary video file.
+// Frames are read in order on the calling thread; colorizing and JPEG
+// encoding run as background tasks of the scheduler and are written back
+// in frame order, so the output does not depend on the thread count.
+// pProgress, when given, receives the progress in per mille.
+bool exportVideo(const QString& oniFileName, const QString& outputFileName, const VideoExportSettings& settings,
+                 QString* pError, VideoExportStats* pStats = NULL,
+                 const QAtomicInt* pCanceled = NULL, QAtomicInt* pProgress = NULL);
+
+#endif // VIDEOEXPORT_H
@@ -0,0 +1,426 @@
+#include "videosurfaceview.h"
+#include "taskscheduler.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QVideoSurfaceFormat>
+#include <QWheelEvent>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    // Most a frame can be magnified, relative to fitting the view.
+    const double kMaxZoom = 128;
+
+    // Zoom factor of one wheel notch.
+    const double kZoomStep = 1.25;
+
+    // Around the values written into magnified pixels.
+    const int kReadoutPadding = 4;
+}
+
+ViewVideoSurface::ViewVideoSurface(VideoSurfaceView* pView) :
+    QAbstractVideoSurface(pView),
+    m_pView(pView)
+{
+}
+
+QList<QVideoFrame::PixelFormat> ViewVideoSurface::supportedPixelFormats(QAbstractVideoBuffer::HandleType handleType) const
+{
+    // Formats QImage can wrap without conversion.
+    QList<QVideoFrame::PixelFormat> formats;
+    if (handleType == QAbstractVideoBuffer::NoHandle)
+    {
+        formats << QVideoFrame::Format_RGB32 << QVideoFrame::Format_ARGB32 << QVideoFrame::Format_ARGB32_Premultiplied
+                << QVideoFrame::Format_RGB24 << QVideoFrame::Format_RGB565 << QVideoFrame::Format_RGB555;
+    }
+    return formats;
+}
+
+bool ViewVideoSurface::start(const QVideoSurfaceFormat& format)
+{
+    if (QVideoFrame::imageFormatFromPixelFormat(format.pixelFormat()) == QImage::Format_Invalid ||
+        format.handleType() != QAbstractVideoBuffer::NoHandle)
+    {
+        return false;
+    }
+
+    return QAbstractVideoSurface::start(format);
+}
+
+void ViewVideoSurface::stop()
+{
+    m_pView->setCurrentFrame(QVideoFrame());
+    QAbstractVideoSurface::stop();
+}
+
+bool ViewVideoSurface::present(const QVideoFrame& frame)
+{
+    if (!isActive() || frame.pixelFormat() != surfaceFormat().pixelFormat())
+    {
+        setError(IncorrectFormatError);
+        return false;
+    }
+
+    m_pView->setCurrentFrame(frame);
+    return true;
+}
+
+VideoSurfaceView::VideoSurfaceView(QWidget* parent) :
+    QWidget(parent),
+    m_pSurface(new ViewVideoSurface(this)),
+    m_pPyramidWatcher(new QFutureWatcher<MipmapPyramid>(this))
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    setMouseTracking(true);
+
+    connect(m_pPyramidWatcher, &QFutureWatcher<MipmapPyramid>::finished, this, &VideoSurfaceView::onPyramidBuilt);
+}
+
+void VideoSurfaceView::setCurrentFrame(const QVideoFrame& frame)
+{
+    if (frame.size() != m_currentFrame.size())
+    {
+        m_pyramid = MipmapPyramid();
+        m_pyramidSerial = -1;
+    }
+    m_currentFrame = frame;
+    ++m_frameSerial;
+    m_valuesSize = QSize();
+    clampCenter();
+    update();
+}
+
+void VideoSurfaceView::setPixelValues(const quint16* pValues, int width, int height, int strideBytes)
+{
+    if (QSize(width, height) != m_currentFrame.size())
+    {
+        return;
+    }
+
+    // Same size every frame, so the buffer is reused.
+    m_values.resize(width * height);
+    const uchar* pInput = reinterpret_cast<const uchar*>(pValues);
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(m_values.data() + y * width, pInput + qint64(y) * strideBytes, width * sizeof(quint16));
+    }
+    m_valuesSize = QSize(width, height);
+    update();
+}
+
+QRectF VideoSurfaceView::frameRect() const
+{
+    if (!m_currentFrame.isValid())
+    {
+        return QRectF();
+    }
+
+    QSizeF size = QSizeF(m_currentFrame.size()).scaled(QSizeF(this->size()), Qt::KeepAspectRatio) * m_zoom;
+    return QRectF(width() / 2.0 - m_center.x() * size.width(), height() / 2.0 - m_center.y() * size.height(),
+                  size.width(), size.height());
+}
+
+void VideoSurfaceView::clampCenter()
+{
+    QRectF frame = frameRect();
+    if (frame.isEmpty())
+    {
+        return;
+    }
+
+    // Centered on an axis where the whole frame fits, otherwise no
+    // background shows on that axis.
+    double halfX = width() / (2 * frame.width());
+    double halfY = height() / (2 * frame.height());
+    m_center.setX(halfX >= 0.5 ? 0.5 : qBound(halfX, m_center.x(), 1 - halfX));
+    m_center.setY(halfY >= 0.5 ? 0.5 : qBound(halfY, m_center.y(), 1 - halfY));
+}
+
+void VideoSurfaceView::setView(double zoom, const QPointF& center)
+{
+    zoom = qBound(1.0, zoom, kMaxZoom);
+    if (zoom == m_zoom && center == m_center)
+    {
+        return;
+    }
+
+    m_zoom = zoom;
+    m_center = center;
+    clampCenter();
+    update();
+}
+
+void VideoSurfaceView::changeView(double zoom, const QPointF& center)
+{
+    QPointF oldCenter = m_center;
+    double oldZoom = m_zoom;
+    setView(zoom, center);
+    if (m_zoom != oldZoom || m_center != oldCenter)
+    {
+        emit viewChanged(m_zoom, m_center);
+    }
+}
+
+void VideoSurfaceView::fitFrame()
+{
+    changeView(1, QPointF(0.5, 0.5));
+}
+
+QPoint VideoSurfaceView::framePixelAt(const QPoint& position) const
+{
+    // Zoomed frames reach past the widget, off it there is no pixel.
+    QRectF frame = frameRect();
+    if (frame.isEmpty() || !rect().contains(position) || !frame.contains(position))
+    {
+        return QPoint(-1, -1);
+    }
+
+    int x = int((position.x() - frame.x()) * m_currentFrame.width() / frame.width());
+    int y = int((position.y() - frame.y()) * m_currentFrame.height() / frame.height());
+    return QPoint(qMin(x, m_currentFrame.width() - 1), qMin(y, m_currentFrame.height() - 1));
+}
+
+void VideoSurfaceView::setSelecting(bool bSelecting)
+{
+    m_bSelecting = bSelecting;
+    setCursor(bSelecting ? Qt::CrossCursor : Qt::ArrowCursor);
+    if (!bSelecting && m_pRubberBand != nullptr)
+    {
+        m_pRubberBand->hide();
+    }
+}
+
+void VideoSurfaceView::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton || !m_currentFrame.isValid())
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    if (!m_bSelecting)
+    {
+        if (m_zoom <= 1)
+        {
+            QWidget::mousePressEvent(event);
+            return;
+        }
+        m_bPanning = true;
+        m_panStart = event->pos();
+        m_panStartCenter = m_center;
+        setCursor(Qt::ClosedHandCursor);
+        return;
+    }
+
+    if (m_pRubberBand == nullptr)
+    {
+        m_pRubberBand = new QRubberBand(QRubberBand::Rectangle, this);
+    }
+    m_selectionStart = event->pos();
+    m_pRubberBand->setGeometry(QRect(m_selectionStart, QSize()));
+    m_pRubberBand->show();
+}
+
+void VideoSurfaceView::mouseMoveEvent(QMouseEvent* event)
+{
+    m_hoverPosition = event->pos();
+
+    if (m_bPanning)
+    {
+        QRectF frame = frameRect();
+        QPoint delta = event->pos() - m_panStart;
+        changeView(m_zoom, m_panStartCenter - QPointF(delta.x() / frame.width(), delta.y() / frame.height()));
+        return;
+    }
+
+    if (m_pRubberBand == nullptr || !m_pRubberBand->isVisible())
+    {
+        // Moves the readout of the pixel under the cursor.
+        update();
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+
+    m_pRubberBand->setGeometry(QRect(m_selectionStart, event->pos()).normalized().intersected(frameRect().toAlignedRect()));
+}
+
+void VideoSurfaceView::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (m_bPanning && event->button() == Qt::LeftButton)
+    {
+        m_bPanning = false;
+        setCursor(m_bSelecting ? Qt::CrossCursor : Qt::ArrowCursor);
+        return;
+    }
+
+    if (m_pRubberBand == nullptr || !m_pRubberBand->isVisible() || event->button() != Qt::LeftButton)
+    {
+        QWidget::mouseReleaseEvent(event);
+        return;
+    }
+
+    m_pRubberBand->hide();
+    QRectF frame = frameRect();
+    QRect selection = QRect(m_selectionStart, event->pos()).normalized().intersected(frame.toAlignedRect());
+    if (selection.width() < 2 || selection.height() < 2)
+    {
+        return;
+    }
+
+    QRectF region((selection.x() - frame.x()) / frame.width(), (selection.y() - frame.y()) / frame.height(),
+                  selection.width() / frame.width(), selection.height() / frame.height());
+    emit regionSelected(region & QRectF(0, 0, 1, 1));
+}
+
+void VideoSurfaceView::mouseDoubleClickEvent(QMouseEvent* event)
+{
+    if (m_bSelecting || event->button() != Qt::LeftButton)
+    {
+        QWidget::mouseDoubleClickEvent(event);
+        return;
+    }
+
+    fitFrame();
+}
+
+void VideoSurfaceView::wheelEvent(QWheelEvent* event)
+{
+    QRectF frame = frameRect();
+    if (frame.isEmpty() || event->angleDelta().y() == 0)
+    {
+        QWidget::wheelEvent(event);
+        return;
+    }
+
+    double zoom = qBound(1.0, m_zoom * pow(kZoomStep, event->angleDelta().y() / 120.0), kMaxZoom);
+
+    // The point of the frame under the cursor stays where it is.
+    QPointF cursor = event->posF();
+    QPointF anchor((cursor.x() - frame.x()) / frame.width(), (cursor.y() - frame.y()) / frame.height());
+    double newWidth = frame.width() * zoom / m_zoom;
+    double newHeight = frame.height() * zoom / m_zoom;
+    changeView(zoom, QPointF(anchor.x() + (width() / 2.0 - cursor.x()) / newWidth,
+                             anchor.y() + (height() / 2.0 - cursor.y()) / newHeight));
+    event->accept();
+}
+
+void VideoSurfaceView::resizeEvent(QResizeEvent* event)
+{
+    clampCenter();
+    QWidget::resizeEvent(event);
+}
+
+void VideoSurfaceView::leaveEvent(QEvent* event)
+{
+    m_hoverPosition = QPoint(-1, -1);
+    update();
+    QWidget::leaveEvent(event);
+}
+
+void VideoSurfaceView::startPyramid(const QImage& image)
+{
+    // One build at a time; when it is done the next paint asks again
+    // with the frame that is current by then.
+    if (m_pPyramidWatcher->isRunning())
+    {
+        return;
+    }
+
+    // The source reuses its frame buffers.
+    QImage copy = image.copy();
+    m_buildingSerial = m_frameSerial;
+    m_pPyramidWatcher->setFuture(TaskScheduler::instance()->run(TaskScheduler::Priority_Interactive, [copy]()
+    {
+        return MipmapPyramid::build(copy);
+    }));
+}
+
+void VideoSurfaceView::onPyramidBuilt()
+{
+    m_pyramid = m_pPyramidWatcher->result();
+    m_pyramidSerial = m_buildingSerial;
+    update();
+}
+
+void VideoSurfaceView::drawReadout(QPainter* pPainter, const QImage& image, const QRectF& frame, const QRect& clip)
+{
+    bool bValues = (m_valuesSize == image.size());
+    double scale = frame.width() / image.width();
+
+    // Values go into the pixels once five digits fit.
+    if (bValues && scale >= pPainter->fontMetrics().width("00000") + 2 * kReadoutPadding)
+    {
+        int left = qMax(0, int(floor((clip.left() - frame.x()) / scale)));
+        int top = qMax(0, int(floor((clip.top() - frame.y()) / scale)));
+        int right = qMin(image.width(), int(ceil((clip.right() + 1 - frame.x()) / scale)));
+        int bottom = qMin(image.height(), int(ceil((clip.bottom() + 1 - frame.y()) / scale)));
+        for (int y = top; y < bottom; ++y)
+        {
+            for (int x = left; x < right; ++x)
+            {
+                pPainter->setPen(qGray(image.pixel(x, y)) < 128 ? Qt::white : Qt::black);
+                pPainter->drawText(QRectF(frame.x() + x * scale, frame.y() + y * scale, scale, scale), Qt::AlignCenter,
+                                   QString::number(m_values[y * image.width() + x]));
+            }
+        }
+    }
+
+    QPoint pixel = framePixelAt(m_hoverPosition);
+    if (pixel.x() < 0)
+    {
+        return;
+    }
+
+    QString value = bValues ? QString::number(m_values[pixel.y() * image.width() + pixel.x()])
+                            : QColor(image.pixel(pixel)).name();
+    QString text = tr("%1, %2: %3").arg(pixel.x()).arg(pixel.y()).arg(value);
+    QRect textRect = pPainter->fontMetrics().boundingRect(text).adjusted(-kReadoutPadding, -kReadoutPadding, kReadoutPadding, kReadoutPadding);
+    textRect.moveTopLeft(QPoint(kReadoutPadding, kReadoutPadding));
+    pPainter->fillRect(textRect, QColor(0, 0, 0, 160));
+    pPainter->setPen(Qt::white);
+    pPainter->drawText(textRect, Qt::AlignCenter, text);
+}
+
+void VideoSurfaceView::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    painter.fillRect(event->rect(), Qt::black);
+
+    QVideoFrame frame = m_currentFrame;
+    if (!frame.isValid() || !frame.map(QAbstractVideoBuffer::ReadOnly))
+    {
+        return;
+    }
+
+    QImage image(frame.bits(), frame.width(), frame.height(), frame.bytesPerLine(),
+                 QVideoFrame::imageFormatFromPixelFormat(frame.pixelFormat()));
+    QRectF target = frameRect();
+    double scale = target.width() / image.width();
+
+    // Only the pyramid of this very frame is drawn, until it is built the
+    // frame is reduced while drawing. A frame painted once, as most are
+    // during playback, is not worth a pyramid; one painted again, paused,
+    // zoomed or panned, is.
+    int level = MipmapPyramid::levelFor(scale);
+    if (level > 0 && m_pyramidSerial != m_frameSerial && m_paintedSerial == m_frameSerial)
+    {
+        startPyramid(image);
+    }
+    m_paintedSerial = m_frameSerial;
+    if (level > 0 && m_pyramidSerial == m_frameSerial)
+    {
+        const QImage& reduced = m_pyramid.level(qMin(level, m_pyramid.levelCount() - 1));
+        drawTiles(&painter, reduced, target.width() / reduced.width(), target.topLeft(), event->rect());
+    }
+    else
+    {
+        drawTiles(&painter, image, scale, target.topLeft(), event->rect());
+    }
+
+    drawReadout(&painter, image, target, event->rect());
+
+    frame.unmap();
+}
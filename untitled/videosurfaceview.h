@@ -0,0 +1,140 @@
+#ifndef VIDEOSURFACEVIEW_H
+#define VIDEOSURFACEVIEW_H
+
+#include <QAbstractVideoSurface>
+#include <QFutureWatcher>
+#include <QRubberBand>
+#include <QVector>
+#include <QVideoFrame>
+#include <QWidget>
+#include "mipmappyramid.h"
+
+class VideoSurfaceView;
+
+// Keeps the latest presented frame for its view and schedules a repaint.
+class ViewVideoSurface : public QAbstractVideoSurface
+{
+public:
+    explicit ViewVideoSurface(VideoSurfaceView* pView);
+
+    QList<QVideoFrame::PixelFormat> supportedPixelFormats(QAbstractVideoBuffer::HandleType handleType = QAbstractVideoBuffer::NoHandle) const override;
+
+    bool start(const QVideoSurfaceFormat& format) override;
+
+    void stop() override;
+
+    bool present(const QVideoFrame& frame) override;
+
+private:
+    VideoSurfaceView* m_pView;
+};
+
+// Video output shared by both player modes: QMediaPlayer renders into its
+// surface in the standard mode, OniVideoSource in ONI mode. The wheel
+// zooms around the cursor, a drag pans and a double click fits the frame
+// again. Magnified frames are painted straight from the mapped buffer;
+// reduced ones that are painted more than once from a mipmap pyramid of
+// that frame, built as an interactive task of the scheduler, one build in
+// flight at a time. Either way only the tiles on screen are drawn. Once a
+// frame pixel is large enough, the values set with setPixelValues are
+// written into it; the pixel under the cursor is always read out. While
+// selecting, a drag picks a region of the frame instead of panning.
+class VideoSurfaceView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit VideoSurfaceView(QWidget* parent = nullptr);
+
+    QAbstractVideoSurface* videoSurface() const { return m_pSurface; }
+
+    void setSelecting(bool bSelecting);
+
+    // Raw values of the frame presented last, e.g. depth in millimetres,
+    // copied. Cleared by the next frame.
+    void setPixelValues(const quint16* pValues, int width, int height, int strideBytes);
+
+    double zoom() const { return m_zoom; }
+
+    QPointF center() const { return m_center; }
+
+public slots:
+    // zoom is relative to the fitted frame, center is the point of the
+    // frame in the middle of the view, 0..1 on both axes.
+    void setView(double zoom, const QPointF& center);
+
+    void fitFrame();
+
+signals:
+    // Relative to the whole frame, 0..1 on both axes.
+    void regionSelected(const QRectF& region);
+
+    // Only emitted for changes made in this view.
+    void viewChanged(double zoom, const QPointF& center);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+    void mousePressEvent(QMouseEvent* event) override;
+
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+    void mouseReleaseEvent(QMouseEvent* event) override;
+
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+    void wheelEvent(QWheelEvent* event) override;
+
+    void resizeEvent(QResizeEvent* event) override;
+
+    void leaveEvent(QEvent* event) override;
+
+private:
+    friend class ViewVideoSurface;
+
+    void setCurrentFrame(const QVideoFrame& frame);
+
+    // Where the whole current frame is drawn, mostly off screen when zoomed.
+    QRectF frameRect() const;
+
+    // Keeps the frame covering the view on the axes where it is larger.
+    void clampCenter();
+
+    void changeView(double zoom, const QPointF& center);
+
+    QPoint framePixelAt(const QPoint& position) const;
+
+    void startPyramid(const QImage& image);
+
+    void onPyramidBuilt();
+
+    void drawReadout(QPainter* pPainter, const QImage& image, const QRectF& frame, const QRect& clip);
+
+    ViewVideoSurface* m_pSurface;
+    QVideoFrame m_currentFrame;
+    int m_frameSerial = 0;
+
+    double m_zoom = 1;
+    QPointF m_center = QPointF(0.5, 0.5);
+
+    bool m_bPanning = false;
+    QPoint m_panStart;
+    QPointF m_panStartCenter;
+    QPoint m_hoverPosition = QPoint(-1, -1);
+
+    int m_paintedSerial = -1;
+
+    MipmapPyramid m_pyramid;
+    int m_pyramidSerial = -1;
+    QFutureWatcher<MipmapPyramid>* m_pPyramidWatcher;
+    int m_buildingSerial = -1;
+
+    QVector<quint16> m_values;
+    QSize m_valuesSize;
+
+    bool m_bSelecting = false;
+    QRubberBand* m_pRubberBand = nullptr;
+    QPoint m_selectionStart;
+};
+
+#endif // VIDEOSURFACEVIEW_H